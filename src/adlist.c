@@ -2,6 +2,321 @@
 #include "adlist.h"
 #include "zmalloc.h"
 
+/*
+ * Free list of listNode structures.
+ *
+ * Queues like the client list or the pending replies add and remove nodes
+ * all the time: instead of a zmalloc()/zfree() per operation, removed
+ * nodes are kept here, linked through their next pointer, and reused by
+ * the following additions. The pool keeps at most node_pool_max nodes, so
+ * that releasing a huge list gives its memory back.
+ *
+ * The pool and its maximum are thread local, so lists can still be
+ * released by a background thread. A thread that only releases lists
+ * should disable its pool with listNodePoolSetMax(0).
+*/
+/*
+ * listNode 结构的空闲链表
+ *
+ * 客户端链表、待回复队列之类的队列会不停地添加和删除结点，
+ * 被删除的结点通过 next 指针链接起来保存在这里，供之后的添加操作重用，
+ * 而不是每次操作都调用 zmalloc()/zfree()
+ * 池中最多保存 node_pool_max 个结点，这样释放很大的链表时内存仍然会被归还
+ *
+ * 结点池和它的最大长度都是线程局部的，所以链表仍然可以由后台线程释放
+ * 只释放链表的线程应该调用 listNodePoolSetMax(0) 关闭自己的结点池
+*/
+#define LIST_NODE_POOL_MAX 1024
+
+static __thread listNode *node_pool = NULL;         // 空闲结点
+static __thread unsigned long node_pool_len = 0;    // 空闲结点数量
+static __thread unsigned long node_pool_max = LIST_NODE_POOL_MAX;  // 池中最多保存的结点数量
+
+/*
+ * Get a node from the pool, or allocate a new one when it is empty.
+ *
+ * T = O(1)
+*/
+// 从结点池中取出一个结点，池为空时分配一个新结点
+static listNode *listNodeAlloc(void) {
+    listNode *node = node_pool;
+
+    if (node == NULL) return zmalloc(sizeof(*node));
+
+    node_pool = node->next;
+    node_pool_len--;
+    return node;
+}
+
+/*
+ * Give a node back to the pool, or free it when the pool is full.
+ *
+ * T = O(1)
+*/
+// 将结点归还给结点池，池已满时释放结点
+static void listNodeRecycle(listNode *node) {
+    if (node_pool_len >= node_pool_max) {
+        zfree(node);
+        return;
+    }
+
+    node->next = node_pool;
+    node_pool = node;
+    node_pool_len++;
+}
+
+/*
+ * Set the maximum number of free nodes kept by the pool of the calling
+ * thread, freeing the extra ones. 0 disables pooling.
+ *
+ * T = O(N)
+*/
+// 设置调用线程的结点池最多保存的空闲结点数量，并释放多出来的结点，0 表示不使用结点池
+void listNodePoolSetMax(unsigned long max) {
+    node_pool_max = max;
+
+    while (node_pool_len > node_pool_max) {
+        listNode *node = node_pool;
+        node_pool = node->next;
+        node_pool_len--;
+        zfree(node);
+    }
+}
+
+/*
+ * Return the number of free nodes in the pool of the calling thread.
+ *
+ * T = O(1)
+*/
+// 返回当前线程的结点池中空闲结点的数量
+unsigned long listNodePoolSize(void) {
+    return node_pool_len;
+}
+
+/*
+ * Positional index.
+ *
+ * listIndex() walks the list one node at a time, which is O(N) for long
+ * lists. Once listSetIndexStep() is called the list keeps a pointer to
+ * every step-th node, starting at position off, so a lookup jumps to the
+ * nearest sample and walks less than step nodes: O(N / step) memory for
+ * O(step) lookups.
+ *
+ * Pushes and pops at both ends keep the index up to date in O(1): at the
+ * head only off changes, adding or dropping a sample when it wraps, at
+ * the tail a sample is appended or dropped. listInsertAt() knows the
+ * position of the new node and moves the following samples by one node,
+ * O(N / step). Any other change to the middle of the list, where the
+ * position of the node is unknown, only flags the index as dirty: it is
+ * rebuilt by the next lookup.
+*/
+/*
+ * 位置索引
+ *
+ * listIndex() 每次前进一个结点，对于很长的链表复杂度是 O(N)
+ * 调用 listSetIndexStep() 之后，链表从位置 off 开始每隔 step 个结点保存一个结点指针，
+ * 查找时先跳到最近的采样，再前进不到 step 个结点：
+ * 使用 O(N / step) 的内存换取 O(step) 的查找
+ *
+ * 在两端添加和删除结点时以 O(1) 复杂度更新索引：
+ * 在表头只需要修改 off，它回绕时添加或删除一个采样，在表尾添加或删除一个采样
+ * listInsertAt() 知道新结点的位置，它将之后的采样各移动一个结点，复杂度为 O(N / step)
+ * 其他在链表中间进行的修改不知道结点的位置，只是将索引标记为失效，由下次查找重建
+*/
+
+// 第 i 个采样
+#define listSkipAt(si, i) ((si)->nodes[((si)->start + (i)) & ((si)->cap - 1)])
+
+// 初始的采样容量
+#define LIST_SKIP_INITIAL_CAP 16
+
+/*
+ * Make room for one more sample, unwrapping the ring buffer.
+ *
+ * T = O(N / step)
+*/
+// 为一个新的采样腾出空间，同时展开环形数组
+static void listSkipGrow(listSkipIndex *si) {
+    unsigned long cap, i;
+    listNode **nodes;
+
+    if (si->len < si->cap) return;
+
+    cap = si->cap ? si->cap * 2 : LIST_SKIP_INITIAL_CAP;
+    nodes = zmalloc(sizeof(listNode *) * cap);
+    for (i = 0; i < si->len; i++) nodes[i] = listSkipAt(si, i);
+
+    zfree(si->nodes);
+    si->nodes = nodes;
+    si->cap = cap;
+    si->start = 0;
+}
+
+/*
+ * Add a sample before the first one.
+ *
+ * T = O(1) amortized
+*/
+// 在第一个采样之前添加一个采样
+static void listSkipPrepend(listSkipIndex *si, listNode *node) {
+    listSkipGrow(si);
+    si->start = (si->start - 1) & (si->cap - 1);
+    si->nodes[si->start] = node;
+    si->len++;
+}
+
+/*
+ * Add a sample after the last one.
+ *
+ * T = O(1) amortized
+*/
+// 在最后一个采样之后添加一个采样
+static void listSkipAppend(listSkipIndex *si, listNode *node) {
+    listSkipGrow(si);
+    listSkipAt(si, si->len) = node;
+    si->len++;
+}
+
+/*
+ * Rebuild the index from scratch, with a sample at position 0.
+ *
+ * T = O(N)
+*/
+// 从头重建索引，第一个采样位于位置 0
+static void listSkipRebuild(list *list) {
+    listSkipIndex *si = list->skip;
+    listNode *node;
+    unsigned long pos = 0;
+
+    si->len = 0;
+    si->start = 0;
+    si->off = 0;
+    si->dirty = 0;
+    for (node = list->head; node; node = node->next, pos++) {
+        if (pos % si->step == 0) listSkipAppend(si, node);
+    }
+}
+
+/*
+ * Update the index after the node at position pos was linked, list->len
+ * being already incremented.
+ *
+ * T = O(1) at the head and at the tail, O(N / step) elsewhere
+*/
+/*
+ * 在位置 pos 上链接结点之后更新索引，此时 list->len 已经增加
+ *
+ * 在表头和表尾复杂度为 O(1)，其他位置为 O(N / step)
+*/
+static void listSkipInserted(list *list, unsigned long pos) {
+    listSkipIndex *si = list->skip;
+    unsigned long i;
+
+    if (si == NULL || si->dirty) return;
+
+    if (si->len == 0) {
+        // 没有采样时，off 是第一个采样将要出现的位置，只有在表头插入才会移动它
+        if (pos == 0 && ++si->off == si->step) {
+            listSkipPrepend(si, list->head);
+            si->off = 0;
+        }
+    } else if (pos <= si->off) {
+        // 所有采样都向后移动一个位置
+        if (++si->off == si->step) {
+            listSkipPrepend(si, list->head);
+            si->off = 0;
+        }
+    } else {
+        // pos 之后的采样指向前一个结点，保持它们的位置不变
+        for (i = (pos - si->off + si->step - 1) / si->step; i < si->len; i++)
+            listSkipAt(si, i) = listSkipAt(si, i)->prev;
+    }
+
+    // 新的表尾可能正好落在采样位置上
+    if (list->len - 1 == si->off + si->len * si->step)
+        listSkipAppend(si, list->tail);
+}
+
+/*
+ * Update the index before the node at position pos is unlinked.
+ *
+ * T = O(1) at the head and at the tail, O(N / step) elsewhere
+*/
+/*
+ * 在解除位置 pos 上结点的链接之前更新索引
+ *
+ * 在表头和表尾复杂度为 O(1)，其他位置为 O(N / step)
+*/
+static void listSkipRemoving(list *list, unsigned long pos) {
+    listSkipIndex *si = list->skip;
+    unsigned long i;
+
+    if (si == NULL || si->dirty) return;
+
+    if (si->len == 0) {
+        // 没有采样时，只有删除表头才会移动 off
+        if (pos == 0) si->off--;
+    } else if (pos < si->off) {
+        // 所有采样都向前移动一个位置
+        si->off--;
+    } else if (pos == 0) {
+        // 删除的表头就是第一个采样
+        si->start = (si->start + 1) & (si->cap - 1);
+        si->len--;
+        si->off = si->step - 1;
+    } else {
+        // pos 之后的采样（包括 pos 本身）指向后一个结点，保持它们的位置不变
+        for (i = (pos - si->off + si->step - 1) / si->step; i < si->len; i++)
+            listSkipAt(si, i) = listSkipAt(si, i)->next;
+
+        // 删除的是表尾上的采样
+        if (listSkipAt(si, si->len - 1) == NULL) si->len--;
+    }
+}
+
+/*
+ * Flag the index as out of date, to be rebuilt by the next lookup.
+ *
+ * T = O(1)
+*/
+// 将索引标记为失效，由下次查找重建
+static void listSkipInvalidate(list *list) {
+    if (list->skip) list->skip->dirty = 1;
+}
+
+/*
+ * Enable the positional index with a sample every step nodes, or disable
+ * it if step is 0. Lists are created without index: only long lists
+ * accessed by position benefit from it.
+ *
+ * T = O(1), the index is built by the next lookup
+*/
+/*
+ * 启用每隔 step 个结点一个采样的位置索引，step 为 0 时禁用索引
+ * 新建的链表没有索引：只有按位置访问的长链表才能从中受益
+*/
+void listSetIndexStep(list *list, unsigned long step) {
+    listSkipIndex *si = list->skip;
+
+    if (step == 0) {
+        if (si) {
+            zfree(si->nodes);
+            zfree(si);
+            list->skip = NULL;
+        }
+        return;
+    }
+
+    if (si == NULL) {
+        si = zmalloc(sizeof(*si));
+        si->nodes = NULL;
+        si->cap = si->len = si->start = 0;
+        list->skip = si;
+    }
+    si->step = step;
+    si->dirty = 1;
+}
+
 /* Create a new list. The created list can be freed with
  * AlFreeList(), but private value of evert node need to be
  * freed by the user before to call AlFreeList().
@@ -25,6 +340,7 @@ list *listCreate(void) {
     list->dup = NULL;
     list->free = NULL;
     list->match = NULL;
+    list->skip = NULL;
 
     return list;
 }
@@ -51,13 +367,14 @@ void listRelease(list *list) {
         // 如果有设置释放函数，执行
         if (list->free) list->free(current->value);
 
-        // 释放结点
-        zfree(current);
+        // 回收结点
+        listNodeRecycle(current);
 
         current = next;
     }
 
-    // 释放链表
+    // 释放索引和链表
+    listSetIndexStep(list, 0);
     zfree(list);
 }
 
@@ -82,7 +399,7 @@ list *listAddNodeHead(list *list, void *value) {
     listNode *node;
 
     // 为结点分配内存
-    if ((node == zmalloc(sizeof(*node))) == NULL) 
+    if ((node = listNodeAlloc()) == NULL) 
         return NULL;
     
     // 保存值指针
@@ -102,6 +419,7 @@ list *listAddNodeHead(list *list, void *value) {
 
     // 更新链表结点数
     list->len++;
+    listSkipInserted(list, 0);
 
     return list;
 }
@@ -125,7 +443,7 @@ list *listAddNodeTail(list *list, void *value) {
     listNode *node;
 
     // 为新结点分配内存
-    if ((node == zmalloc(sizeof(*node))) == NULL)
+    if ((node = listNodeAlloc()) == NULL)
         return NULL;
     
     // 保存值指针
@@ -145,6 +463,7 @@ list *listAddNodeTail(list *list, void *value) {
 
     // 更新链表结点数
     list->len++;
+    listSkipInserted(list, list->len - 1);
 
     return list;
 }
@@ -154,7 +473,7 @@ list *listInsertNode(list *list, listNode *old_node, void *value, int after) {
     listNode *node;
 
     // 新建结点
-    if ((node = zmalloc(sizeof(*node))) == NULL) {
+    if ((node = listNodeAlloc()) == NULL) {
         return NULL;
     }
 
@@ -192,6 +511,11 @@ list *listInsertNode(list *list, listNode *old_node, void *value, int after) {
     // 更新链表节点数
     list->len++;
 
+    // 只有在两端插入时才知道新结点的位置
+    if (node == list->head) listSkipInserted(list, 0);
+    else if (node == list->tail) listSkipInserted(list, list->len - 1);
+    else listSkipInvalidate(list);
+
     return list;
 }
 
@@ -207,6 +531,11 @@ list *listInsertNode(list *list, listNode *old_node, void *value, int after) {
 */
 void listDelNode(list *list, listNode *node) {
 
+    // 只有删除两端的结点时才知道它的位置
+    if (node == list->head) listSkipRemoving(list, 0);
+    else if (node == list->tail) listSkipRemoving(list, list->len - 1);
+    else listSkipInvalidate(list);
+
     // 调整前置结点指针
     if (node->prev) {
         node->prev->next = node->next;
@@ -226,8 +555,8 @@ void listDelNode(list *list, listNode *node) {
         list->free(node->value);
     }
 
-    // 释放结点
-    zfree(node);
+    // 回收结点
+    listNodeRecycle(node);
 
     // 更新链表结点数
     list->len--;
@@ -419,7 +748,7 @@ listNode *listSearchKey(list *list, void *key) {
     listNode *node;
 
     // 迭代整个链表
-    iter = listGetIterator(iter, AL_START_HEAD);
+    iter = listGetIterator(list, AL_START_HEAD);
     while ((node = listNext(iter)) != NULL) {
 
         // 对比
@@ -463,6 +792,38 @@ listNode *listSearchKey(list *list, void *key) {
 listNode *listIndex(list *list, long index) {
     listNode *node;
     
+    if (list->skip) {
+        listSkipIndex *si = list->skip;
+        unsigned long pos, i, steps;
+
+        if (index < 0) index = (long)list->len + index;
+        if (index < 0 || (unsigned long)index >= list->len) return NULL;
+        pos = (unsigned long)index;
+
+        if (si->dirty) listSkipRebuild(list);
+
+        // 第一个采样之前的结点从表头开始查找
+        if (si->len == 0 || pos < si->off) {
+            node = list->head;
+            steps = pos;
+        } else {
+            i = (pos - si->off) / si->step;
+            if (i >= si->len) i = si->len - 1;
+            node = listSkipAt(si, i);
+            steps = pos - (si->off + i * si->step);
+        }
+
+        // 离表尾更近时从表尾开始查找
+        if (list->len - 1 - pos < steps) {
+            node = list->tail;
+            steps = list->len - 1 - pos;
+            while (steps--) node = node->prev;
+        } else {
+            while (steps--) node = node->next;
+        }
+        return node;
+    }
+
     if (index < 0) {
         // 如果索引为负数，从表尾开始查找
         index = (-index) - 1;
@@ -518,6 +879,9 @@ void listRotate(list *list) {
 
     if (listLength(list) <= 1) return;
 
+    // 相当于删除表尾结点再添加到表头，索引可以以 O(1) 复杂度更新
+    listSkipRemoving(list, list->len - 1);
+
     /* Detach current tail */
     // 取出表尾结点
     list->tail = tail->prev;
@@ -529,4 +893,458 @@ void listRotate(list *list) {
     tail->prev = NULL;
     tail->next = list->head;
     list->head = tail;
-}
\ No newline at end of file
+
+    // listSkipInserted() 要求 list->len 包含新结点，长度本身没有变化
+    listSkipInserted(list, 0);
+}
+
+/*
+ * Insert a new node holding value so that it ends up at position index.
+ * index can be list->len to append, and negative indexes count from the
+ * tail, -1 meaning after the last node.
+ *
+ * With the positional index enabled this is O(N / step), since both the
+ * lookup and the index update know the position.
+ *
+ * Returns NULL, leaving the list untouched, if index is out of range.
+ *
+ * T = O(N / step) with the index, O(N) otherwise
+*/
+/*
+ * 插入一个包含 value 的新结点，使它位于位置 index 上
+ * index 可以是 list->len，表示添加到表尾，负数从表尾开始计算，-1 表示最后一个结点之后
+ *
+ * 启用位置索引时复杂度为 O(N / step)，因为查找和更新索引时都知道位置
+ *
+ * index 超出范围时不修改链表并返回 NULL
+*/
+list *listInsertAt(list *list, long index, void *value) {
+    listNode *old_node, *node;
+    unsigned long pos;
+
+    if (index < 0) index = (long)list->len + 1 + index;
+    if (index < 0 || (unsigned long)index > list->len) return NULL;
+    pos = (unsigned long)index;
+
+    if (pos == list->len) return listAddNodeTail(list, value);
+    if (pos == 0) return listAddNodeHead(list, value);
+
+    old_node = listIndex(list, index);
+    if ((node = listNodeAlloc()) == NULL) return NULL;
+
+    // 链接到 old_node 之前
+    node->value = value;
+    node->next = old_node;
+    node->prev = old_node->prev;
+    old_node->prev->next = node;
+    old_node->prev = node;
+    list->len++;
+
+    listSkipInserted(list, pos);
+    return list;
+}
+
+/*
+ * Initialize an empty intrusive list.
+ *
+ * T = O(1)
+*/
+// 初始化一个空的侵入式链表
+void ilistInit(ilist *list) {
+    list->head = list->tail = NULL;
+    list->len = 0;
+}
+
+/*
+ * Link the node at the head of the intrusive list.
+ *
+ * T = O(1)
+*/
+// 将结点链接到侵入式链表的表头
+void ilistAddHead(ilist *list, ilistNode *node) {
+    node->prev = NULL;
+    node->next = list->head;
+    if (list->head) {
+        list->head->prev = node;
+    } else {
+        list->tail = node;
+    }
+    list->head = node;
+    list->len++;
+}
+
+/*
+ * Link the node at the tail of the intrusive list.
+ *
+ * T = O(1)
+*/
+// 将结点链接到侵入式链表的表尾
+void ilistAddTail(ilist *list, ilistNode *node) {
+    node->next = NULL;
+    node->prev = list->tail;
+    if (list->tail) {
+        list->tail->next = node;
+    } else {
+        list->head = node;
+    }
+    list->tail = node;
+    list->len++;
+}
+
+/*
+ * Link the node before (after == 0) or after (after == 1) old_node.
+ *
+ * T = O(1)
+*/
+// 将结点链接到 old_node 之前（after == 0）或之后（after == 1）
+void ilistInsert(ilist *list, ilistNode *old_node, ilistNode *node, int after) {
+    if (after) {
+        node->prev = old_node;
+        node->next = old_node->next;
+        if (list->tail == old_node) list->tail = node;
+    } else {
+        node->next = old_node;
+        node->prev = old_node->prev;
+        if (list->head == old_node) list->head = node;
+    }
+
+    if (node->prev != NULL) node->prev->next = node;
+    if (node->next != NULL) node->next->prev = node;
+
+    list->len++;
+}
+
+/*
+ * Unlink the node from the intrusive list. The owner of the node is left
+ * alone: it's up to the caller to free it.
+ *
+ * T = O(1)
+*/
+// 将结点从侵入式链表中解除链接，拥有结点的结构由调用者负责释放
+void ilistDel(ilist *list, ilistNode *node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        list->head = node->next;
+    }
+
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+
+    node->prev = node->next = NULL;
+    list->len--;
+}
+
+/*
+ * Unlink and return the head node, or NULL if the list is empty.
+ *
+ * T = O(1)
+*/
+// 解除表头结点的链接并返回它，链表为空时返回 NULL
+ilistNode *ilistPopHead(ilist *list) {
+    ilistNode *node = list->head;
+
+    if (node) ilistDel(list, node);
+    return node;
+}
+
+/*
+ * Unlink and return the tail node, or NULL if the list is empty.
+ *
+ * T = O(1)
+*/
+// 解除表尾结点的链接并返回它，链表为空时返回 NULL
+ilistNode *ilistPopTail(ilist *list) {
+    ilistNode *node = list->tail;
+
+    if (node) ilistDel(list, node);
+    return node;
+}
+
+#ifdef ADLIST_TEST_MAIN
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "testhelp.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
+// 防止编译器优化掉基准测试
+static volatile long sink;
+
+/* A queued item with its embedded node, like a client in the client list */
+typedef struct item {
+    long id;
+    ilistNode node;
+} item;
+
+/*
+ * Queue churn: keep depth values queued, pushing at the tail and popping
+ * from the head ops times. Returns the sum of the popped values.
+*/
+static long churnList(long depth, long ops) {
+    list *l = listCreate();
+    long j, sum = 0;
+
+    for (j = 0; j < depth; j++) listAddNodeTail(l, (void*)j);
+    for (j = 0; j < ops; j++) {
+        listNode *head = listFirst(l);
+        sum += (long)listNodeValue(head);
+        listDelNode(l, head);
+        listAddNodeTail(l, (void*)j);
+    }
+    listRelease(l);
+    return sum;
+}
+
+static long churnIlist(long depth, long ops) {
+    item *items = zmalloc(sizeof(item) * depth);
+    ilist l;
+    long j, sum = 0;
+
+    ilistInit(&l);
+    for (j = 0; j < depth; j++) {
+        items[j].id = j;
+        ilistAddTail(&l, &items[j].node);
+    }
+    for (j = 0; j < ops; j++) {
+        item *it = ilistEntry(ilistPopHead(&l), item, node);
+        sum += it->id;
+        it->id = j;
+        ilistAddTail(&l, &it->node);
+    }
+    zfree(items);
+    return sum;
+}
+
+int main(void) {
+    {
+        list *l = listCreate();
+        listNode *first;
+
+        listNodePoolSetMax(LIST_NODE_POOL_MAX);
+        listAddNodeTail(l, (void*)1);
+        first = listFirst(l);
+        listDelNode(l, first);
+        listAddNodeHead(l, (void*)2);
+        test_cond("Deleted nodes are reused by the next addition",
+            listFirst(l) == first && listNodePoolSize() == 0);
+        listRelease(l);
+        test_cond("Released lists give their nodes to the pool",
+            listNodePoolSize() == 1);
+    }
+
+    {
+        list *l = listCreate();
+        long j;
+
+        for (j = 0; j < 5000; j++) listAddNodeTail(l, (void*)j);
+        listRelease(l);
+        test_cond("The pool is bounded", listNodePoolSize() == LIST_NODE_POOL_MAX);
+        listNodePoolSetMax(10);
+        test_cond("Lowering the maximum trims the pool", listNodePoolSize() == 10);
+        listNodePoolSetMax(LIST_NODE_POOL_MAX);
+    }
+
+    {
+        list *l = listCreate();
+
+        listAddNodeTail(l, (void*)1);
+        listAddNodeTail(l, (void*)2);
+        listAddNodeTail(l, (void*)3);
+        test_cond("Search key", listSearchKey(l, (void*)2) == listIndex(l, 1) &&
+            listSearchKey(l, (void*)4) == NULL);
+        listRelease(l);
+    }
+
+    {
+        item items[4];
+        ilist l;
+        ilistNode *n;
+        long j, ok = 1;
+
+        ilistInit(&l);
+        for (j = 0; j < 4; j++) items[j].id = j;
+        ilistAddTail(&l, &items[1].node);
+        ilistAddHead(&l, &items[0].node);
+        ilistAddTail(&l, &items[3].node);
+        ilistInsert(&l, &items[3].node, &items[2].node, 0);
+        for (j = 0, n = ilistFirst(&l); n; n = n->next, j++)
+            if (ilistEntry(n, item, node)->id != j) ok = 0;
+        test_cond("Intrusive list add and insert", ok && j == 4 && ilistLength(&l) == 4);
+
+        ilistDel(&l, &items[1].node);
+        test_cond("Intrusive list delete",
+            ilistLength(&l) == 3 && items[0].node.next == &items[2].node &&
+            items[2].node.prev == &items[0].node);
+
+        test_cond("Intrusive list pop",
+            ilistEntry(ilistPopTail(&l), item, node)->id == 3 &&
+            ilistEntry(ilistPopHead(&l), item, node)->id == 0 &&
+            ilistEntry(ilistPopHead(&l), item, node)->id == 2 &&
+            ilistPopHead(&l) == NULL && ilistFirst(&l) == NULL && ilistLast(&l) == NULL);
+    }
+
+    {
+        unsigned long steps[] = {1, 3, 16};
+        long ref[2000], len, j, op, ok = 1;
+        unsigned int k;
+
+        srand(1234);
+        for (k = 0; k < sizeof(steps) / sizeof(*steps); k++) {
+            list *l = listCreate();
+
+            listSetIndexStep(l, steps[k]);
+            len = 0;
+            for (op = 0; op < 20000 && ok; op++) {
+                long v = op, pos;
+                int action = rand() % 8;
+
+                if (len >= 1900) action = 4;
+                if (action == 0) {
+                    listAddNodeHead(l, (void*)v);
+                    memmove(ref + 1, ref, sizeof(long) * len);
+                    ref[0] = v;
+                    len++;
+                } else if (action == 1) {
+                    listAddNodeTail(l, (void*)v);
+                    ref[len++] = v;
+                } else if (action == 2) {
+                    pos = rand() % (len + 1);
+                    listInsertAt(l, pos, (void*)v);
+                    memmove(ref + pos + 1, ref + pos, sizeof(long) * (len - pos));
+                    ref[pos] = v;
+                    len++;
+                } else if (len == 0) {
+                    continue;
+                } else if (action == 3) {
+                    listDelNode(l, listFirst(l));
+                    memmove(ref, ref + 1, sizeof(long) * --len);
+                } else if (action == 4) {
+                    listDelNode(l, listLast(l));
+                    len--;
+                } else if (action == 5) {
+                    // 在中间删除会使索引失效
+                    pos = rand() % len;
+                    listDelNode(l, listIndex(l, pos));
+                    memmove(ref + pos, ref + pos + 1, sizeof(long) * (len - pos - 1));
+                    len--;
+                } else if (action == 6) {
+                    listRotate(l);
+                    v = ref[len - 1];
+                    memmove(ref + 1, ref, sizeof(long) * (len - 1));
+                    ref[0] = v;
+                } else {
+                    // 不经过查找，直接检查采样的位置
+                    listSkipIndex *si = l->skip;
+                    if (!si->dirty) {
+                        for (j = 0; j < (long)si->len; j++) {
+                            if ((long)listNodeValue(listSkipAt(si, j)) !=
+                                ref[si->off + j * si->step]) ok = 0;
+                        }
+                        if (si->off + si->len * si->step < (unsigned long)len) ok = 0;
+                    }
+                }
+
+                if (op % 16 == 0) {
+                    for (j = 0; j < len; j++) {
+                        if ((long)listNodeValue(listIndex(l, j)) != ref[j] ||
+                            listIndex(l, j - len) != listIndex(l, j)) ok = 0;
+                    }
+                    if (listIndex(l, len) || listIndex(l, -len - 1)) ok = 0;
+                }
+            }
+            if ((long)listLength(l) != len) ok = 0;
+            listRelease(l);
+        }
+        test_cond("Positional index matches the list", ok);
+    }
+
+    {
+        list *l = listCreate();
+
+        listSetIndexStep(l, 4);
+        test_cond("Insert at an out of range position",
+            listInsertAt(l, 1, (void*)1) == NULL &&
+            listInsertAt(l, -2, (void*)1) == NULL && listLength(l) == 0);
+        listInsertAt(l, -1, (void*)2);
+        listInsertAt(l, 0, (void*)0);
+        listInsertAt(l, 1, (void*)1);
+        test_cond("Insert at the head, the tail and in the middle",
+            (long)listNodeValue(listIndex(l, 0)) == 0 &&
+            (long)listNodeValue(listIndex(l, 1)) == 1 &&
+            (long)listNodeValue(listIndex(l, 2)) == 2);
+        listRelease(l);
+    }
+
+    test_report();
+
+    {
+        unsigned long steps[] = {0, 64};
+        long count = 100000, lookups = 200000, j, sum = 0;
+        unsigned int k;
+
+        for (k = 0; k < sizeof(steps) / sizeof(*steps); k++) {
+            list *l = listCreate();
+            long long start;
+            double lookup, insert;
+
+            listSetIndexStep(l, steps[k]);
+            for (j = 0; j < count; j++) listAddNodeTail(l, (void*)j);
+
+            start = usec();
+            for (j = 0; j < lookups; j++)
+                sum += (long)listNodeValue(listIndex(l, rand() % count));
+            lookup = (double)(usec() - start) * 1000 / lookups;
+
+            start = usec();
+            for (j = 0; j < lookups / 10; j++)
+                listInsertAt(l, rand() % listLength(l), (void*)j);
+            insert = (double)(usec() - start) * 1000 / (lookups / 10);
+
+            printf("LINDEX on %ld nodes, index step %lu: lookup %.1f ns/op, "
+                   "insert at %.1f ns/op\n", count, steps[k], lookup, insert);
+            listRelease(l);
+        }
+        sink = sum;
+    }
+
+    {
+        long depths[] = {16, 1024, 100000};
+        long ops = 10000000, sum = 0;
+        unsigned int j;
+
+        for (j = 0; j < sizeof(depths) / sizeof(*depths); j++) {
+            long long start;
+            double plain, pooled, intrusive;
+
+            listNodePoolSetMax(0);
+            start = usec();
+            sum += churnList(depths[j], ops);
+            plain = (double)(usec() - start) * 1000 / ops;
+
+            listNodePoolSetMax(LIST_NODE_POOL_MAX);
+            start = usec();
+            sum += churnList(depths[j], ops);
+            pooled = (double)(usec() - start) * 1000 / ops;
+
+            start = usec();
+            sum += churnIlist(depths[j], ops);
+            intrusive = (double)(usec() - start) * 1000 / ops;
+
+            printf("Queue churn, depth %ld: zmalloc %.1f ns/op, "
+                   "pooled %.1f ns/op, intrusive %.1f ns/op\n",
+                   depths[j], plain, pooled, intrusive);
+        }
+        sink = sum;
+    }
+    return 0;
+}
+#endif
@@ -1,6 +1,8 @@
 #ifndef __ADLIST_H__
 #define __ADLIST_H__
 
+#include <stddef.h>
+
 /* Node, List, and Iterator are the only data structure used currently*/
 
 /*
@@ -26,6 +28,31 @@ typedef struct listIter {
 } listIter;
 
 
+/*
+ * Optional positional index of a list, see listSetIndexStep(): a pointer
+ * to every step-th node, starting at position off, kept in a ring buffer
+ * so samples can be added and removed at both ends in O(1).
+*/
+/*
+ * 链表的可选位置索引，见 listSetIndexStep()：
+ * 从位置 off 开始，每隔 step 个结点保存一个结点指针，
+ * 使用环形数组保存，所以可以在两端以 O(1) 复杂度添加和删除采样
+*/
+typedef struct listSkipIndex {
+
+    listNode **nodes;           // 采样的结点，环形数组
+    unsigned long cap;          // nodes 的容量，2 的幂
+    unsigned long start;        // 第一个采样在 nodes 中的下标
+    unsigned long len;          // 采样的数量
+
+    unsigned long off;          // 第一个采样在链表中的位置
+    unsigned long step;         // 采样的间隔
+
+    int dirty;                  // 索引已失效，下次查找时重建
+
+} listSkipIndex;
+
+
 /*
  * 双端链表结构
 */
@@ -40,9 +67,37 @@ typedef struct list {
 
     unsigned long len;          // 链表所包含的结点数量
 
+    listSkipIndex *skip;        // 位置索引，没有启用时为 NULL
+
 } list;
 
 
+/*
+ * Intrusive list: the node is embedded in the owning structure, so linking
+ * and unlinking never allocate. ilistEntry() gets the owner back from its
+ * node, the way container_of() does.
+*/
+/*
+ * 侵入式双端链表：结点嵌入在拥有它的结构中，所以链接和解除链接都不需要分配内存
+ * 通过 ilistEntry() 从结点取回拥有它的结构，和 container_of() 一样
+*/
+typedef struct ilistNode {
+
+    struct ilistNode *prev;     // 前置结点
+    struct ilistNode *next;     // 后置结点
+
+} ilistNode;
+
+typedef struct ilist {
+
+    ilistNode *head;            // 头结点
+    ilistNode *tail;            // 尾结点
+
+    unsigned long len;          // 链表所包含的结点数量
+
+} ilist;
+
+
 /* Function implemented as macros*/
 // T = O(1)
 
@@ -62,6 +117,14 @@ typedef struct list {
 #define listGetFree(l) ((l)->free)                  // 返回给定链表的值释放函数
 #define listGetMatchMethod(l) ((l)->match)          // 返回给定链表的值对比函数
 
+#define ilistLength(l) ((l)->len)       // 返回侵入式链表所包含的结点数量
+#define ilistFirst(l) ((l)->head)       // 返回侵入式链表的表头结点
+#define ilistLast(l) ((l)->tail)        // 返回侵入式链表的表尾结点
+
+// 返回嵌入了结点 n 的 type 类型结构，member 是结点在结构中的成员名
+#define ilistEntry(n, type, member) \
+    ((type *)((char *)(n) - offsetof(type, member)))
+
 
 /* Prototypes */
 
@@ -80,6 +143,18 @@ listNode *listIndex(list *list, long index);
 void listRewind(list *list, listIter *li);
 void listRewindTail(list *list, listIter *li);
 void listRotate(list *list);
+list *listInsertAt(list *list, long index, void *value);
+void listSetIndexStep(list *list, unsigned long step);
+void listNodePoolSetMax(unsigned long max);
+unsigned long listNodePoolSize(void);
+
+void ilistInit(ilist *list);
+void ilistAddHead(ilist *list, ilistNode *node);
+void ilistAddTail(ilist *list, ilistNode *node);
+void ilistInsert(ilist *list, ilistNode *old_node, ilistNode *node, int after);
+void ilistDel(ilist *list, ilistNode *node);
+ilistNode *ilistPopHead(ilist *list);
+ilistNode *ilistPopTail(ilist *list);
 
 
 /* Direction for iterators */
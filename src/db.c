@@ -0,0 +1,334 @@
+/*
+ * Keyspace access.
+ *
+ * Every database maps keys, stored as sds strings, to value objects in
+ * its dict. The keys that have an expire are also in the expires dict,
+ * which shares the key strings with the main dict and stores the expire
+ * time as a signed integer value.
+ *
+ * All the reads and writes of keys go through these functions, so that
+ * accesses are recorded for the eviction (see evict.c), and keys are
+ * always removed from both dicts.
+*/
+/*
+ * 键空间的访问
+ *
+ * 每个数据库的 dict 将键（sds 字符串）映射到值对象
+ * 设置了过期时间的键同时保存在 expires 字典中，它和主字典共享键字符串，
+ * 并以有符号整数值的形式保存过期时间
+ *
+ * 所有对键的读写都通过这些函数进行，这样访问会被记录下来供淘汰使用（见 evict.c），
+ * 并且键总是会从两个字典中同时删除
+*/
+
+#include <string.h>
+
+#include "redis.h"
+
+/* ----------------------------------------------------------------------------
+ * Dict types
+ * --------------------------------------------------------------------------*/
+
+static unsigned int dictSdsHash(const void *key) {
+    return dictGenHashFunction((unsigned char*)key, sdslen((sds)key));
+}
+
+static int dictSdsKeyCompare(void *privdata, const void *key1,
+        const void *key2)
+{
+    size_t l1, l2;
+    DICT_NOTUSED(privdata);
+
+    l1 = sdslen((sds)key1);
+    l2 = sdslen((sds)key2);
+    if (l1 != l2) return 0;
+    return memcmp(key1, key2, l1) == 0;
+}
+
+static int dictSdsDestructor(void *privdata, void *val) {
+    DICT_NOTUSED(privdata);
+
+    sdsfree(val);
+    return 0;
+}
+
+static void dictRedisObjectDestructor(void *privdata, void *val) {
+    DICT_NOTUSED(privdata);
+
+    decrRefCount(val);
+}
+
+/* Db->dict, keys are sds strings, vals are Redis objects. */
+// 数据库键空间，键为 sds 字符串，值为对象
+dictType dbDictType = {
+    dictSdsHash,                /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictSdsKeyCompare,          /* key compare */
+    dictSdsDestructor,          /* key destructor */
+    dictRedisObjectDestructor   /* val destructor */
+};
+
+/* Db->expires, keys are the sds strings of db->dict, vals are integers. */
+// 过期字典，键和键空间共享，值为整数，因此都不需要释放
+dictType keyptrDictType = {
+    dictSdsHash,                /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictSdsKeyCompare,          /* key compare */
+    NULL,                       /* key destructor */
+    NULL                        /* val destructor */
+};
+
+/* ----------------------------------------------------------------------------
+ * Keyspace access
+ * --------------------------------------------------------------------------*/
+
+/*
+ * Return the value of the key, or NULL if it does not exist. The access
+ * is recorded in the lru field of the value.
+ *
+ * T = O(1)
+*/
+// 返回键的值，键不存在时返回 NULL，访问会被记录在值的 lru 字段中
+robj *lookupKey(redisDb *db, robj *key) {
+    dictEntry *de = dictFind(db->dict, key->ptr);
+
+    if (de) {
+        robj *val = dictGetVal(de);
+
+        objectTouch(val);
+        return val;
+    } else {
+        return NULL;
+    }
+}
+
+/*
+ * Lookup a key for read or write operations: like lookupKey(), but the
+ * key is deleted first if it is logically expired.
+ *
+ * T = O(1)
+*/
+// 为读操作或者写操作查找键：和 lookupKey() 一样，但如果键已经过期，先将它删除
+robj *lookupKeyRead(redisDb *db, robj *key) {
+    expireIfNeeded(db, key);
+    return lookupKey(db, key);
+}
+
+robj *lookupKeyWrite(redisDb *db, robj *key) {
+    expireIfNeeded(db, key);
+    return lookupKey(db, key);
+}
+
+/*
+ * Add the key to the DB. It's up to the caller to increment the reference
+ * counter of the value if needed.
+ *
+ * The program is aborted if the key already exists.
+ *
+ * T = O(1)
+*/
+/*
+ * 将键添加到数据库中，由调用者负责在需要时增加值的引用计数
+ *
+ * 键已经存在时程序终止
+*/
+void dbAdd(redisDb *db, robj *key, robj *val) {
+    sds copy = sdsdup(key->ptr);
+    int retval = dictAdd(db->dict, copy, val);
+
+    redisAssertWithInfo(NULL, key, retval == REDIS_OK);
+}
+
+/*
+ * Delete a key, value, and associated expiration entry if any, from the
+ * DB. Returns 1 if the key was deleted, 0 if it did not exist.
+ *
+ * The value is released with decrRefCountLazy(), so that deleting,
+ * expiring or evicting a big collection doesn't block the server when
+ * lazy freeing is enabled.
+ *
+ * T = O(1)
+*/
+/*
+ * 从数据库中删除键、值，以及键的过期时间（如果有的话），键被删除时返回 1，不存在时返回 0
+ *
+ * 值通过 decrRefCountLazy() 释放，这样启用惰性释放时，
+ * 删除、过期或者淘汰一个大集合都不会阻塞服务器
+*/
+int dbDelete(redisDb *db, robj *key) {
+    dictEntry *de;
+    sds keyptr;
+    robj *val;
+
+    /* Deleting an entry from the expires dict will not free the sds of
+     * the key, because it is shared with the main dictionary. */
+    // 过期字典和主字典共享键字符串，删除过期字典中的项不会释放它
+    if (dictSize(db->expires) > 0) dictDelete(db->expires, key->ptr);
+
+    if ((de = dictFind(db->dict, key->ptr)) == NULL) return 0;
+    keyptr = dictGetKey(de);
+    val = dictGetVal(de);
+
+    // 只解除链接，键和值由这里释放
+    dictDeleteNoFree(db->dict, key->ptr);
+    sdsfree(keyptr);
+    decrRefCountLazy(val);
+    return 1;
+}
+
+/*
+ * Set the expire time of an existing key, as an absolute UNIX time in
+ * milliseconds.
+ *
+ * T = O(1)
+*/
+// 为已经存在的键设置过期时间，when 为毫秒格式的 UNIX 时间戳
+void setExpire(redisDb *db, robj *key, long long when) {
+    dictEntry *kde, *de;
+
+    /* Reuse the sds from the main dict in the expire dict */
+    // 过期字典使用主字典中的键字符串
+    kde = dictFind(db->dict, key->ptr);
+    redisAssertWithInfo(NULL, key, kde != NULL);
+    de = dictReplaceRaw(db->expires, dictGetKey(kde));
+    dictSetSignedIntegerVal(de, when);
+}
+
+/*
+ * Return the expire time of the specified key, or -1 if no expire is
+ * associated with this key (i.e. the key is non volatile).
+ *
+ * T = O(1)
+*/
+// 返回键的过期时间，键没有设置过期时间时返回 -1
+long long getExpire(redisDb *db, robj *key) {
+    dictEntry *de;
+
+    if (dictSize(db->expires) == 0 ||
+       (de = dictFind(db->expires, key->ptr)) == NULL) return -1;
+
+    return dictGetSignedIntegerVal(de);
+}
+
+/*
+ * Remove the expire of the key, making it persistent. Returns 1 if the
+ * key had an expire, 0 otherwise.
+ *
+ * T = O(1)
+*/
+// 移除键的过期时间，键原来设置了过期时间时返回 1，否则返回 0
+int removeExpire(redisDb *db, robj *key) {
+    return dictDelete(db->expires, key->ptr) == DICT_OK;
+}
+
+/*
+ * Delete the key if its expire time has passed. This is the lazy side of
+ * expiration: a key is never returned once expired, even if the active
+ * expire cycle didn't get to it yet.
+ *
+ * The time is the cached server.mstime, taken before the command runs,
+ * so that a key doesn't expire in the middle of a command.
+ *
+ * Returns 1 if the key was expired and deleted, 0 otherwise.
+ *
+ * T = O(1)
+*/
+/*
+ * 如果键的过期时间已经到了，删除它：这是过期的惰性部分，
+ * 即使主动过期还没有处理到这个键，已经过期的键也不会被返回
+ *
+ * 使用命令执行之前缓存的 server.mstime，这样键不会在命令执行的过程中过期
+ *
+ * 键已过期并被删除时返回 1，否则返回 0
+*/
+int expireIfNeeded(redisDb *db, robj *key) {
+    long long when = getExpire(db, key);
+
+    // 键没有设置过期时间
+    if (when < 0) return 0;
+
+    // 键还没有过期
+    if (server.mstime <= when) return 0;
+
+    server.stat_expiredkeys++;
+    return dbDelete(db, key);
+}
+
+/* ----------------------------------------------------------------------------
+ * Keyspace scan
+ * --------------------------------------------------------------------------*/
+
+// keyspaceScanCallback() 的参数
+typedef struct keyspaceScanData {
+    redisDb *db;
+    // 键需要匹配的模式，为 NULL 时返回所有键
+    const stringmatchPattern *pattern;
+    // 保存匹配的键
+    list *keys;
+} keyspaceScanData;
+
+/*
+ * dictScan() callback: add a copy of the key to the list if it matches
+ * the pattern and is not logically expired. Filtering here, against a
+ * pattern compiled once for the whole scan, means the keys that don't
+ * match are never copied.
+*/
+// dictScan() 的回调函数：键匹配模式，并且没有逻辑上过期时，将键的副本添加到链表中
+// 在这里使用整个迭代只编译一次的模式进行过滤，不匹配的键永远不会被复制
+static void keyspaceScanCallback(void *privdata, const dictEntry *de) {
+    keyspaceScanData *data = privdata;
+    sds key = dictGetKey(de);
+    dictEntry *ede;
+
+    if (data->pattern && !stringmatchExec(data->pattern, key, sdslen(key)))
+        return;
+
+    // 已经过期的键留给惰性过期和主动过期删除，迭代时不能修改字典
+    if (dictSize(data->db->expires) > 0 &&
+        (ede = dictFind(data->db->expires, key)) != NULL &&
+        server.mstime > dictGetSignedIntegerVal(ede)) return;
+
+    listAddNodeTail(data->keys, sdsdup(key));
+}
+
+/*
+ * One step of SCAN: continue the keyspace iteration at the cursor, adding
+ * to the list the keys that match the pattern (NULL to match them all).
+ * Returns the cursor of the next call, 0 when the iteration is complete.
+ *
+ * Buckets are visited until count keys were added, or 10 times count
+ * buckets were visited, so that a pattern that matches few keys doesn't
+ * block the server. The keys are sds copies, owned by the caller.
+ *
+ * KEYS is the same iteration run until the cursor is 0.
+ *
+ * T = O(count) per call
+*/
+/*
+ * SCAN 的一步：从游标处继续迭代键空间，将匹配模式（为 NULL 时匹配所有键）的键添加到链表中
+ * 返回下次调用使用的游标，迭代完成时返回 0
+ *
+ * 直到添加了 count 个键，或者访问了 10 倍 count 个桶为止，
+ * 这样只匹配少量键的模式不会阻塞服务器
+ * 链表中的键是 sds 副本，由调用者负责释放
+ *
+ * KEYS 就是一直执行到游标为 0 的同一个迭代
+*/
+unsigned long keyspaceScan(redisDb *db, unsigned long cursor, long count,
+        const stringmatchPattern *pattern, list *keys)
+{
+    keyspaceScanData data;
+    long maxiterations = count * 10;
+    unsigned long start = listLength(keys);
+
+    data.db = db;
+    data.pattern = pattern;
+    data.keys = keys;
+    do {
+        cursor = dictScan(db->dict, cursor, keyspaceScanCallback, &data);
+    } while (cursor && maxiterations-- &&
+             listLength(keys) - start < (unsigned long)count);
+    return cursor;
+}
@@ -9,64 +9,9 @@
 
 #include "dict.h"
 #include "zmalloc.h"
+#include "monotonic.h"
 #include "redisassert.h"
 
-/* =========================================================================== */
-
-// 手动实现 gettimeofday() 函数
-// 替代 unix 下的 <sys/time.h>
-#include <time.h>
-#include <windows.h>
-
-#if defined(_MSC_VER) || defined(_MSC_EXTENSIONS)
-    #define DELTA_EPOCH_IN_MICROSECS  11644473600000000Ui64
-#else
-    #define DELTA_EPOCH_IN_MICROSECS  11644473600000000ULL
-#endif
-
-struct timezone
-{
-    int  tz_minuteswest; /* minutes W of Greenwich */
-    int  tz_dsttime;     /* type of dst correction */
-};
-
-int gettimeofday(struct timeval *tv, struct timezone *tz)
-{
-    FILETIME ft;
-    unsigned __int64 tmpres = 0;
-    static int tzflag;
-
-    if (NULL != tv)
-    {
-        GetSystemTimeAsFileTime(&ft);
-
-        tmpres |= ft.dwHighDateTime;
-        tmpres <<= 32;
-        tmpres |= ft.dwLowDateTime;
-
-        /*converting file time to unix epoch*/
-        tmpres /= 10;  /*convert into microseconds*/
-        tmpres -= DELTA_EPOCH_IN_MICROSECS;
-        tv->tv_sec = (long)(tmpres / 1000000UL);
-        tv->tv_usec = (long)(tmpres % 1000000UL);
-    }
-
-  if (NULL != tz)
-  {
-    if (!tzflag)
-    {
-      _tzset();
-      tzflag++;
-    }
-    tz->tz_minuteswest = _timezone / 60;
-    tz->tz_dsttime = _daylight;
-  }
-
-  return 0;
-}
-
-/* =========================================================================== */
-
 /*
  * 通过 dictEnableResize() 和 dictDisableResize() 两个函数，
  * 程序可以手动的允许或阻止哈希表进行 rehash，
@@ -412,32 +357,22 @@ int dictRehash(dict *d, int n) {
     return 1;
 }
 
-/*
- * 返回以毫秒为单位的 UNIX 时间戳
- * 
- * T = O(1)
-*/
-long long timeInMilliseconds(void) {
-    struct timeval tv;
-
-    gettimeofday(&tv, NULL);
-    return (((long long)tv.tv_sec) *1000) + (tv.tv_usec / 1000);
-}
-
 /* Rehash for an amount of the time between ms millisecond ans ms + 1 milliseconds */
 /*
  * 在给定毫秒内，以 100 步为单位，对字典进行 rehash
  * 
+ * 使用单调时钟计时，调整系统时间不会使 rehash 提前结束或者超出预算
+ * 
  * T = O(N)
 */
-int dictRehashMillisecond(dict *d, int ms) {
-
-    long long start = timeInMilliseconds();
+int dictRehashMilliseconds(dict *d, int ms) {
+    monotime start;
     int rehashes = 0;
 
+    elapsedStart(&start);
     while (dictRehash(d, 100)) {
         rehashes += 100;
-        if (timeInMilliseconds() - start > ms) break;
+        if (elapsedMs(start) > (uint64_t)ms) break;
     }
 
     return rehashes;
@@ -550,7 +485,7 @@ dictEntry *dictAddRaw(dict *d, void *key) {
     entry->next = ht->table[index];
     ht->table[index] = entry;
     // 更新哈希表已使用结点数量
-    ht->size++;
+    ht->used++;
 
     /* Set the hash entry fields */
     // 设置新的结点
@@ -714,6 +649,19 @@ static int dictGenericDelete(dict *d, const void *key, int nofree) {
     return DICT_ERR;
 }
 
+/*
+ * 从字典中删除包含给定键的结点
+ * 
+ * 并且调用键值的释放函数来删除键值
+ * 
+ * 找到并成功删除返回 DICT_OK，没找到则返回 DICT_ERR
+ * 
+ * T = O(1)
+*/
+int dictDelete(dict *ht, const void *key) {
+    return dictGenericDelete(ht, key, 0);
+}
+
 /*
  * 从字典中删除包含给定键的结点
  * 
@@ -785,7 +733,7 @@ int _dictClear(dict *d, dictht *ht, void(callback)(void *)) {
 void dictRelease(dict *d) {
     // 删除并清空两个哈希表
     _dictClear(d, &d->ht[0], NULL);
-    _dictClear(d, &d->ht[0], NULL);
+    _dictClear(d, &d->ht[1], NULL);
     // 释放结点结构
     zfree(d);
 }
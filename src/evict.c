@@ -0,0 +1,898 @@
+/*
+ * Access tracking for key eviction.
+ *
+ * The 24 bits lru field of every object records how it was accessed:
+ *
+ * - LRU policies: the LRU clock of the last access, so that the idle
+ *   time of the object is the distance from the current clock.
+ * - LFU policies: the last decrement time in minutes in the high 16
+ *   bits, and a logarithmic access counter in the low 8 bits.
+ *
+ *       16 bits      8 bits
+ *   +------------+--------+
+ *   + Last decr. | LOG_C  |
+ *   +------------+--------+
+ *
+ * LOG_C is a Morris counter: every access increments it with probability
+ * 1 / ((LOG_C - REDIS_LFU_INIT_VAL) * lfu_log_factor + 1), so that 8
+ * bits are enough to tell apart keys accessed tens of times from keys
+ * accessed millions of times. It is decremented by one for every
+ * lfu_decay_time minutes the key is not accessed, so keys that used to be
+ * hot eventually become candidates for eviction again.
+ *
+ * When server.maxmemory is set and exceeded, freeMemoryIfNeeded() evicts
+ * the keys with the greatest idle time or lowest counter, approximated by
+ * sampling, until the used memory is back under the limit.
+*/
+/*
+ * 键淘汰所需的访问记录
+ *
+ * 每个对象 24 位的 lru 字段记录了它被访问的情况：
+ *
+ * - LRU 策略：最后一次访问时的 LRU 时钟，对象的空转时间就是它和当前时钟的距离
+ * - LFU 策略：高 16 位为最后一次计数器衰减的时间（分钟），低 8 位为对数访问计数器
+ *
+ *       16 bits      8 bits
+ *   +------------+--------+
+ *   + Last decr. | LOG_C  |
+ *   +------------+--------+
+ *
+ * LOG_C 是一个 Morris 计数器：每次访问以 1 / ((LOG_C - REDIS_LFU_INIT_VAL) * lfu_log_factor + 1)
+ * 的概率增加它，因此 8 位就足以区分被访问几十次和被访问几百万次的键
+ * 键每 lfu_decay_time 分钟没有被访问，计数器就减一，曾经很热的键最终也会重新成为淘汰的候选
+ *
+ * 设置了 server.maxmemory 并且超出时，freeMemoryIfNeeded() 通过采样近似地
+ * 淘汰空转时间最长或者计数器最小的键，直到使用的内存回到限制之下
+*/
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "redis.h"
+
+/* ----------------------------------------------------------------------------
+ * Clocks and cached time
+ * --------------------------------------------------------------------------*/
+
+/*
+ * Return the UNIX time in microseconds. This is wall clock time, that
+ * can jump when the system time is adjusted: only use it for absolute
+ * times, and getMonotonicUs() (see monotonic.h) to measure durations.
+ * Hot paths should read the cached server.ustime/mstime/unixtime.
+*/
+/*
+ * 返回微秒格式的 UNIX 时间
+ * 1 秒 = 1 000 000 微秒
+ *
+ * 这是系统时间，调整系统时间时会跳变：只用于绝对时间，
+ * 测量时间间隔使用 getMonotonicUs()（见 monotonic.h）
+ * 热路径应该读取缓存的 server.ustime/mstime/unixtime
+*/
+long long ustime(void) {
+    struct timeval tv;
+    long long ust;
+
+    gettimeofday(&tv, NULL);
+    ust = ((long long)tv.tv_sec)*1000000;
+    ust += tv.tv_usec;
+    return ust;
+}
+
+/* Return the UNIX time in milliseconds */
+// 返回毫秒格式的 UNIX 时间
+// 1 秒 = 1 000 毫秒
+long long mstime(void) {
+    return ustime()/1000;
+}
+
+/*
+ * Return the LRU clock. Only distances between LRU clocks matter, so it
+ * is based on the monotonic clock.
+*/
+// 返回 LRU 时钟，只有 LRU 时钟之间的距离有意义，因此使用单调时钟
+unsigned int getLRUClock(void) {
+    return (getMonotonicUs()/1000/REDIS_LRU_CLOCK_RESOLUTION) & REDIS_LRU_CLOCK_MAX;
+}
+
+/*
+ * Update the cached time, called at every server cron tick (and before
+ * running a command) so that the hot paths read the time from memory
+ * instead of calling into the clock.
+ *
+ * T = O(1)
+*/
+/*
+ * 更新缓存的时间，在每次服务器时钟周期（以及执行命令之前）调用，
+ * 热路径从内存读取时间，而不需要访问时钟
+*/
+void updateCachedTime(void) {
+    server.ustime = ustime();
+    server.mstime = server.ustime / 1000;
+    server.unixtime = server.mstime / 1000;
+    server.lruclock = getLRUClock();
+}
+
+/* ----------------------------------------------------------------------------
+ * LFU (Least Frequently Used) implementation
+ * --------------------------------------------------------------------------*/
+
+/*
+ * Return the current time in minutes, just taking the least significant
+ * 16 bits. The returned time is suitable to be stored as LDT (last
+ * decrement time) for the LFU implementation.
+ *
+ * Every access calls this, so it reads the cached server.unixtime:
+ * minutes resolution doesn't need a fresh clock.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回以分钟为单位的当前时间的低 16 位，用作 LFU 的最后衰减时间
+ *
+ * 每次访问都会调用它，因此读取缓存的 server.unixtime：分钟精度不需要最新的时钟
+*/
+unsigned long LFUGetTimeInMinutes(void) {
+    return (server.unixtime / 60) & 65535;
+}
+
+/*
+ * Given an object last decrement time, compute the minimum number of
+ * minutes that elapsed since the last decrement. Handle overflow (ldt
+ * greater than the current 16 bits minutes time) considering the time
+ * as wrapping exactly once.
+ *
+ * T = O(1)
+*/
+/*
+ * 计算自对象最后一次衰减以来经过的分钟数
+ * ldt 大于当前时间时，认为时间正好回绕了一次
+*/
+unsigned long LFUTimeElapsed(unsigned long ldt) {
+    unsigned long now = LFUGetTimeInMinutes();
+
+    if (now >= ldt) return now - ldt;
+    return 65535 - ldt + now;
+}
+
+/*
+ * Logarithmically increment a counter. The greater is the current
+ * counter value the less likely is that it gets really implemented.
+ * Saturate it at 255.
+ *
+ * T = O(1)
+*/
+// 对数地增加计数器：计数器越大，真正增加的概率越小，最大为 255
+uint8_t LFULogIncr(uint8_t counter) {
+    double r, baseval, p;
+
+    if (counter == 255) return 255;
+
+    r = (double)rand() / RAND_MAX;
+    baseval = counter - REDIS_LFU_INIT_VAL;
+    if (baseval < 0) baseval = 0;
+    p = 1.0 / (baseval * server.lfu_log_factor + 1);
+    if (r < p) counter++;
+    return counter;
+}
+
+/*
+ * If the object decrement time is reached decrement the LFU counter, by
+ * one for every server.lfu_decay_time minutes elapsed, but do not update
+ * the LFU fields of the object: the access time and counter are updated
+ * in an explicit way when the object is really accessed.
+ *
+ * Return the object frequency counter.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回对象衰减之后的访问计数器，但不修改对象的 LFU 字段，
+ * 字段只在对象真正被访问时更新
+ *
+ * 每经过 server.lfu_decay_time 分钟，计数器减一
+*/
+unsigned long LFUDecrAndReturn(robj *o) {
+    unsigned long ldt = o->lru >> 8;
+    unsigned long counter = o->lru & 255;
+    unsigned long num_periods;
+
+    num_periods = server.lfu_decay_time ?
+                  LFUTimeElapsed(ldt) / server.lfu_decay_time : 0;
+    if (num_periods)
+        counter = (num_periods > counter) ? 0 : counter - num_periods;
+    return counter;
+}
+
+/*
+ * Return the value the lru field of a new object starts with: the
+ * current LRU clock, or a small LFU counter so that new keys have a
+ * chance to accumulate accesses before being evicted.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回新对象 lru 字段的初始值：当前的 LRU 时钟，
+ * 或者一个较小的 LFU 计数器，使新键在被淘汰之前有机会积累访问次数
+*/
+unsigned int objectInitialLRU(void) {
+    if (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_LFU)
+        return (LFUGetTimeInMinutes() << 8) | REDIS_LFU_INIT_VAL;
+    return LRU_CLOCK();
+}
+
+/*
+ * Record an access to the object: update the LRU clock, or decay then
+ * increment the LFU counter.
+ *
+ * Shared objects are left alone, they stand for many keys at once and
+ * must not be written to.
+ *
+ * T = O(1)
+*/
+/*
+ * 记录一次对对象的访问：更新 LRU 时钟，或者先衰减再增加 LFU 计数器
+ *
+ * 共享对象同时代表很多键，并且不能被写入，因此不做记录
+*/
+void objectTouch(robj *o) {
+    if (objectGetRefCount(o) == REDIS_SHARED_REFCOUNT) return;
+
+    if (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_LFU) {
+        unsigned long counter = LFUDecrAndReturn(o);
+
+        counter = LFULogIncr(counter);
+        o->lru = (LFUGetTimeInMinutes() << 8) | counter;
+    } else {
+        o->lru = LRU_CLOCK();
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * The external API for eviction: freeMemoryIfNeeded() is called by the
+ * server when there is a memory limit set, to check if there is memory
+ * to free according to the configured policy.
+ * --------------------------------------------------------------------------*/
+
+/*
+ * Evicting the key with the greatest idle time among all the keys would
+ * need a sorted index of the whole keyspace. Instead, every call samples
+ * server.maxmemory_samples keys from every database and merges them into
+ * the eviction pool, a small array of candidates sorted by ascending
+ * score: the best candidate is always at the end. The pool survives
+ * between calls, so good candidates accumulated by the previous samples
+ * are not thrown away, which brings the approximation much closer to the
+ * true LRU or LFU order for the same number of samples.
+ *
+ * The score is the idle time under LRU policies, 255 minus the counter
+ * under LFU policies, and the distance from the end of time to the
+ * expire under volatile-ttl, so that greater is always better.
+*/
+/*
+ * 要淘汰所有键中空转时间最长的键，需要对整个键空间建立有序的索引
+ * 作为代替，每次调用从每个数据库中采样 server.maxmemory_samples 个键，
+ * 合并到淘汰池中：淘汰池是一个按分数从小到大排列的候选键数组，最合适的候选总是在末尾
+ * 淘汰池在多次调用之间保留，之前采样积累的好的候选不会被丢弃，
+ * 在同样的采样数量下，这使近似结果更接近真正的 LRU 或者 LFU 顺序
+ *
+ * LRU 策略下分数为空转时间，LFU 策略下为 255 减去计数器，volatile-ttl 策略下
+ * 为过期时间到时间终点的距离，因此分数总是越大越合适
+*/
+typedef struct evictionPoolEntry {
+
+    unsigned long long idle;        // 分数，越大越应该被淘汰
+
+    sds key;                        // 键名，为 NULL 时表示空位
+
+    sds cached;                     // 预先分配的键名缓冲区，键名放得下时 key 指向它
+
+    int dbid;                       // 键所在的数据库
+
+} evictionPoolEntry;
+
+static evictionPoolEntry *EvictionPoolLRU;
+
+/*
+ * Create the eviction pool. Must be called once at startup, before
+ * freeMemoryIfNeeded().
+ *
+ * Every entry owns a preallocated buffer for the key name, so that
+ * sampling does not allocate: the memory freed by evicting a key is then
+ * not offset by the copies of the names kept in the pool.
+*/
+/*
+ * 创建淘汰池，需要在启动时，在调用 freeMemoryIfNeeded() 之前调用一次
+ *
+ * 每一项都有一个预先分配的键名缓冲区，采样时不需要分配内存：
+ * 淘汰键释放的内存就不会被淘汰池中保存的键名副本抵消
+*/
+void evictionPoolAlloc(void) {
+    evictionPoolEntry *ep;
+    int j;
+
+    ep = zmalloc(sizeof(*ep) * REDIS_EVICTION_POOL_SIZE);
+    for (j = 0; j < REDIS_EVICTION_POOL_SIZE; j++) {
+        ep[j].idle = 0;
+        ep[j].key = NULL;
+        ep[j].cached = sdsnewlen(NULL, REDIS_EVICTION_POOL_CACHED_SDS_SIZE);
+        ep[j].dbid = 0;
+    }
+    EvictionPoolLRU = ep;
+}
+
+/*
+ * Sample keys from sampledict and insert the ones with a better score
+ * than the current candidates into the pool, keeping it sorted. keydict
+ * is the main dict of the database, used to find the value of keys
+ * sampled from the expires dict.
+ *
+ * T = O(samples * REDIS_EVICTION_POOL_SIZE)
+*/
+/*
+ * 从 sampledict 中采样键，将分数比现有候选更好的键插入淘汰池中，并保持淘汰池有序
+ * keydict 是数据库的主字典，用于查找从过期字典中采样的键的值
+*/
+static void evictionPoolPopulate(int dbid, dict *sampledict, dict *keydict,
+                                 evictionPoolEntry *pool) {
+    dictEntry *samples[server.maxmemory_samples];
+    int j, k, count;
+
+    count = dictGetRandomKeys(sampledict, samples, server.maxmemory_samples);
+    for (j = 0; j < count; j++) {
+        unsigned long long idle;
+        sds key;
+        robj *o = NULL;
+        dictEntry *de;
+
+        de = samples[j];
+        key = dictGetKey(de);
+
+        // 从过期字典采样时，值需要到主字典中查找
+        if (server.maxmemory_policy != REDIS_MAXMEMORY_VOLATILE_TTL) {
+            if (sampledict != keydict) de = dictFind(keydict, key);
+            o = dictGetVal(de);
+        }
+
+        if (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_LRU) {
+            idle = estimateObjectIdleTime(o);
+        } else if (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_LFU) {
+            idle = 255 - LFUDecrAndReturn(o);
+        } else {
+            // 过期时间越早，分数越大
+            idle = ULLONG_MAX - dictGetSignedIntegerVal(de);
+        }
+
+        // 找到第一个分数不小于 idle 的位置，或者第一个空位
+        k = 0;
+        while (k < REDIS_EVICTION_POOL_SIZE &&
+               pool[k].key &&
+               pool[k].idle < idle) k++;
+
+        if (k == 0 && pool[REDIS_EVICTION_POOL_SIZE - 1].key != NULL) {
+            /* Can't insert if the element is < the worst element we have
+             * and there are no empty buckets. */
+            // 比所有候选都差，并且淘汰池已满
+            continue;
+        } else if (k < REDIS_EVICTION_POOL_SIZE && pool[k].key == NULL) {
+            /* Inserting into empty position. No setup needed before insert. */
+            // 插入到空位中
+        } else {
+            /* Inserting in the middle. Now k points to the first element
+             * greater than the element to insert.  */
+            // 移动的是整个项，被覆盖的项的缓冲区需要移到空出来的位置上
+            if (pool[REDIS_EVICTION_POOL_SIZE - 1].key == NULL) {
+                /* Free space on the right? Insert at k shifting
+                 * all the elements from k to end to the right. */
+                // 右边还有空位，将 k 及之后的候选右移
+                sds cached = pool[REDIS_EVICTION_POOL_SIZE - 1].cached;
+
+                memmove(pool + k + 1, pool + k,
+                        sizeof(pool[0]) * (REDIS_EVICTION_POOL_SIZE - k - 1));
+                pool[k].cached = cached;
+            } else {
+                /* No free space on right? Insert at k-1 */
+                // 右边没有空位，丢弃分数最小的候选，将 k 之前的候选左移
+                sds cached = pool[0].cached;
+
+                k--;
+                if (pool[0].key != pool[0].cached) sdsfree(pool[0].key);
+                memmove(pool, pool + 1, sizeof(pool[0]) * k);
+                pool[k].cached = cached;
+            }
+        }
+
+        // 键名太长时才单独分配
+        if (sdslen(key) > REDIS_EVICTION_POOL_CACHED_SDS_SIZE)
+            pool[k].key = sdsdup(key);
+        else
+            pool[k].key = sdscpylen(pool[k].cached, key, sdslen(key));
+        pool[k].idle = idle;
+        pool[k].dbid = dbid;
+    }
+}
+
+/*
+ * Return the memory used, not counting the bytes of the objects queued
+ * for the lazy free thread: they are already unreachable and will be
+ * returned soon, evicting more keys for them would free too much.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回使用的内存，不包括等待惰性释放线程释放的对象的字节数：
+ * 这些对象已经无法访问，很快就会被释放，为它们淘汰更多的键会释放过多的内存
+*/
+static size_t evictGetUsedMemory(void) {
+    size_t used = zmalloc_used_memory();
+    size_t pending = lazyfreeGetPendingBytes();
+
+    return used > pending ? used - pending : 0;
+}
+
+/*
+ * Evict keys according to server.maxmemory_policy until the memory used
+ * is back under server.maxmemory.
+ *
+ * Returns REDIS_OK if the memory is under the limit, or was brought back
+ * under it. Returns REDIS_ERR if the limit is exceeded and nothing more
+ * can be evicted (noeviction policy, or no candidate keys for volatile
+ * policies): the caller should then refuse commands that may grow the
+ * memory.
+ *
+ * T = O(N * samples * dbnum), N is the number of evicted keys
+*/
+/*
+ * 根据 server.maxmemory_policy 淘汰键，直到使用的内存回到 server.maxmemory 之下
+ *
+ * 内存没有超出限制，或者淘汰之后回到限制之下时返回 REDIS_OK
+ * 超出限制并且没有可以淘汰的键时（noeviction 策略，或者 volatile 策略下没有候选键），
+ * 返回 REDIS_ERR：调用者应该拒绝可能增加内存的命令
+*/
+int freeMemoryIfNeeded(void) {
+    size_t mem_used, mem_tofree, mem_freed;
+    static int next_db = 0;
+    int j, k;
+
+    mem_used = evictGetUsedMemory();
+    if (server.maxmemory == 0 || mem_used <= server.maxmemory) return REDIS_OK;
+
+    if (server.maxmemory_policy == REDIS_MAXMEMORY_NO_EVICTION)
+        return REDIS_ERR; /* We need to free memory, but policy forbids. */
+
+    /* Compute how much memory we need to free. */
+    mem_tofree = mem_used - server.maxmemory;
+    mem_freed = 0;
+    while (mem_freed < mem_tofree) {
+        sds bestkey = NULL;
+        int bestdbid = 0;
+        redisDb *db;
+        dict *dict;
+        dictEntry *de;
+
+        if (server.maxmemory_policy & (REDIS_MAXMEMORY_FLAG_LRU|REDIS_MAXMEMORY_FLAG_LFU) ||
+            server.maxmemory_policy == REDIS_MAXMEMORY_VOLATILE_TTL)
+        {
+            evictionPoolEntry *pool = EvictionPoolLRU;
+
+            while (bestkey == NULL) {
+                unsigned long total_keys = 0, keys;
+
+                /* We don't want to make local-db choices when expiring keys,
+                 * so to start populate the eviction pool sampling keys from
+                 * every DB. */
+                // 从每个数据库中采样，在所有数据库的键中选择淘汰的键
+                for (j = 0; j < server.dbnum; j++) {
+                    db = server.db + j;
+                    dict = (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_ALLKEYS) ?
+                            db->dict : db->expires;
+                    if ((keys = dictSize(dict)) != 0) {
+                        evictionPoolPopulate(j, dict, db->dict, pool);
+                        total_keys += keys;
+                    }
+                }
+                if (!total_keys) break; /* No keys to evict. */
+
+                /* Go backward from best to worst element to evict. */
+                // 从最合适的候选开始，跳过采样之后已经被删除的键
+                for (k = REDIS_EVICTION_POOL_SIZE - 1; k >= 0; k--) {
+                    if (pool[k].key == NULL) continue;
+                    bestdbid = pool[k].dbid;
+
+                    db = server.db + bestdbid;
+                    if (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_ALLKEYS)
+                        de = dictFind(db->dict, pool[k].key);
+                    else
+                        de = dictFind(db->expires, pool[k].key);
+
+                    /* Remove the entry from the pool. */
+                    if (pool[k].key != pool[k].cached) sdsfree(pool[k].key);
+                    pool[k].key = NULL;
+                    pool[k].idle = 0;
+
+                    /* If the key exists, is our pick. Otherwise it is
+                     * a ghost and we need to try the next element. */
+                    if (de) {
+                        bestkey = dictGetKey(de);
+                        break;
+                    }
+                }
+            }
+        } else {
+            /* When evicting a random key, we try to evict a key for
+             * each DB, so we use the static 'next_db' variable to
+             * incrementally visit all DBs. */
+            // 随机淘汰时轮流访问每个数据库
+            for (j = 0; j < server.dbnum; j++) {
+                bestdbid = (++next_db) % server.dbnum;
+                db = server.db + bestdbid;
+                dict = (server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_ALLKEYS) ?
+                        db->dict : db->expires;
+                if (dictSize(dict) != 0) {
+                    de = dictGetRandomKey(dict);
+                    bestkey = dictGetKey(de);
+                    break;
+                }
+            }
+        }
+
+        /* Finally remove the selected key. */
+        if (bestkey) {
+            robj *keyobj;
+            size_t before, after;
+
+            db = server.db + bestdbid;
+            keyobj = createStringObject(bestkey, sdslen(bestkey));
+            /* We compute the amount of memory freed by dbDelete() alone.
+             * The key object is allocated before and freed after, so it
+             * does not count. A value handed to the lazy free thread
+             * counts as freed as soon as it is queued. */
+            /*
+             * 只统计 dbDelete() 释放的内存，键对象在此之前创建，之后释放，不计算在内
+             * 交给惰性释放线程的值在入队时就被当作已经释放
+            */
+            before = evictGetUsedMemory();
+            dbDelete(db, keyobj);
+            after = evictGetUsedMemory();
+            // 回收线程同时在释放内存，只计算减少的部分
+            if (before > after) mem_freed += before - after;
+            server.stat_evictedkeys++;
+            decrRefCount(keyobj);
+        } else {
+            // 没有可以淘汰的键
+            return REDIS_ERR;
+        }
+    }
+    return REDIS_OK;
+}
+
+
+#ifdef EVICT_TEST_MAIN
+#include <stdio.h>
+#include <math.h>
+#include "testhelp.h"
+
+/*
+ * Eviction replay: run a trace of reads against a database limited to
+ * EVICT_SIM_MEMORY bytes over the baseline, adding the key on every miss
+ * and calling freeMemoryIfNeeded() after it, like a cache would.
+ *
+ * The trace is a Zipf distribution over EVICT_SIM_KEYS keys, with a scan
+ * of never repeated keys every EVICT_SIM_SCAN_EVERY requests: LRU lets
+ * scans push the hot keys out, LFU doesn't.
+*/
+/*
+ * 淘汰重放：在内存比基线多 EVICT_SIM_MEMORY 字节的数据库上执行一个读取序列，
+ * 和缓存一样，每次未命中时添加键，并在之后调用 freeMemoryIfNeeded()
+ *
+ * 访问序列在 EVICT_SIM_KEYS 个键上服从 Zipf 分布，每 EVICT_SIM_SCAN_EVERY 次请求
+ * 插入一次对从不重复的键的扫描：LRU 会让扫描把热键挤出去，LFU 不会
+*/
+#define EVICT_SIM_KEYS 100000
+#define EVICT_SIM_MEMORY (640 * 1024)
+#define EVICT_SIM_REQUESTS 5000000
+#define EVICT_SIM_SCAN_EVERY 100000
+#define EVICT_SIM_SCAN_LEN 10000
+#define EVICT_SIM_ZIPF_S 0.99
+
+static double zipf_cdf[EVICT_SIM_KEYS];
+
+static void zipfInit(double s) {
+    double sum = 0;
+    int j;
+
+    for (j = 0; j < EVICT_SIM_KEYS; j++) sum += 1.0 / pow(j + 1, s);
+    zipf_cdf[0] = 1.0 / sum;
+    for (j = 1; j < EVICT_SIM_KEYS; j++)
+        zipf_cdf[j] = zipf_cdf[j - 1] + 1.0 / pow(j + 1, s) / sum;
+}
+
+// 二分查找 CDF，返回一个服从 Zipf 分布的键
+static int zipfNext(void) {
+    double r = (double)rand() / RAND_MAX;
+    int lo = 0, hi = EVICT_SIM_KEYS - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zipf_cdf[mid] < r) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// 创建 dbnum 个空数据库
+static void evictTestCreateDbs(int dbnum) {
+    int j;
+
+    server.dbnum = dbnum;
+    server.db = zmalloc(sizeof(redisDb) * dbnum);
+    for (j = 0; j < dbnum; j++) {
+        server.db[j].dict = dictCreate(&dbDictType, NULL);
+        server.db[j].expires = dictCreate(&keyptrDictType, NULL);
+        server.db[j].id = j;
+    }
+}
+
+// 释放所有数据库
+static void evictTestReleaseDbs(void) {
+    int j;
+
+    for (j = 0; j < server.dbnum; j++) {
+        dictRelease(server.db[j].expires);
+        dictRelease(server.db[j].dict);
+    }
+    zfree(server.db);
+    server.db = NULL;
+    server.dbnum = 0;
+}
+
+// 将键 key:<id> 添加到数据库中，expire 不为 -1 时同时设置过期时间
+static void evictTestAdd(redisDb *db, long id, long long expire) {
+    char buf[32], val[32];
+    robj *key;
+
+    memset(val, 'x', sizeof(val));
+    key = createStringObject(buf, snprintf(buf, sizeof(buf), "key:%ld", id));
+    dbAdd(db, key, createStringObject(val, sizeof(val)));
+    if (expire != -1) setExpire(db, key, expire);
+    decrRefCount(key);
+}
+
+// 检查键 key:<id> 是否还在数据库中
+static int evictTestExists(redisDb *db, long id) {
+    char buf[32];
+    sds key = sdsnewlen(buf, snprintf(buf, sizeof(buf), "key:%ld", id));
+    int exists = dictFind(db->dict, key) != NULL;
+
+    sdsfree(key);
+    return exists;
+}
+
+/*
+ * Replay the trace with the given policy and return the hit rate. Keys
+ * at or above EVICT_SIM_KEYS are scan keys, accessed once. The time
+ * spent in freeMemoryIfNeeded() is stored in *evict_us.
+*/
+/*
+ * 使用给定的策略重放访问序列，返回命中率，EVICT_SIM_KEYS 及以上的键是只访问一次的扫描键
+ * freeMemoryIfNeeded() 使用的时间保存在 *evict_us 中
+*/
+static double evictReplay(int policy, long long *evict_us, long long *evicted) {
+    long j, hits = 0, next_scan_key = EVICT_SIM_KEYS;
+    char buf[32];
+
+    evictTestCreateDbs(1);
+    server.maxmemory_policy = policy;
+    server.maxmemory = zmalloc_used_memory() + EVICT_SIM_MEMORY;
+    server.stat_evictedkeys = 0;
+    *evict_us = 0;
+    srand(1234);
+
+    for (j = 0; j < EVICT_SIM_REQUESTS; j++) {
+        long id;
+        robj *key;
+        monotime start;
+
+        // 使用请求数作为逻辑 LRU 时钟
+        server.lruclock = j & REDIS_LRU_CLOCK_MAX;
+
+        if (j % EVICT_SIM_SCAN_EVERY < EVICT_SIM_SCAN_LEN &&
+            j >= EVICT_SIM_SCAN_EVERY)
+            id = next_scan_key++;
+        else
+            id = zipfNext();
+
+        key = createStringObject(buf, snprintf(buf, sizeof(buf), "key:%ld", id));
+        if (lookupKey(server.db, key)) {
+            hits++;
+        } else {
+            evictTestAdd(server.db, id, -1);
+            elapsedStart(&start);
+            freeMemoryIfNeeded();
+            *evict_us += elapsedUs(start);
+        }
+        decrRefCount(key);
+    }
+
+    *evicted = server.stat_evictedkeys;
+    evictTestReleaseDbs();
+    server.maxmemory = 0;
+    return (double)hits / EVICT_SIM_REQUESTS;
+}
+
+int main(void) {
+    monotonicInit();
+    updateCachedTime();
+    server.hz = 10;
+    server.lfu_log_factor = REDIS_LFU_LOG_FACTOR;
+    server.lfu_decay_time = REDIS_LFU_DECAY_TIME;
+    server.maxmemory = REDIS_DEFAULT_MAXMEMORY;
+    server.maxmemory_samples = REDIS_DEFAULT_MAXMEMORY_SAMPLES;
+    srand(1234);
+    evictionPoolAlloc();
+
+    {
+        robj *o;
+        unsigned long freq;
+        int j;
+
+        server.maxmemory_policy = REDIS_MAXMEMORY_ALLKEYS_LRU;
+        o = createObject(REDIS_STRING, NULL);
+        test_cond("OBJECT FREQ is refused under LRU policies",
+            objectGetFrequency(o, &freq) == REDIS_ERR);
+        decrRefCount(o);
+
+        server.maxmemory_policy = REDIS_MAXMEMORY_ALLKEYS_LFU;
+        o = createObject(REDIS_STRING, NULL);
+        test_cond("New objects start with the initial LFU counter",
+            objectGetFrequency(o, &freq) == REDIS_OK && freq == REDIS_LFU_INIT_VAL);
+
+        for (j = 0; j < 1000; j++) objectTouch(o);
+        objectGetFrequency(o, &freq);
+        test_cond("1000 accesses grow the counter logarithmically",
+            freq > 10 && freq < 30);
+
+        // 将最后衰减时间调回 5 分钟之前
+        o->lru = (((LFUGetTimeInMinutes() - 5) & 65535) << 8) | freq;
+        test_cond("The counter decays by one per decay period",
+            LFUDecrAndReturn(o) == freq - 5);
+        decrRefCount(o);
+
+        // 设置了 maxmemory 时，LRU 和 LFU 策略下的每个值都需要自己的 lru 字段
+        server.maxmemory = 1024 * 1024 * 1024;
+        o = createStringObjectFromLongLong(10);
+        test_cond("Small integers are not shared under LFU policies",
+            o->encoding == REDIS_ENCODING_INT && (long)o->ptr == 10 &&
+            objectGetRefCount(o) == 1);
+        decrRefCount(o);
+        server.maxmemory = REDIS_DEFAULT_MAXMEMORY;
+    }
+
+    {
+        long j;
+        int ok = 0;
+
+        // 前 1000 个键在较早的时钟被访问，之后的键在较晚的时钟
+        evictTestCreateDbs(2);
+        server.maxmemory_policy = REDIS_MAXMEMORY_ALLKEYS_LRU;
+        server.lruclock = 1000;
+        for (j = 0; j < 1000; j++) evictTestAdd(server.db + j % 2, j, -1);
+        server.lruclock = 2000;
+        for (j = 1000; j < 4000; j++) evictTestAdd(server.db + j % 2, j, -1);
+        server.maxmemory = zmalloc_used_memory() - 32 * 1024;
+        test_cond("allkeys-lru brings the memory back under the limit",
+            freeMemoryIfNeeded() == REDIS_OK &&
+            zmalloc_used_memory() <= server.maxmemory &&
+            dictSize(server.db[0].dict) > 0 && dictSize(server.db[1].dict) > 0);
+        // 采样是近似的，允许少量较新的键被淘汰
+        for (j = 1000; j < 4000; j++)
+            if (!evictTestExists(server.db + j % 2, j)) ok++;
+        test_cond("allkeys-lru mostly evicts the least recently used keys",
+            server.stat_evictedkeys > 0 && ok < server.stat_evictedkeys / 5);
+
+        server.maxmemory_policy = REDIS_MAXMEMORY_NO_EVICTION;
+        server.maxmemory = zmalloc_used_memory() - 1;
+        test_cond("noeviction refuses to free memory",
+            freeMemoryIfNeeded() == REDIS_ERR);
+
+        server.maxmemory_policy = REDIS_MAXMEMORY_VOLATILE_LRU;
+        test_cond("Volatile policies fail when no key has an expire",
+            freeMemoryIfNeeded() == REDIS_ERR);
+        evictTestReleaseDbs();
+
+        // 一半的键设置了过期时间，过期时间和键的序号成正比
+        evictTestCreateDbs(1);
+        server.maxmemory_policy = REDIS_MAXMEMORY_VOLATILE_TTL;
+        for (j = 0; j < 4000; j++)
+            evictTestAdd(server.db, j, j % 2 ? 1000000 + j : -1);
+        server.maxmemory = zmalloc_used_memory() - 32 * 1024;
+        test_cond("volatile-ttl brings the memory back under the limit",
+            freeMemoryIfNeeded() == REDIS_OK &&
+            zmalloc_used_memory() <= server.maxmemory);
+        ok = 1;
+        for (j = 0; j < 4000; j += 2)
+            if (!evictTestExists(server.db, j)) ok = 0;
+        for (j = 3001; j < 4000; j += 2)
+            if (!evictTestExists(server.db, j)) ok = 0;
+        test_cond("volatile-ttl only evicts keys close to their expire", ok);
+        evictTestReleaseDbs();
+        server.maxmemory = 0;
+    }
+
+    /*
+     * The only volatile key is a big set, evicted through the lazy free
+     * thread: its bytes count as freed while it is still queued, so the
+     * eviction stops there instead of failing for lack of candidates.
+    */
+    /*
+     * 唯一设置了过期时间的键是一个大集合，它通过惰性释放线程淘汰：
+     * 它还在队列中时，字节数就被当作已经释放，因此淘汰到此为止，而不会因为没有候选键而失败
+    */
+    {
+        char buf[32];
+        robj *key, *set;
+        long j;
+
+        evictTestCreateDbs(1);
+        server.maxmemory_policy = REDIS_MAXMEMORY_VOLATILE_TTL;
+        server.stat_evictedkeys = 0;
+        server.lazyfree_enabled = 1;
+        lazyfreeInit();
+        for (j = 1; j < 1000; j++) evictTestAdd(server.db, j, -1);
+
+        set = createObject(REDIS_SET, dictCreate(&setDictType, NULL));
+        set->encoding = REDIS_ENCODING_HT;
+        for (j = 0; j < 200000; j++)
+            dictAdd(set->ptr, createStringObject(buf,
+                snprintf(buf, sizeof(buf), "member:%ld", j)), NULL);
+        key = createStringObject(buf, snprintf(buf, sizeof(buf), "key:%d", 0));
+        dbAdd(server.db, key, set);
+        setExpire(server.db, key, 1000000);
+        decrRefCount(key);
+
+        // 需要释放的内存远多于回收线程在淘汰返回之前来得及释放的内存
+        server.maxmemory = zmalloc_used_memory() - 4 * 1024 * 1024;
+        test_cond("Values queued for lazy free count as freed memory",
+            freeMemoryIfNeeded() == REDIS_OK &&
+            server.stat_evictedkeys == 1 && !evictTestExists(server.db, 0));
+        lazyfreeDrain();
+        test_cond("The lazy free thread released the evicted set",
+            lazyfreeGetPendingObjectsCount() == 0 &&
+            lazyfreeGetFreedObjectsCount() == 1 &&
+            zmalloc_used_memory() <= server.maxmemory);
+        evictTestReleaseDbs();
+        server.lazyfree_enabled = 0;
+        server.maxmemory = 0;
+    }
+
+    {
+        static const struct {
+            char *name;
+            int policy;
+        } policies[] = {
+            {"allkeys-lru", REDIS_MAXMEMORY_ALLKEYS_LRU},
+            {"allkeys-lfu", REDIS_MAXMEMORY_ALLKEYS_LFU},
+            {"allkeys-random", REDIS_MAXMEMORY_ALLKEYS_RANDOM}
+        };
+        double hit_rate[3];
+        long long evict_us, evicted;
+        int j;
+
+        zipfInit(EVICT_SIM_ZIPF_S);
+        printf("Zipf(%.2f) over %d keys, %d bytes of keys, scans of %d keys, "
+               "%d samples:\n", EVICT_SIM_ZIPF_S, EVICT_SIM_KEYS,
+               EVICT_SIM_MEMORY, EVICT_SIM_SCAN_LEN, server.maxmemory_samples);
+        for (j = 0; j < 3; j++) {
+            hit_rate[j] = evictReplay(policies[j].policy, &evict_us, &evicted);
+            printf("  %-15s hit rate %.2f%%, %lld keys evicted, "
+                   "%.3f us per evicted key\n", policies[j].name,
+                   hit_rate[j] * 100, evicted, (double)evict_us / evicted);
+        }
+        test_cond("LFU keeps more hot keys than LRU across scans",
+            hit_rate[1] > hit_rate[0]);
+        test_cond("LRU keeps more hot keys than random eviction",
+            hit_rate[0] > hit_rate[2]);
+    }
+
+    test_report();
+    return 0;
+}
+#endif
@@ -0,0 +1,473 @@
+/*
+ * Expiration of keys.
+ *
+ * The expire time of a key is stored in db->expires as an absolute UNIX
+ * time in milliseconds, held in the signed integer of the dictEntry
+ * value union, so volatile keys cost one dictEntry and no allocation for
+ * the time itself (see setExpire() in db.c).
+ *
+ * Expired keys are deleted in two ways:
+ *
+ * - lazily: expireIfNeeded() deletes a key when it is accessed after its
+ *   expire time, so an expired key is never returned;
+ * - actively: activeExpireCycle(), called on every server tick, samples
+ *   volatile keys and deletes the expired ones, to reclaim the memory of
+ *   keys that are never accessed again.
+ *
+ * The active cycle is adaptive: it keeps sampling a database while more
+ * than 25% of the sampled keys were expired, which keeps the memory used
+ * by expired keys around 25% of the volatile ones, and it stops when its
+ * time budget for the tick is used.
+*/
+/*
+ * 键的过期
+ *
+ * 键的过期时间以毫秒格式的 UNIX 时间戳保存在 db->expires 中，
+ * 存放在 dictEntry 值联合体的有符号整数里，因此带有过期时间的键只需要一个 dictEntry，
+ * 过期时间本身不需要分配内存（见 db.c 中的 setExpire()）
+ *
+ * 过期的键通过两种方式删除：
+ *
+ * - 惰性删除：键在过期之后被访问时，expireIfNeeded() 将它删除，因此过期的键永远不会被返回
+ * - 主动删除：每个服务器时钟周期调用一次 activeExpireCycle()，采样带有过期时间的键，
+ *   删除其中已经过期的，回收那些之后不再被访问的键的内存
+ *
+ * 主动过期是自适应的：采样的键中有超过 25% 已经过期时，就继续对这个数据库采样，
+ * 这使过期键占用的内存大约保持在带有过期时间的键的 25% 左右，
+ * 用完这个时钟周期的时间预算之后就停止
+*/
+
+#include "redis.h"
+
+/*
+ * Helper function for activeExpireCycle(): if the key is expired at the
+ * given time, delete it.
+ *
+ * Returns 1 if the key was expired, 0 otherwise.
+ *
+ * T = O(1)
+*/
+// activeExpireCycle() 使用的辅助函数：如果键在 now 时已经过期，删除它，删除时返回 1，否则返回 0
+static int activeExpireCycleTryExpire(redisDb *db, dictEntry *de, long long now) {
+    long long t = dictGetSignedIntegerVal(de);
+
+    if (now > t) {
+        sds key = dictGetKey(de);
+        robj *keyobj = createStringObject(key, sdslen(key));
+
+        dbDelete(db, keyobj);
+        decrRefCount(keyobj);
+        server.stat_expiredkeys++;
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/*
+ * Try to expire a few timed out keys. The algorithm used is adaptive and
+ * will use few CPU cycles if there are few expiring keys, otherwise it
+ * will get more aggressive to avoid that too much memory is used by keys
+ * that can be removed from the keyspace.
+ *
+ * No more than REDIS_DBCRON_DBS_PER_CALL databases are tested at every
+ * iteration. Every database is sampled ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP
+ * keys at a time, until less than 25% of a sample were expired.
+ *
+ * With type ACTIVE_EXPIRE_CYCLE_SLOW, the normal expire cycle called by
+ * the server cron, the time limit is ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC
+ * percent of the tick (1000000 / server.hz microseconds).
+ *
+ * With type ACTIVE_EXPIRE_CYCLE_FAST, called before sleeping in the event
+ * loop, the cycle runs for at most ACTIVE_EXPIRE_CYCLE_FAST_DURATION
+ * microseconds, and only if the previous cycle exited because of the time
+ * limit, that is when there is a backlog of expired keys. It is not
+ * repeated more often than every 2 * ACTIVE_EXPIRE_CYCLE_FAST_DURATION.
+ *
+ * The time limit is measured with the monotonic clock. Expire times are
+ * compared with the cached server.mstime, which is stable for the whole
+ * cycle.
+ *
+ * T = O(time limit)
+*/
+/*
+ * 尝试删除一些已经过期的键，算法是自适应的：
+ * 过期的键很少时只使用很少的 CPU 时间，否则会更积极地删除，
+ * 避免可以从键空间中删除的键占用太多内存
+ *
+ * 每次最多检查 REDIS_DBCRON_DBS_PER_CALL 个数据库，
+ * 每个数据库每次采样 ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP 个键，直到一次采样中过期的键少于 25%
+ *
+ * ACTIVE_EXPIRE_CYCLE_SLOW 是服务器时钟调用的普通过期循环，
+ * 时间限制为每个时钟周期（1000000 / server.hz 微秒）的 ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC%
+ *
+ * ACTIVE_EXPIRE_CYCLE_FAST 在事件循环进入睡眠之前调用，最多运行
+ * ACTIVE_EXPIRE_CYCLE_FAST_DURATION 微秒，并且只在上一次循环因为时间限制而退出时
+ * （也就是积压了过期的键时）才运行，两次之间至少间隔 2 * ACTIVE_EXPIRE_CYCLE_FAST_DURATION 微秒
+ *
+ * 时间限制使用单调时钟测量，过期时间和缓存的 server.mstime 比较，在整个循环中保持不变
+*/
+void activeExpireCycle(int type) {
+    /* This function has some global state in order to continue the work
+     * incrementally across calls. */
+    static unsigned int current_db = 0; /* Last DB tested. */
+    static int timelimit_exit = 0;      /* Time limit hit in previous call? */
+    static monotime last_fast_cycle = 0; /* When last fast cycle ran. */
+
+    int j, iteration = 0;
+    int dbs_per_call = REDIS_DBCRON_DBS_PER_CALL;
+    monotime start;
+    uint64_t timelimit;
+
+    elapsedStart(&start);
+
+    if (type == ACTIVE_EXPIRE_CYCLE_FAST) {
+        /* Don't start a fast cycle if the previous cycle did not exit
+         * for the time limit. Also don't repeat a fast cycle for the same
+         * period as the fast cycle total duration itself. */
+        if (!timelimit_exit) return;
+        if (start < last_fast_cycle + ACTIVE_EXPIRE_CYCLE_FAST_DURATION * 2) return;
+        last_fast_cycle = start;
+    }
+
+    /* We usually should test REDIS_DBCRON_DBS_PER_CALL per iteration, with
+     * two exceptions:
+     *
+     * 1) Don't test more DBs than we have.
+     * 2) If last time we hit the time limit, we want to scan all DBs
+     * in this iteration, as there is work to do in some DB and we don't want
+     * expired keys to use memory for too much time. */
+    if (dbs_per_call > server.dbnum || timelimit_exit)
+        dbs_per_call = server.dbnum;
+
+    /* We can use at max ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC percentage of CPU
+     * time per iteration. Since this function gets called with a frequency of
+     * server.hz times per second, the following is the max amount of
+     * microseconds we can spend in this function. */
+    timelimit = 1000000 * ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC / server.hz / 100;
+    timelimit_exit = 0;
+    if (timelimit == 0) timelimit = 1;
+
+    if (type == ACTIVE_EXPIRE_CYCLE_FAST)
+        timelimit = ACTIVE_EXPIRE_CYCLE_FAST_DURATION; /* in microseconds. */
+
+    for (j = 0; j < dbs_per_call; j++) {
+        int expired;
+        redisDb *db = server.db + (current_db % server.dbnum);
+
+        /* Increment the DB now so we are sure if we run out of time
+         * in the current DB we'll restart from the next. This allows to
+         * distribute the time evenly across DBs. */
+        current_db++;
+
+        /* Continue to expire if at the end of the cycle more than 25%
+         * of the keys were expired. */
+        do {
+            unsigned long num, slots;
+
+            /* If there is nothing to expire try next DB ASAP. */
+            if ((num = dictSize(db->expires)) == 0) break;
+            slots = dictSlots(db->expires);
+
+            /* When there are less than 1% filled slots getting random
+             * keys is expensive, so stop here waiting for better times...
+             * The dictionary will be resized asap. */
+            // 填充率低于 1% 时随机取键的代价太高，等待字典被缩小
+            if (num && slots > DICT_HT_INITIAL_SIZE &&
+                (num * 100 / slots < 1)) break;
+
+            /* The main collection cycle. Sample random keys among keys
+             * with an expire set, checking for expired ones. */
+            expired = 0;
+            if (num > ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP)
+                num = ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP;
+            while (num--) {
+                dictEntry *de;
+
+                if ((de = dictGetRandomKey(db->expires)) == NULL) break;
+                if (activeExpireCycleTryExpire(db, de, server.mstime)) expired++;
+            }
+
+            /* We can't block forever here even if there are many keys to
+             * expire. So after a given amount of milliseconds return to the
+             * caller waiting for the other active expire cycle. */
+            // 每 16 次循环检查一次时间限制
+            iteration++;
+            if ((iteration & 0xf) == 0 && elapsedUs(start) > timelimit)
+                timelimit_exit = 1;
+            if (timelimit_exit) return;
+        } while (expired > ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP / 4);
+    }
+}
+
+#ifdef EXPIRE_TEST_MAIN
+#include <stdio.h>
+#include "testhelp.h"
+
+/*
+ * Benchmark: EXPIRE_BENCH_KEYS keys with TTLs uniformly distributed in
+ * (0, EXPIRE_BENCH_MAX_TTL] milliseconds, then simulated server ticks
+ * that advance the cached time by one tick, run a slow expire cycle and
+ * EXPIRE_BENCH_READS_PER_TICK random reads. The time is simulated, the
+ * cycle and read costs are measured.
+*/
+/*
+ * 基准测试：EXPIRE_BENCH_KEYS 个键，生存时间在 (0, EXPIRE_BENCH_MAX_TTL] 毫秒之间均匀分布，
+ * 然后模拟服务器时钟周期：每个周期将缓存的时间推进一个周期，执行一次慢速主动过期，
+ * 以及 EXPIRE_BENCH_READS_PER_TICK 次随机读取
+ * 时间是模拟的，主动过期和读取的代价是实际测量的
+*/
+#define EXPIRE_BENCH_KEYS 10000000
+#define EXPIRE_BENCH_MAX_TTL 600000
+#define EXPIRE_BENCH_HZ 10
+#define EXPIRE_BENCH_READS_PER_TICK 200
+
+// 创建一个空的数据库
+static void expireTestCreateDb(void) {
+    server.dbnum = 1;
+    server.db = zmalloc(sizeof(redisDb));
+    server.db->dict = dictCreate(&dbDictType, NULL);
+    server.db->expires = dictCreate(&keyptrDictType, NULL);
+    server.db->id = 0;
+}
+
+static void expireTestReleaseDb(void) {
+    dictRelease(server.db->expires);
+    dictRelease(server.db->dict);
+    zfree(server.db);
+    server.db = NULL;
+    server.dbnum = 0;
+}
+
+// 返回键 key:<id> 的对象
+static robj *expireTestKey(long id) {
+    char buf[32];
+
+    return createStringObject(buf, snprintf(buf, sizeof(buf), "key:%ld", id));
+}
+
+// 添加键 key:<id>，expire 不为 -1 时设置过期时间
+static void expireTestAdd(long id, long long expire) {
+    robj *key = expireTestKey(id);
+
+    dbAdd(server.db, key, createStringObject("value:0123456789", 16));
+    if (expire != -1) setExpire(server.db, key, expire);
+    decrRefCount(key);
+}
+
+// 数据库中已经逻辑过期、但还没有被删除的键的数量
+static unsigned long expireTestCountStale(void) {
+    dictIterator *di = dictGetIterator(server.db->expires);
+    dictEntry *de;
+    unsigned long stale = 0;
+
+    while ((de = dictNext(di)) != NULL)
+        if (dictGetSignedIntegerVal(de) < server.mstime) stale++;
+    dictReleaseIterator(di);
+    return stale;
+}
+
+// 模拟服务器时钟，将缓存的时间推进 ms 毫秒
+static void expireTestAdvance(long long ms) {
+    server.mstime += ms;
+    server.ustime = server.mstime * 1000;
+    server.unixtime = server.mstime / 1000;
+}
+
+// 模拟服务器时钟：字典很稀疏时缩小它，正在 rehash 时进行 1 毫秒的 rehash
+static void expireTestResize(dict *d) {
+    if (dictIsRehashing(d))
+        dictRehashMilliseconds(d, 1);
+    else if (dictSlots(d) > DICT_HT_INITIAL_SIZE && dictSize(d) * 100 / dictSlots(d) < 10)
+        dictResize(d);
+}
+
+static void expireBenchmark(void) {
+    static unsigned long expiring[EXPIRE_BENCH_MAX_TTL / (1000 / EXPIRE_BENCH_HZ) + 1];
+    unsigned long alive = EXPIRE_BENCH_KEYS, max_cycle_us = 0;
+    unsigned long long cycle_us = 0, reads_us = 0, cycles = 0, reads = 0;
+    long long start_time, lazy_expired = 0, stat_before;
+    size_t mem_empty, mem_full;
+    monotime start;
+    long j, tick;
+
+    expireTestCreateDb();
+    server.hz = EXPIRE_BENCH_HZ;
+    start_time = server.mstime;
+    mem_empty = zmalloc_used_memory();
+    memset(expiring, 0, sizeof(expiring));
+
+    elapsedStart(&start);
+    for (j = 0; j < EXPIRE_BENCH_KEYS; j++) {
+        long long ttl = 1 + rand() % EXPIRE_BENCH_MAX_TTL;
+
+        expireTestAdd(j, start_time + ttl);
+        // 统计每个时钟周期内过期的键的数量
+        expiring[ttl / (1000 / EXPIRE_BENCH_HZ)]++;
+    }
+    mem_full = zmalloc_used_memory();
+    printf("%d keys with TTLs up to %ds, %.1f MB, loaded in %llu ms\n",
+        EXPIRE_BENCH_KEYS, EXPIRE_BENCH_MAX_TTL / 1000,
+        (double)(mem_full - mem_empty) / 1024 / 1024,
+        (unsigned long long)elapsedMs(start));
+    printf("  time  keys      alive     stale  used MB  cycle avg/max us  read ns\n");
+
+    stat_before = server.stat_expiredkeys;
+    for (tick = 1; tick <= (EXPIRE_BENCH_MAX_TTL + 60000) * EXPIRE_BENCH_HZ / 1000; tick++) {
+        unsigned long us;
+
+        expireTestAdvance(1000 / EXPIRE_BENCH_HZ);
+        if (tick - 1 < (long)(sizeof(expiring) / sizeof(expiring[0])))
+            alive -= expiring[tick - 1];
+
+        elapsedStart(&start);
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        us = elapsedUs(start);
+        cycle_us += us;
+        cycles++;
+        if (us > max_cycle_us) max_cycle_us = us;
+
+        // 随机读取，会惰性删除遇到的过期键
+        elapsedStart(&start);
+        for (j = 0; j < EXPIRE_BENCH_READS_PER_TICK; j++) {
+            robj *key = expireTestKey(rand() % EXPIRE_BENCH_KEYS);
+            long long before = server.stat_expiredkeys;
+
+            lookupKeyRead(server.db, key);
+            lazy_expired += server.stat_expiredkeys - before;
+            decrRefCount(key);
+        }
+        reads_us += elapsedUs(start);
+        reads += EXPIRE_BENCH_READS_PER_TICK;
+
+        // 每秒一次，和服务器时钟一样缩小稀疏的字典
+        if (tick % EXPIRE_BENCH_HZ == 0) {
+            expireTestResize(server.db->dict);
+            expireTestResize(server.db->expires);
+        }
+
+        if (tick % (EXPIRE_BENCH_HZ * 60) == 0) {
+            unsigned long keys = dictSize(server.db->dict);
+
+            printf("  %3lds  %-8lu  %-8lu  %4.1f%%  %7.1f  %8.0f / %-6lu  %7.0f\n",
+                tick / EXPIRE_BENCH_HZ, keys, alive,
+                keys ? 100.0 * (keys - alive) / keys : 0.0,
+                (double)(zmalloc_used_memory() - mem_empty) / 1024 / 1024,
+                (double)cycle_us / cycles, max_cycle_us,
+                (double)reads_us * 1000 / reads);
+            cycle_us = reads_us = cycles = reads = 0;
+            max_cycle_us = 0;
+        }
+    }
+    printf("Reclaimed %.1f MB of %.1f MB, %lld keys expired: %lld actively, "
+           "%lld lazily on access\n",
+        (double)(mem_full - zmalloc_used_memory()) / 1024 / 1024,
+        (double)(mem_full - mem_empty) / 1024 / 1024,
+        server.stat_expiredkeys - stat_before,
+        server.stat_expiredkeys - stat_before - lazy_expired, lazy_expired);
+    expireTestReleaseDb();
+}
+
+int main(void) {
+    monotonicInit();
+    updateCachedTime();
+    server.hz = 10;
+    srand(1234);
+
+    {
+        robj *key, *missing;
+
+        expireTestCreateDb();
+        expireTestAdd(1, server.mstime + 1000);
+        expireTestAdd(2, -1);
+        key = expireTestKey(1);
+        missing = expireTestKey(2);
+
+        test_cond("getExpire returns the expire time",
+            getExpire(server.db, key) == server.mstime + 1000 &&
+            getExpire(server.db, missing) == -1);
+        test_cond("A key is readable before its expire time",
+            lookupKeyRead(server.db, key) != NULL);
+
+        expireTestAdvance(1001);
+        test_cond("An expired key is deleted when accessed",
+            lookupKeyRead(server.db, key) == NULL &&
+            dictSize(server.db->dict) == 1 && dictSize(server.db->expires) == 0);
+        test_cond("A key without expire is never expired",
+            lookupKeyRead(server.db, missing) != NULL);
+
+        setExpire(server.db, missing, server.mstime - 1);
+        test_cond("removeExpire makes a key persistent",
+            removeExpire(server.db, missing) &&
+            lookupKeyRead(server.db, missing) != NULL);
+
+        decrRefCount(key);
+        decrRefCount(missing);
+        expireTestReleaseDb();
+    }
+
+    {
+        long j;
+        unsigned long stale;
+        monotime start;
+        uint64_t us;
+
+        // 9000 个键已经过期，1000 个还没有
+        expireTestCreateDb();
+        for (j = 0; j < 10000; j++)
+            expireTestAdd(j, server.mstime + (j < 9000 ? -1 : 100000));
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        stale = expireTestCountStale();
+        test_cond("A slow cycle keeps going while many sampled keys are expired",
+            stale < 3000 && dictSize(server.db->dict) - stale == 1000);
+        expireTestReleaseDb();
+
+        // 只有 1% 的键已经过期
+        expireTestCreateDb();
+        for (j = 0; j < 10000; j++)
+            expireTestAdd(j, server.mstime + (j < 100 ? -1 : 100000));
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        test_cond("A slow cycle stops early when few sampled keys are expired",
+            dictSize(server.db->dict) >= 10000 - ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP);
+        expireTestReleaseDb();
+
+        // 所有键都已经过期，数量多到无法在时间预算内删除
+        expireTestCreateDb();
+        for (j = 0; j < 1000000; j++) expireTestAdd(j, server.mstime - 1);
+        elapsedStart(&start);
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        us = elapsedUs(start);
+        printf("Slow cycle on 1000000 expired keys: %llu us, %lu keys left\n",
+            (unsigned long long)us, dictSize(server.db->dict));
+        test_cond("A slow cycle stops at its time budget",
+            us < 1000000 * ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC / server.hz / 100 * 3 / 2 &&
+            dictSize(server.db->dict) > 0);
+
+        j = dictSize(server.db->dict);
+        elapsedStart(&start);
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_FAST);
+        us = elapsedUs(start);
+        test_cond("A fast cycle runs after a slow cycle ran out of time",
+            dictSize(server.db->dict) < (unsigned long)j &&
+            us < ACTIVE_EXPIRE_CYCLE_FAST_DURATION * 3);
+
+        // 等待快速循环的最小间隔，再让慢速循环在时间预算内完成
+        while (elapsedUs(start) < ACTIVE_EXPIRE_CYCLE_FAST_DURATION * 2);
+        while (dictSize(server.db->dict)) {
+            expireTestResize(server.db->expires);
+            activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        }
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_SLOW);
+        expireTestAdd(0, server.mstime - 1);
+        activeExpireCycle(ACTIVE_EXPIRE_CYCLE_FAST);
+        test_cond("A fast cycle doesn't run when there is no backlog",
+            dictSize(server.db->dict) == 1);
+        expireTestReleaseDb();
+    }
+
+    expireBenchmark();
+
+    test_report();
+    return 0;
+}
+#endif
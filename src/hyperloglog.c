@@ -1,9 +1,16 @@
 #include "redis.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
-struct hlldhr {
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct hllhdr {
     char magic[4];          // "HYLL"
     uint8_t encoding;       // HLL_DENSE or HLL_SPARSE
     uint8_t notused[3];     // Reversed for future use, must be zero
@@ -12,14 +19,20 @@ struct hlldhr {
 };
 
 /*
- * The cached cardinality MSB is used to signal validity of the cached value
+ * The cached cardinality MSB is used to signal validity of the cached value.
+ * The cardinality is little endian, so the MSB is the top bit of card[7].
+*/
+/*
+ * 缓存基数的最高位用于标识缓存值是否有效
+ * 基数以小端保存，所以最高位是 card[7] 的最高位
 */
-#define HLL_INVALIDATE_CACHE(hdr) (hdr)->card[0] |= (1<<7)
-#define HLL_VALID_CACHE(hdr) (((hdr)->card[0] & (1<<7)) == 0)
+#define HLL_INVALIDATE_CACHE(hdr) (hdr)->card[7] |= (1<<7)
+#define HLL_VALID_CACHE(hdr) (((hdr)->card[7] & (1<<7)) == 0)
 
 #define HLL_P 14                // The greater is P, the smaller the error
 #define HLL_REGISTERS (1 << HLL_P)  // With p=14, 16384 registers
 #define HLL_P_MASK (HLL_REGISTERS - 1)  // Mask to index register
+#define HLL_Q (64 - HLL_P)      // Hash bits used to count the run of zeroes
 #define HLL_BITS 6              // Enough to count up to 63 leading zeroes
 #define HLL_REGISTER_MAX ((1 << HLL_BITS) - 1)
 #define HLL_HDR_SIZE sizeof(struct hllhdr)
@@ -33,7 +46,26 @@ static char *invalid_hll_err = "-INVALIDOBJ Corrupted HLL object detected\r\n";
 
 /* =========================== Low level bit macros ========================= */
 
+/*
+ * Dense registers are 6 bit wide and packed starting from the least
+ * significant bit of the first byte, so register 0 uses bits 0-5 of the
+ * first byte, register 1 uses bits 6-7 of the first byte and bits 0-3
+ * of the second byte and so forth.
+ *
+ * Every group of 8 registers fits exactly in 6 bytes (48 bits), which is
+ * what the chunked functions below work on.
+*/
+/*
+ * 密集表示的寄存器宽 6 位，从第一个字节的最低位开始紧密排列：
+ * 寄存器 0 使用第一个字节的 0-5 位，
+ * 寄存器 1 使用第一个字节的 6-7 位以及第二个字节的 0-3 位，以此类推
+ *
+ * 每 8 个寄存器正好占用 6 个字节（48 位），下面按块处理的函数都以此为单位
+*/
 
+/* Store the value of the register at position 'regnum' into variable 'target'.
+ * 'p' is an array of unsigned bytes. */
+// 将位置 regnum 上的寄存器的值保存到 target 中，p 是一个无符号字节数组
 #define HLL_DENSE_GET_REGISTER(target, p, regnum) do { \
     uint8_t *_p = (uint8_t*) p; \
     unsigned long _byte = regnum * HLL_BITS / 8; \
@@ -41,5 +73,1816 @@ static char *invalid_hll_err = "-INVALIDOBJ Corrupted HLL object detected\r\n";
     unsigned long _fb8 = 8 - _fb; \
     unsigned long b0 = _p[_byte]; \
     unsigned long b1 = _p[_byte + 1]; \
-    target = ((b0 >> b1) | (b1 << _fb8)) & HLL_REGISTER_MAX; \
-} while(0)
\ No newline at end of file
+    target = ((b0 >> _fb) | (b1 << _fb8)) & HLL_REGISTER_MAX; \
+} while(0)
+
+/* Set the value of the register at position 'regnum' to 'val'.
+ * 'p' is an array of unsigned bytes. */
+// 将位置 regnum 上的寄存器的值设置为 val，p 是一个无符号字节数组
+#define HLL_DENSE_SET_REGISTER(p, regnum, val) do { \
+    uint8_t *_p = (uint8_t*) p; \
+    unsigned long _byte = regnum * HLL_BITS / 8; \
+    unsigned long _fb = regnum * HLL_BITS & 7; \
+    unsigned long _fb8 = 8 - _fb; \
+    unsigned long _v = val; \
+    _p[_byte] &= ~(HLL_REGISTER_MAX << _fb); \
+    _p[_byte] |= _v << _fb; \
+    _p[_byte + 1] &= ~(HLL_REGISTER_MAX >> _fb8); \
+    _p[_byte + 1] |= _v >> _fb8; \
+} while(0)
+
+/* Load and store 8 dense registers (48 bits) as a little endian integer */
+// 以小端整数的形式读取和写入 8 个密集寄存器（48 位）
+#define HLL_DENSE_LOAD_CHUNK(p) \
+    ((uint64_t)(p)[0] | ((uint64_t)(p)[1] << 8) | ((uint64_t)(p)[2] << 16) | \
+     ((uint64_t)(p)[3] << 24) | ((uint64_t)(p)[4] << 32) | ((uint64_t)(p)[5] << 40))
+
+#define HLL_DENSE_STORE_CHUNK(p, w) do { \
+    (p)[0] = (w); (p)[1] = (w) >> 8; (p)[2] = (w) >> 16; \
+    (p)[3] = (w) >> 24; (p)[4] = (w) >> 32; (p)[5] = (w) >> 40; \
+} while(0)
+
+/*
+ * The sparse representation is a sequence of three kinds of opcodes,
+ * run length encoding the registers from the first to the last:
+ *
+ * ZERO:  00xxxxxx          xxxxxx + 1 registers (1-64) set to zero
+ * XZERO: 01xxxxxx yyyyyyyy xxxxxxyyyyyyyy + 1 registers (1-16384) set to zero
+ * VAL:   1vvvvvxx          xx + 1 registers (1-4) set to vvvvv + 1 (1-32)
+ *
+ * An empty HLL is a single XZERO opcode covering the 16384 registers, so
+ * it takes 2 bytes instead of 12KB. A register set to a value greater
+ * than 32, or a representation longer than server.hll_sparse_max_bytes,
+ * promotes the HLL to the dense representation.
+*/
+/*
+ * 稀疏表示由三种操作码组成，从第一个寄存器到最后一个寄存器进行游程编码：
+ *
+ * ZERO：  00xxxxxx          xxxxxx + 1 个（1-64）值为零的寄存器
+ * XZERO： 01xxxxxx yyyyyyyy xxxxxxyyyyyyyy + 1 个（1-16384）值为零的寄存器
+ * VAL：   1vvvvvxx          xx + 1 个（1-4）值为 vvvvv + 1（1-32）的寄存器
+ *
+ * 空的 HLL 只需要一个覆盖 16384 个寄存器的 XZERO 操作码，
+ * 占用 2 个字节而不是 12KB
+ * 当某个寄存器的值大于 32，或者表示的长度超过 server.hll_sparse_max_bytes 时，
+ * HLL 会被转换为密集表示
+*/
+#define HLL_SPARSE_XZERO_BIT 0x40 /* 01xxxxxx */
+#define HLL_SPARSE_VAL_BIT 0x80 /* 1vvvvvxx */
+#define HLL_SPARSE_IS_ZERO(p) (((*(p)) & 0xc0) == 0) /* 00xxxxxx */
+#define HLL_SPARSE_IS_XZERO(p) (((*(p)) & 0xc0) == HLL_SPARSE_XZERO_BIT)
+#define HLL_SPARSE_IS_VAL(p) ((*(p)) & HLL_SPARSE_VAL_BIT)
+#define HLL_SPARSE_ZERO_LEN(p) (((*(p)) & 0x3f)+1)
+#define HLL_SPARSE_XZERO_LEN(p) (((((*(p)) & 0x3f) << 8) | (*((p)+1)))+1)
+#define HLL_SPARSE_VAL_VALUE(p) ((((*(p)) >> 2) & 0x1f)+1)
+#define HLL_SPARSE_VAL_LEN(p) (((*(p)) & 0x3)+1)
+#define HLL_SPARSE_VAL_MAX_VALUE 32
+#define HLL_SPARSE_VAL_MAX_LEN 4
+#define HLL_SPARSE_ZERO_MAX_LEN 64
+#define HLL_SPARSE_XZERO_MAX_LEN 16384
+#define HLL_SPARSE_VAL_SET(p,val,len) do { \
+    *(p) = (((val)-1)<<2|((len)-1))|HLL_SPARSE_VAL_BIT; \
+} while(0)
+#define HLL_SPARSE_ZERO_SET(p,len) do { \
+    *(p) = (len)-1; \
+} while(0)
+#define HLL_SPARSE_XZERO_SET(p,len) do { \
+    int _l = (len)-1; \
+    *(p) = (_l>>8) | HLL_SPARSE_XZERO_BIT; \
+    *((p)+1) = (_l&0xff); \
+} while(0)
+
+/* ========================= HyperLogLog algorithm  ========================= */
+
+/*
+ * Our hash function is MurmurHash2, 64 bit version.
+ * It was modified for Redis in order to provide the same result in
+ * big and little endian archs (endian neutral).
+*/
+/*
+ * 哈希函数使用 64 位版本的 MurmurHash2
+ * 这里对其进行了修改，使它在大端和小端架构上得出相同的结果（与字节序无关）
+*/
+uint64_t MurmurHash64A(const void *key, int len, unsigned int seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+    const uint8_t *data = (const uint8_t *)key;
+    const uint8_t *end = data + (len - (len & 7));
+
+    while(data != end) {
+        uint64_t k;
+
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+        memcpy(&k, data, sizeof(k));
+#else
+        k = (uint64_t) data[0];
+        k |= (uint64_t) data[1] << 8;
+        k |= (uint64_t) data[2] << 16;
+        k |= (uint64_t) data[3] << 24;
+        k |= (uint64_t) data[4] << 32;
+        k |= (uint64_t) data[5] << 40;
+        k |= (uint64_t) data[6] << 48;
+        k |= (uint64_t) data[7] << 56;
+#endif
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+        data += 8;
+    }
+
+    switch(len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48; /* fall through */
+    case 6: h ^= (uint64_t)data[5] << 40; /* fall through */
+    case 5: h ^= (uint64_t)data[4] << 32; /* fall through */
+    case 4: h ^= (uint64_t)data[3] << 24; /* fall through */
+    case 3: h ^= (uint64_t)data[2] << 16; /* fall through */
+    case 2: h ^= (uint64_t)data[1] << 8; /* fall through */
+    case 1: h ^= (uint64_t)data[0];
+            h *= m; /* fall through */
+    };
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+/*
+ * Given the 64 bit hash of an element, returns the length of the pattern
+ * 000..1 of the hash. As a side effect 'regp' is set to the register
+ * index this hash maps to.
+ *
+ * The low HLL_P bits of the hash select the register, the remaining
+ * HLL_Q bits are used to count the run of zeroes. A bit is set past the
+ * last one so that the count never exceeds HLL_Q + 1.
+ *
+ * T = O(1)
+*/
+/*
+ * 计算哈希值中 000..1 模式的长度
+ * 同时将 regp 设置为哈希值所属寄存器的索引
+ *
+ * 哈希值的低 HLL_P 位用于选择寄存器，其余 HLL_Q 位用于计算连续零的长度
+ * 在最高位之后额外设置一个位，确保计数不会超过 HLL_Q + 1
+*/
+static inline int hllPatLenHash(uint64_t hash, long *regp) {
+    *regp = (long)(hash & HLL_P_MASK);
+    hash >>= HLL_P;
+    hash |= ((uint64_t)1 << HLL_Q);
+    return __builtin_ctzll(hash) + 1;
+}
+
+/*
+ * Given a string element to add to the HyperLogLog, returns the length
+ * of the pattern 000..1 of the element hash, see hllPatLenHash().
+ *
+ * T = O(N) where N is the element length
+*/
+/*
+ * 计算元素哈希值中 000..1 模式的长度，见 hllPatLenHash()
+*/
+int hllPatLen(unsigned char *ele, size_t elesize, long *regp) {
+    return hllPatLenHash(MurmurHash64A(ele, elesize, 0xadc83b19ULL), regp);
+}
+
+/* ================== Dense representation implementation  ================== */
+
+/*
+ * Low level function to set the dense HLL register at 'index' to the
+ * specified value if the current value is smaller than 'count'.
+ *
+ * Returns 1 if the register was updated, 0 otherwise.
+ *
+ * T = O(1)
+*/
+/*
+ * 如果密集 HLL 中位于 index 的寄存器的值小于 count，那么将其设置为 count
+ *
+ * 寄存器被更新时返回 1，否则返回 0
+*/
+int hllDenseSet(uint8_t *registers, long index, uint8_t count) {
+    uint8_t oldcount;
+
+    HLL_DENSE_GET_REGISTER(oldcount, registers, index);
+    if (count > oldcount) {
+        HLL_DENSE_SET_REGISTER(registers, index, count);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * "Add" the element in the dense hyperloglog data structure.
+ *
+ * Returns 1 if the register was updated, so that the approximated
+ * cardinality may have changed, 0 otherwise.
+ *
+ * T = O(N) where N is the element length
+*/
+/*
+ * 将元素添加到密集 HLL 中
+ *
+ * 寄存器被更新（基数估算值可能改变）时返回 1，否则返回 0
+*/
+int hllDenseAdd(uint8_t *registers, unsigned char *ele, size_t elesize) {
+    long index;
+    uint8_t count = hllPatLen(ele, elesize, &index);
+
+    return hllDenseSet(registers, index, count);
+}
+
+/*
+ * Compute the register histogram of a dense HLL: reghisto[j] is set to
+ * the number of registers whose value is j.
+ *
+ * Registers are processed 8 at a time, loading the 48 bits holding them
+ * as a single integer, so there are no per register branches or unaligned
+ * bit fiddling. Each of the 8 positions of a chunk counts into its own
+ * histogram: in sparsely populated sketches most registers are zero, and
+ * a single histogram would serialise all the increments on reghisto[0].
+ *
+ * T = O(M) where M is the number of registers
+*/
+/*
+ * 计算密集 HLL 的寄存器直方图：reghisto[j] 为值等于 j 的寄存器数量
+ *
+ * 每次以一个整数的形式读取 8 个寄存器所在的 48 位，
+ * 因此处理每个寄存器时既没有分支，也不需要跨字节的位操作
+ * 块中的 8 个位置各自使用一个直方图：元素较少时大部分寄存器都是零，
+ * 只用一个直方图的话，所有自增操作都会串行地落在 reghisto[0] 上
+*/
+void hllDenseRegHisto(uint8_t *registers, int *reghisto) {
+    int h[8][64];
+    uint8_t *p = registers;
+    int j;
+
+    memset(h, 0, sizeof(h));
+    for (j = 0; j < HLL_REGISTERS / 8; j++) {
+        uint64_t w = HLL_DENSE_LOAD_CHUNK(p);
+
+        h[0][w & 63]++;
+        h[1][(w >> 6) & 63]++;
+        h[2][(w >> 12) & 63]++;
+        h[3][(w >> 18) & 63]++;
+        h[4][(w >> 24) & 63]++;
+        h[5][(w >> 30) & 63]++;
+        h[6][(w >> 36) & 63]++;
+        h[7][(w >> 42) & 63]++;
+        p += 6;
+    }
+    for (j = 0; j < 64; j++) {
+        reghisto[j] += h[0][j] + h[1][j] + h[2][j] + h[3][j] +
+                       h[4][j] + h[5][j] + h[6][j] + h[7][j];
+    }
+}
+
+/*
+ * Compute the register histogram of an HLL_RAW representation, which
+ * uses one byte per register. Like hllDenseRegHisto() it spreads the
+ * increments over 8 histograms.
+ *
+ * T = O(M)
+*/
+/*
+ * 计算 HLL_RAW 表示（每个寄存器一个字节）的寄存器直方图
+ * 和 hllDenseRegHisto() 一样，自增操作分散在 8 个直方图上
+*/
+void hllRawRegHisto(uint8_t *registers, int *reghisto) {
+    int h[8][64];
+    int j;
+
+    memset(h, 0, sizeof(h));
+    for (j = 0; j < HLL_REGISTERS; j += 8) {
+        h[0][registers[j]]++;
+        h[1][registers[j + 1]]++;
+        h[2][registers[j + 2]]++;
+        h[3][registers[j + 3]]++;
+        h[4][registers[j + 4]]++;
+        h[5][registers[j + 5]]++;
+        h[6][registers[j + 6]]++;
+        h[7][registers[j + 7]]++;
+    }
+    for (j = 0; j < 64; j++) {
+        reghisto[j] += h[0][j] + h[1][j] + h[2][j] + h[3][j] +
+                       h[4][j] + h[5][j] + h[6][j] + h[7][j];
+    }
+}
+
+/*
+ * Spread the 8 registers of a 48 bit chunk to the 8 bytes of the result,
+ * register 0 in the least significant byte.
+*/
+// 将 48 位块中的 8 个寄存器分散到结果的 8 个字节中，寄存器 0 位于最低字节
+static inline uint64_t hllSpreadChunk(uint64_t w) {
+    // 24 位一组分到两个 32 位半部，12 位一组分到 16 位，最后 6 位一组分到字节
+    w = (w & 0xffffffULL) | ((w & 0xffffff000000ULL) << 8);
+    w = (w & 0x00000fff00000fffULL) | ((w & 0x00fff00000fff000ULL) << 4);
+    w = (w & 0x003f003f003f003fULL) | ((w & 0x0fc00fc00fc00fc0ULL) << 2);
+    return w;
+}
+
+/*
+ * Unpack the dense registers into an HLL_RAW buffer of HLL_REGISTERS bytes,
+ * or, when 'merge' is true, store in every byte of the buffer the max of
+ * its current value and the register, in the same pass.
+ *
+ * With AVX2 every 32 bit lane receives 3 dense bytes (4 registers) via a
+ * byte shuffle, then the 4 registers are moved to their own byte with
+ * shifts and masks: 32 registers per iteration. The last iteration is
+ * left to the scalar loop, as the 16 byte loads would read past the
+ * registers. With SSE2 only, chunks are spread to bytes with scalar
+ * shifts and merged 16 registers at a time.
+ *
+ * T = O(M)
+*/
+/*
+ * 将密集寄存器解压到一个 HLL_REGISTERS 字节的 HLL_RAW 缓冲区中，
+ * merge 为真时，在同一次遍历中将缓冲区的每个字节设置为其当前值与寄存器值中的较大者
+ *
+ * 使用 AVX2 时，每个 32 位通道通过字节重排取得 3 个密集字节（4 个寄存器），
+ * 再通过移位和掩码将 4 个寄存器分别移到各自的字节中，每次迭代处理 32 个寄存器
+ * 最后一次迭代交给标量循环处理，因为 16 字节的读取会越过寄存器的末尾
+ * 只支持 SSE2 时，使用标量移位将块分散为字节，每次合并 16 个寄存器
+*/
+static inline void hllDenseUnpack(uint8_t *raw, uint8_t *registers, int merge) {
+    uint8_t *p = registers;
+    int j = 0, k;
+
+#if defined(__AVX2__)
+    const __m256i shuf = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i m0 = _mm256_set1_epi32(0x3f);
+    const __m256i m1 = _mm256_set1_epi32(0x3f00);
+    const __m256i m2 = _mm256_set1_epi32(0x3f0000);
+    const __m256i m3 = _mm256_set1_epi32(0x3f000000);
+
+    for (; j + 32 < HLL_REGISTERS; j += 32) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+            _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+
+        v = _mm256_shuffle_epi8(v, shuf);
+        v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(v, m0),
+                            _mm256_and_si256(_mm256_slli_epi32(v, 2), m1)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 4), m2),
+                            _mm256_and_si256(_mm256_slli_epi32(v, 6), m3)));
+        if (merge) {
+            v = _mm256_max_epu8(v, _mm256_loadu_si256((const __m256i*)(raw + j)));
+        }
+        _mm256_storeu_si256((__m256i*)(raw + j), v);
+        p += 24;
+    }
+#elif defined(__SSE2__)
+    // 没有字节重排指令时，每次将两个 48 位块分散为 16 个字节
+    // x86 总是小端的，所以可以用 8 字节读取代替逐字节组装，
+    // 最后一次迭代同样交给标量循环，避免读取越界
+    for (; j + 16 < HLL_REGISTERS; j += 16) {
+        uint64_t w0, w1;
+        __m128i v;
+
+        memcpy(&w0, p, sizeof(w0));
+        memcpy(&w1, p + 6, sizeof(w1));
+        v = _mm_set_epi64x(hllSpreadChunk(w1 & 0xffffffffffffULL),
+                           hllSpreadChunk(w0 & 0xffffffffffffULL));
+
+        if (merge) v = _mm_max_epu8(v, _mm_loadu_si128((const __m128i*)(raw + j)));
+        _mm_storeu_si128((__m128i*)(raw + j), v);
+        p += 12;
+    }
+#endif
+    for (; j < HLL_REGISTERS; j += 8) {
+        uint64_t x = hllSpreadChunk(HLL_DENSE_LOAD_CHUNK(p));
+
+        for (k = 0; k < 8; k++) {
+            uint8_t reg = (x >> (k * 8)) & 0xff;
+            if (!merge || reg > raw[j + k]) raw[j + k] = reg;
+        }
+        p += 6;
+    }
+}
+
+/*
+ * Unpack the dense registers into an HLL_RAW buffer
+ *
+ * T = O(M)
+*/
+// 将密集寄存器解压到 HLL_RAW 缓冲区中
+void hllDenseToRaw(uint8_t *raw, uint8_t *registers) {
+    hllDenseUnpack(raw, registers, 0);
+}
+
+/*
+ * Merge the dense registers into an HLL_RAW buffer, register-wise max,
+ * without materialising the unpacked registers.
+ *
+ * T = O(M)
+*/
+/*
+ * 将密集寄存器按寄存器取最大值合并到 HLL_RAW 缓冲区中，不需要先将寄存器解压出来
+*/
+void hllDenseMaxRaw(uint8_t *max, uint8_t *registers) {
+    hllDenseUnpack(max, registers, 1);
+}
+
+/*
+ * Pack an HLL_RAW buffer back into dense registers, the inverse of
+ * hllDenseToRaw(). The AVX2 path stores 16 bytes for every 12 it
+ * produces, the extra bytes being overwritten by the next iteration.
+ *
+ * T = O(M)
+*/
+/*
+ * 将 HLL_RAW 缓冲区重新打包为密集寄存器，是 hllDenseToRaw() 的逆操作
+ * AVX2 路径每产生 12 个字节就写入 16 个字节，多出的字节会被下一次迭代覆盖
+*/
+void hllRawToDense(uint8_t *registers, uint8_t *raw) {
+    uint8_t *p = registers;
+    int j = 0, k;
+
+#if defined(__AVX2__)
+    const __m256i shuf = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i m0 = _mm256_set1_epi32(0x3f);
+    const __m256i m1 = _mm256_set1_epi32(0xfc0);
+    const __m256i m2 = _mm256_set1_epi32(0x3f000);
+    const __m256i m3 = _mm256_set1_epi32(0xfc0000);
+
+    for (; j + 32 < HLL_REGISTERS; j += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(raw + j));
+
+        v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(v, m0),
+                            _mm256_and_si256(_mm256_srli_epi32(v, 2), m1)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 4), m2),
+                            _mm256_and_si256(_mm256_srli_epi32(v, 6), m3)));
+        v = _mm256_shuffle_epi8(v, shuf);
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(p + 12), _mm256_extracti128_si256(v, 1));
+        p += 24;
+    }
+#endif
+    for (; j < HLL_REGISTERS; j += 8) {
+        uint64_t w = 0;
+
+        for (k = 0; k < 8; k++) w |= (uint64_t)raw[j + k] << (k * HLL_BITS);
+        HLL_DENSE_STORE_CHUNK(p, w);
+        p += 6;
+    }
+}
+
+/*
+ * Register-wise max of two HLL_RAW buffers, storing the result in max.
+ * This is the core of PFMERGE: 32 registers per instruction with AVX2,
+ * 16 with SSE2.
+ *
+ * T = O(M)
+*/
+/*
+ * 对两个 HLL_RAW 缓冲区逐个寄存器取最大值，结果保存在 max 中
+ * 这是 PFMERGE 的核心操作：使用 AVX2 时每条指令处理 32 个寄存器，
+ * 使用 SSE2 时处理 16 个
+*/
+void hllRawMax(uint8_t *max, const uint8_t *raw) {
+    int j = 0;
+
+#if defined(__AVX2__)
+    for (; j + 32 <= HLL_REGISTERS; j += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(max + j));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(raw + j));
+        _mm256_storeu_si256((__m256i*)(max + j), _mm256_max_epu8(a, b));
+    }
+#elif defined(__SSE2__)
+    for (; j + 16 <= HLL_REGISTERS; j += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(max + j));
+        __m128i b = _mm_loadu_si128((const __m128i*)(raw + j));
+        _mm_storeu_si128((__m128i*)(max + j), _mm_max_epu8(a, b));
+    }
+#endif
+    for (; j < HLL_REGISTERS; j++) {
+        if (raw[j] > max[j]) max[j] = raw[j];
+    }
+}
+
+/* ================== Sparse representation implementation  ================= */
+
+/*
+ * Convert the HLL with sparse representation given as input in its dense
+ * representation. Both representations are represented by SDS strings,
+ * and the input representation is freed as a side effect.
+ *
+ * The function returns REDIS_OK if the sparse representation was valid,
+ * otherwise REDIS_ERR is returned if the representation was corrupted.
+ *
+ * T = O(M)
+*/
+/*
+ * 将稀疏表示的 HLL 转换为密集表示
+ * 两种表示都保存在 SDS 字符串中，输入的表示会被释放
+ *
+ * 稀疏表示合法时返回 REDIS_OK，表示已损坏时返回 REDIS_ERR
+*/
+int hllSparseToDense(robj *o) {
+    sds sparse = o->ptr, dense;
+    struct hllhdr *hdr, *oldhdr = (struct hllhdr*)sparse;
+    int idx = 0, runlen, regval;
+    uint8_t *p = (uint8_t*)sparse, *end = p + sdslen(sparse);
+
+    /* If the representation is already the right one return ASAP. */
+    hdr = (struct hllhdr*) sparse;
+    if (hdr->encoding == HLL_DENSE) return REDIS_OK;
+
+    /* Create a string of the right size filled with zero bytes.
+     * Note that the cached cardinality is set to 0 as a side effect
+     * that is exactly the cardinality of an empty HLL. */
+    dense = sdsnewlen(NULL, HLL_DENSE_SIZE);
+    hdr = (struct hllhdr*) dense;
+    *hdr = *oldhdr; /* This will copy the magic and cached cardinality. */
+    hdr->encoding = HLL_DENSE;
+
+    /* Now read the sparse representation and set non-zero registers
+     * accordingly. */
+    // 读取稀疏表示，设置非零的寄存器
+    p += HLL_HDR_SIZE;
+    while (p < end) {
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            runlen = HLL_SPARSE_ZERO_LEN(p);
+            idx += runlen;
+            p++;
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            runlen = HLL_SPARSE_XZERO_LEN(p);
+            idx += runlen;
+            p += 2;
+        } else {
+            runlen = HLL_SPARSE_VAL_LEN(p);
+            regval = HLL_SPARSE_VAL_VALUE(p);
+            if ((runlen + idx) > HLL_REGISTERS) break; /* Overflow. */
+            while (runlen--) {
+                HLL_DENSE_SET_REGISTER(hdr->registers, idx, regval);
+                idx++;
+            }
+            p++;
+        }
+    }
+
+    /* If the sparse representation was valid, we expect to find idx
+     * set to HLL_REGISTERS. */
+    if (idx != HLL_REGISTERS) {
+        sdsfree(dense);
+        return REDIS_ERR;
+    }
+
+    /* Free the old representation and set the new one. */
+    sdsfree(o->ptr);
+    o->ptr = dense;
+    return REDIS_OK;
+}
+
+/*
+ * Low level function to set the sparse HLL register at 'index' to the
+ * specified value if the current value is smaller than 'count'.
+ *
+ * The object 'o' is the String object holding the HLL. The function
+ * requires a reference to the object in order to be able to enlarge the
+ * string if needed.
+ *
+ * On success, the function returns 1 if the cardinality changed, or 0
+ * if the register for this element was not updated.
+ * On error (if the representation is invalid) -1 is returned.
+ *
+ * As a side effect the function may promote the HLL representation from
+ * sparse to dense: this happens when a register requires to be set to a
+ * value not representable with the sparse representation, or when the
+ * resulting size would be greater than server.hll_sparse_max_bytes.
+ *
+ * T = O(N) where N is the sparse representation length
+*/
+/*
+ * 如果稀疏 HLL 中位于 index 的寄存器的值小于 count，那么将其设置为 count
+ *
+ * o 是保存 HLL 的字符串对象，函数在需要时会扩展这个字符串
+ *
+ * 基数发生变化时返回 1，寄存器没有被更新时返回 0，表示不合法时返回 -1
+ *
+ * 当寄存器的值无法用稀疏表示保存，或者更新后的长度超过
+ * server.hll_sparse_max_bytes 时，函数会将 HLL 转换为密集表示
+*/
+int hllSparseSet(robj *o, long index, uint8_t count) {
+    struct hllhdr *hdr;
+    uint8_t oldcount, *sparse, *end, *p, *prev, *next;
+    long first, span;
+    long is_zero = 0, is_xzero = 0, is_val = 0, runlen = 0;
+    uint8_t seq[5], *n;
+    int last, len, seqlen, oldlen, deltalen, scanlen, dense_retval;
+
+    /* If the count is too big to be representable by the sparse
+     * representation, switch to dense representation. */
+    if (count > HLL_SPARSE_VAL_MAX_VALUE) goto promote;
+
+    /* When updating a sparse representation, sometimes we may need to
+     * enlarge the buffer for up to 3 bytes in the worst case (XZERO split
+     * into XZERO-VAL-XZERO). Make sure there is enough space right now
+     * so that the pointers we take during the execution of the function
+     * will be valid all the time. */
+    o->ptr = sdsMakeRoomFor(o->ptr, 3);
+
+    /* Step 1: we need to locate the opcode we need to modify to check
+     * for current value. */
+    // 第一步：找到覆盖 index 的操作码
+    sparse = p = ((uint8_t*)o->ptr) + HLL_HDR_SIZE;
+    end = p + sdslen(o->ptr) - HLL_HDR_SIZE;
+
+    first = 0;
+    prev = NULL; /* Points to previous opcode at the end of the loop. */
+    next = NULL; /* Points to the next opcode at the end of the loop. */
+    span = 0;
+    while (p < end) {
+        long oplen;
+
+        /* Set span to the number of registers covered by this opcode. */
+        oplen = 1;
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            span = HLL_SPARSE_ZERO_LEN(p);
+        } else if (HLL_SPARSE_IS_VAL(p)) {
+            span = HLL_SPARSE_VAL_LEN(p);
+        } else { /* XZERO. */
+            span = HLL_SPARSE_XZERO_LEN(p);
+            oplen = 2;
+        }
+        /* Break if this opcode covers the register as 'index'. */
+        if (index <= first + span - 1) break;
+        prev = p;
+        p += oplen;
+        first += span;
+    }
+    if (span == 0 || p >= end) return -1; /* Invalid format. */
+
+    next = HLL_SPARSE_IS_XZERO(p) ? p + 2 : p + 1;
+    if (next >= end) next = NULL;
+
+    /* Cache current opcode type to avoid using the macro again and
+     * again for something that will not change. */
+    if (HLL_SPARSE_IS_ZERO(p)) {
+        is_zero = 1;
+        runlen = HLL_SPARSE_ZERO_LEN(p);
+    } else if (HLL_SPARSE_IS_XZERO(p)) {
+        is_xzero = 1;
+        runlen = HLL_SPARSE_XZERO_LEN(p);
+    } else {
+        is_val = 1;
+        runlen = HLL_SPARSE_VAL_LEN(p);
+    }
+
+    /* Step 2: After the loop:
+     *
+     * 'first' stores to the index of the first register covered
+     *  by the current opcode, which is pointed by 'p'.
+     *
+     * 'next' ad 'prev' store respectively the next and previous opcode,
+     *  or NULL if the opcode at 'p' is respectively the last or first.
+     *
+     * 'span' is set to the number of registers covered by the current
+     *  opcode.
+     *
+     * There are different cases in order to update the data structure
+     * in place without generating it from scratch:
+     *
+     * A) If it is a VAL opcode already set to a value >= our 'count'
+     *    no update is needed, regardless of the VAL run-length field.
+     *    In this case PFADD returns 0 since no changes are performed.
+     *
+     * B) If it is a VAL opcode with len = 1 (representing only our
+     *    register) and the value is less than 'count', we just update it
+     *    since this is a trivial case. */
+    // 第二步：能够原地完成的简单情况
+    if (is_val) {
+        oldcount = HLL_SPARSE_VAL_VALUE(p);
+        /* Case A. */
+        if (oldcount >= count) return 0;
+
+        /* Case B. */
+        if (runlen == 1) {
+            HLL_SPARSE_VAL_SET(p, count, 1);
+            goto updated;
+        }
+    }
+
+    /* C) Another trivial to handle case is a ZERO opcode with a len of 1.
+     * We can just replace it with a VAL opcode with our value and len of 1. */
+    if (is_zero && runlen == 1) {
+        HLL_SPARSE_VAL_SET(p, count, 1);
+        goto updated;
+    }
+
+    /* D) General case.
+     *
+     * The other cases are more complex: our register requires to be updated
+     * and is either currently represented by a VAL opcode with len > 1,
+     * by a ZERO opcode with len > 1, or by an XZERO opcode.
+     *
+     * In those cases the original opcode must be split into multiple
+     * opcodes. The worst case is an XZERO split in the middle resuling into
+     * XZERO - VAL - XZERO, so the resulting sequence max length is
+     * 5 bytes.
+     *
+     * We perform the split writing the new sequence into the 'new' buffer
+     * with 'newlen' as length. Later the new sequence is inserted in place
+     * of the old one, possibly moving what is on the right a few bytes
+     * if the new sequence is longer than the older one. */
+    // 第三步：一般情况，将原来的操作码分裂为最多三个操作码
+    n = seq;
+    last = first + span - 1; /* Last register covered by the sequence. */
+
+    if (is_zero || is_xzero) {
+        /* Handle splitting of ZERO / XZERO. */
+        if (index != first) {
+            len = index - first;
+            if (len > HLL_SPARSE_ZERO_MAX_LEN) {
+                HLL_SPARSE_XZERO_SET(n, len);
+                n += 2;
+            } else {
+                HLL_SPARSE_ZERO_SET(n, len);
+                n++;
+            }
+        }
+        HLL_SPARSE_VAL_SET(n, count, 1);
+        n++;
+        if (index != last) {
+            len = last - index;
+            if (len > HLL_SPARSE_ZERO_MAX_LEN) {
+                HLL_SPARSE_XZERO_SET(n, len);
+                n += 2;
+            } else {
+                HLL_SPARSE_ZERO_SET(n, len);
+                n++;
+            }
+        }
+    } else {
+        /* Handle splitting of VAL. */
+        int curval = HLL_SPARSE_VAL_VALUE(p);
+
+        if (index != first) {
+            len = index - first;
+            HLL_SPARSE_VAL_SET(n, curval, len);
+            n++;
+        }
+        HLL_SPARSE_VAL_SET(n, count, 1);
+        n++;
+        if (index != last) {
+            len = last - index;
+            HLL_SPARSE_VAL_SET(n, curval, len);
+            n++;
+        }
+    }
+
+    /* Step 3: substitute the new sequence with the old one.
+     *
+     * Note that we already allocated space on the sds string
+     * calling sdsMakeRoomFor(). */
+    seqlen = n - seq;
+    oldlen = is_xzero ? 2 : 1;
+    deltalen = seqlen - oldlen;
+
+    if (deltalen > 0 &&
+        sdslen(o->ptr) + deltalen > server.hll_sparse_max_bytes) goto promote;
+    if (deltalen && next) memmove(next + deltalen, next, end - next);
+    sdsIncrLen(o->ptr, deltalen);
+    memcpy(p, seq, seqlen);
+    end += deltalen;
+
+updated:
+    /* Step 4: Merge adjacent values if possible.
+     *
+     * The representation was updated, however the resulting representation
+     * may not be optimal: adjacent VAL opcodes can sometimes be merged into
+     * a single one. */
+    // 第四步：尽可能合并相邻的 VAL 操作码
+    p = prev ? prev : sparse;
+    scanlen = 5; /* Scan up to 5 upcodes starting from prev. */
+    while (p < end && scanlen--) {
+        if (HLL_SPARSE_IS_XZERO(p)) {
+            p += 2;
+            continue;
+        } else if (HLL_SPARSE_IS_ZERO(p)) {
+            p++;
+            continue;
+        }
+        /* We need two adjacent VAL opcodes to try a merge, having
+         * the same value, and a len that fits the VAL opcode max len. */
+        if (p + 1 < end && HLL_SPARSE_IS_VAL(p + 1)) {
+            int v1 = HLL_SPARSE_VAL_VALUE(p);
+            int v2 = HLL_SPARSE_VAL_VALUE(p + 1);
+            if (v1 == v2) {
+                len = HLL_SPARSE_VAL_LEN(p) + HLL_SPARSE_VAL_LEN(p + 1);
+                if (len <= HLL_SPARSE_VAL_MAX_LEN) {
+                    HLL_SPARSE_VAL_SET(p + 1, v1, len);
+                    memmove(p, p + 1, end - p);
+                    sdsIncrLen(o->ptr, -1);
+                    end--;
+                    /* After a merge we reiterate without incrementing 'p'
+                     * in order to try to merge the just merged value with
+                     * a value on its right. */
+                    continue;
+                }
+            }
+        }
+        p++;
+    }
+
+    /* Invalidate the cached cardinality. */
+    hdr = o->ptr;
+    HLL_INVALIDATE_CACHE(hdr);
+    return 1;
+
+promote: /* Promote to dense representation. */
+    // 转换为密集表示，然后在密集表示上设置寄存器
+    if (hllSparseToDense(o) == REDIS_ERR) return -1; /* Corrupted HLL. */
+    hdr = o->ptr;
+
+    /* We need to call hllDenseSet() to perform the operation after the
+     * conversion. However the result must be 1, since if we need to
+     * convert from sparse to dense a register requires to be updated. */
+    dense_retval = hllDenseSet(hdr->registers, index, count);
+    redisAssert(dense_retval == 1);
+    HLL_INVALIDATE_CACHE(hdr);
+    return dense_retval;
+}
+
+/*
+ * "Add" the element in the sparse hyperloglog data structure.
+ * Actually nothing is added, but the max 0 pattern counter of the subset
+ * the element belongs to is incremented if needed.
+ *
+ * This function is actually a wrapper for hllSparseSet(), it only
+ * performs the hashing of the element to obtain the index and zeros run
+ * length.
+ *
+ * T = O(N) where N is the sparse representation length
+*/
+/*
+ * 将元素添加到稀疏 HLL 中
+ * 这个函数只是 hllSparseSet() 的包装，它负责计算元素的寄存器索引和连续零的长度
+*/
+int hllSparseAdd(robj *o, unsigned char *ele, size_t elesize) {
+    long index;
+    uint8_t count = hllPatLen(ele, elesize, &index);
+
+    return hllSparseSet(o, index, count);
+}
+
+/*
+ * Compute the register histogram in the sparse representation.
+ * If the representation is invalid, the integer pointed by 'invalid' is
+ * set to non-zero.
+ *
+ * T = O(N) where N is the sparse representation length
+*/
+/*
+ * 计算稀疏表示的寄存器直方图
+ * 表示不合法时，将 invalid 指向的整数设置为非零值
+*/
+void hllSparseRegHisto(uint8_t *sparse, int sparselen, int *invalid, int *reghisto) {
+    int idx = 0, runlen, regval;
+    uint8_t *end = sparse + sparselen, *p = sparse;
+
+    while (p < end) {
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            runlen = HLL_SPARSE_ZERO_LEN(p);
+            idx += runlen;
+            reghisto[0] += runlen;
+            p++;
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            runlen = HLL_SPARSE_XZERO_LEN(p);
+            idx += runlen;
+            reghisto[0] += runlen;
+            p += 2;
+        } else {
+            runlen = HLL_SPARSE_VAL_LEN(p);
+            regval = HLL_SPARSE_VAL_VALUE(p);
+            idx += runlen;
+            reghisto[regval] += runlen;
+            p++;
+        }
+    }
+    if (idx != HLL_REGISTERS && invalid) *invalid = 1;
+}
+
+/* ========================= HyperLogLog Count ============================== */
+
+/*
+ * Helper function sigma as defined in
+ * "New cardinality estimation algorithms for HyperLogLog sketches"
+ * Otmar Ertl, arXiv:1702.01284
+ *
+ * Sums the series x + x^2 + 2x^4 + 4x^8 + ... until it converges.
+*/
+/*
+ * Ertl 论文（arXiv:1702.01284）中定义的辅助函数 sigma
+ * 对级数 x + x^2 + 2x^4 + 4x^8 + ... 求和直到收敛
+*/
+double hllSigma(double x) {
+    double zPrime, y = 1, z = x;
+
+    if (x == 1.) return INFINITY;
+    do {
+        x *= x;
+        zPrime = z;
+        z += x * y;
+        y += y;
+    } while (zPrime != z);
+    return z;
+}
+
+/*
+ * Helper function tau as defined in
+ * "New cardinality estimation algorithms for HyperLogLog sketches"
+ * Otmar Ertl, arXiv:1702.01284
+*/
+// Ertl 论文中定义的辅助函数 tau
+double hllTau(double x) {
+    double zPrime, y = 1.0, z = 1 - x;
+
+    if (x == 0. || x == 1.) return 0.;
+    do {
+        x = sqrt(x);
+        zPrime = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while (zPrime != z);
+    return z / 3;
+}
+
+#define HLL_ALPHA_INF 0.721347520444481703680 /* constant for 0.5/ln(2) */
+
+/*
+ * Estimate the cardinality from the register histogram, using the
+ * improved raw estimator by Otmar Ertl.
+ *
+ * The estimator accounts for the registers that are still zero (sigma)
+ * and for the ones that saturated at HLL_Q + 1 (tau) in closed form, so
+ * it is accurate over the whole range without bias correction tables or
+ * a switch to linear counting for small cardinalities. The histogram is
+ * folded with Horner's scheme, one addition and one halving per bucket.
+ *
+ * T = O(Q) where Q is the number of histogram buckets
+*/
+/*
+ * 使用 Otmar Ertl 改进的原始估算方法，根据寄存器直方图估算基数
+ *
+ * 这个估算方法以解析的形式处理仍然为零的寄存器（sigma）
+ * 以及达到上限 HLL_Q + 1 的寄存器（tau），
+ * 因此在整个区间内都是准确的，不需要偏差修正表，也不需要在基数较小时切换到线性计数
+ * 直方图使用秦九韶算法折叠，每个桶只需要一次加法和一次减半
+*/
+uint64_t hllEstimate(int *reghisto) {
+    double m = HLL_REGISTERS;
+    double z = m * hllTau((m - reghisto[HLL_Q + 1]) / m);
+    int j;
+
+    for (j = HLL_Q; j >= 1; --j) {
+        z += reghisto[j];
+        z *= 0.5;
+    }
+    z += m * hllSigma(reghisto[0] / m);
+    return (uint64_t) llroundl(HLL_ALPHA_INF * m * m / z);
+}
+
+/*
+ * Return the approximated cardinality of the set based on the harmonic
+ * mean of the registers values. 'hdr' points to the start of the SDS
+ * representing the String object holding the HLL representation.
+ *
+ * If the HLL object is not valid, the integer pointed by 'invalid' is
+ * set to non-zero, otherwise it is left untouched.
+ *
+ * hllCount() supports a special internal-only encoding of HLL_RAW, that
+ * is, hdr->registers will point to an uint8_t array of HLL_REGISTERS
+ * element. This is useful in order to speedup PFCOUNT when called
+ * against multiple keys (no need to work with 6-bit integers encoding).
+ *
+ * T = O(M)
+*/
+/*
+ * 根据寄存器值的调和平均数返回集合的近似基数
+ * hdr 指向保存 HLL 表示的字符串对象的 SDS 的开头
+ *
+ * 如果 HLL 对象不合法，那么将 invalid 指向的整数设置为非零值，
+ * 否则不改动它
+ *
+ * hllCount() 还支持仅在内部使用的 HLL_RAW 编码，
+ * 也即 hdr->registers 指向一个有 HLL_REGISTERS 个元素的 uint8_t 数组，
+ * 用于加速对多个键执行的 PFCOUNT（不需要处理 6 位整数编码）
+*/
+uint64_t hllCount(struct hllhdr *hdr, int *invalid) {
+    int reghisto[64] = {0};
+
+    if (hdr->encoding == HLL_DENSE) {
+        hllDenseRegHisto(hdr->registers, reghisto);
+    } else if (hdr->encoding == HLL_SPARSE) {
+        hllSparseRegHisto(hdr->registers,
+                          sdslen((sds)hdr) - HLL_HDR_SIZE, invalid, reghisto);
+    } else if (hdr->encoding == HLL_RAW) {
+        hllRawRegHisto(hdr->registers, reghisto);
+    } else {
+        if (invalid) *invalid = 1;
+        return 0;
+    }
+    return hllEstimate(reghisto);
+}
+
+/*
+ * Call hllDenseAdd() or hllSparseAdd() depending on the encoding.
+ * A successful update invalidates the cached cardinality.
+ *
+ * Returns 1 if the register was updated, 0 if not, -1 on error.
+ *
+ * T = O(N) where N is the element length
+*/
+/*
+ * 根据编码调用 hllDenseAdd() 或 hllSparseAdd()
+ * 更新成功时会使缓存的基数失效
+ *
+ * 寄存器被更新时返回 1，没有更新时返回 0，出错时返回 -1
+*/
+int hllAdd(robj *o, unsigned char *ele, size_t elesize) {
+    struct hllhdr *hdr = o->ptr;
+    int updated;
+
+    switch (hdr->encoding) {
+    case HLL_DENSE: updated = hllDenseAdd(hdr->registers, ele, elesize); break;
+    case HLL_SPARSE: updated = hllSparseAdd(o, ele, elesize); break;
+    default: return -1; /* Invalid representation. */
+    }
+
+    // 稀疏表示的更新可能改变了 o->ptr
+    if (updated == 1) HLL_INVALIDATE_CACHE((struct hllhdr*)o->ptr);
+    return updated;
+}
+
+/*
+ * Merge by computing MAX(registers[i],hll[i]) the HyperLogLog 'hll'
+ * with an array of uint8_t HLL_REGISTERS registers pointed by 'max'.
+ *
+ * The hll object must be already validated via isHLLObject().
+ *
+ * Returns REDIS_OK on success, REDIS_ERR if the representation is not
+ * supported.
+ *
+ * T = O(M)
+*/
+/*
+ * 将 HyperLogLog 对象 hll 合并到 max 指向的 HLL_REGISTERS 个
+ * uint8_t 寄存器中，每个寄存器取 MAX(max[i], hll[i])
+ *
+ * hll 对象必须已经通过 isHLLObject() 的检查
+ *
+ * 成功时返回 REDIS_OK，不支持的表示返回 REDIS_ERR
+*/
+int hllMerge(uint8_t *max, robj *hll) {
+    struct hllhdr *hdr = hll->ptr;
+
+    if (hdr->encoding == HLL_DENSE) {
+        hllDenseMaxRaw(max, hdr->registers);
+        return REDIS_OK;
+    } else if (hdr->encoding == HLL_RAW) {
+        hllRawMax(max, hdr->registers);
+        return REDIS_OK;
+    } else if (hdr->encoding == HLL_SPARSE) {
+        uint8_t *p = hll->ptr, *end = p + sdslen(hll->ptr);
+        long runlen, regval, i = 0;
+
+        // 稀疏表示中只有 VAL 操作码需要处理
+        p += HLL_HDR_SIZE;
+        while (p < end) {
+            if (HLL_SPARSE_IS_ZERO(p)) {
+                runlen = HLL_SPARSE_ZERO_LEN(p);
+                i += runlen;
+                p++;
+            } else if (HLL_SPARSE_IS_XZERO(p)) {
+                runlen = HLL_SPARSE_XZERO_LEN(p);
+                i += runlen;
+                p += 2;
+            } else {
+                runlen = HLL_SPARSE_VAL_LEN(p);
+                regval = HLL_SPARSE_VAL_VALUE(p);
+                if ((runlen + i) > HLL_REGISTERS) break; /* Overflow. */
+                while (runlen--) {
+                    if (regval > max[i]) max[i] = regval;
+                    i++;
+                }
+                p++;
+            }
+        }
+        if (i != HLL_REGISTERS) return REDIS_ERR;
+        return REDIS_OK;
+    }
+    return REDIS_ERR;
+}
+
+/* ========================== HyperLogLog commands ========================== */
+
+/*
+ * Create an HLL object. We always create the HLL using sparse encoding.
+ * This will be upgraded to the dense representation as needed.
+*/
+/*
+ * 创建一个 HLL 对象，总是使用稀疏表示，之后在需要时转换为密集表示
+*/
+robj *createHLLObject(void) {
+    robj *o;
+    struct hllhdr *hdr;
+    sds s;
+    uint8_t *p;
+    int sparselen = HLL_HDR_SIZE +
+                    (((HLL_REGISTERS + (HLL_SPARSE_XZERO_MAX_LEN - 1)) /
+                     HLL_SPARSE_XZERO_MAX_LEN) * 2);
+    int aux;
+
+    /* Populate the sparse representation with as many XZERO opcodes as
+     * needed to represent all the registers. */
+    // 使用足够数量的 XZERO 操作码表示所有寄存器
+    aux = HLL_REGISTERS;
+    s = sdsnewlen(NULL, sparselen);
+    p = (uint8_t*)s + HLL_HDR_SIZE;
+    while (aux) {
+        int xzero = HLL_SPARSE_XZERO_MAX_LEN;
+        if (xzero > aux) xzero = aux;
+        HLL_SPARSE_XZERO_SET(p, xzero);
+        p += 2;
+        aux -= xzero;
+    }
+    redisAssert((p - (uint8_t*)s) == sparselen);
+
+    /* Create the actual object. */
+    hdr = (struct hllhdr*) s;
+    memcpy(hdr->magic, "HYLL", 4);
+    hdr->encoding = HLL_SPARSE;
+
+    o = createObject(REDIS_STRING, s);
+    return o;
+}
+
+/*
+ * Check if the object is a String with a valid HLL representation.
+ * Return REDIS_OK if this is true, otherwise REDIS_ERR.
+*/
+/*
+ * 检查对象是否为保存合法 HLL 表示的字符串
+ * 是的话返回 REDIS_OK，否则返回 REDIS_ERR
+*/
+int isHLLObject(robj *o) {
+    struct hllhdr *hdr;
+
+    /*
+     * INT and INLINE encoded strings are shorter than the HLL header,
+     * so only sds strings can hold an HLL.
+    */
+    // INT 和 INLINE 编码的字符串比 HLL 头部还短，只有 sds 字符串才可能保存 HLL
+    if (o->type != REDIS_STRING || !sdsEncodedObject(o)) return REDIS_ERR;
+    if (sdslen(o->ptr) < sizeof(*hdr)) return REDIS_ERR;
+    hdr = o->ptr;
+
+    /* Magic should be "HYLL". */
+    if (hdr->magic[0] != 'H' || hdr->magic[1] != 'Y' ||
+        hdr->magic[2] != 'L' || hdr->magic[3] != 'L') return REDIS_ERR;
+
+    if (hdr->encoding > HLL_MAX_ENCODING) return REDIS_ERR;
+
+    /* Dense representation string length should match exactly. */
+    if (hdr->encoding == HLL_DENSE &&
+        sdslen(o->ptr) != HLL_DENSE_SIZE) return REDIS_ERR;
+
+    return REDIS_OK;
+}
+
+/*
+ * PFMERGE core: merge the HLL objects srcs into dest. dest and the
+ * sources are merged into an HLL_RAW buffer with the vectorised max,
+ * then dest is converted to the dense representation and the buffer is
+ * packed into it once.
+ *
+ * Returns REDIS_OK on success, REDIS_ERR if dest or some source is not a
+ * valid HLL. dest is not modified on error.
+ *
+ * T = O(N*M) where N is the number of sources
+*/
+/*
+ * PFMERGE 的核心：将 HLL 对象 srcs 合并到 dest 中
+ * 先使用向量化的最大值运算将 dest 和所有来源合并到一个 HLL_RAW 缓冲区，
+ * 再将 dest 转换为密集表示，一次性打包写入
+ *
+ * 成功时返回 REDIS_OK，dest 或者有来源不合法时返回 REDIS_ERR，出错时 dest 不会被修改
+*/
+int hllMergeObjects(robj *dest, robj **srcs, int numsrcs) {
+    uint8_t max[HLL_REGISTERS];
+    struct hllhdr *hdr;
+    int j;
+
+    // 先检查所有对象，出错时 dest 还没有被修改
+    if (isHLLObject(dest) != REDIS_OK) return REDIS_ERR;
+    for (j = 0; j < numsrcs; j++) {
+        if (isHLLObject(srcs[j]) != REDIS_OK) return REDIS_ERR;
+    }
+
+    memset(max, 0, sizeof(max));
+    if (hllMerge(max, dest) == REDIS_ERR) return REDIS_ERR;
+    for (j = 0; j < numsrcs; j++) {
+        if (hllMerge(max, srcs[j]) == REDIS_ERR) return REDIS_ERR;
+    }
+
+    // 合并的结果使用密集表示保存
+    if (hllSparseToDense(dest) == REDIS_ERR) return REDIS_ERR;
+    hdr = dest->ptr;
+    hllRawToDense(hdr->registers, max);
+    HLL_INVALIDATE_CACHE(hdr);
+    return REDIS_OK;
+}
+
+/*
+ * PFCOUNT of a single HLL: return the cached cardinality when it is
+ * valid, otherwise compute it and store it in the header so that the
+ * next call is O(1) until the HLL is modified again.
+ *
+ * If the HLL object is not valid, the integer pointed by 'invalid' is
+ * set to non-zero.
+ *
+ * T = O(1) with a valid cache, O(M) otherwise
+*/
+/*
+ * 对单个 HLL 执行的 PFCOUNT：缓存的基数有效时直接返回，
+ * 否则计算基数并保存到头部，在 HLL 再次被修改之前，之后的调用都是 O(1) 的
+ *
+ * 如果 HLL 对象不合法，那么将 invalid 指向的整数设置为非零值
+*/
+uint64_t hllCountCached(robj *o, int *invalid) {
+    struct hllhdr *hdr = o->ptr;
+    uint64_t card;
+    int j;
+
+    if (HLL_VALID_CACHE(hdr)) {
+        /* Just return the cached value. */
+        // 直接返回缓存的值
+        card = 0;
+        for (j = 7; j >= 0; j--) card = (card << 8) | hdr->card[j];
+    } else {
+        int bad = 0;
+
+        /* Recompute it and update the cached value. */
+        // 重新计算基数并更新缓存的值
+        card = hllCount(hdr, &bad);
+        if (bad) {
+            if (invalid) *invalid = 1;
+            return 0;
+        }
+        for (j = 0; j < 8; j++) hdr->card[j] = (card >> (j * 8)) & 0xff;
+    }
+    return card;
+}
+
+/*
+ * PFCOUNT of several HLLs: the cardinality of their union. NULL entries
+ * stand for keys that don't exist and are skipped.
+ *
+ * A single HLL is served by hllCountCached(). Otherwise every sketch is
+ * merged in one pass into an HLL_RAW buffer on the stack, dense ones
+ * unpacking and taking the max in the same SIMD loop, and the estimate
+ * is computed from the buffer: no temporary dense HLL is created, and
+ * the function can be called from any thread.
+ *
+ * If some HLL object is not valid, the integer pointed by 'invalid' is
+ * set to non-zero.
+ *
+ * T = O(N*M) where N is the number of sketches
+*/
+/*
+ * 对多个 HLL 执行的 PFCOUNT：返回它们的并集的基数
+ * 值为 NULL 的项表示不存在的键，会被跳过
+ *
+ * 只有一个 HLL 时使用 hllCountCached()
+ * 否则将每个 HLL 在一次遍历中合并到栈上的 HLL_RAW 缓冲区中，
+ * 密集表示的 HLL 在同一个 SIMD 循环中完成解压和取最大值，
+ * 最后根据缓冲区计算基数估算值，不需要创建临时的密集 HLL，并且可以在任何线程中调用
+ *
+ * 如果有 HLL 对象不合法，那么将 invalid 指向的整数设置为非零值
+*/
+uint64_t hllCountMulti(robj **hlls, int numkeys, int *invalid) {
+    uint8_t max[HLL_HDR_SIZE + HLL_REGISTERS];
+    struct hllhdr *hdr = (struct hllhdr*)max;
+    int j, present = 0, last = -1;
+
+    for (j = 0; j < numkeys; j++) {
+        if (hlls[j] == NULL) continue;
+        if (isHLLObject(hlls[j]) != REDIS_OK) {
+            if (invalid) *invalid = 1;
+            return 0;
+        }
+        present++;
+        last = j;
+    }
+    if (present == 0) return 0;
+    if (present == 1) return hllCountCached(hlls[last], invalid);
+
+    // 每次调用使用自己的缓冲区，多个线程可以同时调用
+    memset(max, 0, sizeof(max));
+    memcpy(hdr->magic, "HYLL", 4);
+    hdr->encoding = HLL_RAW;
+
+    // 将所有 HLL 合并到缓冲区中
+    for (j = 0; j < numkeys; j++) {
+        if (hlls[j] == NULL) continue;
+        if (hllMerge(hdr->registers, hlls[j]) == REDIS_ERR) {
+            if (invalid) *invalid = 1;
+            return 0;
+        }
+    }
+    return hllCount(hdr, invalid);
+}
+
+// 测试部分
+#ifdef HLL_TEST_MAIN
+#include <stdio.h>
+#include <assert.h>
+#include <sys/time.h>
+#include "testhelp.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
+/* Add count distinct elements, numbered from first, to the HLL */
+static void hllAddRange(robj *o, long long first, long long count) {
+    char buf[32];
+    long long j;
+
+    for (j = first; j < first + count; j++) {
+        int len = snprintf(buf, sizeof(buf), "ele:%lld", j);
+        hllAdd(o, (unsigned char*)buf, len);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint8_t raw[HLL_REGISTERS], raw2[HLL_REGISTERS];
+    robj *o = createHLLObject();
+    struct hllhdr *hdr;
+    long long maxcard = (argc > 1) ? atoll(argv[1]) : 1000000000LL;
+    int j, ok;
+
+    srand(time(NULL));
+    server.hll_sparse_max_bytes = REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES;
+    hllSparseToDense(o);
+    hdr = o->ptr;
+
+    {
+        ok = 1;
+        for (j = 0; j < HLL_REGISTERS; j++) raw[j] = rand() & HLL_REGISTER_MAX;
+        for (j = 0; j < HLL_REGISTERS; j++) HLL_DENSE_SET_REGISTER(hdr->registers, j, raw[j]);
+        for (j = 0; j < HLL_REGISTERS; j++) {
+            uint8_t val;
+            HLL_DENSE_GET_REGISTER(val, hdr->registers, j);
+            if (val != raw[j]) ok = 0;
+        }
+        test_cond("Dense register get/set round trip ", ok);
+
+        hllDenseToRaw(raw2, hdr->registers);
+        test_cond("hllDenseToRaw() matches HLL_DENSE_GET_REGISTER ",
+            memcmp(raw, raw2, HLL_REGISTERS) == 0);
+    }
+
+    {
+        int reghisto[64] = {0}, expected[64] = {0};
+
+        for (j = 0; j < HLL_REGISTERS; j++) expected[raw[j]]++;
+        hllDenseRegHisto(hdr->registers, reghisto);
+        test_cond("Chunked histogram matches the registers ",
+            memcmp(reghisto, expected, sizeof(reghisto)) == 0);
+
+        memset(hdr->registers, 0, HLL_DENSE_SIZE - HLL_HDR_SIZE);
+        hllRawToDense(hdr->registers, raw);
+        hllDenseToRaw(raw2, hdr->registers);
+        test_cond("hllRawToDense() is the inverse of hllDenseToRaw() ",
+            memcmp(raw, raw2, HLL_REGISTERS) == 0);
+    }
+
+    {
+        uint8_t max[HLL_REGISTERS];
+
+        ok = 1;
+        for (j = 0; j < HLL_REGISTERS; j++) raw2[j] = rand() & HLL_REGISTER_MAX;
+        memcpy(max, raw, HLL_REGISTERS);
+        hllRawMax(max, raw2);
+        for (j = 0; j < HLL_REGISTERS; j++) {
+            if (max[j] != (raw[j] > raw2[j] ? raw[j] : raw2[j])) ok = 0;
+        }
+        test_cond("hllRawMax() computes the register-wise max ", ok);
+    }
+
+    {
+        robj *sparse = createHLLObject(), *dense = createHLLObject();
+        uint8_t raw3[HLL_REGISTERS];
+        char buf[32];
+
+        ok = 1;
+        server.hll_sparse_max_bytes = 1 << 20;
+        hllSparseToDense(dense);
+        for (j = 0; j < 3000; j++) {
+            int len = snprintf(buf, sizeof(buf), "%d", rand());
+            if (hllAdd(sparse, (unsigned char*)buf, len) !=
+                hllAdd(dense, (unsigned char*)buf, len)) ok = 0;
+        }
+        ok = ok && ((struct hllhdr*)sparse->ptr)->encoding == HLL_SPARSE &&
+             hllCount(sparse->ptr, NULL) == hllCount(dense->ptr, NULL);
+        memset(raw, 0, sizeof(raw));
+        memset(raw3, 0, sizeof(raw3));
+        hllMerge(raw, sparse);
+        hllMerge(raw3, dense);
+        ok = ok && memcmp(raw, raw3, HLL_REGISTERS) == 0;
+        hllSparseToDense(sparse);
+        test_cond("Sparse and dense representations agree ",
+            ok && memcmp(((struct hllhdr*)sparse->ptr)->registers,
+                         ((struct hllhdr*)dense->ptr)->registers,
+                         HLL_DENSE_SIZE - HLL_HDR_SIZE) == 0);
+        decrRefCount(sparse);
+        decrRefCount(dense);
+        server.hll_sparse_max_bytes = REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES;
+    }
+
+    {
+        robj *h = createHLLObject();
+        size_t maxlen = 0;
+
+        for (j = 0; ((struct hllhdr*)h->ptr)->encoding == HLL_SPARSE; j++) {
+            maxlen = sdslen(h->ptr);
+            hllAddRange(h, j, 1);
+        }
+        test_cond("Sparse HLL is promoted past hll_sparse_max_bytes ",
+            maxlen <= server.hll_sparse_max_bytes &&
+            sdslen(h->ptr) == HLL_DENSE_SIZE);
+        printf("promoted to dense after %d elements\n", j);
+        decrRefCount(h);
+    }
+
+    {
+        robj *h = createHLLObject();
+        struct hllhdr *hh;
+        uint64_t card;
+
+        ok = hllCountCached(h, NULL) == 0 && HLL_VALID_CACHE((struct hllhdr*)h->ptr);
+        hllAddRange(h, 0, 5000);
+        hh = h->ptr;
+        ok = ok && !HLL_VALID_CACHE(hh);
+        card = hllCountCached(h, NULL);
+        ok = ok && HLL_VALID_CACHE(hh) && card == hllCount(hh, NULL);
+
+        // 伪造一个缓存值，确认 hllCountCached() 确实使用了缓存
+        memset(hh->card, 0, sizeof(hh->card));
+        hh->card[0] = 0x39;
+        hh->card[1] = 0x30;
+        ok = ok && hllCountCached(h, NULL) == 12345;
+        hllAddRange(h, 5000, 1000);
+        test_cond("PFCOUNT uses and refreshes the cached cardinality ",
+            ok && hllCountCached(h, NULL) == hllCount(h->ptr, NULL));
+        decrRefCount(h);
+    }
+
+    {
+        robj *keys[4], *u = createHLLObject();
+        uint64_t multi;
+        int invalid = 0;
+
+        keys[0] = createHLLObject();
+        keys[1] = createHLLObject();
+        keys[2] = NULL;
+        keys[3] = createHLLObject();
+        hllAddRange(keys[0], 0, 50000);         // 密集表示
+        hllAddRange(keys[1], 30000, 100);       // 稀疏表示
+        hllAddRange(keys[3], 45000, 20000);
+        hllAddRange(u, 0, 65000);
+        multi = hllCountMulti(keys, 4, &invalid);
+        test_cond("Multi-key PFCOUNT counts the union of mixed encodings ",
+            !invalid && ((struct hllhdr*)keys[1]->ptr)->encoding == HLL_SPARSE &&
+            multi == hllCount(u->ptr, NULL));
+        for (j = 0; j < 4; j++) if (keys[j]) decrRefCount(keys[j]);
+        decrRefCount(u);
+    }
+
+    /* Short strings are INLINE encoded, their ptr is not an sds. */
+    {
+        robj *keys[2];
+        int invalid = 0;
+
+        keys[0] = createHLLObject();
+        keys[1] = createInlineStringObject("HYLL", 4);
+        hllCountMulti(keys, 2, &invalid);
+        test_cond("INLINE encoded strings are not HLL objects ",
+            isHLLObject(keys[1]) == REDIS_ERR && invalid &&
+            hllMergeObjects(keys[0], keys + 1, 1) == REDIS_ERR);
+        decrRefCount(keys[0]);
+        decrRefCount(keys[1]);
+    }
+
+    /* A failed PFMERGE leaves the destination untouched. */
+    {
+        robj *dest = createHLLObject(), *srcs[2], *str;
+        sds before;
+
+        hllAddRange(dest, 0, 100);              // 稀疏表示
+        srcs[0] = createHLLObject();
+        hllAddRange(srcs[0], 0, 50000);         // 密集表示
+        srcs[1] = createObject(REDIS_STRING, sdsnew("not an HLL"));
+        str = createObject(REDIS_STRING, sdsnew("not an HLL"));
+        before = sdsnewlen(dest->ptr, sdslen(dest->ptr));
+        test_cond("PFMERGE checks every HLL before writing the destination ",
+            hllMergeObjects(dest, srcs, 2) == REDIS_ERR &&
+            sdslen(dest->ptr) == sdslen(before) &&
+            memcmp(dest->ptr, before, sdslen(before)) == 0 &&
+            hllMergeObjects(str, srcs, 1) == REDIS_ERR &&
+            strcmp(str->ptr, "not an HLL") == 0 &&
+            hllMergeObjects(dest, srcs, 1) == REDIS_OK &&
+            hllCount(dest->ptr, NULL) == hllCount(srcs[0]->ptr, NULL));
+        sdsfree(before);
+        decrRefCount(dest);
+        decrRefCount(srcs[0]);
+        decrRefCount(srcs[1]);
+        decrRefCount(str);
+    }
+
+    /*
+     * PFCOUNT over 1, 10 and 100 keys: computing the count every time and
+     * merging into a temporary dense HLL, against the cached count and
+     * the single pass merge into the reusable HLL_RAW buffer.
+    */
+    {
+        static const int nkeys[] = {1, 10, 100};
+        robj *keys[100];
+        unsigned int n;
+
+        for (j = 0; j < 100; j++) {
+            keys[j] = createHLLObject();
+            hllAddRange(keys[j], j * 1000, 5000);
+        }
+        for (n = 0; n < sizeof(nkeys) / sizeof(nkeys[0]); n++) {
+            int iter = 20000 / nkeys[n], k;
+            uint64_t c1 = 0, c2 = 0;
+            long long start, told;
+
+            start = usec();
+            for (k = 0; k < iter; k++) {
+                if (nkeys[n] == 1) {
+                    c1 = hllCount(keys[0]->ptr, NULL);
+                } else {
+                    robj *tmp = createHLLObject();
+                    hllMergeObjects(tmp, keys, nkeys[n]);
+                    c1 = hllCount(tmp->ptr, NULL);
+                    decrRefCount(tmp);
+                }
+            }
+            told = usec() - start;
+
+            start = usec();
+            for (k = 0; k < iter; k++) c2 = hllCountMulti(keys, nkeys[n], NULL);
+            printf("PFCOUNT %3d keys: temporary HLL %8.2f usec/op, "
+                   "cached/raw buffer %8.2f usec/op\n", nkeys[n],
+                (double)told / iter, (double)(usec() - start) / iter);
+            assert(c1 == c2);
+        }
+        for (j = 0; j < 100; j++) decrRefCount(keys[j]);
+    }
+
+    /*
+     * Memory used by low cardinality sketches, and the cost of an update
+     * in both encodings as the sparse representation grows.
+    */
+    {
+        static const long long cards[] = {1, 10, 100, 500, 1000, 2000};
+        unsigned int c;
+        int iter = 200;
+
+        for (c = 0; c < sizeof(cards) / sizeof(cards[0]); c++) {
+            robj *sparse = createHLLObject(), *dense = createHLLObject();
+            long long start, tsparse, tdense;
+            int k;
+
+            server.hll_sparse_max_bytes = 1 << 20;
+            hllSparseToDense(dense);
+            hllAddRange(sparse, 0, cards[c]);
+            hllAddRange(dense, 0, cards[c]);
+
+            // 重复添加已经存在的元素，测量的是查找和更新的代价而不是增长
+            start = usec();
+            for (k = 0; k < iter; k++) hllAddRange(sparse, k % cards[c], 1);
+            tsparse = usec() - start;
+            start = usec();
+            for (k = 0; k < iter; k++) hllAddRange(dense, k % cards[c], 1);
+            tdense = usec() - start;
+
+            printf("%5lld elements: sparse %5zu bytes, dense %zu bytes, "
+                   "update sparse %.3f usec, dense %.3f usec\n",
+                cards[c], sdslen(sparse->ptr), sdslen(dense->ptr),
+                (double)tsparse / iter, (double)tdense / iter);
+            decrRefCount(sparse);
+            decrRefCount(dense);
+        }
+        server.hll_sparse_max_bytes = REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES;
+    }
+
+    {
+        static const long long cards[] = {10, 1000, 20000, 100000, 1000000};
+        unsigned int c;
+
+        ok = 1;
+        for (c = 0; c < sizeof(cards) / sizeof(cards[0]); c++) {
+            robj *h = createHLLObject();
+            uint64_t est;
+            double err;
+
+            hllAddRange(h, 0, cards[c]);
+            est = hllCount(h->ptr, NULL);
+            err = fabs((double)est - cards[c]) / cards[c];
+            printf("cardinality %7lld estimate %7llu error %.4f\n",
+                cards[c], (unsigned long long)est, err);
+            if (err > 0.05) ok = 0;
+            decrRefCount(h);
+        }
+        test_cond("Estimation error below 5% ", ok);
+    }
+
+    /*
+     * Estimator accuracy from 1 to maxcard (10^9 unless given on the
+     * command line), fed with a synthetic hash stream instead of hashing
+     * strings: splitmix64 of a counter, applied straight to HLL_RAW
+     * registers. Up to 10^6 the bias and the spread are averaged over
+     * several streams (mean and root mean square of the relative error),
+     * above that a single stream is followed. The CPU
+     * time of one estimate from the histogram is reported too.
+    */
+    {
+        static const int steps[] = {1, 2, 5};
+        int trials = 32, t, maxed = 1;
+        double sumerr[64], sumsq[64];
+        long long checkpoints[64], maxerr_card = 0;
+        double maxerr = 0;
+        int ncheck = 0, c;
+
+        for (c = 0; c < 64; c++) sumerr[c] = sumsq[c] = 0;
+        for (checkpoints[0] = 1; ; ) {
+            long long next = 0;
+            long long decade = 1;
+            while (decade * 10 <= checkpoints[ncheck]) decade *= 10;
+            for (j = 0; j < 3; j++) {
+                if (steps[j] * decade > checkpoints[ncheck]) {
+                    next = steps[j] * decade;
+                    break;
+                }
+            }
+            if (next == 0) next = decade * 10;
+            ncheck++;
+            if (next > maxcard) break;
+            checkpoints[ncheck] = next;
+        }
+
+        for (t = 0; t < trials; t++) {
+            uint64_t seed = (uint64_t)t << 40;  // 每个流使用不相交的计数器区间
+            long long n = 0;
+
+            // 只有第一个流会一直运行到 maxcard
+            memset(raw, 0, sizeof(raw));
+            for (c = 0; c < ncheck; c++) {
+                int reghisto[64] = {0};
+                uint64_t est;
+                double err;
+
+                if (t > 0 && checkpoints[c] > 1000000) break;
+                for (; n < checkpoints[c]; n++) {
+                    uint64_t z = (seed + (uint64_t)n) * 0x9e3779b97f4a7c15ULL;
+                    long index;
+                    uint8_t count;
+
+                    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                    z ^= z >> 31;
+                    count = hllPatLenHash(z, &index);
+                    if (count > raw[index]) raw[index] = count;
+                }
+                hllRawRegHisto(raw, reghisto);
+                est = hllEstimate(reghisto);
+                err = ((double)est - checkpoints[c]) / checkpoints[c];
+                sumerr[c] += err;
+                sumsq[c] += err * err;
+                if (fabs(err) > maxerr) {
+                    maxerr = fabs(err);
+                    maxerr_card = checkpoints[c];
+                }
+            }
+        }
+
+        for (c = 0; c < ncheck; c++) {
+            int runs = checkpoints[c] > 1000000 ? 1 : trials;
+            int reghisto[64] = {0};
+            long long start;
+            int k, iter = 100000;
+            volatile uint64_t sink = 0;
+
+            // 使用一个合成的直方图测量单次估算的 CPU 时间
+            reghisto[0] = HLL_REGISTERS / (c + 2);
+            reghisto[1 + c % 20] = HLL_REGISTERS - reghisto[0];
+            start = usec();
+            for (k = 0; k < iter; k++) {
+                reghisto[0] ^= k & 1;
+                sink += hllEstimate(reghisto);
+            }
+            printf("cardinality %10lld: bias %+.5f, rms error %.5f over %2d streams, "
+                   "%.3f usec/estimate\n", checkpoints[c], sumerr[c] / runs,
+                sqrt(sumsq[c] / runs), runs, (double)(usec() - start) / iter);
+        }
+        printf("max relative error %.5f at %lld\n", maxerr, maxerr_card);
+        if (checkpoints[ncheck - 1] < maxcard) maxed = 0;
+        test_cond("Ertl estimator stays within 5% from 1 to maxcard ",
+            maxerr < 0.05 && maxed);
+    }
+
+    {
+        robj *a = createHLLObject(), *b = createHLLObject(), *u = createHLLObject();
+        robj *srcs[2];
+        uint64_t merged, direct;
+
+        hllAddRange(a, 0, 60000);
+        hllAddRange(b, 40000, 60000);
+        hllAddRange(u, 0, 100000);
+        hllSparseToDense(u);
+        srcs[0] = a;
+        srcs[1] = b;
+        memset(((struct hllhdr*)o->ptr)->registers, 0, HLL_DENSE_SIZE - HLL_HDR_SIZE);
+        hllMergeObjects(o, srcs, 2);
+        merged = hllCount(o->ptr, NULL);
+        direct = hllCount(u->ptr, NULL);
+        test_cond("Merged sketch equals the sketch of the union ",
+            merged == direct &&
+            memcmp(((struct hllhdr*)o->ptr)->registers,
+                   ((struct hllhdr*)u->ptr)->registers, HLL_DENSE_SIZE - HLL_HDR_SIZE) == 0);
+
+        /*
+         * PFCOUNT and PFMERGE throughput on 16384 register sketches: the
+         * register at a time macros against the chunked histogram and the
+         * vectorised raw max.
+        */
+        {
+            int iter = 20000, k;
+            long long start;
+            uint64_t sum = 0;
+
+            start = usec();
+            for (k = 0; k < iter; k++) {
+                int reghisto[64] = {0};
+                for (j = 0; j < HLL_REGISTERS; j++) {
+                    unsigned long reg;
+                    HLL_DENSE_GET_REGISTER(reg, ((struct hllhdr*)a->ptr)->registers, j);
+                    reghisto[reg]++;
+                }
+                sum += hllEstimate(reghisto);
+            }
+            printf("PFCOUNT per register histogram: %.2f usec/op\n",
+                (double)(usec() - start) / iter);
+
+            start = usec();
+            for (k = 0; k < iter; k++) sum += hllCount(a->ptr, NULL);
+            printf("PFCOUNT chunked histogram:      %.2f usec/op\n",
+                (double)(usec() - start) / iter);
+
+            start = usec();
+            for (k = 0; k < iter; k++) {
+                uint8_t *dst = ((struct hllhdr*)o->ptr)->registers;
+                uint8_t *src = ((struct hllhdr*)b->ptr)->registers;
+                for (j = 0; j < HLL_REGISTERS; j++) {
+                    uint8_t r1, r2;
+                    HLL_DENSE_GET_REGISTER(r1, dst, j);
+                    HLL_DENSE_GET_REGISTER(r2, src, j);
+                    if (r2 > r1) HLL_DENSE_SET_REGISTER(dst, j, r2);
+                }
+            }
+            printf("PFMERGE per register max:       %.2f usec/op\n",
+                (double)(usec() - start) / iter);
+
+            start = usec();
+            for (k = 0; k < iter; k++) hllMergeObjects(o, srcs + 1, 1);
+            printf("PFMERGE raw max:                %.2f usec/op (%llu)\n",
+                (double)(usec() - start) / iter, (unsigned long long)sum);
+        }
+
+        decrRefCount(a);
+        decrRefCount(b);
+        decrRefCount(u);
+    }
+
+    decrRefCount(o);
+    test_report();
+    return 0;
+}
+#endif
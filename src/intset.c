@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "intset.h"
 #include "zmalloc.h"
 #include "endianconv.h"
@@ -17,6 +23,16 @@
 #define INTSET_ENC_INT32 (sizeof(int32_t))
 #define INTSET_ENC_INT64 (sizeof(int64_t))
 
+/*
+ * Compressed encoding, see intsetPack(). It sits outside of the ordering
+ * above: every public function checks for it before looking at widths.
+*/
+// 压缩编码，见 intsetPack()
+// 它不参与上面的大小顺序，所有公开函数都会先检查这种编码
+#define INTSET_ENC_PACKED 1
+
+#define intsetIsPacked(is) (intrev32ifbe((is)->encoding) == INTSET_ENC_PACKED)
+
 /* Return the required encoding for the provided value */
 /*
  * 返回适用于传入值 v 的编码方式
@@ -71,4 +87,1888 @@ static int64_t _intsetGetEncoded(intset *is, int pos, uint8_t enc) {
 */
 static int64_t _intsetGet(intset *is, int pos) {
     return _intsetGetEncoded(is, pos, intrev32ifbe(is->encoding));
-}
\ No newline at end of file
+}
+
+/*
+ * Set the value at pos, using the configured encoding
+ *
+ * 根据集合的编码方式，将底层数组在 pos 位置上的值设为 value
+ *
+ * T = O(1)
+*/
+static void _intsetSet(intset *is, int pos, int64_t value) {
+    uint32_t encoding = intrev32ifbe(is->encoding);
+
+    if (encoding == INTSET_ENC_INT64) {
+        ((int64_t*)is->contents)[pos] = value;
+        memrev64ifbe(((int64_t*)is->contents) + pos);
+    } else if (encoding == INTSET_ENC_INT32) {
+        ((int32_t*)is->contents)[pos] = value;
+        memrev32ifbe(((int32_t*)is->contents) + pos);
+    } else {
+        ((int16_t*)is->contents)[pos] = value;
+        memrev16ifbe(((int16_t*)is->contents) + pos);
+    }
+}
+
+/*
+ * Create an empty intset
+ *
+ * 创建并返回一个新的空整数集合
+ *
+ * T = O(1)
+*/
+intset *intsetNew(void) {
+    intset *is = zmalloc(sizeof(intset));
+
+    // 设置初始编码
+    is->encoding = intrev32ifbe(INTSET_ENC_INT16);
+
+    // 初始化元素数量
+    is->length = 0;
+
+    return is;
+}
+
+/*
+ * Resize the intset
+ *
+ * 调整整数集合的内存空间大小
+ *
+ * 如果调整后的大小要比集合原来的大小要大，
+ * 那么集合中原有元素的值不会被改变
+ *
+ * T = O(N)
+*/
+static intset *_intsetResize(intset *is, uint32_t len) {
+    uint32_t size = len * intrev32ifbe(is->encoding);
+
+    is = zrealloc(is, sizeof(intset) + size);
+    return is;
+}
+
+/* ------------------------- Packed encoding ------------------------------ */
+
+/*
+ * Clustered values, like user IDs close to 9e9, need the 64 bit encoding
+ * even if they differ only in the low bits. intsetPack() converts such a
+ * set to a frame of reference encoding: blocks of INTSET_PACK_BLOCK
+ * values stored as the first value of the block (the base) plus the
+ * offsets of the other values from the base, bit packed at the width
+ * required by the biggest offset of the block.
+ *
+ * contents layout:
+ *
+ * | nblocks | datawords | skip index: nblocks x intsetPackBlock | data |
+ *
+ * The skip index holds the base of every block, so a lookup is a binary
+ * search on the bases followed by a binary search inside one block, and
+ * positional access is O(1) as all the offsets of a block have the same
+ * width. Every block is followed by a padding word, so that a value can
+ * always be read with two unconditional 64 bit loads.
+ *
+ * Packed sets are meant for large sets that are mostly read: the
+ * functions modifying the set transparently unpack it first.
+*/
+/*
+ * 聚集的值（例如接近 9e9 的用户 ID）即使只有低位不同，也需要 64 位编码
+ * intsetPack() 将这样的集合转换为参考帧（frame of reference）编码：
+ * 每 INTSET_PACK_BLOCK 个值为一块，保存块的第一个值（基准值）
+ * 以及其他值相对于基准值的偏移量，偏移量按块内最大偏移所需的位宽紧凑存放
+ *
+ * contents 的布局：
+ *
+ * | nblocks | datawords | 跳跃索引：nblocks 个 intsetPackBlock | 数据 |
+ *
+ * 跳跃索引保存每一块的基准值，查找时先对基准值进行二分查找，
+ * 再在块内二分查找；同一块中的偏移量宽度相同，所以按位置访问是 O(1) 的
+ * 每一块后面都有一个填充字，因此读取一个值总是可以用两次无条件的 64 位读取完成
+ *
+ * 压缩集合适用于以读取为主的大集合，修改集合的函数会先自动将其解压
+*/
+#define INTSET_PACK_BLOCK 128
+
+typedef struct intsetPackBlock {
+    int64_t base;           // 块的基准值，也即块中的最小值
+    uint32_t offset;        // 块数据在数据区中的起始位置，以 64 位字为单位
+    uint8_t bits;           // 偏移量的位宽
+    uint8_t notused[3];
+} intsetPackBlock;
+
+typedef struct intsetPackHeader {
+    uint32_t nblocks;       // 块的数量
+    uint32_t datawords;     // 数据区的 64 位字数量
+    intsetPackBlock index[];
+} intsetPackHeader;
+
+/*
+ * Minimum fraction of the plain size that packing must save, as set by
+ * intsetSetPackMinSaving()
+*/
+// 压缩至少需要节省的空间比例，由 intsetSetPackMinSaving() 设置
+static double intset_pack_min_saving = 0.25;
+
+#define _intsetPackHeader(is) ((intsetPackHeader*)(is)->contents)
+#define _intsetPackData(is) \
+    ((uint64_t*)(_intsetPackHeader(is)->index + _intsetPackHeader(is)->nblocks))
+
+/*
+ * Set the minimum saving, as a fraction of the plain size, that
+ * intsetPack() requires to use the packed encoding
+*/
+/*
+ * 设置 intsetPack() 使用压缩编码所需的最小节省比例（相对于普通编码的大小）
+*/
+void intsetSetPackMinSaving(double ratio) {
+    intset_pack_min_saving = ratio;
+}
+
+/* Number of data words used by a block of n values of the given width */
+static uint32_t _intsetPackBlockWords(uint32_t n, uint8_t bits) {
+    // 最后一个值所在的字，再加一个填充字
+    return (uint32_t)(((uint64_t)n * bits) / 64) + 2;
+}
+
+/*
+ * Read the i-th offset of a bit packed block
+ *
+ * T = O(1)
+*/
+static uint64_t _intsetUnpackOne(const uint64_t *words, uint8_t bits, uint32_t i) {
+    uint64_t bit = (uint64_t)i * bits;
+    uint32_t shift = bit & 63;
+    const uint64_t *w = words + (bit >> 6);
+    uint64_t mask = (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+
+    // (w[1] << 1) << (63 - shift) 在 shift 为 0 时结果为 0，避免移位 64 位
+    return ((w[0] >> shift) | ((w[1] << 1) << (63 - shift))) & mask;
+}
+
+/*
+ * Decode the n offsets of a block into out. With AVX2 four offsets are
+ * decoded at a time: the two words holding each offset are gathered and
+ * combined with per lane variable shifts.
+ *
+ * T = O(N)
+*/
+/*
+ * 将一块中的 n 个偏移量解码到 out 中
+ * 支持 AVX2 时一次解码四个偏移量：取出每个偏移量所在的两个字，
+ * 再使用按通道的可变移位进行组合
+*/
+static void _intsetUnpackBlock(const uint64_t *words, uint8_t bits, uint32_t n, uint64_t *out) {
+    uint32_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i mask = _mm256_set1_epi64x((bits == 64) ? ~0ULL : ((1ULL << bits) - 1));
+    __m256i bitpos = _mm256_set_epi64x(3 * bits, 2 * bits, bits, 0);
+    __m256i step = _mm256_set1_epi64x(4 * bits);
+    __m256i sixtyfour = _mm256_set1_epi64x(64);
+    __m256i sixtythree = _mm256_set1_epi64x(63);
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i idx = _mm256_srli_epi64(bitpos, 6);
+        __m256i shift = _mm256_and_si256(bitpos, sixtythree);
+        __m256i lo = _mm256_i64gather_epi64((const long long*)words, idx, 8);
+        __m256i hi = _mm256_i64gather_epi64((const long long*)words + 1, idx, 8);
+
+        // 移位数大于 63 时 _mm256_sllv_epi64 的结果为 0，正好处理 shift 为 0 的情况
+        __m256i v = _mm256_or_si256(_mm256_srlv_epi64(lo, shift),
+                    _mm256_sllv_epi64(hi, _mm256_sub_epi64(sixtyfour, shift)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(v, mask));
+        bitpos = _mm256_add_epi64(bitpos, step);
+    }
+#endif
+    for (; i < n; i++) out[i] = _intsetUnpackOne(words, bits, i);
+}
+
+/*
+ * Return the value at pos of a packed set
+ *
+ * T = O(1)
+*/
+static int64_t _intsetPackedGet(intset *is, uint32_t pos) {
+    intsetPackHeader *hdr = _intsetPackHeader(is);
+    intsetPackBlock *blk = hdr->index + pos / INTSET_PACK_BLOCK;
+
+    return (int64_t)((uint64_t)blk->base +
+        _intsetUnpackOne(_intsetPackData(is) + blk->offset, blk->bits, pos % INTSET_PACK_BLOCK));
+}
+
+/*
+ * Return 1 if value belongs to the packed set
+ *
+ * T = O(log N)
+*/
+static uint8_t _intsetPackedFind(intset *is, int64_t value) {
+    intsetPackHeader *hdr = _intsetPackHeader(is);
+    uint32_t len = intrev32ifbe(is->length);
+    uint32_t b = 0, n = hdr->nblocks, p = 0;
+    intsetPackBlock *blk;
+    const uint64_t *words;
+    uint64_t delta;
+
+    if (value < hdr->index[0].base) return 0;
+
+    // 在跳跃索引中无分支地查找最后一个基准值小于等于 value 的块
+    while (n > 1) {
+        uint32_t half = n >> 1;
+        b = (hdr->index[b + half].base <= value) ? b + half : b;
+        n -= half;
+    }
+
+    // 在块内无分支地查找第一个大于等于 delta 的偏移量
+    blk = hdr->index + b;
+    words = _intsetPackData(is) + blk->offset;
+    delta = (uint64_t)value - (uint64_t)blk->base;
+    n = (b == hdr->nblocks - 1) ? len - b * INTSET_PACK_BLOCK : INTSET_PACK_BLOCK;
+    while (n > 1) {
+        uint32_t half = n >> 1;
+        p = (_intsetUnpackOne(words, blk->bits, p + half - 1) < delta) ? p + half : p;
+        n -= half;
+    }
+    return _intsetUnpackOne(words, blk->bits, p) == delta;
+}
+
+/*
+ * Convert the set to the packed encoding if that saves at least the
+ * configured fraction of its size, otherwise return it unchanged.
+ * Packing is only available on little endian hosts.
+ *
+ * Nothing packs a set implicitly: every write unpacks it first, so
+ * packing on the write path would cost two O(N) copies per SADD. Callers
+ * pack sets they know are done growing, such as a bulk load through
+ * intsetAddMany() followed by reads.
+ *
+ * T = O(N)
+*/
+/*
+ * 如果压缩编码能节省至少配置的比例，那么将集合转换为压缩编码，
+ * 否则原样返回集合
+ * 压缩编码只在小端主机上可用
+ *
+ * 集合不会被隐式地压缩：每次写入都要先解压，在写入路径上压缩会让每个 SADD 多出两次 O(N) 的复制
+ * 调用者在确定集合不再增长时才压缩它，比如通过 intsetAddMany() 批量加载之后只进行读取的集合
+*/
+intset *intsetPack(intset *is) {
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+    uint32_t len = intrev32ifbe(is->length);
+    uint32_t nblocks = (len + INTSET_PACK_BLOCK - 1) / INTSET_PACK_BLOCK;
+    uint32_t b, j, datawords = 0;
+    size_t packedlen;
+    intset *packed;
+    intsetPackHeader *hdr;
+    uint64_t *data;
+
+    if (intsetIsPacked(is) || len == 0) return is;
+
+    // 先计算每一块的位宽以及压缩后的大小
+    for (b = 0; b < nblocks; b++) {
+        uint32_t first = b * INTSET_PACK_BLOCK;
+        uint32_t n = (len - first < INTSET_PACK_BLOCK) ? len - first : INTSET_PACK_BLOCK;
+        uint64_t span = (uint64_t)_intsetGet(is, first + n - 1) - (uint64_t)_intsetGet(is, first);
+        uint8_t bits = span ? 64 - __builtin_clzll(span) : 0;
+        datawords += _intsetPackBlockWords(n, bits);
+    }
+    packedlen = sizeof(intset) + sizeof(intsetPackHeader) +
+                nblocks * sizeof(intsetPackBlock) + (size_t)datawords * sizeof(uint64_t);
+    if (packedlen > intsetBlobLen(is) * (1 - intset_pack_min_saving)) return is;
+
+    packed = zcalloc(packedlen);
+    packed->encoding = intrev32ifbe(INTSET_ENC_PACKED);
+    packed->length = is->length;
+    hdr = _intsetPackHeader(packed);
+    hdr->nblocks = nblocks;
+    hdr->datawords = datawords;
+    data = _intsetPackData(packed);
+
+    // 逐块写入基准值和按位紧凑存放的偏移量
+    for (b = 0, datawords = 0; b < nblocks; b++) {
+        uint32_t first = b * INTSET_PACK_BLOCK;
+        uint32_t n = (len - first < INTSET_PACK_BLOCK) ? len - first : INTSET_PACK_BLOCK;
+        int64_t base = _intsetGet(is, first);
+        uint64_t span = (uint64_t)_intsetGet(is, first + n - 1) - (uint64_t)base;
+        uint8_t bits = span ? 64 - __builtin_clzll(span) : 0;
+        uint64_t *words = data + datawords;
+
+        hdr->index[b].base = base;
+        hdr->index[b].offset = datawords;
+        hdr->index[b].bits = bits;
+        for (j = 0; bits && j < n; j++) {
+            uint64_t delta = (uint64_t)_intsetGet(is, first + j) - (uint64_t)base;
+            uint64_t bit = (uint64_t)j * bits;
+            uint32_t shift = bit & 63;
+
+            words[bit >> 6] |= delta << shift;
+            if (shift + bits > 64) words[(bit >> 6) + 1] |= delta >> (64 - shift);
+        }
+        datawords += _intsetPackBlockWords(n, bits);
+    }
+
+    zfree(is);
+    return packed;
+#else
+    return is;
+#endif
+}
+
+/*
+ * Convert a packed set back to the plain encoding, plain sets are
+ * returned unchanged.
+ *
+ * T = O(N)
+*/
+/*
+ * 将压缩编码的集合转换回普通编码，普通编码的集合原样返回
+*/
+intset *intsetUnpack(intset *is) {
+    intsetPackHeader *hdr;
+    uint64_t deltas[INTSET_PACK_BLOCK];
+    uint32_t len, b, j;
+    uint8_t enc;
+    intset *plain;
+
+    if (!intsetIsPacked(is)) return is;
+
+    hdr = _intsetPackHeader(is);
+    len = intrev32ifbe(is->length);
+
+    // 第一个值和最后一个值决定普通编码的宽度
+    enc = _intsetValueEncoding(_intsetPackedGet(is, 0));
+    if (_intsetValueEncoding(_intsetPackedGet(is, len - 1)) > enc) {
+        enc = _intsetValueEncoding(_intsetPackedGet(is, len - 1));
+    }
+
+    plain = zmalloc(sizeof(intset) + (size_t)len * enc);
+    plain->encoding = intrev32ifbe(enc);
+    plain->length = is->length;
+
+    // 逐块解码
+    for (b = 0; b < hdr->nblocks; b++) {
+        uint32_t first = b * INTSET_PACK_BLOCK;
+        uint32_t n = (len - first < INTSET_PACK_BLOCK) ? len - first : INTSET_PACK_BLOCK;
+
+        _intsetUnpackBlock(_intsetPackData(is) + hdr->index[b].offset,
+                           hdr->index[b].bits, n, deltas);
+        for (j = 0; j < n; j++) {
+            _intsetSet(plain, first + j, (int64_t)((uint64_t)hdr->index[b].base + deltas[j]));
+        }
+    }
+
+    zfree(is);
+    return plain;
+}
+
+/* ------------------------- Search engine -------------------------------- */
+
+/*
+ * The search engine works directly on the typed contents array, so it is
+ * only used on little endian hosts where no byte swap is needed. Big endian
+ * hosts use the generic _intsetGet() based binary search.
+ *
+ * Sets with at most INTSET_LINEAR_BYTES bytes of payload are searched
+ * with a linear "count the elements smaller than value" scan, that is
+ * branch free and maps to AVX2 compares when available (the threshold is
+ * smaller without AVX2). Larger sets use a
+ * branchless binary search, where the only data dependent operation is a
+ * conditional move, so there are no mispredicted branches.
+*/
+/*
+ * 查找引擎直接操作类型化的底层数组，因此只在不需要大小端转换的小端主机上使用，
+ * 大端主机使用基于 _intsetGet() 的通用二分查找
+ *
+ * 数据不超过 INTSET_LINEAR_BYTES 字节的小集合使用线性扫描，
+ * 计算比 value 小的元素个数，这个过程没有分支，支持 AVX2 时会使用向量比较；
+ * 更大的集合使用无分支二分查找，只依赖条件移动指令，不会产生分支预测失败
+*/
+#if defined(__AVX2__)
+#define INTSET_LINEAR_BYTES 256
+#else
+#define INTSET_LINEAR_BYTES 64
+#endif
+
+#if (BYTE_ORDER == LITTLE_ENDIAN)
+#define INTSET_TYPED_SEARCH 1
+#endif
+
+/*
+ * Generic binary search through _intsetGet(), used when the contents can't
+ * be accessed directly. Little endian builds only need it as the reference
+ * of the tests.
+ *
+ * T = O(log N)
+*/
+// 通过 _intsetGet() 进行的通用二分查找，小端主机上只作为测试的参照
+#if !defined(INTSET_TYPED_SEARCH) || defined(INTSET_TEST_MAIN)
+static uint8_t _intsetSearchGeneric(intset *is, int64_t value, uint32_t *pos) {
+    int min = 0, max = intrev32ifbe(is->length) - 1, mid = -1;
+    int64_t cur = -1;
+
+    // 处理 is 为空时的情况
+    if (intrev32ifbe(is->length) == 0) {
+        if (pos) *pos = 0;
+        return 0;
+    } else {
+        /*
+         * Check for the case where we know we cannot find the value,
+         * but do know the insert position.
+        */
+        // 因为底层数组是有序的，如果 value 比数组中最后一个值都要大
+        // 那么 value 肯定不存在于集合中，
+        // 并且应该将 value 添加到底层数组的最末端
+        if (value > _intsetGet(is, intrev32ifbe(is->length) - 1)) {
+            if (pos) *pos = intrev32ifbe(is->length);
+            return 0;
+        // 如果 value 比数组中最前一个值都要小
+        // 那么 value 肯定不存在于集合中，
+        // 并且应该将它添加到底层数组的最前端
+        } else if (value < _intsetGet(is, 0)) {
+            if (pos) *pos = 0;
+            return 0;
+        }
+    }
+
+    // 在有序数组中进行二分查找
+    while (max >= min) {
+        mid = ((unsigned int)min + (unsigned int)max) >> 1;
+        cur = _intsetGet(is, mid);
+        if (value > cur) {
+            min = mid + 1;
+        } else if (value < cur) {
+            max = mid - 1;
+        } else {
+            break;
+        }
+    }
+
+    // 检查是否已经找到了 value
+    if (value == cur) {
+        if (pos) *pos = mid;
+        return 1;
+    } else {
+        if (pos) *pos = min;
+        return 0;
+    }
+}
+#endif
+
+#ifdef INTSET_TYPED_SEARCH
+
+/*
+ * Return the number of elements of the sorted array a[0..len-1] that are
+ * smaller than v, that is the lower bound position of v.
+ *
+ * One function for every encoding, generated by the macro below.
+*/
+/*
+ * 返回有序数组 a[0..len-1] 中比 v 小的元素个数，也即 v 的下界位置
+ *
+ * 每种编码各有一个版本，由下面的宏生成
+*/
+#define INTSET_LOWER_BOUND_IMPL(name, type) \
+static uint32_t name(const type *a, uint32_t len, type v) { \
+    const type *base = a; \
+    uint32_t n = len; \
+    if (n == 0) return 0; \
+    while (n > 1) { \
+        uint32_t half = n >> 1; \
+        base = (base[half] < v) ? base + half : base; \
+        n -= half; \
+    } \
+    return (uint32_t)(base - a) + (*base < v); \
+}
+
+INTSET_LOWER_BOUND_IMPL(_intsetLowerBound16, int16_t)
+INTSET_LOWER_BOUND_IMPL(_intsetLowerBound32, int32_t)
+INTSET_LOWER_BOUND_IMPL(_intsetLowerBound64, int64_t)
+
+/*
+ * Linear lower bound for small arrays: count the elements smaller than v.
+ * There are no early exits, so the loop is branch free, and with AVX2 we
+ * compare a whole 32 byte register at a time.
+*/
+/*
+ * 小数组的线性下界查找：统计比 v 小的元素个数
+ * 循环中没有提前退出，因此没有分支；支持 AVX2 时一次比较 32 个字节
+*/
+static uint32_t _intsetLinearCount16(const int16_t *a, uint32_t len, int16_t v) {
+    uint32_t j = 0, count = 0;
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi16(v);
+    for (; j + 16 <= len; j += 16) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(a + j));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpgt_epi16(needle, chunk));
+        // 每个 16 位元素对应掩码中的两个位
+        count += __builtin_popcount(mask) >> 1;
+    }
+#endif
+    for (; j < len; j++) count += a[j] < v;
+    return count;
+}
+
+static uint32_t _intsetLinearCount32(const int32_t *a, uint32_t len, int32_t v) {
+    uint32_t j = 0, count = 0;
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi32(v);
+    for (; j + 8 <= len; j += 8) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(a + j));
+        __m256 lt = _mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, chunk));
+        count += __builtin_popcount(_mm256_movemask_ps(lt));
+    }
+#endif
+    for (; j < len; j++) count += a[j] < v;
+    return count;
+}
+
+static uint32_t _intsetLinearCount64(const int64_t *a, uint32_t len, int64_t v) {
+    uint32_t j = 0, count = 0;
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi64x(v);
+    for (; j + 4 <= len; j += 4) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(a + j));
+        __m256d lt = _mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, chunk));
+        count += __builtin_popcount(_mm256_movemask_pd(lt));
+    }
+#endif
+    for (; j < len; j++) count += a[j] < v;
+    return count;
+}
+
+/*
+ * Return the lower bound position of value in the contents of the intset,
+ * that must be representable in the intset encoding.
+ *
+ * T = O(log N)
+*/
+/*
+ * 返回 value 在整数集合底层数组中的下界位置
+ * value 必须能用集合当前的编码表示
+*/
+static uint32_t _intsetLowerBound(intset *is, int64_t value) {
+    uint32_t enc = intrev32ifbe(is->encoding);
+    uint32_t len = intrev32ifbe(is->length);
+
+    if (enc == INTSET_ENC_INT64) {
+        const int64_t *a = (const int64_t*)is->contents;
+        return (len * sizeof(int64_t) <= INTSET_LINEAR_BYTES) ?
+            _intsetLinearCount64(a, len, value) :
+            _intsetLowerBound64(a, len, value);
+    } else if (enc == INTSET_ENC_INT32) {
+        const int32_t *a = (const int32_t*)is->contents;
+        return (len * sizeof(int32_t) <= INTSET_LINEAR_BYTES) ?
+            _intsetLinearCount32(a, len, (int32_t)value) :
+            _intsetLowerBound32(a, len, (int32_t)value);
+    } else {
+        const int16_t *a = (const int16_t*)is->contents;
+        return (len * sizeof(int16_t) <= INTSET_LINEAR_BYTES) ?
+            _intsetLinearCount16(a, len, (int16_t)value) :
+            _intsetLowerBound16(a, len, (int16_t)value);
+    }
+}
+
+#endif /* INTSET_TYPED_SEARCH */
+
+/*
+ * Search for the position of "value".
+ *
+ * Return 1 when the value was found and sets "pos" to the position of
+ * the value within the intset. Return 0 when the value is not present
+ * in the intset and sets "pos" to the position where "value" can be
+ * inserted.
+*/
+/*
+ * 在集合 is 的底层数组中查找值 value 所在的索引
+ *
+ * 成功找到 value 时，函数返回 1，并将 *pos 的值设为 value 所在的索引
+ *
+ * 当在数组中没有找到 value 时，返回 0
+ * 并将 *pos 的值设为 value 可以插入到数组中的位置
+ *
+ * T = O(log N)
+*/
+static uint8_t intsetSearch(intset *is, int64_t value, uint32_t *pos) {
+#ifdef INTSET_TYPED_SEARCH
+    uint32_t len = intrev32ifbe(is->length);
+    uint32_t p = _intsetLowerBound(is, value);
+
+    if (pos) *pos = p;
+    return p < len && _intsetGet(is, p) == value;
+#else
+    return _intsetSearchGeneric(is, value, pos);
+#endif
+}
+
+/*
+ * Upgrades the intset to a larger encoding and inserts the given integer.
+ *
+ * 根据值 value 所使用的编码方式，对整数集合的编码进行升级，
+ * 并将值 value 添加到升级后的整数集合中
+ *
+ * 返回值：添加新元素之后的整数集合
+ *
+ * T = O(N)
+*/
+static intset *intsetUpgradeAndAdd(intset *is, int64_t value) {
+    // 当前的编码方式
+    uint8_t curenc = intrev32ifbe(is->encoding);
+
+    // 新值所需的编码方式
+    uint8_t newenc = _intsetValueEncoding(value);
+
+    // 当前集合的元素数量
+    int length = intrev32ifbe(is->length);
+
+    /*
+     * 根据 value 的值，决定是将它添加到底层数组的最前端还是最后端
+     * 注意，因为 value 的编码比集合原有的其他元素的编码都要大
+     * 所以 value 要么大于集合中的所有元素，要么小于集合中的所有元素
+     * 因此，value 只能添加到底层数组的最前端或最后端
+    */
+    int prepend = value < 0 ? 1 : 0;
+
+    /* First set new encoding and resize */
+    // 更新集合的编码方式
+    is->encoding = intrev32ifbe(newenc);
+    // 根据新编码对集合（的底层数组）进行空间调整
+    is = _intsetResize(is, intrev32ifbe(is->length) + 1);
+
+    /*
+     * Upgrade back-to-front so we don't overwrite values.
+     * Note that the "prepend" variable is used to make sure we have an empty
+     * space at either the beginning or the end of the intset.
+    */
+    // 根据集合原来的编码方式，从底层数组中取出集合元素
+    // 然后再将元素以新编码的方式添加到集合中
+    // 从后向前进行，因此不会覆盖尚未转换的元素
+    while (length--) {
+        _intsetSet(is, length + prepend, _intsetGetEncoded(is, length, curenc));
+    }
+
+    /* Set the value at the beginning or the end. */
+    // 设置新值，根据 prepend 的值来决定是添加到数组头还是数组尾
+    if (prepend) {
+        _intsetSet(is, 0, value);
+    } else {
+        _intsetSet(is, intrev32ifbe(is->length), value);
+    }
+
+    // 更新整数集合的元素数量
+    is->length = intrev32ifbe(intrev32ifbe(is->length) + 1);
+
+    return is;
+}
+
+/*
+ * 向前或向后移动指定索引范围内的数组元素
+ *
+ * 函数名中的 MoveTail 其实是一个有误导性的名字，
+ * 这个函数可以向前或向后移动元素，而不仅仅是向后
+ *
+ * 在添加新元素到数组时，就需要进行向后移动，
+ * 如果数组表示如下（？表示一个未设置新值的空间）：
+ * | x | y | z | ? |
+ *     |<----->|
+ * 而新元素 n 的 pos 为 1 ，那么数组将移动 y 和 z 两个元素
+ * | x | y | y | z |
+ *         |<----->|
+ * 接着就可以将新元素 n 设置到 pos 上了：
+ * | x | n | y | z |
+ *
+ * 当从数组中删除元素时，就需要进行向前移动，
+ * 如果数组表示如下，并且 b 为要删除的目标：
+ * | a | b | c | d |
+ *         |<----->|
+ * 那么程序就会移动 b 后的所有元素向前一个元素的位置，
+ * 从而覆盖 b 的值：
+ * | a | c | d | d |
+ *     |<----->|
+ * 最后，程序再从数组末尾删除一个元素的空间：
+ * | a | c | d |
+ * 这样就完成了删除操作
+ *
+ * T = O(N)
+*/
+static void intsetMoveTail(intset *is, uint32_t from, uint32_t to) {
+    void *src, *dst;
+
+    // 要移动的元素个数
+    uint32_t bytes = intrev32ifbe(is->length) - from;
+
+    // 集合的编码方式
+    uint32_t encoding = intrev32ifbe(is->encoding);
+
+    // 根据不同的编码，计算出需要移动的字节数，以及源地址和目标地址
+    if (encoding == INTSET_ENC_INT64) {
+        src = (int64_t*)is->contents + from;
+        dst = (int64_t*)is->contents + to;
+        bytes *= sizeof(int64_t);
+    } else if (encoding == INTSET_ENC_INT32) {
+        src = (int32_t*)is->contents + from;
+        dst = (int32_t*)is->contents + to;
+        bytes *= sizeof(int32_t);
+    } else {
+        src = (int16_t*)is->contents + from;
+        dst = (int16_t*)is->contents + to;
+        bytes *= sizeof(int16_t);
+    }
+
+    // 进行移动
+    memmove(dst, src, bytes);
+}
+
+/*
+ * Insert an integer in the intset
+ *
+ * 尝试将元素 value 添加到整数集合中
+ *
+ * *success 的值指示添加是否成功：
+ * - 如果添加成功，那么将 *success 的值设为 1
+ * - 因为元素已存在而造成添加失败时，将 *success 的值设为 0
+ *
+ * T = O(N)
+*/
+intset *intsetAdd(intset *is, int64_t value, uint8_t *success) {
+    // 计算编码 value 所需的长度
+    uint8_t valenc = _intsetValueEncoding(value);
+    uint32_t pos;
+
+    // 压缩编码的集合先解压
+    is = intsetUnpack(is);
+
+    // 默认设置插入为成功
+    if (success) *success = 1;
+
+    /*
+     * Upgrade encoding if necessary. If we need to upgrade, we know that
+     * this value should be either appended (if > 0) or prepended (if < 0),
+     * because it lies outside the range of existing values.
+    */
+    // 如果 value 的编码比整数集合现在的编码要大
+    // 那么表示 value 必然可以添加到整数集合中
+    // 并且整数集合需要对自身进行升级，才能满足 value 所需的编码
+    if (valenc > intrev32ifbe(is->encoding)) {
+        /* This always succeeds, so we don't need to curry *success. */
+        return intsetUpgradeAndAdd(is, value);
+    } else {
+        /*
+         * Abort if the value is already present in the set.
+         * This call will populate "pos" with the right position to insert
+         * the value when it cannot be found.
+        */
+        // 在整数集合中查找 value ，看他是否存在：
+        // - 如果存在，那么将 *success 设置为 0 ，并返回未经改动的整数集合
+        // - 如果不存在，那么可以插入 value 的位置将被保存到 pos 指针中
+        if (intsetSearch(is, value, &pos)) {
+            if (success) *success = 0;
+            return is;
+        }
+
+        // 为 value 在集合中分配空间
+        is = _intsetResize(is, intrev32ifbe(is->length) + 1);
+
+        // 如果新元素不是被添加到底层数组的末尾
+        // 那么需要对现有元素的数据进行移动，空出 pos 上的位置，用于设置新值
+        if (pos < intrev32ifbe(is->length)) intsetMoveTail(is, pos, pos + 1);
+    }
+
+    // 将新值设置到底层数组的指定位置中
+    _intsetSet(is, pos, value);
+
+    // 增一集合元素数量的计数器
+    is->length = intrev32ifbe(intrev32ifbe(is->length) + 1);
+
+    return is;
+}
+
+/*
+ * Move count values from position from to position to, the ranges may
+ * overlap. Same as intsetMoveTail() but for a block in the middle.
+ *
+ * T = O(N)
+*/
+static void _intsetMoveBlock(intset *is, uint32_t from, uint32_t to, uint32_t count) {
+    uint32_t enc = intrev32ifbe(is->encoding);
+
+    memmove(is->contents + (size_t)to * enc, is->contents + (size_t)from * enc,
+            (size_t)count * enc);
+}
+
+/* qsort() comparator for int64_t values */
+static int _intsetCompareInt64(const void *a, const void *b) {
+    int64_t va = *(const int64_t*)a, vb = *(const int64_t*)b;
+
+    return (va > vb) - (va < vb);
+}
+
+/*
+ * Insert a batch of integers in the intset, the way SADD with many members
+ * does.
+ *
+ * Calling intsetAdd() for every value costs a search, a memmove() and a
+ * zrealloc() per value, that is O(N^2) bytes moved to build a set. Here
+ * the batch is sorted and deduplicated, the encoding is upgraded at most
+ * once, the intset is resized once, and old and new values are merged in
+ * a single backward pass, so no value is ever moved twice.
+ *
+ * If added is not NULL it is set to the number of values actually added.
+ *
+ * T = O(M log M + N + M), M being the batch size
+*/
+/*
+ * 将一批整数添加到整数集合中，例如带有多个成员的 SADD
+ *
+ * 对每个值调用 intsetAdd() 需要一次查找、一次 memmove() 和一次 zrealloc()，
+ * 构建一个集合总共要移动 O(N^2) 字节
+ * 这里先对这批值进行排序和去重，编码最多升级一次，集合只调整一次大小，
+ * 然后从后向前一次归并新旧元素，每个元素只会被移动一次
+ *
+ * 如果 added 不为 NULL，那么它被设为实际添加的元素数量
+*/
+intset *intsetAddMany(intset *is, const int64_t *values, uint32_t count, uint32_t *added) {
+    uint8_t curenc, newenc;
+    uint32_t len, n, j, i, k, pos, newcount = 0;
+    int64_t *batch;
+
+    if (added) *added = 0;
+    if (count == 0) return is;
+
+    // 压缩编码的集合先解压
+    is = intsetUnpack(is);
+    curenc = newenc = intrev32ifbe(is->encoding);
+    len = intrev32ifbe(is->length);
+
+    // 复制、排序并去重
+    batch = zmalloc(sizeof(int64_t) * count);
+    memcpy(batch, values, sizeof(int64_t) * count);
+    qsort(batch, count, sizeof(int64_t), _intsetCompareInt64);
+    for (n = 1, j = 1; j < count; j++) {
+        if (batch[j] != batch[n - 1]) batch[n++] = batch[j];
+    }
+
+    // 批量中的最小值和最大值决定升级后的编码
+    if (_intsetValueEncoding(batch[0]) > newenc) newenc = _intsetValueEncoding(batch[0]);
+    if (_intsetValueEncoding(batch[n - 1]) > newenc) newenc = _intsetValueEncoding(batch[n - 1]);
+
+    // 统计真正需要添加的元素数量
+    for (j = 0; j < n; j++) {
+        if (_intsetValueEncoding(batch[j]) > curenc || !intsetSearch(is, batch[j], NULL)) {
+            newcount++;
+        }
+    }
+    if (newcount == 0) {
+        zfree(batch);
+        return is;
+    }
+
+    // 只升级编码一次，只调整大小一次
+    is->encoding = intrev32ifbe(newenc);
+    is = _intsetResize(is, len + newcount);
+
+    i = len;
+    j = n;
+    k = len + newcount;
+    if (newenc == curenc) {
+        /*
+         * Same encoding: for every batch value, from the biggest, find its
+         * place among the old values still to be merged and move the
+         * whole block of old values after it with a single memmove().
+        */
+        // 编码不变：从最大的值开始，找到它在尚未归并的旧元素中的位置，
+        // 然后用一次 memmove() 移动位于它之后的整块旧元素
+        while (j > 0) {
+            int64_t v = batch[--j];
+            uint8_t found;
+
+            is->length = intrev32ifbe(i);
+            found = intsetSearch(is, v, &pos);
+            if (pos < i) {
+                k -= i - pos;
+                is->length = intrev32ifbe(i);
+                _intsetMoveBlock(is, pos, k, i - pos);
+            }
+            i = pos;
+            if (!found) _intsetSet(is, --k, v);
+        }
+    } else {
+        /*
+         * The encoding changes, so every old value has to be rewritten
+         * anyway. Merge from the back: the write position k never goes
+         * below the number of values still to be read, so with the wider
+         * encoding the writes never overwrite a value that wasn't read yet.
+        */
+        // 编码升级，所有旧元素都需要重写：从后向前归并，
+        // 写入位置 k 总是不小于尚未读取的元素数量，
+        // 因此即使编码变宽，也不会覆盖尚未读取的元素
+        while (k > 0) {
+            int64_t cur = i > 0 ? _intsetGetEncoded(is, i - 1, curenc) : 0;
+
+            if (j == 0 || (i > 0 && cur > batch[j - 1])) {
+                _intsetSet(is, --k, cur);
+                i--;
+            } else if (i > 0 && cur == batch[j - 1]) {
+                // 已经存在的值只保留一份
+                _intsetSet(is, --k, cur);
+                i--;
+                j--;
+            } else {
+                _intsetSet(is, --k, batch[j - 1]);
+                j--;
+            }
+        }
+    }
+
+    is->length = intrev32ifbe(len + newcount);
+    if (added) *added = newcount;
+    zfree(batch);
+    return is;
+}
+
+/*
+ * Delete integer from intset
+ *
+ * 从整数集合中删除值 value
+ *
+ * *success 的值指示删除是否成功：
+ * - 因值不存在而造成删除失败时该值为 0
+ * - 删除成功时该值为 1
+ *
+ * T = O(N)
+*/
+intset *intsetRemove(intset *is, int64_t value, int *success) {
+    // 计算 value 的编码方式
+    uint8_t valenc = _intsetValueEncoding(value);
+    uint32_t pos;
+
+    // 默认设置标识值为删除失败
+    if (success) *success = 0;
+
+    // 压缩编码的集合先解压
+    is = intsetUnpack(is);
+
+    // 当 value 的编码大小小于或等于集合的当前编码方式（说明 value 有可能存在于集合）
+    // 并且 intsetSearch 的结果为真，那么执行删除
+    if (valenc <= intrev32ifbe(is->encoding) && intsetSearch(is, value, &pos)) {
+        // 取出集合当前的元素数量
+        uint32_t len = intrev32ifbe(is->length);
+
+        /* We know we can delete */
+        // 设置标识值为删除成功
+        if (success) *success = 1;
+
+        /* Overwrite value with tail and update length */
+        // 如果 value 不是位于数组的末尾
+        // 那么需要对原本位于 value 之后的元素进行移动
+        if (pos < (len - 1)) intsetMoveTail(is, pos + 1, pos);
+
+        // 缩小数组的大小，移除被删除元素占用的空间
+        is = _intsetResize(is, len - 1);
+
+        // 更新集合的元素数量
+        is->length = intrev32ifbe(len - 1);
+    }
+
+    return is;
+}
+
+/*
+ * Determine whether a value belongs to this set
+ *
+ * 检查给定值 value 是否集合中的元素
+ *
+ * 是返回 1 ，不是返回 0
+ *
+ * T = O(log N)
+*/
+uint8_t intsetFind(intset *is, int64_t value) {
+    // 计算 value 的编码
+    uint8_t valenc = _intsetValueEncoding(value);
+
+    if (intsetIsPacked(is)) return _intsetPackedFind(is, value);
+
+    // 如果 value 的编码大于集合的当前编码，那么 value 一定不存在于集合
+    // 当 value 的编码小于等于集合的当前编码时，
+    // 才再使用 intsetSearch 进行查找
+    return valenc <= intrev32ifbe(is->encoding) && intsetSearch(is, value, NULL);
+}
+
+/*
+ * Batched membership test, meant for SMISMEMBER style probes.
+ *
+ * results[j] is set to 1 if values[j] belongs to the set, 0 otherwise.
+ *
+ * Probes are processed INTSET_FIND_BATCH at a time and their binary
+ * searches advance in lockstep: the memory loads of independent probes
+ * overlap instead of waiting on each other, which matters once the set
+ * no longer fits in the L1 cache.
+ *
+ * T = O(M log N), M being the number of probes
+*/
+/*
+ * 批量成员检查，用于 SMISMEMBER 一类的批量探测
+ *
+ * 如果 values[j] 是集合的成员，那么 results[j] 被设为 1，否则设为 0
+ *
+ * 每次处理 INTSET_FIND_BATCH 个探测值，它们的二分查找同步推进，
+ * 这样不同探测值之间的内存访问可以重叠进行，而不是互相等待
+*/
+#define INTSET_FIND_BATCH 8
+
+void intsetFindMulti(intset *is, const int64_t *values, uint32_t count, uint8_t *results) {
+    uint32_t len = intrev32ifbe(is->length);
+    uint32_t j = 0;
+
+#ifdef INTSET_TYPED_SEARCH
+    uint32_t enc = intrev32ifbe(is->encoding);
+
+    // 小集合的线性扫描本身已经足够快，只有大集合才需要同步推进
+    // 压缩编码的集合逐个查找
+    if (!intsetIsPacked(is) && len * enc > INTSET_LINEAR_BYTES) {
+        for (; j + INTSET_FIND_BATCH <= count; j += INTSET_FIND_BATCH) {
+            uint32_t base[INTSET_FIND_BATCH], n = len, k;
+
+            for (k = 0; k < INTSET_FIND_BATCH; k++) base[k] = 0;
+
+            // 所有探测值的二分查找同步推进，每一轮的区间长度都相同
+            while (n > 1) {
+                uint32_t half = n >> 1;
+                for (k = 0; k < INTSET_FIND_BATCH; k++) {
+                    int64_t probe = values[j + k];
+                    base[k] = (_intsetGet(is, base[k] + half) < probe) ?
+                              base[k] + half : base[k];
+                }
+                n -= half;
+            }
+
+            for (k = 0; k < INTSET_FIND_BATCH; k++) {
+                int64_t probe = values[j + k];
+                uint32_t p = base[k] + (_intsetGet(is, base[k]) < probe);
+                results[j + k] = p < len && _intsetGet(is, p) == probe;
+            }
+        }
+    }
+#endif
+
+    // 剩余的探测值逐个处理
+    for (; j < count; j++) results[j] = intsetFind(is, values[j]);
+}
+
+/*
+ * Return random member
+ *
+ * 从整数集合中随机返回一个元素
+ *
+ * 只能在集合非空时使用
+ *
+ * T = O(1)
+*/
+int64_t intsetRandom(intset *is) {
+    int64_t value;
+
+    intsetGet(is, rand() % intrev32ifbe(is->length), &value);
+    return value;
+}
+
+/*
+ * Sets the value to the value at the given position. When this position
+ * is out of range the function returns 0, when in range it returns 1.
+ *
+ * 取出集合底层数组指定位置中的值，并将它保存到 value 指针中
+ *
+ * 如果 pos 没超出数组的索引范围，那么返回 1 ，如果超出索引，那么返回 0
+ *
+ * T = O(1)
+*/
+uint8_t intsetGet(intset *is, uint32_t pos, int64_t *value) {
+    if (pos < intrev32ifbe(is->length)) {
+        *value = intsetIsPacked(is) ? _intsetPackedGet(is, pos) : _intsetGet(is, pos);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Return intset length
+ *
+ * 返回整数集合现有的元素个数
+ *
+ * T = O(1)
+*/
+uint32_t intsetLen(intset *is) {
+    return intrev32ifbe(is->length);
+}
+
+/*
+ * Return intset blob size in bytes.
+ *
+ * 返回整数集合现在占用的字节总数量
+ * 这个数量包括整数集合的结构大小，以及整数集合所有元素的总大小
+ * 对于压缩编码的集合，还包括跳跃索引的大小
+ *
+ * T = O(1)
+*/
+size_t intsetBlobLen(intset *is) {
+    if (intsetIsPacked(is)) {
+        intsetPackHeader *hdr = _intsetPackHeader(is);
+        return sizeof(intset) + sizeof(intsetPackHeader) +
+               hdr->nblocks * sizeof(intsetPackBlock) +
+               (size_t)hdr->datawords * sizeof(uint64_t);
+    }
+    return sizeof(intset) + intrev32ifbe(is->length) * intrev32ifbe(is->encoding);
+}
+
+/* ------------------------- Set algebra ---------------------------------- */
+
+/*
+ * Native intset to intset SINTER / SUNION / SDIFF kernels. They produce a
+ * new intset directly instead of probing elements one by one.
+ *
+ * Operands with different encodings are merged by widening every element
+ * to int64 as it is read, so no operand is ever upgraded or copied. The
+ * result uses the narrowest encoding that can hold it a priori: the
+ * smaller of the two for the intersection, the bigger for the union and
+ * the encoding of the first set for the difference.
+ *
+ * When one set is more than INTSET_GALLOP_RATIO times larger than the
+ * other we walk the small one and gallop (exponential then binary search)
+ * in the large one. Similar sizes use a linear merge, that for same
+ * encoding int16/int32 operands is vectorized with SSE2: blocks of the two
+ * sets are compared all against all by rotating one of them (the scheme
+ * described by Lemire et al. for sorted integer intersection).
+*/
+/*
+ * 整数集合之间的交集、并集、差集运算，直接生成新的整数集合，
+ * 不需要逐个元素进行探测
+ *
+ * 编码不同的两个集合在读取元素时就地扩展为 int64 进行合并，
+ * 不会对任何一个集合进行升级或复制
+ * 结果集合事先选择能容纳结果的编码：交集取较小的编码，
+ * 并集取较大的编码，差集使用第一个集合的编码
+ *
+ * 当一个集合比另一个大 INTSET_GALLOP_RATIO 倍以上时，
+ * 遍历小集合，并在大集合中进行跳跃查找（先指数查找再二分查找）；
+ * 大小相近时使用线性归并，两个集合同为 int16 或 int32 编码时
+ * 使用 SSE2 向量化：通过旋转其中一个块，将两个块中的元素两两比较
+ * （即 Lemire 等人描述的有序整数求交方法）
+*/
+#define INTSET_GALLOP_RATIO 32
+
+/* Create an empty intset with the given encoding and room for len values */
+static intset *_intsetNewWithCapacity(uint8_t enc, uint32_t len) {
+    intset *is = zmalloc(sizeof(intset) + (size_t)len * enc);
+
+    is->encoding = intrev32ifbe(enc);
+    is->length = 0;
+    return is;
+}
+
+/* Append a value known to be bigger than every element already present */
+static void _intsetAppend(intset *is, int64_t value) {
+    uint32_t len = intrev32ifbe(is->length);
+
+    _intsetSet(is, len, value);
+    is->length = intrev32ifbe(len + 1);
+}
+
+/* Release the unused capacity of a result built with _intsetAppend() */
+static intset *_intsetShrinkToFit(intset *is) {
+    return _intsetResize(is, intrev32ifbe(is->length));
+}
+
+/*
+ * Return the first position >= from holding a value >= value, or len.
+ * Exponential probing first, then binary search in the last gap.
+ *
+ * T = O(log D), D being the distance from 'from' to the result
+*/
+/*
+ * 返回从 from 开始第一个值大于等于 value 的位置，不存在时返回 len
+ * 先进行指数探测，再在最后一个区间中二分查找
+*/
+static uint32_t _intsetGallop(intset *is, uint8_t enc, uint32_t from,
+                              uint32_t len, int64_t value) {
+    uint32_t lo = from, hi, step = 1;
+
+    if (lo >= len || _intsetGetEncoded(is, lo, enc) >= value) return lo;
+
+    // 指数探测，直到越过 value 或到达数组末尾
+    hi = lo + step;
+    while (hi < len && _intsetGetEncoded(is, hi, enc) < value) {
+        lo = hi;
+        step <<= 1;
+        hi = lo + step;
+    }
+    if (hi > len) hi = len;
+
+    // 此时 is[lo] < value <= is[hi]，在 (lo, hi] 中二分查找
+    while (lo + 1 < hi) {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+        if (_intsetGetEncoded(is, mid, enc) < value) lo = mid;
+        else hi = mid;
+    }
+    return hi;
+}
+
+#if defined(__SSE2__) && defined(INTSET_TYPED_SEARCH)
+/*
+ * SSE2 block intersection of two int32 arrays, appending the matches to
+ * out. Returns the number of matches and stores in *ia / *ib how far the
+ * two arrays were consumed, the scalar merge takes care of the rest.
+*/
+/*
+ * 使用 SSE2 对两个 int32 数组按块求交，匹配的元素追加到 out 中
+ * 返回匹配数量，*ia 和 *ib 记录两个数组被处理到的位置，剩余部分由标量归并处理
+*/
+static uint32_t _intsetIntersect32SSE(const int32_t *a, uint32_t alen,
+                                      const int32_t *b, uint32_t blen,
+                                      int32_t *out, uint32_t *ia, uint32_t *ib) {
+    uint32_t i = 0, j = 0, count = 0;
+
+    while (i + 4 <= alen && j + 4 <= blen) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        int32_t amax = a[i + 3], bmax = b[j + 3];
+
+        // 将 vb 旋转三次，使 va 的每个元素和 vb 的每个元素都比较一次
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0,3,2,1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1,0,3,2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2,1,0,3)))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+
+        // 按顺序输出 va 中匹配的元素
+        while (mask) {
+            out[count++] = a[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+
+        // 最大值较小的块已经处理完毕，向前推进
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+    *ia = i;
+    *ib = j;
+    return count;
+}
+
+/*
+ * Same as above for int16 arrays, 8 elements per block. SSE2 has no 16 bit
+ * lane shuffle, so vb is rotated with a pair of byte shifts.
+*/
+/*
+ * 同上，处理 int16 数组，每块 8 个元素
+ * SSE2 没有 16 位通道的混洗指令，因此用两次字节移位来旋转 vb
+*/
+#define INTSET_ROTATE16(v, n) \
+    _mm_or_si128(_mm_srli_si128((v), 2 * (n)), _mm_slli_si128((v), 16 - 2 * (n)))
+
+static uint32_t _intsetIntersect16SSE(const int16_t *a, uint32_t alen,
+                                      const int16_t *b, uint32_t blen,
+                                      int16_t *out, uint32_t *ia, uint32_t *ib) {
+    uint32_t i = 0, j = 0, count = 0;
+
+    while (i + 8 <= alen && j + 8 <= blen) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        int16_t amax = a[i + 7], bmax = b[j + 7];
+        __m128i eq = _mm_cmpeq_epi16(va, vb);
+        int mask;
+
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 1)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 2)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 3)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 4)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 5)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 6)));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi16(va, INTSET_ROTATE16(vb, 7)));
+
+        // 每个 16 位元素对应掩码中的两个位，只保留低位
+        mask = _mm_movemask_epi8(eq) & 0x5555;
+        while (mask) {
+            out[count++] = a[i + (__builtin_ctz(mask) >> 1)];
+            mask &= mask - 1;
+        }
+
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+    }
+    *ia = i;
+    *ib = j;
+    return count;
+}
+#endif
+
+/*
+ * Run a set operation on packed operands through plain copies of them.
+ * The kernels below work on the fixed width encodings only.
+ *
+ * T = O(N + M)
+*/
+/*
+ * 通过普通编码的副本对压缩编码的集合执行集合运算
+ * 下面的运算函数只处理定长编码
+*/
+static intset *_intsetPackedOp(intset *a, intset *b, intset *(*op)(intset*, intset*)) {
+    intset *pa = a, *pb = b, *res;
+
+    if (intsetIsPacked(a)) {
+        pa = zmalloc(intsetBlobLen(a));
+        memcpy(pa, a, intsetBlobLen(a));
+        pa = intsetUnpack(pa);
+    }
+    if (intsetIsPacked(b)) {
+        pb = zmalloc(intsetBlobLen(b));
+        memcpy(pb, b, intsetBlobLen(b));
+        pb = intsetUnpack(pb);
+    }
+    res = op(pa, pb);
+    if (pa != a) zfree(pa);
+    if (pb != b) zfree(pb);
+    return res;
+}
+
+/*
+ * Return a new intset with the elements present in both a and b
+ *
+ * 返回一个新的整数集合，包含同时存在于 a 和 b 中的元素
+ *
+ * T = O(N + M), or O(N log(M / N)) when the sizes are skewed
+*/
+intset *intsetIntersect(intset *a, intset *b) {
+    uint8_t enca, encb;
+    uint32_t alen, blen, i = 0, j = 0;
+    intset *res;
+
+    if (intsetIsPacked(a) || intsetIsPacked(b)) return _intsetPackedOp(a, b, intsetIntersect);
+
+    // 总是让 a 指向较小的集合
+    if (intrev32ifbe(a->length) > intrev32ifbe(b->length)) {
+        intset *tmp = a; a = b; b = tmp;
+    }
+    enca = intrev32ifbe(a->encoding);
+    encb = intrev32ifbe(b->encoding);
+    alen = intrev32ifbe(a->length);
+    blen = intrev32ifbe(b->length);
+
+    res = _intsetNewWithCapacity(enca < encb ? enca : encb, alen);
+    if (alen == 0) return _intsetShrinkToFit(res);
+
+    // 大小悬殊：遍历小集合，在大集合中跳跃查找
+    if ((uint64_t)alen * INTSET_GALLOP_RATIO < blen) {
+        for (i = 0; i < alen && j < blen; i++) {
+            int64_t v = _intsetGetEncoded(a, i, enca);
+            j = _intsetGallop(b, encb, j, blen, v);
+            if (j < blen && _intsetGetEncoded(b, j, encb) == v) {
+                _intsetAppend(res, v);
+                j++;
+            }
+        }
+        return _intsetShrinkToFit(res);
+    }
+
+#if defined(__SSE2__) && defined(INTSET_TYPED_SEARCH)
+    // 编码相同时，先使用向量化的块求交
+    if (enca == encb && enca == INTSET_ENC_INT32) {
+        res->length = _intsetIntersect32SSE((int32_t*)a->contents, alen,
+            (int32_t*)b->contents, blen, (int32_t*)res->contents, &i, &j);
+    } else if (enca == encb && enca == INTSET_ENC_INT16) {
+        res->length = _intsetIntersect16SSE((int16_t*)a->contents, alen,
+            (int16_t*)b->contents, blen, (int16_t*)res->contents, &i, &j);
+    }
+#endif
+
+    // 标量归并处理剩余部分（以及不同编码或 int64 编码的情况）
+    while (i < alen && j < blen) {
+        int64_t va = _intsetGetEncoded(a, i, enca);
+        int64_t vb = _intsetGetEncoded(b, j, encb);
+
+        if (va < vb) {
+            i++;
+        } else if (va > vb) {
+            j++;
+        } else {
+            _intsetAppend(res, va);
+            i++;
+            j++;
+        }
+    }
+    return _intsetShrinkToFit(res);
+}
+
+/*
+ * Return a new intset with the elements present in a or b
+ *
+ * 返回一个新的整数集合，包含存在于 a 或 b 中的元素
+ *
+ * T = O(N + M)
+*/
+intset *intsetUnion(intset *a, intset *b) {
+    uint8_t enca, encb;
+    uint32_t alen, blen, i = 0, j = 0;
+    intset *res;
+
+    if (intsetIsPacked(a) || intsetIsPacked(b)) return _intsetPackedOp(a, b, intsetUnion);
+
+    enca = intrev32ifbe(a->encoding);
+    encb = intrev32ifbe(b->encoding);
+    alen = intrev32ifbe(a->length);
+    blen = intrev32ifbe(b->length);
+    res = _intsetNewWithCapacity(enca > encb ? enca : encb, alen + blen);
+
+    // 归并两个有序数组，相同的元素只保留一个
+    while (i < alen && j < blen) {
+        int64_t va = _intsetGetEncoded(a, i, enca);
+        int64_t vb = _intsetGetEncoded(b, j, encb);
+
+        if (va < vb) {
+            _intsetAppend(res, va);
+            i++;
+        } else if (va > vb) {
+            _intsetAppend(res, vb);
+            j++;
+        } else {
+            _intsetAppend(res, va);
+            i++;
+            j++;
+        }
+    }
+
+    // 复制较长集合的剩余部分
+    for (; i < alen; i++) _intsetAppend(res, _intsetGetEncoded(a, i, enca));
+    for (; j < blen; j++) _intsetAppend(res, _intsetGetEncoded(b, j, encb));
+
+    return _intsetShrinkToFit(res);
+}
+
+/*
+ * Return a new intset with the elements of a that are not in b
+ *
+ * 返回一个新的整数集合，包含存在于 a 但不存在于 b 中的元素
+ *
+ * T = O(N + M), or O(N log(M / N)) when b is much larger than a
+*/
+intset *intsetDifference(intset *a, intset *b) {
+    uint8_t enca, encb;
+    uint32_t alen, blen, i, j = 0;
+    int gallop;
+    intset *res;
+
+    if (intsetIsPacked(a) || intsetIsPacked(b)) return _intsetPackedOp(a, b, intsetDifference);
+
+    enca = intrev32ifbe(a->encoding);
+    encb = intrev32ifbe(b->encoding);
+    alen = intrev32ifbe(a->length);
+    blen = intrev32ifbe(b->length);
+    gallop = (uint64_t)alen * INTSET_GALLOP_RATIO < blen;
+    res = _intsetNewWithCapacity(enca, alen);
+
+    for (i = 0; i < alen; i++) {
+        int64_t va = _intsetGetEncoded(a, i, enca);
+
+        // b 远大于 a 时跳跃查找，否则线性推进
+        if (gallop) {
+            j = _intsetGallop(b, encb, j, blen, va);
+        } else {
+            while (j < blen && _intsetGetEncoded(b, j, encb) < va) j++;
+        }
+        if (j == blen || _intsetGetEncoded(b, j, encb) != va) {
+            _intsetAppend(res, va);
+        }
+    }
+    return _intsetShrinkToFit(res);
+}
+
+// 测试部分
+#ifdef INTSET_TEST_MAIN
+#include <sys/time.h>
+#include <time.h>
+#include <assert.h>
+#include "testhelp.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
+/* Build a set of len values with the requested encoding, spaced by step */
+static intset *createSet(int64_t first, int64_t step, uint32_t len) {
+    intset *is = intsetNew();
+    uint32_t j;
+
+    for (j = 0; j < len; j++) is = intsetAdd(is, first + step * j, NULL);
+    return is;
+}
+
+static void checkConsistency(intset *is) {
+    uint32_t i;
+
+    for (i = 0; i < (intrev32ifbe(is->length) - 1); i++) {
+        assert(_intsetGet(is, i) < _intsetGet(is, i + 1));
+    }
+}
+
+int main(void) {
+    uint8_t success;
+    int i;
+    intset *is;
+
+    srand(time(NULL));
+
+    {
+        is = intsetNew();
+        is = intsetAdd(is, 32, NULL);
+        is = intsetAdd(is, 65535, NULL);
+        is = intsetAdd(is, 4294967295LL, NULL);
+        test_cond("Upgrade from int16 to int64 ",
+            intrev32ifbe(is->encoding) == INTSET_ENC_INT64 &&
+            intsetFind(is, 32) && intsetFind(is, 65535) &&
+            intsetFind(is, 4294967295LL));
+        checkConsistency(is);
+        zfree(is);
+    }
+
+    {
+        is = intsetNew();
+        is = intsetAdd(is, 5, &success); assert(success);
+        is = intsetAdd(is, 6, &success); assert(success);
+        is = intsetAdd(is, 4, &success); assert(success);
+        is = intsetAdd(is, 4, &success);
+        test_cond("Add duplicate value ", !success && intsetLen(is) == 3);
+        zfree(is);
+    }
+
+    {
+        is = intsetNew();
+        for (i = 0; i < 1024; i++) is = intsetAdd(is, rand() % 0x800, NULL);
+        checkConsistency(is);
+        for (i = -1; i < 0x801; i++) {
+            uint32_t pos, gpos;
+            uint8_t found = intsetSearch(is, i, &pos);
+            if (found != _intsetSearchGeneric(is, i, &gpos) || pos != gpos) break;
+        }
+        test_cond("Search engine agrees with the generic search ", i == 0x801);
+        zfree(is);
+    }
+
+    {
+        int64_t probes[1000];
+        uint8_t res[1000];
+        int ok = 1;
+
+        is = createSet(-70000, 3, 20000);
+        for (i = 0; i < 1000; i++) probes[i] = -70000 + rand() % 60000;
+        intsetFindMulti(is, probes, 1000, res);
+        for (i = 0; i < 1000; i++) ok &= (res[i] == intsetFind(is, probes[i]));
+        test_cond("intsetFindMulti() agrees with intsetFind() ", ok);
+        zfree(is);
+    }
+
+    {
+        is = intsetNew();
+        for (i = 0; i < 100; i++) is = intsetAdd(is, i, NULL);
+        for (i = 0; i < 100; i += 2) is = intsetRemove(is, i, NULL);
+        test_cond("Remove even values ",
+            intsetLen(is) == 50 && !intsetFind(is, 0) && intsetFind(is, 99));
+        checkConsistency(is);
+        zfree(is);
+    }
+
+    {
+        intset *a = createSet(-3000, 7, 3000), *b = createSet(-5000, 3, 8000);
+        intset *c = createSet(10000000000LL, 1, 10), *r;
+        int64_t v = 0;
+        uint32_t inter = 0, diff = 0;
+        int ok = 1;
+
+        for (i = 0; i < 3000; i++) {
+            if (intsetFind(b, -3000 + 7 * i)) inter++; else diff++;
+        }
+        r = intsetIntersect(a, b);
+        test_cond("intsetIntersect() of int16 sets ", intsetLen(r) == inter);
+        for (i = 0; i < (int)intsetLen(r); i++) {
+            intsetGet(r, i, &v);
+            ok &= intsetFind(a, v) && intsetFind(b, v);
+        }
+        zfree(r);
+        r = intsetDifference(a, b);
+        test_cond("intsetDifference() of int16 sets ", intsetLen(r) == diff);
+        zfree(r);
+        r = intsetUnion(a, b);
+        test_cond("intsetUnion() of int16 sets ",
+            intsetLen(r) == intsetLen(a) + intsetLen(b) - inter);
+        checkConsistency(r);
+        zfree(r);
+        r = intsetUnion(a, c);
+        test_cond("intsetUnion() of mixed encodings widens the result ",
+            intrev32ifbe(r->encoding) == INTSET_ENC_INT64 &&
+            intsetLen(r) == 3010 && intsetFind(r, -3000));
+        zfree(r);
+        r = intsetIntersect(a, c);
+        test_cond("intsetIntersect() of disjoint sets is empty ", intsetLen(r) == 0);
+        zfree(r);
+        test_cond("Intersection members belong to both sets ", ok);
+        zfree(a);
+        zfree(b);
+        zfree(c);
+    }
+
+    /*
+     * Set algebra benchmark: the element by element loop that probes b
+     * for every member of a, against the native kernels, for similar and
+     * skewed sizes.
+    */
+    {
+        static const uint32_t sizes[2][2][2] = {
+            {{10000, 10000}, {300, 20000}},         /* int16 */
+            {{100000, 100000}, {1000, 1000000}}     /* int32 */
+        };
+        static const int64_t firsts[] = {-30000, 100000};
+        unsigned int e, s;
+
+        for (e = 0; e < 2; e++) {
+            for (s = 0; s < 2; s++) {
+                intset *a = createSet(firsts[e], 2, sizes[e][s][0]);
+                intset *b = createSet(firsts[e], 3, sizes[e][s][1]);
+                intset *r = intsetNew();
+                long long start;
+                uint32_t j;
+
+                start = usec();
+                for (j = 0; j < intsetLen(a); j++) {
+                    int64_t v = _intsetGet(a, j);
+                    if (intsetFind(b, v)) r = intsetAdd(r, v, NULL);
+                }
+                printf("%s %u x %u: loop inter %lld usec, ", e ? "int32" : "int16",
+                    sizes[e][s][0], sizes[e][s][1], usec() - start);
+                zfree(r);
+
+                start = usec();
+                r = intsetIntersect(a, b);
+                printf("intsetIntersect %lld usec, ", usec() - start);
+                zfree(r);
+
+                start = usec();
+                r = intsetUnion(a, b);
+                printf("intsetUnion %lld usec, ", usec() - start);
+                zfree(r);
+
+                start = usec();
+                r = intsetDifference(a, b);
+                printf("intsetDifference %lld usec\n", usec() - start);
+                zfree(r);
+                zfree(a);
+                zfree(b);
+            }
+        }
+    }
+
+    {
+        int64_t values[] = {5, -3, 70000, 5, 12, -3, 1};
+        uint32_t added;
+
+        is = intsetNew();
+        is = intsetAdd(is, 12, NULL);
+        is = intsetAdd(is, 100, NULL);
+        is = intsetAddMany(is, values, sizeof(values) / sizeof(values[0]), &added);
+        test_cond("intsetAddMany() sorts, dedupes and upgrades once ",
+            added == 4 && intsetLen(is) == 6 &&
+            intrev32ifbe(is->encoding) == INTSET_ENC_INT32 &&
+            intsetFind(is, -3) && intsetFind(is, 70000) && intsetFind(is, 100));
+        checkConsistency(is);
+        zfree(is);
+    }
+
+    {
+        int64_t values[3000];
+        intset *ref = intsetNew();
+        int ok = 1;
+
+        is = intsetNew();
+        for (i = 0; i < 20; i++) {
+            int j;
+            for (j = 0; j < 3000; j++) {
+                values[j] = (rand() % 2) ? rand() % 5000 : ((int64_t)rand() << 20);
+                ref = intsetAdd(ref, values[j], NULL);
+            }
+            is = intsetAddMany(is, values, 3000, NULL);
+        }
+        ok = intsetLen(is) == intsetLen(ref) &&
+             intsetBlobLen(is) == intsetBlobLen(ref) &&
+             memcmp(is->contents, ref->contents, intsetBlobLen(is) - sizeof(intset)) == 0;
+        test_cond("intsetAddMany() matches repeated intsetAdd() ", ok);
+        zfree(is);
+        zfree(ref);
+    }
+
+    {
+        intset *plain = intsetNew(), *r;
+        int64_t v = 9000000000LL, got;
+        uint32_t len, j;
+        int ok = 1;
+
+        // 聚集在 9e9 附近的 ID，间隔随机，偶尔有较大的跳跃
+        for (j = 0; j < 5000; j++) {
+            v += 1 + rand() % ((j % 700 == 0) ? 1000000 : 50);
+            plain = intsetAdd(plain, v, NULL);
+        }
+        len = intsetLen(plain);
+        is = zmalloc(intsetBlobLen(plain));
+        memcpy(is, plain, intsetBlobLen(plain));
+        is = intsetPack(is);
+        test_cond("intsetPack() shrinks clustered int64 sets ",
+            intsetIsPacked(is) && intsetBlobLen(is) * 4 < intsetBlobLen(plain));
+
+        for (j = 0; j < len; j++) {
+            int64_t want = 0;
+            intsetGet(plain, j, &want);
+            if (!intsetGet(is, j, &got) || got != want || !intsetFind(is, want) ||
+                intsetFind(is, want + 1) != intsetFind(plain, want + 1)) ok = 0;
+        }
+        test_cond("Packed set lookups match the plain set ",
+            ok && !intsetFind(is, 0) && !intsetFind(is, v + 1) && intsetLen(is) == len);
+
+        r = intsetIntersect(is, plain);
+        test_cond("Set algebra accepts packed operands ", intsetLen(r) == len);
+        zfree(r);
+
+        is = intsetAdd(is, v + 1, &success);
+        test_cond("Mutating a packed set unpacks it ",
+            success && !intsetIsPacked(is) && intsetLen(is) == len + 1 &&
+            memcmp(is->contents, plain->contents, len * sizeof(int64_t)) == 0);
+        zfree(is);
+
+        // 值分布稀疏时压缩无法节省足够的空间
+        is = createSet(0, 1LL << 40, 1000);
+        test_cond("intsetPack() keeps sets it can't shrink ",
+            !intsetIsPacked(intsetPack(is)));
+        zfree(is);
+        zfree(plain);
+    }
+
+    /*
+     * SADD with many integer members: one intsetAdd() per member against
+     * a single intsetAddMany() call per command, for a large SADD and for
+     * batches of 100 members.
+    */
+    {
+        static const uint32_t batches[] = {100000, 1000, 100};
+        uint32_t total = 100000, b, j;
+        int64_t *values = zmalloc(sizeof(int64_t) * total);
+        long long start;
+
+        for (j = 0; j < total; j++) values[j] = rand() % 1000000;
+
+        for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            is = intsetNew();
+            start = usec();
+            for (j = 0; j < total; j++) is = intsetAdd(is, values[j], NULL);
+            printf("SADD %u members in batches of %u: intsetAdd %lld usec, ",
+                total, batches[b], usec() - start);
+            zfree(is);
+
+            is = intsetNew();
+            start = usec();
+            for (j = 0; j < total; j += batches[b]) {
+                is = intsetAddMany(is, values + j, batches[b], NULL);
+            }
+            printf("intsetAddMany %lld usec\n", usec() - start);
+            zfree(is);
+        }
+        zfree(values);
+    }
+
+    /*
+     * Packed encoding: size and intsetFind() speed of clustered int64
+     * IDs against the plain encoding, plus the full decode time.
+    */
+    {
+        static const uint32_t sizes[] = {1000, 100000, 1000000};
+        int64_t *probes = zmalloc(sizeof(int64_t) * 1000000);
+        unsigned int s;
+
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            intset *plain, *packed;
+            uint32_t len = sizes[s], hits = 0, phits = 0;
+            long long start;
+            int n = 1000000;
+
+            plain = createSet(9000000000LL, 7, len);
+            packed = zmalloc(intsetBlobLen(plain));
+            memcpy(packed, plain, intsetBlobLen(plain));
+            packed = intsetPack(packed);
+            for (i = 0; i < n; i++) probes[i] = 9000000000LL + rand() % (len * 7);
+
+            printf("packed %7u elements: %8zu -> %8zu bytes, ",
+                len, intsetBlobLen(plain), intsetBlobLen(packed));
+            start = usec();
+            for (i = 0; i < n; i++) hits += intsetFind(plain, probes[i]);
+            printf("plain %6lld usec, ", usec() - start);
+            start = usec();
+            for (i = 0; i < n; i++) phits += intsetFind(packed, probes[i]);
+            printf("packed %6lld usec, ", usec() - start);
+            assert(hits == phits);
+
+            start = usec();
+            packed = intsetUnpack(packed);
+            printf("unpack %lld usec\n", usec() - start);
+            assert(intsetBlobLen(packed) == intsetBlobLen(plain));
+            zfree(packed);
+            zfree(plain);
+        }
+        zfree(probes);
+    }
+
+    /*
+     * Lookup benchmark across encodings and sizes: the generic
+     * _intsetGet() based binary search against the specialised engine,
+     * then the batched intsetFindMulti().
+    */
+    {
+        static const uint32_t sizes[] = {16, 128, 1024, 16384, 262144};
+        static const int64_t steps[] = {1, 3, 70000};
+        static const char *names[] = {"int16", "int32", "int64"};
+        int64_t *probes = zmalloc(sizeof(int64_t) * 1000000);
+        uint8_t *res = zmalloc(1000000);
+        unsigned int e, s;
+
+        for (e = 0; e < 3; e++) {
+            for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                uint32_t len = sizes[s], hits = 0, ghits = 0;
+                int64_t first = (e == 0) ? -(int64_t)(len / 2) :
+                                (e == 1) ? 100000 : 10000000000LL;
+                int64_t step = (e == 0 && len > 32768) ? 0 : steps[e];
+                long long start;
+                int n = 1000000;
+
+                if (step == 0) continue;   /* doesn't fit int16 */
+                is = createSet(first, step, len);
+                for (i = 0; i < n; i++) {
+                    probes[i] = first + (rand() % len) * step + (rand() & 1);
+                }
+
+                start = usec();
+                for (i = 0; i < n; i++) ghits += _intsetSearchGeneric(is, probes[i], NULL);
+                printf("%s %7u elements: generic %6lld usec, ",
+                    names[e], len, usec() - start);
+
+                start = usec();
+                for (i = 0; i < n; i++) hits += intsetFind(is, probes[i]);
+                printf("intsetFind %6lld usec, ", usec() - start);
+                assert(hits == ghits);
+
+                start = usec();
+                intsetFindMulti(is, probes, n, res);
+                printf("intsetFindMulti %6lld usec (%u hits)\n",
+                    usec() - start, hits);
+                zfree(is);
+            }
+        }
+        zfree(probes);
+        zfree(res);
+    }
+
+    test_report();
+    return 0;
+}
+#endif
@@ -14,11 +14,19 @@ typedef struct intset {
 
 intset *intsetNew(void);
 intset *intsetAdd(intset *is, int64_t value, uint8_t *success);
+intset *intsetAddMany(intset *is, const int64_t *values, uint32_t count, uint32_t *added);
 intset *intsetRemove(intset *is, int64_t value, int *success);
 uint8_t intsetFind(intset *is, int64_t value);
+void intsetFindMulti(intset *is, const int64_t *values, uint32_t count, uint8_t *results);
+intset *intsetIntersect(intset *a, intset *b);
+intset *intsetUnion(intset *a, intset *b);
+intset *intsetDifference(intset *a, intset *b);
 int64_t intsetRandom(intset *is);
 uint8_t intsetGet(intset *is, uint32_t pos, int64_t *value);
 uint32_t intsetLen(intset *is);
 size_t intsetBlobLen(intset *is);
+intset *intsetPack(intset *is);
+intset *intsetUnpack(intset *is);
+void intsetSetPackMinSaving(double ratio);
 
 #endif // __INTSET_H__
\ No newline at end of file
@@ -0,0 +1,291 @@
+/*
+ * Lazy free: release big objects in a background thread.
+ *
+ * Freeing a set, sorted set or hash with millions of elements walks all
+ * of them, stalling the server for hundreds of milliseconds. When lazy
+ * freeing is enabled, decrRefCountLazy() hands the last reference to
+ * such objects to a reclamation thread instead, so the caller only pays
+ * for the unlink.
+ *
+ * The queue is bounded: when it is full, or the object is cheap to free,
+ * the object is freed synchronously as decrRefCount() would do. The
+ * reclamation thread frees memory concurrently with the main thread, so
+ * zmalloc is switched to its thread safe accounting by lazyfreeInit().
+ *
+ * Members of a freed object may still be referenced by other objects,
+ * whose reference counts are then updated from both threads: lazy
+ * freeing is disabled by default (server.lazyfree_enabled), and should
+ * only be enabled in builds with REDIS_ATOMIC_REFCOUNT.
+*/
+/*
+ * 惰性释放：在后台线程中释放大对象
+ *
+ * 释放包含几百万个元素的集合、有序集合或哈希需要遍历所有元素，会使服务器停顿几百毫秒
+ * 启用惰性释放时，decrRefCountLazy() 将这类对象的最后一个引用交给回收线程，
+ * 调用者只需要付出解除链接的代价
+ *
+ * 队列的长度是有限的：队列已满，或者对象的释放代价很小时，
+ * 像 decrRefCount() 一样同步释放对象
+ * 回收线程和主线程同时释放内存，因此 lazyfreeInit() 会将 zmalloc 切换为线程安全的统计方式
+ *
+ * 被释放对象的成员可能仍然被其他对象引用，它们的引用计数会被两个线程同时修改：
+ * 惰性释放默认是关闭的（server.lazyfree_enabled），只应该在使用 REDIS_ATOMIC_REFCOUNT 编译时启用
+*/
+
+#include <pthread.h>
+
+#include "redis.h"
+#include "intset.h"
+#include "roaring.h"
+
+// 等待释放的对象，以及它们的估计字节数，组成一个环形队列
+static robj *lazyfree_queue[REDIS_LAZYFREE_QUEUE_LEN];
+static size_t lazyfree_queue_bytes[REDIS_LAZYFREE_QUEUE_LEN];
+static unsigned long lazyfree_head = 0;     // 队头的位置
+static unsigned long lazyfree_len = 0;      // 队列中的对象数量
+
+// 统计信息，包括正在被回收线程释放的对象
+static unsigned long lazyfree_pending_objects = 0;
+static size_t lazyfree_pending_bytes = 0;
+static unsigned long long lazyfree_freed_objects = 0;
+
+static pthread_mutex_t lazyfree_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t lazyfree_job_cond = PTHREAD_COND_INITIALIZER;    // 有新的对象入队
+static pthread_cond_t lazyfree_done_cond = PTHREAD_COND_INITIALIZER;   // 没有等待释放的对象
+static pthread_t lazyfree_thread;
+static int lazyfree_started = 0;
+
+/*
+ * Return the number of allocations freeing the object takes, roughly
+ * the number of elements for the encodings that allocate each of them
+ * separately, and 1 for the packed ones.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回释放对象需要进行的释放操作数量：
+ * 对于单独分配每个元素的编码，大约是元素的数量，紧凑编码则为 1
+*/
+size_t lazyfreeGetFreeEffort(robj *o) {
+    if (o->type == REDIS_LIST && o->encoding == REDIS_ENCODING_LINKEDLIST) {
+        return listLength((list*)o->ptr);
+    } else if (o->type == REDIS_SET && o->encoding == REDIS_ENCODING_HT) {
+        return dictSize((dict*)o->ptr);
+    } else if (o->type == REDIS_SET && o->encoding == REDIS_ENCODING_ROARING) {
+        // 每个容器一次释放
+        return ((roaring*)o->ptr)->size;
+    } else if (o->type == REDIS_ZSET && o->encoding == REDIS_ENCODING_SKIPLIST) {
+        return ((zset*)o->ptr)->zsl->length;
+    } else if (o->type == REDIS_HASH && o->encoding == REDIS_ENCODING_HT) {
+        return dictSize((dict*)o->ptr);
+    } else {
+        return 1;
+    }
+}
+
+/*
+ * Estimate the memory used by the object: its own structures and member
+ * objects, not counting the strings the members point to, so this is a
+ * lower bound.
+ *
+ * T = O(1)
+*/
+/*
+ * 估计对象使用的内存：对象本身的结构和成员对象，不包括成员指向的字符串，因此这是一个下限
+*/
+static size_t lazyfreeEstimateBytes(robj *o) {
+    size_t bytes = sizeof(robj);
+    dict *d;
+
+    switch (o->type) {
+    case REDIS_LIST:
+        if (o->encoding == REDIS_ENCODING_LINKEDLIST)
+            bytes += listLength((list*)o->ptr) * (sizeof(listNode) + sizeof(robj));
+        else
+            bytes += zmalloc_size(o->ptr);
+        break;
+    case REDIS_SET:
+        if (o->encoding == REDIS_ENCODING_HT) {
+            d = o->ptr;
+            bytes += dictSize(d) * (sizeof(dictEntry) + sizeof(robj)) +
+                     dictSlots(d) * sizeof(dictEntry*);
+        } else if (o->encoding == REDIS_ENCODING_INTSET) {
+            bytes += intsetBlobLen(o->ptr);
+        } else {
+            bytes += roaringBlobLen(o->ptr);
+        }
+        break;
+    case REDIS_ZSET:
+        if (o->encoding == REDIS_ENCODING_SKIPLIST) {
+            zset *zs = o->ptr;
+
+            // 平均每个结点 1 / (1 - ZSKIPLIST_P) 层
+            d = zs->dict;
+            bytes += dictSize(d) * (sizeof(dictEntry) + sizeof(robj)) +
+                     dictSlots(d) * sizeof(dictEntry*) +
+                     zs->zsl->length * (sizeof(zskiplistNode) +
+                     sizeof(struct zskiplistLevel) * 4 / 3);
+        } else {
+            bytes += zmalloc_size(o->ptr);
+        }
+        break;
+    case REDIS_HASH:
+        if (o->encoding == REDIS_ENCODING_HT) {
+            d = o->ptr;
+            bytes += dictSize(d) * (sizeof(dictEntry) + 2 * sizeof(robj)) +
+                     dictSlots(d) * sizeof(dictEntry*);
+        } else {
+            bytes += zmalloc_size(o->ptr);
+        }
+        break;
+    }
+    return bytes;
+}
+
+/*
+ * Body of the reclamation thread: free the queued objects one by one,
+ * dropping the lock while freeing.
+*/
+// 回收线程：逐个释放队列中的对象，释放时不持有锁
+static void *lazyfreeThreadMain(void *arg) {
+    robj *o;
+    size_t bytes;
+
+    (void)arg;
+
+    /*
+     * This thread only releases lists, its node pool would fill up with
+     * nodes that are never reused.
+    */
+    // 这个线程只释放链表，结点池会被永远不会重用的结点填满，因此不使用结点池
+    listNodePoolSetMax(0);
+
+    pthread_mutex_lock(&lazyfree_mutex);
+    while (1) {
+        while (lazyfree_len == 0)
+            pthread_cond_wait(&lazyfree_job_cond, &lazyfree_mutex);
+
+        o = lazyfree_queue[lazyfree_head];
+        bytes = lazyfree_queue_bytes[lazyfree_head];
+        lazyfree_head = (lazyfree_head + 1) % REDIS_LAZYFREE_QUEUE_LEN;
+        lazyfree_len--;
+        pthread_mutex_unlock(&lazyfree_mutex);
+
+        decrRefCount(o);
+
+        pthread_mutex_lock(&lazyfree_mutex);
+        lazyfree_pending_objects--;
+        lazyfree_pending_bytes -= bytes;
+        lazyfree_freed_objects++;
+        if (lazyfree_pending_objects == 0)
+            pthread_cond_broadcast(&lazyfree_done_cond);
+    }
+    return NULL;
+}
+
+/*
+ * Start the reclamation thread. Must be called once at startup, before
+ * decrRefCountLazy() can defer anything.
+*/
+// 启动回收线程，需要在启动时调用一次，在此之前 decrRefCountLazy() 总是同步释放
+void lazyfreeInit(void) {
+    if (lazyfree_started) return;
+
+    // 回收线程也会调用 zfree()
+    zmalloc_enable_thread_safeness();
+    if (pthread_create(&lazyfree_thread, NULL, lazyfreeThreadMain, NULL) != 0)
+        redisPanic("Can't create the lazy free thread");
+    lazyfree_started = 1;
+}
+
+/*
+ * Drop a reference to the object like decrRefCount(), but when it is the
+ * last one and the object is expensive to free, with more than
+ * REDIS_LAZYFREE_THRESHOLD elements, hand it to the reclamation thread.
+ *
+ * The caller must have unlinked the object from every place the main
+ * thread can reach it.
+ *
+ * Returns 1 if the object was queued, 0 if it was handled synchronously.
+ *
+ * T = O(1) when queued
+*/
+/*
+ * 和 decrRefCount() 一样减少对象的引用计数，
+ * 但这是最后一个引用，并且对象的释放代价较高（超过 REDIS_LAZYFREE_THRESHOLD 个元素）时，
+ * 将对象交给回收线程
+ *
+ * 调用者需要已经将对象从主线程可以访问到的所有地方解除链接
+ *
+ * 对象被放入队列时返回 1，同步处理时返回 0
+*/
+int decrRefCountLazy(robj *o) {
+    size_t bytes;
+
+    if (!server.lazyfree_enabled || !lazyfree_started || objectGetRefCount(o) != 1 ||
+        lazyfreeGetFreeEffort(o) <= REDIS_LAZYFREE_THRESHOLD)
+    {
+        decrRefCount(o);
+        return 0;
+    }
+
+    bytes = lazyfreeEstimateBytes(o);
+
+    pthread_mutex_lock(&lazyfree_mutex);
+    if (lazyfree_len == REDIS_LAZYFREE_QUEUE_LEN) {
+        // 队列已满，回收线程跟不上时由调用者自己释放
+        pthread_mutex_unlock(&lazyfree_mutex);
+        decrRefCount(o);
+        return 0;
+    }
+    lazyfree_queue[(lazyfree_head + lazyfree_len) % REDIS_LAZYFREE_QUEUE_LEN] = o;
+    lazyfree_queue_bytes[(lazyfree_head + lazyfree_len) % REDIS_LAZYFREE_QUEUE_LEN] = bytes;
+    lazyfree_len++;
+    lazyfree_pending_objects++;
+    lazyfree_pending_bytes += bytes;
+    pthread_cond_signal(&lazyfree_job_cond);
+    pthread_mutex_unlock(&lazyfree_mutex);
+    return 1;
+}
+
+/*
+ * Block until every queued object has been freed, for shutdown and for
+ * callers that need the memory back now.
+*/
+// 阻塞直到所有队列中的对象都被释放，用于关闭服务器，或者需要立即回收内存的调用者
+void lazyfreeDrain(void) {
+    pthread_mutex_lock(&lazyfree_mutex);
+    while (lazyfree_pending_objects)
+        pthread_cond_wait(&lazyfree_done_cond, &lazyfree_mutex);
+    pthread_mutex_unlock(&lazyfree_mutex);
+}
+
+// 返回等待释放的对象数量
+unsigned long lazyfreeGetPendingObjectsCount(void) {
+    unsigned long count;
+
+    pthread_mutex_lock(&lazyfree_mutex);
+    count = lazyfree_pending_objects;
+    pthread_mutex_unlock(&lazyfree_mutex);
+    return count;
+}
+
+// 返回等待释放的对象的估计字节数
+size_t lazyfreeGetPendingBytes(void) {
+    size_t bytes;
+
+    pthread_mutex_lock(&lazyfree_mutex);
+    bytes = lazyfree_pending_bytes;
+    pthread_mutex_unlock(&lazyfree_mutex);
+    return bytes;
+}
+
+// 返回回收线程已经释放的对象数量
+unsigned long long lazyfreeGetFreedObjectsCount(void) {
+    unsigned long long count;
+
+    pthread_mutex_lock(&lazyfree_mutex);
+    count = lazyfree_freed_objects;
+    pthread_mutex_unlock(&lazyfree_mutex);
+    return count;
+}
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lzf.h"
+
+#define LZF_HLOG 13                         // 哈希表大小的对数
+#define LZF_HSIZE (1 << LZF_HLOG)           // 哈希表的槽数量
+
+#define LZF_MAX_LIT (1 << 5)                // 一段字面字节的最大长度
+#define LZF_MAX_OFF (1 << 13)               // 反向引用的最大距离
+#define LZF_MAX_REF ((1 << 8) + (1 << 3))   // 反向引用的最大长度
+
+// 三个字节的哈希值
+#define LZF_HASH(p) \
+    ((((uint32_t)(p)[0] << 16 | (uint32_t)(p)[1] << 8 | (p)[2]) * 2654435761U) \
+     >> (32 - LZF_HLOG))
+
+/*
+ * Append n literal bytes to the output, in runs of at most LZF_MAX_LIT.
+ * Returns 0 if they don't fit.
+ *
+ * T = O(N)
+*/
+// 将 n 个字面字节添加到输出中，每段最多 LZF_MAX_LIT 个，放不下时返回 0
+static int lzfEmitLiterals(unsigned char **op, const unsigned char *out_end,
+                           const unsigned char *lit, unsigned int n) {
+    while (n) {
+        unsigned int run = n > LZF_MAX_LIT ? LZF_MAX_LIT : n;
+
+        if ((size_t)(out_end - *op) < run + 1) return 0;
+        *(*op)++ = (unsigned char)(run - 1);
+        memcpy(*op, lit, run);
+        *op += run;
+        lit += run;
+        n -= run;
+    }
+    return 1;
+}
+
+/*
+ * Compress in_len bytes from in_data into out_data, writing at most
+ * out_len bytes.
+ *
+ * Returns the size of the compressed data, or 0 if it doesn't fit in
+ * out_len bytes: passing out_len smaller than in_len is the way to only
+ * keep the result when it saves space.
+ *
+ * Every position is looked up in a hash table of the last position where
+ * its first three bytes were seen, and matches are extended as far as
+ * possible. The table holds offsets + 1 so 0 can mean empty.
+ *
+ * T = O(N)
+*/
+/*
+ * 将 in_data 中的 in_len 个字节压缩到 out_data 中，最多写入 out_len 个字节
+ *
+ * 返回压缩后数据的大小，放不下 out_len 个字节时返回 0：
+ * 传入比 in_len 小的 out_len，就可以只在节省空间时才保留压缩结果
+ *
+ * 每个位置前三个字节最后一次出现的位置保存在哈希表中，找到的匹配会尽量延长，
+ * 哈希表中保存的是偏移加一，这样 0 可以表示空槽
+*/
+unsigned int lzf_compress(const void *in_data, unsigned int in_len,
+                          void *out_data, unsigned int out_len) {
+    uint32_t htab[LZF_HSIZE];
+    const unsigned char *in = in_data, *ip = in, *anchor = in;
+    const unsigned char *in_end = in + in_len;
+    unsigned char *op = out_data, *out_end = op + out_len;
+
+    if (in_len == 0 || out_len == 0) return 0;
+
+    memset(htab, 0, sizeof(htab));
+
+    while (in_end - ip >= 3) {
+        uint32_t h = LZF_HASH(ip);
+        const unsigned char *ref = htab[h] ? in + htab[h] - 1 : NULL;
+
+        htab[h] = (uint32_t)(ip - in) + 1;
+
+        if (ref && ip - ref <= LZF_MAX_OFF &&
+            ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+        {
+            unsigned int len = 3, off = (unsigned int)(ip - ref - 1);
+            unsigned int maxlen = in_end - ip > LZF_MAX_REF ?
+                                  LZF_MAX_REF : (unsigned int)(in_end - ip);
+
+            while (len < maxlen && ref[len] == ip[len]) len++;
+
+            // 先写出匹配之前的字面字节
+            if (!lzfEmitLiterals(&op, out_end, anchor, (unsigned int)(ip - anchor)))
+                return 0;
+
+            len -= 2;
+            if (len < 7) {
+                if (out_end - op < 2) return 0;
+                *op++ = (unsigned char)((len << 5) | (off >> 8));
+            } else {
+                if (out_end - op < 3) return 0;
+                *op++ = (unsigned char)((7 << 5) | (off >> 8));
+                *op++ = (unsigned char)(len - 7);
+            }
+            *op++ = (unsigned char)off;
+
+            ip += len + 2;
+            anchor = ip;
+        } else {
+            ip++;
+        }
+    }
+
+    if (!lzfEmitLiterals(&op, out_end, anchor, (unsigned int)(in_end - anchor)))
+        return 0;
+    return (unsigned int)(op - (unsigned char *)out_data);
+}
+
+/*
+ * Decompress in_len bytes from in_data into out_data, writing at most
+ * out_len bytes.
+ *
+ * Returns the size of the decompressed data, or 0 if the input is
+ * corrupted or the output doesn't fit in out_len bytes.
+ *
+ * T = O(N)
+*/
+/*
+ * 将 in_data 中的 in_len 个字节解压到 out_data 中，最多写入 out_len 个字节
+ *
+ * 返回解压后数据的大小，输入已损坏或者输出放不下 out_len 个字节时返回 0
+*/
+unsigned int lzf_decompress(const void *in_data, unsigned int in_len,
+                            void *out_data, unsigned int out_len) {
+    const unsigned char *ip = in_data, *in_end = ip + in_len;
+    unsigned char *out = out_data, *op = out, *out_end = op + out_len;
+
+    while (ip < in_end) {
+        unsigned int ctrl = *ip++;
+
+        if (ctrl < LZF_MAX_LIT) {
+            // 字面字节
+            unsigned int run = ctrl + 1;
+
+            if ((size_t)(out_end - op) < run || (size_t)(in_end - ip) < run) return 0;
+            if ((size_t)(out_end - op) >= LZF_MAX_LIT && (size_t)(in_end - ip) >= LZF_MAX_LIT) {
+                // 固定长度的复制可以被内联，多写的字节之后会被覆盖
+                memcpy(op, ip, LZF_MAX_LIT);
+            } else {
+                memcpy(op, ip, run);
+            }
+            op += run;
+            ip += run;
+        } else {
+            // 反向引用
+            unsigned int len = ctrl >> 5;
+            const unsigned char *ref;
+
+            if (len == 7) {
+                if (ip >= in_end) return 0;
+                len += *ip++;
+            }
+            if (ip >= in_end) return 0;
+
+            ref = op - ((ctrl & 0x1f) << 8) - *ip++ - 1;
+            len += 2;
+            if (ref < out || (size_t)(out_end - op) < len) return 0;
+
+            if (op - ref >= 8 && (size_t)(out_end - op) >= len + 8) {
+                // 每次复制 8 个字节，可能多写最多 7 个字节，它们之后会被覆盖
+                unsigned char *end = op + len;
+
+                do {
+                    memcpy(op, ref, 8);
+                    op += 8;
+                    ref += 8;
+                } while (op < end);
+                op = end;
+            } else {
+                // 引用的区域和输出重叠（比如一段重复的字节），或者接近输出的末尾
+                while (len--) *op++ = *ref++;
+            }
+        }
+    }
+    return (unsigned int)(op - out);
+}
+
+#ifdef LZF_TEST_MAIN
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "testhelp.h"
+
+int main(void) {
+    unsigned char in[20000], out[20000], back[20000];
+    unsigned int j, k, clen, dlen;
+    int ok = 1;
+
+    srand(time(NULL));
+
+    for (j = 0; j < sizeof(in); j++) in[j] = "abcdefgh"[j % 8];
+    clen = lzf_compress(in, sizeof(in), out, sizeof(out));
+    dlen = lzf_decompress(out, clen, back, sizeof(back));
+    test_cond("Repetitive data compresses and round trips",
+        clen > 0 && clen < sizeof(in) / 20 && dlen == sizeof(in) &&
+        memcmp(in, back, dlen) == 0);
+
+    for (j = 0; j < sizeof(in); j++) in[j] = rand();
+    test_cond("Incompressible data doesn't fit in a smaller buffer",
+        lzf_compress(in, sizeof(in), out, sizeof(in) - 1) == 0);
+
+    for (k = 0; k < 1000 && ok; k++) {
+        unsigned int len = rand() % sizeof(in) + 1, alphabet = rand() % 16 + 1;
+
+        // 随机数据夹杂着复制的片段
+        for (j = 0; j < len; j++) {
+            if (j > 300 && rand() % 40 == 0) {
+                unsigned int n = rand() % 280, from = rand() % j;
+                while (n-- && j < len) in[j++] = in[from++];
+                j--;
+            } else {
+                in[j] = 'a' + rand() % alphabet;
+            }
+        }
+        clen = lzf_compress(in, len, out, sizeof(out));
+        if (clen == 0) { ok = 0; break; }
+        dlen = lzf_decompress(out, clen, back, len);
+        if (dlen != len || memcmp(in, back, len)) ok = 0;
+        // 输出缓冲区太小时必须失败，而不是越界
+        if (len > 1 && lzf_decompress(out, clen, back, len - 1) != 0) ok = 0;
+    }
+    test_cond("Random round trips", ok);
+
+    test_report();
+    return 0;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef __LZF_H__
+#define __LZF_H__
+
+/*
+ * LZF: a very fast LZ77 style compressor, using the stream format of
+ * liblzf by Marc Lehmann, so data compressed here can be decompressed by
+ * any LZF implementation and the other way around.
+ *
+ * The compressed stream is a sequence of:
+ *
+ * - 000LLLLL                      a run of L + 1 literal bytes (1 .. 32)
+ * - LLLooooo oooooooo             a back reference of L + 2 bytes (3 .. 8)
+ * - 111ooooo LLLLLLLL oooooooo    a back reference of L + 9 bytes (9 .. 264)
+ *
+ * the 13 bit offset o being the distance - 1 of the reference (up to 8KB).
+*/
+/*
+ * LZF：非常快的 LZ77 类压缩算法，使用 Marc Lehmann 的 liblzf 的流格式，
+ * 所以这里压缩的数据可以用任何 LZF 实现解压，反之亦然
+ *
+ * 压缩流由以下几种片段组成：
+ *
+ * - 000LLLLL                      L + 1 个字面字节（1 .. 32）
+ * - LLLooooo oooooooo             长度为 L + 2 的反向引用（3 .. 8）
+ * - 111ooooo LLLLLLLL oooooooo    长度为 L + 9 的反向引用（9 .. 264）
+ *
+ * 13 位的 o 是引用的距离减一（最大 8KB）
+*/
+
+unsigned int lzf_compress(const void *in_data, unsigned int in_len,
+                          void *out_data, unsigned int out_len);
+unsigned int lzf_decompress(const void *in_data, unsigned int in_len,
+                            void *out_data, unsigned int out_len);
+
+#endif // __LZF_H__
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "monotonic.h"
+
+// 描述当前时钟源的字符串
+static char monotonic_info_string[64];
+
+/*
+ * Read CLOCK_MONOTONIC, through the vDSO on Linux.
+ *
+ * T = O(1)
+*/
+// 读取 CLOCK_MONOTONIC，在 Linux 上通过 vDSO 完成
+static monotime getMonotonicUs_posix(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+monotime (*getMonotonicUs)(void) = getMonotonicUs_posix;
+
+#if defined(USE_PROCESSOR_CLOCK) && defined(__x86_64__) && defined(__linux__)
+// 校准 TSC 时等待的微秒数
+#define MONOTONIC_CALIBRATION_US 20000
+
+/*
+ * Microseconds per TSC tick, as a 32.32 fixed point number, so that the
+ * conversion is a multiplication instead of a division.
+*/
+// 每个 TSC 周期的微秒数，使用 32.32 的定点数表示，这样转换只需要一次乘法，而不是除法
+static uint64_t mono_us_per_tick_fp;
+
+static inline uint64_t rdtsc(void) {
+    unsigned int lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * Convert the TSC to microseconds. The product needs more than 64 bits:
+ * a TSC running at a few GHz for days is already above 2^50.
+ *
+ * T = O(1)
+*/
+// 将 TSC 转换为微秒，乘积需要超过 64 位：几 GHz 的 TSC 运行几天就已经超过 2^50
+static monotime getMonotonicUs_x86(void) {
+    return (monotime)(((unsigned __int128)rdtsc() * mono_us_per_tick_fp) >> 32);
+}
+
+/*
+ * Return 1 if the flags in /proc/cpuinfo contain the given one.
+*/
+// 检查 /proc/cpuinfo 中的标志是否包含 flag
+static int monotonicCpuHasFlag(const char *flag) {
+    char buf[4096], *p;
+    size_t len = strlen(flag);
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    int found = 0;
+
+    if (fp == NULL) return 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        if (strncmp(buf, "flags", 5) != 0) continue;
+
+        // 标志之间用空格分隔，需要整个单词匹配
+        for (p = strstr(buf, flag); p; p = strstr(p + len, flag)) {
+            if (p[-1] == ' ' && (p[len] == ' ' || p[len] == '\n')) {
+                found = 1;
+                break;
+            }
+        }
+        break;
+    }
+    fclose(fp);
+    return found;
+}
+
+/*
+ * Use the TSC if it ticks at a constant rate across frequency changes and
+ * sleep states (constant_tsc and nonstop_tsc), measuring its rate against
+ * CLOCK_MONOTONIC over MONOTONIC_CALIBRATION_US.
+ *
+ * Returns 1 if the TSC is now the clock source.
+*/
+/*
+ * TSC 的频率在调频和睡眠状态下都保持不变时（constant_tsc 和 nonstop_tsc），
+ * 在 MONOTONIC_CALIBRATION_US 微秒内根据 CLOCK_MONOTONIC 测量它的频率，并使用 TSC 作为时钟源
+ *
+ * 切换到 TSC 时返回 1
+*/
+static int monotonicInit_x86linux(void) {
+    uint64_t start_us, end_us, start_tsc, end_tsc;
+
+    if (!monotonicCpuHasFlag("constant_tsc") || !monotonicCpuHasFlag("nonstop_tsc"))
+        return 0;
+
+    start_us = getMonotonicUs_posix();
+    start_tsc = rdtsc();
+    do {
+        end_us = getMonotonicUs_posix();
+    } while (end_us - start_us < MONOTONIC_CALIBRATION_US);
+    end_tsc = rdtsc();
+
+    if (end_tsc <= start_tsc) return 0;
+    mono_us_per_tick_fp = (uint64_t)((double)(end_us - start_us) * 4294967296.0 /
+                                     (end_tsc - start_tsc));
+
+    snprintf(monotonic_info_string, sizeof(monotonic_info_string),
+             "X86 TSC @ %.0f ticks/us",
+             (double)(end_tsc - start_tsc) / (end_us - start_us));
+    getMonotonicUs = getMonotonicUs_x86;
+    return 1;
+}
+#endif
+
+/*
+ * Select the clock source. Must be called once at startup, before any
+ * elapsed time is measured. Returns a description of the source.
+*/
+// 选择时钟源，需要在启动时，在测量任何经过时间之前调用一次，返回时钟源的描述
+const char *monotonicInit(void) {
+#if defined(USE_PROCESSOR_CLOCK) && defined(__x86_64__) && defined(__linux__)
+    if (monotonicInit_x86linux()) return monotonic_info_string;
+#endif
+
+    snprintf(monotonic_info_string, sizeof(monotonic_info_string),
+             "POSIX clock_gettime");
+    getMonotonicUs = getMonotonicUs_posix;
+    return monotonic_info_string;
+}
+
+// 返回当前时钟源的描述
+const char *monotonicInfoString(void) {
+    return monotonic_info_string;
+}
+
+#ifdef MONOTONIC_TEST_MAIN
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "testhelp.h"
+
+#define MONOTONIC_BENCH_CALLS 10000000
+
+// 使用 CLOCK_MONOTONIC 测量 expr 计算 MONOTONIC_BENCH_CALLS 次的平均纳秒数
+#define MONOTONIC_BENCH(name, expr) do { \
+    uint64_t _start = getMonotonicUs_posix(), _sum = 0; \
+    long _j; \
+    for (_j = 0; _j < MONOTONIC_BENCH_CALLS; _j++) _sum += (expr); \
+    printf("  %-32s %6.2f ns/call (%llu)\n", name, \
+        (double)(getMonotonicUs_posix() - _start) * 1000 / MONOTONIC_BENCH_CALLS, \
+        (unsigned long long)(_sum & 1)); \
+} while (0)
+
+static uint64_t benchGettimeofday(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_usec;
+}
+
+static uint64_t benchClockGettime(clockid_t clk) {
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+    return ts.tv_nsec;
+}
+
+int main(void) {
+    volatile monotime cached;
+    monotime prev, now, start;
+    uint64_t posix_start, tsc_us, posix_us;
+    const char *info;
+    long j;
+    int ok = 1;
+
+    prev = getMonotonicUs();
+    for (j = 0; j < 1000000; j++) {
+        now = getMonotonicUs();
+        if (now < prev) ok = 0;
+        prev = now;
+    }
+    test_cond("CLOCK_MONOTONIC never goes backwards", ok);
+
+    info = monotonicInit();
+    printf("Clock source: %s\n", info);
+
+    ok = 1;
+    prev = getMonotonicUs();
+    for (j = 0; j < 1000000; j++) {
+        now = getMonotonicUs();
+        if (now < prev) ok = 0;
+        prev = now;
+    }
+    test_cond("The selected clock never goes backwards", ok);
+
+    // 和 CLOCK_MONOTONIC 比较 200 毫秒内经过的时间
+    elapsedStart(&start);
+    posix_start = getMonotonicUs_posix();
+    usleep(200000);
+    tsc_us = elapsedUs(start);
+    posix_us = getMonotonicUs_posix() - posix_start;
+    printf("200ms sleep: %llu us selected clock, %llu us CLOCK_MONOTONIC\n",
+        (unsigned long long)tsc_us, (unsigned long long)posix_us);
+    test_cond("The selected clock agrees with CLOCK_MONOTONIC within 0.5%",
+        tsc_us * 1000 > posix_us * 995 && tsc_us * 1000 < posix_us * 1005);
+
+    printf("Cost of reading the time, %d calls:\n", MONOTONIC_BENCH_CALLS);
+    MONOTONIC_BENCH("gettimeofday", benchGettimeofday());
+    MONOTONIC_BENCH("clock_gettime REALTIME", benchClockGettime(CLOCK_REALTIME));
+    MONOTONIC_BENCH("clock_gettime MONOTONIC", benchClockGettime(CLOCK_MONOTONIC));
+#ifdef CLOCK_MONOTONIC_COARSE
+    MONOTONIC_BENCH("clock_gettime MONOTONIC_COARSE",
+        benchClockGettime(CLOCK_MONOTONIC_COARSE));
+#endif
+#if defined(USE_PROCESSOR_CLOCK) && defined(__x86_64__) && defined(__linux__)
+    MONOTONIC_BENCH("rdtsc", rdtsc());
+#endif
+    MONOTONIC_BENCH("getMonotonicUs", getMonotonicUs());
+    // 每个时钟周期更新一次的缓存时间，读取它只是一次内存访问
+    cached = getMonotonicUs();
+    MONOTONIC_BENCH("cached per-tick time", cached);
+
+    test_report();
+    return 0;
+}
+#endif
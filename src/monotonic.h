@@ -0,0 +1,56 @@
+#ifndef __MONOTONIC_H
+#define __MONOTONIC_H
+
+#include <stdint.h>
+
+/*
+ * Monotonic clock: microseconds since an unspecified point in the past,
+ * never going backwards when the wall clock is adjusted. Use it to
+ * measure elapsed time (time budgets, latency), and ustime()/mstime()
+ * only where an absolute UNIX time is needed (expires).
+ *
+ * The default source is clock_gettime(CLOCK_MONOTONIC), served by the
+ * vDSO on Linux without a system call. Builds with -DUSE_PROCESSOR_CLOCK
+ * on x86_64 Linux read the TSC directly instead, once monotonicInit() has
+ * checked that the TSC is invariant and calibrated it against
+ * CLOCK_MONOTONIC.
+ *
+ * getMonotonicUs() can be called before monotonicInit(), but values read
+ * before and after it must not be compared.
+*/
+/*
+ * 单调时钟：从过去某个不确定的时间点开始的微秒数，调整系统时间时不会倒退
+ * 用于计算经过的时间（时间预算、延迟），只在需要绝对的 UNIX 时间时（过期时间）
+ * 才使用 ustime()/mstime()
+ *
+ * 默认的时钟源是 clock_gettime(CLOCK_MONOTONIC)，在 Linux 上由 vDSO 提供，不需要系统调用
+ * 在 x86_64 Linux 上使用 -DUSE_PROCESSOR_CLOCK 编译时，monotonicInit() 确认 TSC
+ * 的频率不变，并根据 CLOCK_MONOTONIC 校准之后，直接读取 TSC
+ *
+ * 在 monotonicInit() 之前也可以调用 getMonotonicUs()，但之前和之后读到的值不能互相比较
+*/
+
+typedef uint64_t monotime;
+
+// 返回单调时钟的当前值，单位为微秒
+extern monotime (*getMonotonicUs)(void);
+
+const char *monotonicInit(void);
+const char *monotonicInfoString(void);
+
+// 开始计时
+static inline void elapsedStart(monotime *start_time) {
+    *start_time = getMonotonicUs();
+}
+
+// 返回从 start_time 开始经过的微秒数
+static inline uint64_t elapsedUs(monotime start_time) {
+    return getMonotonicUs() - start_time;
+}
+
+// 返回从 start_time 开始经过的毫秒数
+static inline uint64_t elapsedMs(monotime start_time) {
+    return elapsedUs(start_time) / 1000;
+}
+
+#endif // __MONOTONIC_H
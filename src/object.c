@@ -3,6 +3,8 @@
 #include <string.h>
 
 #include "redis.h"
+#include "intset.h"
+#include "roaring.h"
 
 /*
  * 创建一个新 robj 对象
@@ -17,8 +19,9 @@ robj *createObject(int type, void *ptr) {
     o->ptr = ptr;
     o->refcount = 1;
 
-    /* Set the LRU to the current lruclock (minutes resolution). */
-    o->lru = LRU_CLOCK();
+    /* Set the LRU to the current lruclock (minutes resolution), or the
+     * initial LFU counter under LFU policies. */
+    o->lru = objectInitialLRU();
     return o;
 }
 
@@ -54,7 +57,7 @@ robj *createEmbeddedStringObject(char *ptr, size_t len) {
     o->encoding = REDIS_ENCODING_EMBSTR;
     o->ptr = sh + 1;
     o->refcount = 1;
-    o->lru = LRU_CLOCK();
+    o->lru = objectInitialLRU();
 
     sh->len = len;
     sh->free = 0;
@@ -69,21 +72,145 @@ robj *createEmbeddedStringObject(char *ptr, size_t len) {
 
 /*
  * Create a string object with EMBSTR encoding if it is smaller than
- * REIDS_ENCODING_EMBSTR_SIZE_LIMIT, otherwise the RAW encoding is 
+ * REDIS_ENCODING_EMBSTR_SIZE_LIMIT, otherwise the RAW encoding is 
  * used
  * 
  * The current limit of 39 is chosen so that the biggest string object
- * we allocate as EMBSTR will still fit into the 64 byte arena of jemalloc
+ * we allocate as EMBSTR will still fit into the 64 byte arena of jemalloc.
+ * With the libc allocator a 39 bytes embstr spills into the 80 bytes
+ * chunk, but that is still smaller than the 32 + 64 bytes a RAW object
+ * and its separate sds take, and it saves a pointer dereference, so the
+ * limit is the same with every allocator.
 */
-#define REIDS_ENCODING_EMBSTR_SIZE_LIMIT 39
+/*
+ * 字符串长度不超过 REDIS_ENCODING_EMBSTR_SIZE_LIMIT 时创建 EMBSTR 编码的字符串对象，
+ * 否则使用 RAW 编码
+ *
+ * 39 这个限制使得最大的 EMBSTR 对象仍然可以放进 jemalloc 的 64 字节规格中。
+ * 使用 libc 的分配器时，39 字节的 embstr 会落入 80 字节的块，
+ * 但这仍然比 RAW 对象和独立的 sds 所用的 32 + 64 字节要少，还少一次指针访问，
+ * 所以所有分配器都使用同一个限制
+*/
+#define REDIS_ENCODING_EMBSTR_SIZE_LIMIT 39
 robj *createStringObject(char *ptr, size_t len) {
-    if(len <= REIDS_ENCODING_EMBSTR_SIZE_LIMIT) {
+    if(len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT) {
         return createEmbeddedStringObject(ptr, len);
     } else {
         return createRawStringObject(ptr, len);
     }
 }
 
+/*
+ * Create a string object with INLINE encoding, that is an object
+ * holding a string of at most REDIS_INLINE_MAX_LEN bytes in its ptr
+ * field, with no allocation besides the object itself.
+ *
+ * T = O(1)
+*/
+/*
+ * 创建一个 INLINE 编码的字符串对象
+ * 长度不超过 REDIS_INLINE_MAX_LEN 的字符串直接保存在对象的 ptr 字段中，
+ * 除了对象本身之外不需要分配内存
+*/
+robj *createInlineStringObject(char *ptr, size_t len) {
+    robj *o = createObject(REDIS_STRING, NULL);
+
+    redisAssert(len <= REDIS_INLINE_MAX_LEN);
+    o->encoding = REDIS_ENCODING_INLINE;
+    inlineObjectLen(o) = (unsigned char)len;
+    memcpy(inlineObjectBuf(o), ptr, len);
+    return o;
+}
+
+/*
+ * Create a string object from a long long value, using a shared integer
+ * when the value is in [0, REDIS_SHARED_INTEGERS), otherwise the INT
+ * encoding when it fits in a long, and only then an sds string.
+ *
+ * Shared integers are not used under LRU and LFU maxmemory policies,
+ * as in tryObjectEncoding().
+ *
+ * T = O(1)
+*/
+/*
+ * 根据 long long 值创建字符串对象
+ * 值在 [0, REDIS_SHARED_INTEGERS) 之间时返回共享整数，
+ * 否则在可以用 long 保存时使用 INT 编码，都不行才使用 sds 字符串
+ *
+ * 和 tryObjectEncoding() 一样，LRU 和 LFU 淘汰策略下不使用共享整数
+*/
+robj *createStringObjectFromLongLong(long long value) {
+    robj *o;
+
+    if ((server.maxmemory == 0 ||
+         !(server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_NO_SHARED_INTEGERS)) &&
+        value >= 0 && value < REDIS_SHARED_INTEGERS)
+    {
+        // 共享对象的引用计数不需要增加
+        o = shared.integers[value];
+    } else if (value >= LONG_MIN && value <= LONG_MAX) {
+        o = createObject(REDIS_STRING, NULL);
+        o->encoding = REDIS_ENCODING_INT;
+        o->ptr = (void*)((long)value);
+    } else {
+        o = createObject(REDIS_STRING, sdsfromlonglong(value));
+    }
+    return o;
+}
+
+/*
+ * Mark the object as shared: its reference count is pinned to
+ * REDIS_SHARED_REFCOUNT, so it can be handed out to any number of
+ * owners without touching the count, and is never freed.
+ *
+ * T = O(1)
+*/
+/*
+ * 将对象标记为共享对象：它的引用计数固定为 REDIS_SHARED_REFCOUNT，
+ * 因此可以交给任意多个持有者而不需要修改引用计数，也永远不会被释放
+*/
+robj *makeObjectShared(robj *o) {
+    redisAssert(o->refcount == 1);
+    o->refcount = REDIS_SHARED_REFCOUNT;
+    return o;
+}
+
+/*
+ * Create the shared integers [0, REDIS_SHARED_INTEGERS), called once
+ * at startup.
+ *
+ * T = O(REDIS_SHARED_INTEGERS)
+*/
+// 创建 [0, REDIS_SHARED_INTEGERS) 之间的共享整数，在启动时调用一次
+void createSharedIntegers(void) {
+    long j;
+
+    for (j = 0; j < REDIS_SHARED_INTEGERS; j++) {
+        robj *o = createObject(REDIS_STRING, (void*)j);
+        o->encoding = REDIS_ENCODING_INT;
+        shared.integers[j] = makeObjectShared(o);
+    }
+}
+
+/*
+ * 创建一个 INTSET 编码的集合对象
+*/
+robj *createIntsetObject(void) {
+    intset *is = intsetNew();
+    robj *o = createObject(REDIS_SET, is);
+    o->encoding = REDIS_ENCODING_INTSET;
+    return o;
+}
+
+/*
+ * 创建一个 ROARING 编码的集合对象
+*/
+robj *createRoaringSetObject(void) {
+    roaring *r = roaringNew();
+    robj *o = createObject(REDIS_SET, r);
+    o->encoding = REDIS_ENCODING_ROARING;
+    return o;
+}
 
 /*
  * 释放字符串对象
@@ -121,6 +248,9 @@ void freeSetObject(robj *o) {
         case REDIS_ENCODING_INTSET:
             zfree(o->ptr);
             break;
+        case REDIS_ENCODING_ROARING:
+            roaringFree((roaring*) o->ptr);
+            break;
         default:
             redisPanic("Unknown set encoding type");
     }
@@ -166,21 +296,43 @@ void freeHashObject(robj *o) {
 
 /*
  * 为对象的引用计数 +1
+ *
+ * 共享对象不会写入引用计数，因此多个线程同时使用它们时，所在的缓存行不会在 CPU 之间来回传递
 */
 void incrRefCount(robj *o) {
+    // 共享对象的引用计数保持不变
+    if (objectGetRefCount(o) == REDIS_SHARED_REFCOUNT) return;
+
+#ifdef REDIS_ATOMIC_REFCOUNT
+    __atomic_add_fetch(&o->refcount, 1, __ATOMIC_RELAXED);
+#else
     o->refcount++;
+#endif
 }
 
 /*
  * 为对象的引用计数 -1
  * 
  * 当对象的引用计数降为 0 时，释放对象
+ *
+ * 使用 REDIS_ATOMIC_REFCOUNT 编译时，只有使引用计数降为 0 的线程会释放对象，
+ * acquire-release 顺序保证其他线程之前对对象的访问都在释放之前完成
 */
 void decrRefCount(robj *o) {
-    if (o->refcount <= 0) redisPanic("decrRefCount against refcount <= 0");
+    int refcount;
+
+    // 共享对象永远不会被释放
+    if (objectGetRefCount(o) == REDIS_SHARED_REFCOUNT) return;
+
+#ifdef REDIS_ATOMIC_REFCOUNT
+    refcount = __atomic_fetch_sub(&o->refcount, 1, __ATOMIC_ACQ_REL);
+#else
+    refcount = o->refcount--;
+#endif
+    if (refcount <= 0) redisPanic("decrRefCount against refcount <= 0");
 
     // 若对象计数为 1 ，释放对象
-    if (o->refcount == 1) {
+    if (refcount == 1) {
         switch(o->type) {
             case REDIS_STRING: freeStringObject(o); break;
             case REDIS_LIST: freeListObject(o); break;
@@ -190,10 +342,168 @@ void decrRefCount(robj *o) {
             default: redisPanic("Unknown object type"); break;
         }
         zfree(o);
+    }
+}
+
+/*
+ * Try to encode a string object in order to save space.
+ *
+ * Strings holding a number that fits in a long, without leading zeroes or
+ * spaces so that it prints back to the same string, are replaced by a
+ * shared integer or stored in the INT encoding, directly in ptr. Strings
+ * of at most REDIS_INLINE_MAX_LEN bytes are stored in ptr too, other
+ * short strings are embedded, long ones lose their free space.
+ *
+ * The caller must use the returned object in place of o, which may have
+ * been freed.
+ *
+ * T = O(N)
+*/
+/*
+ * 尝试对字符串对象进行编码，以节约内存
+ *
+ * 保存的数字可以用 long 表示，并且没有前导零或空格（转换回字符串时和原来相同）时，
+ * 字符串会被替换为共享整数，或者使用 INT 编码直接保存在 ptr 中
+ * 长度不超过 REDIS_INLINE_MAX_LEN 的字符串同样保存在 ptr 中，
+ * 其他较短的字符串使用 EMBSTR 编码，较长的字符串释放多余的空间
+ *
+ * 调用者需要使用返回的对象代替 o，o 可能已经被释放
+*/
+robj *tryObjectEncoding(robj *o) {
+    long value;
+    sds s = o->ptr;
+    size_t len;
+
+    redisAssertWithInfo(NULL, o, o->type == REDIS_STRING);
+
+    // 只对 sds 字符串进行编码
+    if (!sdsEncodedObject(o)) return o;
+
+    // 被共享的对象可能被其他地方引用，不能修改
+    if (objectGetRefCount(o) > 1) return o;
+
+    // long 最长为 20 个字符（包括负号）
+    len = sdslen(s);
+    if (len <= 20 && string2l(s, len, &value)) {
+        /* Under LRU and LFU maxmemory policies every key needs its own
+         * lru field, so shared integers can't be used as values. */
+        // LRU 和 LFU 淘汰策略需要每个值都有自己的 lru 字段，此时不能使用共享整数
+        if ((server.maxmemory == 0 ||
+             !(server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_NO_SHARED_INTEGERS)) &&
+            value >= 0 && value < REDIS_SHARED_INTEGERS)
+        {
+            decrRefCount(o);
+            return shared.integers[value];
+        } else if (o->encoding == REDIS_ENCODING_RAW) {
+            sdsfree(o->ptr);
+            o->encoding = REDIS_ENCODING_INT;
+            o->ptr = (void*)value;
+            return o;
+        } else {
+            // EMBSTR 的字符串和对象在同一块内存中，换成一个只有对象结构的新对象
+            robj *io = createObject(REDIS_STRING, (void*)value);
+            io->encoding = REDIS_ENCODING_INT;
+            io->lru = o->lru;
+            decrRefCount(o);
+            return io;
+        }
+    }
+
+    if (len <= REDIS_INLINE_MAX_LEN) {
+        robj *io = createInlineStringObject(s, len);
+
+        io->lru = o->lru;
+        decrRefCount(o);
+        return io;
+    }
+
+    if (len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT) {
+        robj *emb;
+
+        if (o->encoding == REDIS_ENCODING_EMBSTR) return o;
+        emb = createEmbeddedStringObject(s, len);
+        decrRefCount(o);
+        return emb;
+    }
+
+    // 剩余空间超过 10% 时释放它
+    if (o->encoding == REDIS_ENCODING_RAW && sdsavail(s) > len / 10)
+        o->ptr = sdsRemoveFreeSpace(o->ptr);
+
+    return o;
+}
+
+/*
+ * Get a decoded version of an encoded object, returned as a new sds
+ * encoded object or, if the object is already sds encoded, as the same object with its
+ * reference count incremented. Either way the caller must decrement the
+ * reference count of the returned object.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回对象的未编码版本：
+ * INT 和 INLINE 编码的对象转换为一个新的 sds 字符串对象，sds 编码的对象增加引用计数后直接返回
+ * 无论哪种情况，调用者都需要减少返回对象的引用计数
+*/
+robj *getDecodedObject(robj *o) {
+    robj *dec;
+
+    if (sdsEncodedObject(o)) {
+        incrRefCount(o);
+        return o;
+    }
+
+    if (o->type == REDIS_STRING && o->encoding == REDIS_ENCODING_INT) {
+        char buf[32];
+
+        ll2string(buf, sizeof(buf), (long)o->ptr);
+        dec = createStringObject(buf, strlen(buf));
+        return dec;
+    } else if (o->type == REDIS_STRING && o->encoding == REDIS_ENCODING_INLINE) {
+        // 短字符串总是使用 EMBSTR 编码
+        return createStringObject(inlineObjectBuf(o), inlineObjectLen(o));
     } else {
-    // 减少计数
-        o->refcount--;
+        redisPanic("Unknown encoding type");
     }
+    return NULL;
+}
+
+/*
+ * Given an object returns the min number of milliseconds the object was
+ * never requested, using an approximated LRU algorithm.
+ *
+ * T = O(1)
+*/
+// 使用近似 LRU 算法，返回对象至少有多少毫秒没有被访问过
+unsigned long long estimateObjectIdleTime(robj *o) {
+    unsigned long long lruclock = LRU_CLOCK();
+
+    if (lruclock >= o->lru) {
+        return (lruclock - o->lru) * REDIS_LRU_CLOCK_RESOLUTION;
+    } else {
+        // LRU 时钟已经回绕
+        return (lruclock + (REDIS_LRU_CLOCK_MAX - o->lru)) *
+                    REDIS_LRU_CLOCK_RESOLUTION;
+    }
+}
+
+/*
+ * OBJECT FREQ: store in *freq the decayed logarithmic access counter of
+ * the object. The lru field only holds it under LFU policies, otherwise
+ * REDIS_ERR is returned.
+ *
+ * T = O(1)
+*/
+/*
+ * OBJECT FREQ：将对象衰减之后的对数访问计数器保存到 *freq 中
+ * 只有在 LFU 策略下 lru 字段才保存计数器，否则返回 REDIS_ERR
+*/
+int objectGetFrequency(robj *o, unsigned long *freq) {
+    if (!(server.maxmemory_policy & REDIS_MAXMEMORY_FLAG_LFU)) return REDIS_ERR;
+
+    *freq = LFUDecrAndReturn(o);
+    return REDIS_OK;
 }
 
 /*
@@ -221,6 +531,62 @@ void decrRefCount(robj *o) {
 #define REDIS_COMPARE_BINARY (1 << 0)
 #define REDIS_COMPARE_COLL (1 << 1)
 
+/*
+ * Binary comparison of two strings whose lengths are known, ordering a
+ * string before the longer strings it is a prefix of.
+ *
+ * memcmp() is already vectorized by the C library, what matters is not
+ * having to find the lengths or copy the strings first.
+ *
+ * T = O(N)
+*/
+/*
+ * 对两个已知长度的字符串进行二进制安全的对比，字符串排在以它为前缀的更长字符串之前
+ *
+ * C 库的 memcmp() 已经使用了向量指令，关键在于不需要先求出长度或者复制字符串
+*/
+static int compareStringsBinary(const char *a, size_t alen,
+                                const char *b, size_t blen) {
+    size_t minlen = (alen < blen) ? alen : blen;
+    int cmp = memcmp(a, b, minlen);
+
+    if (cmp == 0) return (alen < blen) ? -1 : (alen > blen);
+    return cmp;
+}
+
+/*
+ * Compare two longs the way their string representations compare.
+ *
+ * Numbers with the same sign and number of digits compare as their
+ * absolute values ("12" < "13", "-12" < "-13"), the others are formatted
+ * and compared as strings.
+ *
+ * T = O(1)
+*/
+/*
+ * 按照两个 long 的字符串形式的顺序对比它们
+ *
+ * 符号和位数都相同的数字可以直接对比绝对值（"12" < "13"，"-12" < "-13"），
+ * 其他情况需要转换为字符串再对比
+*/
+static int compareLongsAsStrings(long a, long b) {
+    unsigned long ua, ub;
+    char bufa[32], bufb[32];
+    int alen, blen;
+
+    if (a == b) return 0;
+
+    // 取绝对值时避免 LONG_MIN 溢出
+    ua = (a < 0) ? -(unsigned long)a : (unsigned long)a;
+    ub = (b < 0) ? -(unsigned long)b : (unsigned long)b;
+    if ((a < 0) == (b < 0) && digits10(ua) == digits10(ub))
+        return (ua < ub) ? -1 : 1;
+
+    alen = ll2string(bufa, sizeof(bufa), a);
+    blen = ll2string(bufb, sizeof(bufb), b);
+    return compareStringsBinary(bufa, alen, bufb, blen);
+}
+
 int compareStringObjectWithFlags(robj *a, robj *b, int flags) {
     redisAssertWithInfo(NULL, a, a->type == REDIS_STRING && b->type == REDIS_STRING);
     
@@ -229,10 +595,24 @@ int compareStringObjectWithFlags(robj *a, robj *b, int flags) {
 
     if (a == b) return 0;
 
+    // 二进制对比的常见情况：两个 sds 字符串直接使用保存在头部的长度，两个整数不需要转换为字符串
+    if (flags & REDIS_COMPARE_BINARY) {
+        if (sdsEncodedObject(a) && sdsEncodedObject(b))
+            return compareStringsBinary(a->ptr, sdslen(a->ptr), b->ptr, sdslen(b->ptr));
+        if (a->encoding == REDIS_ENCODING_INT && b->encoding == REDIS_ENCODING_INT)
+            return compareLongsAsStrings((long)a->ptr, (long)b->ptr);
+    }
+
     // 指向字符串值，并在有需要时，将整数转换为字符串 a
     if (sdsEncodedObject(a)) {
         astr = a->ptr;
         alen = sdslen(astr);
+    } else if (a->encoding == REDIS_ENCODING_INLINE) {
+        // 复制到栈上，加上 strcoll() 需要的结束符
+        alen = inlineObjectLen(a);
+        memcpy(bufa, inlineObjectBuf(a), alen);
+        bufa[alen] = '\0';
+        astr = bufa;
     } else {
         alen = ll2string(bufa, sizeof(bufa), (long) a->ptr);
         astr = bufa;
@@ -242,6 +622,11 @@ int compareStringObjectWithFlags(robj *a, robj *b, int flags) {
     if (sdsEncodedObject(b)) {
         bstr = b->ptr;
         blen = sdslen(bstr);
+    } else if (b->encoding == REDIS_ENCODING_INLINE) {
+        blen = inlineObjectLen(b);
+        memcpy(bufb, inlineObjectBuf(b), blen);
+        bufb[blen] = '\0';
+        bstr = bufb;
     } else {
         blen = ll2string(bufb, sizeof(bufb), (long) b->ptr);
         bstr = bufb;
@@ -254,7 +639,7 @@ int compareStringObjectWithFlags(robj *a, robj *b, int flags) {
         int cmp;
         minlen = (alen < blen) ? alen : blen;
         cmp = memcmp(astr, bstr, minlen);
-        if (cmp == 0) return alen - blen;
+        if (cmp == 0) return (alen < blen) ? -1 : (alen > blen);
         return cmp;
     }
 }
@@ -289,17 +674,109 @@ int collareStringObject(robj *a, robj *b) {
  * 更快一些
 */
 int equalStringObjects(robj *a, robj *b) {
-    // 这里的对象编码为 INT，直接对比值
+    // 这里的对象编码都为 INT 或者都为 INLINE，直接对比值
     // 这里避免了将整数值转换为字符串，所以效率更高
-    if (a->encoding == REDIS_ENCODING_INT &&
-        b->encoding == REDIS_ENCODING_INT) {
+    if ((a->encoding == REDIS_ENCODING_INT &&
+         b->encoding == REDIS_ENCODING_INT) ||
+        (a->encoding == REDIS_ENCODING_INLINE &&
+         b->encoding == REDIS_ENCODING_INLINE)) {
         /*
          * If both strings are integer encoded just check if the 
-         * stored long is the same
+         * stored long is the same. The same holds for inline strings,
+         * whose length and zero padding are part of the ptr field.
         */
         return a->ptr == b->ptr;
+    } else if (sdsEncodedObject(a) && sdsEncodedObject(b)) {
+    // 长度保存在 sds 头部，长度不同的字符串不需要对比内容
+        return sdslen(a->ptr) == sdslen(b->ptr) &&
+               memcmp(a->ptr, b->ptr, sdslen(a->ptr)) == 0;
     } else {
     // 进行字符串比较
         return compareStringObjects(a, b) == 0;
     }
-}
\ No newline at end of file
+}
+
+#ifdef OBJECT_TEST_MAIN
+#include <stdio.h>
+#include "testhelp.h"
+
+/*
+ * Memory used by small string values: "u:<n>" with n in base 36, so that
+ * 10M values are at most 7 bytes, stored as embstr (what
+ * createStringObject() returns) and after tryObjectEncoding() turned them
+ * into INLINE objects. The bytes are counted by zmalloc_used_memory().
+*/
+/*
+ * 小字符串值使用的内存："u:<n>"，n 使用 36 进制，这样 1000 万个值都不超过 7 字节
+ * 分别以 embstr（createStringObject() 的返回值）保存，
+ * 以及经过 tryObjectEncoding() 转换为 INLINE 对象之后保存，字节数由 zmalloc_used_memory() 统计
+*/
+#define OBJECT_BENCH_VALUES 10000000
+
+// 将 "u:<n>" 写入 buf，返回长度
+static int objectBenchValue(char *buf, long n) {
+    char digits[16];
+    int len = 0, j = 0;
+
+    do {
+        digits[len++] = "0123456789abcdefghijklmnopqrstuvwxyz"[n % 36];
+        n /= 36;
+    } while (n);
+    buf[j++] = 'u';
+    buf[j++] = ':';
+    while (len) buf[j++] = digits[--len];
+    return j;
+}
+
+/*
+ * Create count values, with tryObjectEncoding() if encode is set, and
+ * return the bytes allocated per value.
+*/
+// 创建 count 个值，encode 为真时使用 tryObjectEncoding() 编码，返回每个值分配的字节数
+static double objectBenchBytesPerValue(robj **values, long count, int encode) {
+    size_t before = zmalloc_used_memory(), after;
+    char buf[16];
+    long j;
+
+    for (j = 0; j < count; j++) {
+        values[j] = createStringObject(buf, objectBenchValue(buf, j));
+        if (encode) values[j] = tryObjectEncoding(values[j]);
+    }
+    after = zmalloc_used_memory();
+    for (j = 0; j < count; j++) decrRefCount(values[j]);
+    return (double)(after - before) / count;
+}
+
+int main(int argc, char **argv) {
+    long count = (argc > 1) ? atol(argv[1]) : OBJECT_BENCH_VALUES, j;
+    robj **values = zmalloc(sizeof(robj*) * count);
+    double embstr, inl;
+    char buf[16];
+    int ok = 1;
+
+    server.maxmemory = 0;
+    createSharedIntegers();
+
+    for (j = 0; j < count && ok; j += 997) {
+        int len = objectBenchValue(buf, j);
+        robj *o = tryObjectEncoding(createStringObject(buf, len));
+        robj *dec = getDecodedObject(o);
+
+        ok = o->encoding == REDIS_ENCODING_INLINE &&
+             sdslen(dec->ptr) == (size_t)len && memcmp(dec->ptr, buf, len) == 0;
+        decrRefCount(dec);
+        decrRefCount(o);
+    }
+    test_cond("Short strings are INLINE encoded and decode back", ok);
+
+    embstr = objectBenchBytesPerValue(values, count, 0);
+    inl = objectBenchBytesPerValue(values, count, 1);
+    printf("%ld \"u:<n>\" values (%s): embstr %.1f bytes/value, "
+        "INLINE %.1f bytes/value\n", count, ZMALLOC_LIB, embstr, inl);
+    test_cond("INLINE values use less memory than embstr", inl < embstr);
+
+    zfree(values);
+    test_report();
+    return 0;
+}
+#endif
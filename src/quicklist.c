@@ -0,0 +1,1714 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "quicklist.h"
+#include "zmalloc.h"
+#include "util.h"
+#include "lzf.h"
+#include "redisassert.h"
+
+/*
+ * Maximum node size in bytes for the negative fill factors -1 .. -5
+*/
+// 负数填充因子 -1 .. -5 对应的结点最大字节数
+static const size_t optimization_level[] = {4096, 8192, 16384, 32768, 65536};
+
+/*
+ * With a positive fill a node is limited by its number of entries, but a
+ * few large values must not be able to make it arbitrarily big: past
+ * this size no entry is added to the node whatever the fill says.
+*/
+// 使用正数填充因子时，结点的大小也不能超过这个限制
+#define SIZE_SAFETY_LIMIT 8192
+
+// 结点可以保存的最大项数，受 count 域的位数限制
+#define QUICKLIST_NODE_MAX_COUNT 65535
+
+/*
+ * Integers are stored as zigzag(value) << 1, that must fit in 64 bits:
+ * values outside of this range are stored as strings.
+*/
+// 整数以 zigzag(value) << 1 保存，必须能放进 64 位，范围以外的值以字符串保存
+#define QUICKLIST_INT_MIN (-(1LL << 62))
+#define QUICKLIST_INT_MAX ((1LL << 62) - 1)
+
+// 整数的字符串表示的最大长度
+#define QUICKLIST_INT_MAX_STRLEN 20
+
+// 小于这个字节数的结点不进行压缩
+#define MIN_COMPRESS_BYTES 48
+
+// 压缩至少要节省这么多字节，否则结点保持原样
+#define MIN_COMPRESS_IMPROVE 8
+
+/* ------------------------------ Entry encoding ------------------------------ */
+
+/*
+ * Write v as a little endian base 128 varint in p, or just compute its
+ * length if p is NULL. Returns the number of bytes used.
+ *
+ * T = O(1)
+*/
+/*
+ * 将 v 以小端 128 进制变长整数写入 p，p 为 NULL 时只计算长度
+ * 返回使用的字节数
+*/
+static unsigned int _qlVarintEncode(unsigned char *p, uint64_t v) {
+    unsigned int len = 1;
+
+    if (p == NULL) {
+        while (v >= 128) { v >>= 7; len++; }
+        return len;
+    }
+
+    while (v >= 128) {
+        *p++ = (unsigned char)(v | 128);
+        v >>= 7;
+        len++;
+    }
+    *p = (unsigned char)v;
+    return len;
+}
+
+/*
+ * Read the varint at p. Returns the number of bytes used.
+ *
+ * T = O(1)
+*/
+// 读取 p 处的变长整数，返回使用的字节数
+static unsigned int _qlVarintDecode(const unsigned char *p, uint64_t *v) {
+    uint64_t val = 0;
+    unsigned int len = 0;
+    int shift = 0;
+
+    do {
+        val |= (uint64_t)(p[len] & 127) << shift;
+        shift += 7;
+    } while (p[len++] & 128);
+
+    *v = val;
+    return len;
+}
+
+/*
+ * Write the back length l in p, or just compute its length if p is NULL.
+ *
+ * The encoding is read from its last byte: every byte holds 7 bits, the
+ * least significant ones in the last byte, and the high bit of a byte is
+ * set when more bytes precede it.
+ *
+ * T = O(1)
+*/
+/*
+ * 将反向长度 l 写入 p，p 为 NULL 时只计算长度
+ *
+ * 这种编码从最后一个字节开始读取：每个字节保存 7 位，最低的 7 位保存在最后一个字节，
+ * 字节的最高位为 1 表示它前面还有字节
+*/
+static unsigned int _qlBacklenEncode(unsigned char *p, uint64_t l) {
+    unsigned int len = _qlVarintEncode(NULL, l), j;
+
+    if (p == NULL) return len;
+
+    for (j = len; j > 0; j--) {
+        p[j - 1] = (unsigned char)((l & 127) | (j > 1 ? 128 : 0));
+        l >>= 7;
+    }
+    return len;
+}
+
+/*
+ * Read the back length ending right before p. Returns the number of
+ * bytes used.
+ *
+ * T = O(1)
+*/
+// 读取在 p 之前结束的反向长度，返回使用的字节数
+static unsigned int _qlBacklenDecode(const unsigned char *p, uint64_t *l) {
+    uint64_t val = 0;
+    unsigned int len = 0;
+
+    do {
+        len++;
+        val |= (uint64_t)(p[-(int)len] & 127) << (7 * (len - 1));
+    } while (p[-(int)len] & 128);
+
+    *l = val;
+    return len;
+}
+
+/*
+ * Return 1 and the integer value if the string can be stored as an
+ * integer entry.
+ *
+ * T = O(1)
+*/
+// 如果字符串可以作为整数项保存，返回 1 并设置 v
+static int _qlTryInteger(const void *value, size_t sz, long long *v) {
+    if (sz == 0 || sz > QUICKLIST_INT_MAX_STRLEN) return 0;
+    if (!string2ll(value, sz, v)) return 0;
+    return *v >= QUICKLIST_INT_MIN && *v <= QUICKLIST_INT_MAX;
+}
+
+/*
+ * Encode an entry in p, or just compute its length if p is NULL.
+ * Returns the total number of bytes of the entry.
+ *
+ * T = O(N)
+*/
+// 将列表项编码到 p 中，p 为 NULL 时只计算长度，返回列表项的总字节数
+static size_t _qlEntryEncode(unsigned char *p, const void *value, size_t sz) {
+    unsigned int hlen, blen;
+    long long v;
+    uint64_t h;
+
+    if (_qlTryInteger(value, sz, &v)) {
+        // zigzag 编码，使绝对值小的负数也只占用很少的字节
+        h = ((((uint64_t)v) << 1) ^ (uint64_t)(v >> 63)) << 1 | 1;
+        sz = 0;
+    } else {
+        h = (uint64_t)sz << 1;
+    }
+
+    hlen = _qlVarintEncode(p, h);
+    if (p != NULL && sz) memcpy(p + hlen, value, sz);
+    blen = _qlBacklenEncode(p ? p + hlen + sz : NULL, hlen + sz);
+    return hlen + sz + blen;
+}
+
+/*
+ * Decode the entry at p in entry (value, sz and longval). Returns the
+ * total number of bytes of the entry.
+ *
+ * T = O(1)
+*/
+// 将 p 处的列表项解码到 entry 中，返回列表项的总字节数
+static size_t _qlEntryDecode(unsigned char *p, quicklistEntry *entry) {
+    unsigned int hlen;
+    size_t len;
+    uint64_t h, zz;
+
+    hlen = _qlVarintDecode(p, &h);
+    if (h & 1) {
+        zz = h >> 1;
+        entry->value = NULL;
+        entry->sz = 0;
+        entry->longval = (long long)(zz >> 1) ^ -(long long)(zz & 1);
+        len = hlen;
+    } else {
+        entry->value = p + hlen;
+        entry->sz = (unsigned int)(h >> 1);
+        entry->longval = -123456789;
+        len = hlen + entry->sz;
+    }
+    return len + _qlBacklenEncode(NULL, len);
+}
+
+/*
+ * Return the total number of bytes of the entry at p.
+ *
+ * T = O(1)
+*/
+// 返回 p 处列表项的总字节数
+static size_t _qlEntryLen(const unsigned char *p) {
+    unsigned int hlen;
+    size_t len;
+    uint64_t h;
+
+    hlen = _qlVarintDecode(p, &h);
+    len = hlen + ((h & 1) ? 0 : (size_t)(h >> 1));
+    return len + _qlBacklenEncode(NULL, len);
+}
+
+/*
+ * Return the entry following p in the node, or NULL if p is the last.
+ *
+ * T = O(1)
+*/
+// 返回结点中 p 之后的列表项，p 是最后一项时返回 NULL
+static unsigned char *_qlEntryNext(const quicklistNode *node, unsigned char *p) {
+    p += _qlEntryLen(p);
+    return p == node->entries + node->sz ? NULL : p;
+}
+
+/*
+ * Return the entry preceding p in the node, or NULL if p is the first.
+ * Passing the end of the node returns its last entry.
+ *
+ * T = O(1)
+*/
+/*
+ * 返回结点中 p 之前的列表项，p 是第一项时返回 NULL
+ * 传入结点的末尾时返回最后一项
+*/
+static unsigned char *_qlEntryPrev(const quicklistNode *node, unsigned char *p) {
+    uint64_t l;
+    unsigned int blen;
+
+    if (p == node->entries) return NULL;
+    blen = _qlBacklenDecode(p, &l);
+    return p - blen - l;
+}
+
+/* ------------------------------- Node helpers ------------------------------- */
+
+/*
+ * Create a new empty node.
+ *
+ * T = O(1)
+*/
+// 创建一个新的空结点
+static quicklistNode *_quicklistCreateNode(void) {
+    quicklistNode *node = zmalloc(sizeof(*node));
+
+    node->prev = node->next = NULL;
+    node->entries = NULL;
+    node->sz = 0;
+    node->count = 0;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+    node->recompress = 0;
+    return node;
+}
+
+/*
+ * Return 1 if an entry of newsz bytes can be added to the node without
+ * breaking the fill factor.
+ *
+ * T = O(1)
+*/
+// 如果可以在不超出填充因子的前提下将 newsz 字节的项添加到结点中，返回 1
+static int _quicklistNodeAllowInsert(const quicklistNode *node, int fill,
+                                     size_t newsz) {
+    size_t new_sz;
+
+    if (node == NULL) return 0;
+    if (node->count >= QUICKLIST_NODE_MAX_COUNT) return 0;
+
+    new_sz = node->sz + newsz;
+    if (fill >= 0) {
+        return (int)node->count < fill && new_sz <= SIZE_SAFETY_LIMIT;
+    } else {
+        size_t idx = (size_t)(-fill) - 1;
+        size_t limit = idx < sizeof(optimization_level) / sizeof(*optimization_level) ?
+                       optimization_level[idx] : SIZE_SAFETY_LIMIT;
+        return new_sz <= limit;
+    }
+}
+
+/*
+ * Insert an entry at byte offset pos of the node.
+ *
+ * T = O(N)
+*/
+// 在结点的 pos 字节偏移处插入一个列表项
+static void _quicklistNodeInsertAt(quicklistNode *node, size_t pos,
+                                   const void *value, size_t sz) {
+    size_t len = _qlEntryEncode(NULL, value, sz);
+
+    node->entries = zrealloc(node->entries, node->sz + len);
+    memmove(node->entries + pos + len, node->entries + pos, node->sz - pos);
+    _qlEntryEncode(node->entries + pos, value, sz);
+    node->sz += len;
+    node->count++;
+}
+
+/*
+ * Remove len bytes holding count entries at byte offset pos of the node.
+ *
+ * T = O(N)
+*/
+// 删除结点中从 pos 字节偏移开始、共 len 字节的 count 个列表项
+static void _quicklistNodeDelBytes(quicklistNode *node, size_t pos, size_t len,
+                                   unsigned int count) {
+    memmove(node->entries + pos, node->entries + pos + len, node->sz - pos - len);
+    node->sz -= len;
+    node->count -= count;
+    // 结点为空时由调用者释放
+    if (node->sz) node->entries = zrealloc(node->entries, node->sz);
+}
+
+/*
+ * Link new_node before (after == 0) or after (after == 1) old_node, or as
+ * the only node when old_node is NULL.
+ *
+ * T = O(1)
+*/
+/*
+ * 将 new_node 链接到 old_node 之前（after == 0）或之后（after == 1），
+ * old_node 为 NULL 时 new_node 成为唯一的结点
+*/
+static void _quicklistInsertNode(quicklist *quicklist, quicklistNode *old_node,
+                                 quicklistNode *new_node, int after) {
+    if (after) {
+        new_node->prev = old_node;
+        if (old_node) {
+            new_node->next = old_node->next;
+            if (old_node->next) old_node->next->prev = new_node;
+            old_node->next = new_node;
+        }
+        if (quicklist->tail == old_node) quicklist->tail = new_node;
+    } else {
+        new_node->next = old_node;
+        if (old_node) {
+            new_node->prev = old_node->prev;
+            if (old_node->prev) old_node->prev->next = new_node;
+            old_node->prev = new_node;
+        }
+        if (quicklist->head == old_node) quicklist->head = new_node;
+    }
+
+    if (quicklist->len == 0) quicklist->head = quicklist->tail = new_node;
+    quicklist->len++;
+}
+
+/*
+ * Unlink and free the node.
+ *
+ * T = O(1)
+*/
+// 解除结点的链接并释放它
+static void _quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
+    if (node->next) node->next->prev = node->prev;
+    if (node->prev) node->prev->next = node->next;
+    if (node == quicklist->tail) quicklist->tail = node->prev;
+    if (node == quicklist->head) quicklist->head = node->next;
+
+    quicklist->count -= node->count;
+    quicklist->len--;
+
+    if (quicklist->unpacked == node) quicklist->unpacked = NULL;
+
+    zfree(node->entries);
+    zfree(node);
+}
+
+/*
+ * Split the node at byte offset pos, offset being the number of entries
+ * before pos: the entries from pos on move to a new node linked after it,
+ * which is returned.
+ *
+ * T = O(N)
+*/
+/*
+ * 在 pos 字节偏移处分裂结点，offset 是 pos 之前的项数：
+ * pos 之后的项移动到链接在它之后的新结点中，返回新结点
+*/
+static quicklistNode *_quicklistSplitNode(quicklist *quicklist, quicklistNode *node,
+                                          size_t pos, unsigned int offset) {
+    quicklistNode *new_node = _quicklistCreateNode();
+
+    new_node->sz = node->sz - pos;
+    new_node->count = node->count - offset;
+    new_node->entries = zmalloc(new_node->sz);
+    memcpy(new_node->entries, node->entries + pos, new_node->sz);
+
+    node->sz = (unsigned int)pos;
+    node->count = offset;
+    node->entries = zrealloc(node->entries, node->sz);
+
+    // 项数只是在两个结点之间转移，quicklist->count 不变
+    _quicklistInsertNode(quicklist, node, new_node, 1);
+    return new_node;
+}
+
+/* -------------------------------- Compression -------------------------------- */
+
+/*
+ * LZF compress the node in place. Nodes that are too small, or that
+ * don't shrink by at least MIN_COMPRESS_IMPROVE bytes, are left raw.
+ *
+ * Returns 1 if the node is compressed.
+ *
+ * T = O(N) in the size of the node
+*/
+/*
+ * 使用 LZF 原地压缩结点，太小的结点，或者压缩后节省不到 MIN_COMPRESS_IMPROVE 字节的结点
+ * 保持原样
+ *
+ * 结点被压缩时返回 1
+*/
+static int _quicklistCompressNode(quicklist *quicklist, quicklistNode *node) {
+    quicklistLZF *lzf;
+
+    node->recompress = 0;
+    if (quicklist->unpacked == node) quicklist->unpacked = NULL;
+
+    if (node->encoding == QUICKLIST_NODE_ENCODING_LZF) return 1;
+    if (node->sz < MIN_COMPRESS_BYTES) return 0;
+
+    // 只在压缩结果足够小时才保留
+    lzf = zmalloc(sizeof(*lzf) + node->sz - MIN_COMPRESS_IMPROVE);
+    lzf->sz = lzf_compress(node->entries, node->sz, lzf->compressed,
+                           node->sz - MIN_COMPRESS_IMPROVE);
+    if (lzf->sz == 0) {
+        zfree(lzf);
+        return 0;
+    }
+
+    lzf = zrealloc(lzf, sizeof(*lzf) + lzf->sz);
+    zfree(node->entries);
+    node->entries = (unsigned char *)lzf;
+    node->encoding = QUICKLIST_NODE_ENCODING_LZF;
+    return 1;
+}
+
+/*
+ * Decompress the node in place.
+ *
+ * T = O(N) in the size of the node
+*/
+// 原地解压结点
+static void _quicklistDecompressNode(quicklistNode *node) {
+    quicklistLZF *lzf = (quicklistLZF *)node->entries;
+    unsigned char *raw;
+
+    if (node->encoding == QUICKLIST_NODE_ENCODING_RAW) return;
+
+    raw = zmalloc(node->sz);
+    if (lzf_decompress(lzf->compressed, lzf->sz, raw, node->sz) != node->sz) {
+        // 只有内存被破坏时才会发生
+        assert(0);
+    }
+    zfree(lzf);
+    node->entries = raw;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+}
+
+/*
+ * Make the entries of the node readable before an access.
+ *
+ * A compressed node is decompressed and flagged for recompression. Only
+ * one such node is kept per quicklist: the previous one is compressed
+ * again first, so walking the interior of a list costs one decompression
+ * per node, and reading the same node twice costs nothing, without ever
+ * leaving more than a node raw.
+ *
+ * Pointers into the entries of a node stay valid until another node of
+ * the quicklist is accessed or the quicklist is modified.
+ *
+ * T = O(N) in the size of the node
+*/
+/*
+ * 在访问结点之前，确保它的列表项可以直接读取
+ *
+ * 被压缩的结点会被解压，并标记为需要重新压缩，
+ * 每个快速列表只保留一个这样的结点：之前的那个会先被重新压缩，
+ * 所以遍历列表中间部分时每个结点只需要解压一次，重复读取同一个结点没有额外开销，
+ * 同时也不会有多于一个中间结点保持解压状态
+ *
+ * 指向结点列表项的指针在访问快速列表的另一个结点，或者修改快速列表之前都是有效的
+*/
+static void _quicklistNodeForUse(quicklist *quicklist, quicklistNode *node) {
+    quicklistNode *old = quicklist->unpacked;
+
+    if (node->encoding == QUICKLIST_NODE_ENCODING_RAW) return;
+
+    if (old && old != node && old->recompress) _quicklistCompressNode(quicklist, old);
+
+    _quicklistDecompressNode(node);
+    node->recompress = 1;
+    quicklist->unpacked = node;
+}
+
+/*
+ * Restore the compression invariant around node after a change: the
+ * compress nodes at each end are raw, the node itself is compressed if it
+ * lies between them, and so are the nodes right past the raw ends, which
+ * may have just moved to the interior. node may be NULL after a node was
+ * removed.
+ *
+ * T = O(compress + N) in the size of the nodes compressed
+*/
+/*
+ * 在修改之后恢复 node 附近的压缩约束：两端各 compress 个结点保持原样，
+ * node 位于它们之间时被压缩，紧挨着两端不压缩部分的结点也被压缩，
+ * 因为它们可能刚刚移动到列表中间，删除结点之后 node 可以为 NULL
+*/
+static void _quicklistCompress(quicklist *quicklist, quicklistNode *node) {
+    quicklistNode *forward = quicklist->head, *reverse = quicklist->tail;
+    int depth = 0, in_depth = 0;
+
+    if (quicklist->compress == 0 || forward == NULL) return;
+
+    while (depth++ < quicklist->compress) {
+        _quicklistDecompressNode(forward);
+        _quicklistDecompressNode(reverse);
+        forward->recompress = reverse->recompress = 0;
+        if (quicklist->unpacked == forward || quicklist->unpacked == reverse)
+            quicklist->unpacked = NULL;
+
+        if (forward == node || reverse == node) in_depth = 1;
+
+        // 整个列表都在两端的不压缩范围之内
+        if (forward == reverse || forward->next == reverse) return;
+
+        forward = forward->next;
+        reverse = reverse->prev;
+    }
+
+    if (node && !in_depth) _quicklistCompressNode(quicklist, node);
+    _quicklistCompressNode(quicklist, forward);
+    _quicklistCompressNode(quicklist, reverse);
+}
+
+/*
+ * Compress the node again if it was only decompressed for an access.
+ *
+ * T = O(N) in the size of the node
+*/
+// 如果结点只是为了访问而被解压，重新压缩它
+static void _quicklistRecompressOnly(quicklist *quicklist, quicklistNode *node) {
+    if (node && node->recompress) _quicklistCompressNode(quicklist, node);
+}
+
+/* ------------------------------ List interface ------------------------------ */
+
+/*
+ * Create a new quicklist with the default fill factor.
+ *
+ * T = O(1)
+*/
+// 创建一个使用默认填充因子的快速列表
+quicklist *quicklistCreate(void) {
+    quicklist *quicklist = zmalloc(sizeof(*quicklist));
+
+    quicklist->head = quicklist->tail = NULL;
+    quicklist->len = 0;
+    quicklist->count = 0;
+    quicklist->fill = QUICKLIST_DEFAULT_FILL;
+    quicklist->compress = QUICKLIST_DEFAULT_COMPRESS;
+    quicklist->unpacked = NULL;
+    return quicklist;
+}
+
+/*
+ * Set the fill factor, see quicklist.h. Affects nodes filled from now on.
+ *
+ * T = O(1)
+*/
+// 设置填充因子，只影响之后填充的结点
+void quicklistSetFill(quicklist *quicklist, int fill) {
+    int min = -(int)(sizeof(optimization_level) / sizeof(*optimization_level));
+
+    if (fill > QUICKLIST_NODE_MAX_COUNT) fill = QUICKLIST_NODE_MAX_COUNT;
+    else if (fill < min) fill = min;
+    // 0 项的结点没有意义
+    else if (fill == 0) fill = 1;
+    quicklist->fill = fill;
+}
+
+/*
+ * Set the compress depth, see quicklist.h, and compress or decompress the
+ * existing nodes accordingly.
+ *
+ * T = O(N)
+*/
+// 设置压缩深度，并据此压缩或解压已有的结点
+void quicklistSetCompressDepth(quicklist *quicklist, int depth) {
+    quicklistNode *node;
+    unsigned long j = 0;
+
+    if (depth < 0) depth = 0;
+    else if (depth > QUICKLIST_NODE_MAX_COUNT) depth = QUICKLIST_NODE_MAX_COUNT;
+    quicklist->compress = depth;
+
+    for (node = quicklist->head; node; node = node->next, j++) {
+        if (depth == 0 || j < (unsigned long)depth ||
+            j >= quicklist->len - depth) {
+            _quicklistDecompressNode(node);
+            node->recompress = 0;
+        } else {
+            _quicklistCompressNode(quicklist, node);
+        }
+    }
+    quicklist->unpacked = NULL;
+}
+
+/*
+ * Create a new quicklist with the given fill factor and compress depth.
+ *
+ * T = O(1)
+*/
+// 创建一个使用给定填充因子和压缩深度的快速列表
+quicklist *quicklistNew(int fill, int compress) {
+    quicklist *quicklist = quicklistCreate();
+
+    quicklistSetFill(quicklist, fill);
+    quicklistSetCompressDepth(quicklist, compress);
+    return quicklist;
+}
+
+/*
+ * Free the quicklist and all its nodes.
+ *
+ * T = O(N) nodes
+*/
+// 释放快速列表及其所有结点
+void quicklistRelease(quicklist *quicklist) {
+    quicklistNode *current, *next;
+
+    current = quicklist->head;
+    while (current) {
+        next = current->next;
+        zfree(current->entries);
+        zfree(current);
+        current = next;
+    }
+    zfree(quicklist);
+}
+
+/*
+ * Add a new entry at the head of the quicklist.
+ *
+ * Returns 1 if a new node was created, 0 if the entry went in the
+ * existing head node.
+ *
+ * T = O(N) in the size of the head node
+*/
+/*
+ * 将新项添加到快速列表的表头
+ *
+ * 创建了新结点返回 1，项被添加到已有的表头结点时返回 0
+*/
+int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_head = quicklist->head;
+    int created = 0;
+
+    if (!_quicklistNodeAllowInsert(orig_head, quicklist->fill,
+                                   _qlEntryEncode(NULL, value, sz))) {
+        quicklistNode *node = _quicklistCreateNode();
+        _quicklistInsertNode(quicklist, orig_head, node, 0);
+        created = 1;
+    }
+    _quicklistNodeForUse(quicklist, quicklist->head);
+    _quicklistNodeInsertAt(quicklist->head, 0, value, sz);
+    quicklist->count++;
+
+    // 原来的表头结点可能移动到了列表中间
+    if (created) _quicklistCompress(quicklist, quicklist->head);
+    return created;
+}
+
+/*
+ * Add a new entry at the tail of the quicklist.
+ *
+ * Returns 1 if a new node was created, 0 if the entry went in the
+ * existing tail node.
+ *
+ * T = O(1) amortized
+*/
+/*
+ * 将新项添加到快速列表的表尾
+ *
+ * 创建了新结点返回 1，项被添加到已有的表尾结点时返回 0
+*/
+int quicklistPushTail(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_tail = quicklist->tail;
+    int created = 0;
+
+    if (!_quicklistNodeAllowInsert(orig_tail, quicklist->fill,
+                                   _qlEntryEncode(NULL, value, sz))) {
+        quicklistNode *node = _quicklistCreateNode();
+        _quicklistInsertNode(quicklist, orig_tail, node, 1);
+        created = 1;
+    }
+    _quicklistNodeForUse(quicklist, quicklist->tail);
+    _quicklistNodeInsertAt(quicklist->tail, quicklist->tail->sz, value, sz);
+    quicklist->count++;
+
+    // 原来的表尾结点可能移动到了列表中间
+    if (created) _quicklistCompress(quicklist, quicklist->tail);
+    return created;
+}
+
+/*
+ * Add a new entry at the head (QUICKLIST_HEAD) or at the tail
+ * (QUICKLIST_TAIL) of the quicklist.
+ *
+ * T = O(N) in the size of the node
+*/
+// 将新项添加到快速列表的表头（QUICKLIST_HEAD）或表尾（QUICKLIST_TAIL）
+void quicklistPush(quicklist *quicklist, void *value, size_t sz, int where) {
+    if (where == QUICKLIST_HEAD) {
+        quicklistPushHead(quicklist, value, sz);
+    } else if (where == QUICKLIST_TAIL) {
+        quicklistPushTail(quicklist, value, sz);
+    }
+}
+
+/*
+ * Delete the entry at p in the node, freeing the node if it becomes empty.
+ * The node must be raw.
+ *
+ * Returns 1 if the node was freed.
+ *
+ * T = O(N) in the size of the node
+*/
+// 删除结点中 p 处的列表项，结点变为空时将其释放，结点必须是未压缩的，释放了结点时返回 1
+static int _quicklistDelIndex(quicklist *quicklist, quicklistNode *node,
+                              unsigned char *p) {
+    _quicklistNodeDelBytes(node, p - node->entries, _qlEntryLen(p), 1);
+    quicklist->count--;
+
+    if (node->count == 0) {
+        _quicklistDelNode(quicklist, node);
+        // 中间的结点可能移动到了列表两端
+        _quicklistCompress(quicklist, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Remove the head (QUICKLIST_HEAD) or tail (QUICKLIST_TAIL) entry.
+ *
+ * Strings are returned in *data as a zmalloc()ed copy of *sz bytes that
+ * the caller has to free, integers are returned in *sval with *data set
+ * to NULL. Any output pointer may be NULL.
+ *
+ * Returns 0 if the quicklist is empty, 1 otherwise.
+ *
+ * T = O(N) in the size of the node
+*/
+/*
+ * 弹出表头（QUICKLIST_HEAD）或表尾（QUICKLIST_TAIL）的项
+ *
+ * 字符串通过 *data 返回，它是长度为 *sz 的 zmalloc() 副本，由调用者负责释放，
+ * 整数通过 *sval 返回，同时 *data 被设为 NULL，任何输出指针都可以为 NULL
+ *
+ * 快速列表为空时返回 0，否则返回 1
+*/
+int quicklistPop(quicklist *quicklist, int where, unsigned char **data,
+                 unsigned int *sz, long long *sval) {
+    quicklistNode *node;
+    quicklistEntry entry;
+    unsigned char *p;
+
+    if (quicklist->count == 0) return 0;
+
+    node = where == QUICKLIST_HEAD ? quicklist->head : quicklist->tail;
+    _quicklistNodeForUse(quicklist, node);
+    p = where == QUICKLIST_HEAD ? node->entries :
+        _qlEntryPrev(node, node->entries + node->sz);
+
+    _qlEntryDecode(p, &entry);
+    if (data) {
+        if (entry.value) {
+            *data = zmalloc(entry.sz ? entry.sz : 1);
+            memcpy(*data, entry.value, entry.sz);
+        } else {
+            *data = NULL;
+        }
+    }
+    if (sz) *sz = entry.sz;
+    if (sval) *sval = entry.longval;
+
+    _quicklistDelIndex(quicklist, node, p);
+    return 1;
+}
+
+/*
+ * Find the entry at index and describe it in entry. Negative indexes
+ * count from the tail, -1 being the last entry.
+ *
+ * Whole nodes are skipped using their entry count, starting from the end
+ * of the list nearer to the index, then the node is walked from its
+ * nearer end, so the cost is the number of nodes skipped plus half a node
+ * at most, instead of one pointer hop per element.
+ *
+ * Returns 1 if the entry was found, 0 if the index is out of range.
+ *
+ * T = O(N / fill + fill)
+*/
+/*
+ * 查找给定索引上的项，并通过 entry 描述它，负数索引从表尾开始计算，-1 为最后一项
+ *
+ * 从离索引较近的一端开始，利用结点的项数整个跳过结点，
+ * 然后从结点中较近的一端开始遍历，
+ * 所以开销是跳过的结点数加上最多半个结点，而不是每个元素一次指针跳转
+ *
+ * 找到返回 1，索引超出范围返回 0
+*/
+int quicklistIndex(quicklist *quicklist, long index, quicklistEntry *entry) {
+    quicklistNode *n;
+    unsigned long accum = 0, target;
+    int forward;
+    long j, offset;
+    unsigned char *p;
+
+    // 超出范围
+    if (index >= 0 ? (unsigned long)index >= quicklist->count :
+                     (unsigned long)(-(index + 1)) >= quicklist->count)
+        return 0;
+
+    // 转换为从表头开始的索引，然后选择较近的一端
+    target = index >= 0 ? (unsigned long)index : quicklist->count + index;
+    forward = target < quicklist->count / 2;
+    if (!forward) target = quicklist->count - 1 - target;
+
+    n = forward ? quicklist->head : quicklist->tail;
+    while (accum + n->count <= target) {
+        accum += n->count;
+        n = forward ? n->next : n->prev;
+    }
+
+    // 项在结点中的序号
+    offset = forward ? (long)(target - accum) : (long)(n->count - 1 - (target - accum));
+
+    _quicklistNodeForUse(quicklist, n);
+
+    if (offset < (long)n->count / 2) {
+        p = n->entries;
+        for (j = 0; j < offset; j++) p += _qlEntryLen(p);
+    } else {
+        p = n->entries + n->sz;
+        for (j = n->count; j > offset; j--) p = _qlEntryPrev(n, p);
+    }
+
+    entry->quicklist = quicklist;
+    entry->node = n;
+    entry->p = p;
+    entry->offset = (int)offset;
+    _qlEntryDecode(p, entry);
+    return 1;
+}
+
+/*
+ * Insert a new entry before (after == 0) or after (after == 1) the given
+ * entry. The entry becomes invalid.
+ *
+ * The new entry goes, in order of preference, in the node of the entry,
+ * in the neighbour node when the entry is at its edge, in a new node when
+ * the neighbour is full too, or in the first half of the node split at
+ * the insertion point. Every node touched is compressed again if it lies
+ * in the interior of the list.
+ *
+ * T = O(N) in the size of the node
+*/
+/*
+ * 在给定项之前（after == 0）或之后（after == 1）插入新项，给定项会失效
+ *
+ * 新项按照以下顺序选择位置：给定项所在的结点；
+ * 给定项位于结点边缘时的相邻结点；相邻结点也已满时的新结点；
+ * 或者在插入位置分裂结点后的前半部分
+*/
+static void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
+                             void *value, size_t sz, int after) {
+    quicklistNode *node = entry->node, *new_node;
+    size_t len = _qlEntryEncode(NULL, value, sz), pos;
+    unsigned int offset;
+    int fill = quicklist->fill;
+
+    // 列表为空
+    if (node == NULL) {
+        quicklistPushHead(quicklist, value, sz);
+        return;
+    }
+
+    // 插入位置的字节偏移，以及它之前的项数
+    pos = entry->p - node->entries;
+    offset = entry->offset;
+    if (after) {
+        pos += _qlEntryLen(entry->p);
+        offset++;
+    }
+
+    // entry 来自 quicklistIndex() 或迭代器，结点已经是未压缩的
+    _quicklistNodeForUse(quicklist, node);
+
+    if (_quicklistNodeAllowInsert(node, fill, len)) {
+        _quicklistNodeInsertAt(node, pos, value, sz);
+        _quicklistCompress(quicklist, node);
+    } else if (pos == node->sz &&
+               _quicklistNodeAllowInsert(node->next, fill, len)) {
+        // 插入到下一个结点的表头
+        new_node = node->next;
+        _quicklistNodeForUse(quicklist, new_node);
+        _quicklistNodeInsertAt(new_node, 0, value, sz);
+        _quicklistCompress(quicklist, new_node);
+    } else if (pos == 0 && _quicklistNodeAllowInsert(node->prev, fill, len)) {
+        // 插入到上一个结点的表尾
+        new_node = node->prev;
+        _quicklistNodeForUse(quicklist, new_node);
+        _quicklistNodeInsertAt(new_node, new_node->sz, value, sz);
+        _quicklistCompress(quicklist, new_node);
+    } else if (pos == node->sz || pos == 0) {
+        // 相邻结点也已满，创建新结点
+        new_node = _quicklistCreateNode();
+        _quicklistInsertNode(quicklist, node, new_node, pos != 0);
+        _quicklistNodeInsertAt(new_node, 0, value, sz);
+        _quicklistCompress(quicklist, node);
+        _quicklistCompress(quicklist, new_node);
+    } else {
+        // 在插入位置分裂结点，新项添加到前半部分的表尾
+        new_node = _quicklistSplitNode(quicklist, node, pos, offset);
+        if (_quicklistNodeAllowInsert(node, fill, len)) {
+            _quicklistNodeInsertAt(node, node->sz, value, sz);
+        } else if (_quicklistNodeAllowInsert(new_node, fill, len)) {
+            _quicklistNodeInsertAt(new_node, 0, value, sz);
+        } else {
+            quicklistNode *mid = _quicklistCreateNode();
+            _quicklistInsertNode(quicklist, node, mid, 1);
+            _quicklistNodeInsertAt(mid, 0, value, sz);
+            _quicklistCompress(quicklist, mid);
+        }
+        _quicklistCompress(quicklist, node);
+        _quicklistCompress(quicklist, new_node);
+    }
+    quicklist->count++;
+}
+
+/*
+ * Insert a new entry before the given entry.
+ *
+ * T = O(N) in the size of the node
+*/
+// 在给定项之前插入新项
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *entry,
+                           void *value, size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 0);
+}
+
+/*
+ * Insert a new entry after the given entry.
+ *
+ * T = O(N) in the size of the node
+*/
+// 在给定项之后插入新项
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *entry,
+                          void *value, size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 1);
+}
+
+/*
+ * Replace the entry at index with a new value.
+ *
+ * Returns 1 if the entry was replaced, 0 if the index is out of range.
+ *
+ * T = O(N / fill + fill)
+*/
+/*
+ * 将给定索引上的项替换为新值
+ *
+ * 替换成功返回 1，索引超出范围返回 0
+*/
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data, size_t sz) {
+    quicklistEntry entry;
+    quicklistNode *node;
+    size_t pos, oldlen, newlen;
+
+    if (!quicklistIndex(quicklist, index, &entry)) return 0;
+
+    node = entry.node;
+    pos = entry.p - node->entries;
+    oldlen = _qlEntryLen(entry.p);
+    newlen = _qlEntryEncode(NULL, data, sz);
+
+    // 先扩展，移动后面的项，再收缩，以免 realloc 丢失数据
+    if (newlen > oldlen) node->entries = zrealloc(node->entries, node->sz - oldlen + newlen);
+    memmove(node->entries + pos + newlen, node->entries + pos + oldlen,
+            node->sz - pos - oldlen);
+    _qlEntryEncode(node->entries + pos, data, sz);
+    node->sz = (unsigned int)(node->sz - oldlen + newlen);
+    if (newlen < oldlen) node->entries = zrealloc(node->entries, node->sz);
+
+    _quicklistCompress(quicklist, node);
+    return 1;
+}
+
+/*
+ * Delete count entries starting at index start (negative indexes count
+ * from the tail). Nodes covered entirely are freed without being walked.
+ *
+ * Returns 1 if some entry was deleted, 0 if start is out of range.
+ *
+ * T = O(N / fill + count)
+*/
+/*
+ * 删除从索引 start 开始的 count 个项（负数索引从表尾开始计算）
+ * 被完全覆盖的结点不需要遍历，直接释放
+ *
+ * 删除了项返回 1，start 超出范围返回 0
+*/
+int quicklistDelRange(quicklist *quicklist, long start, long count) {
+    quicklistEntry entry;
+    quicklistNode *node;
+    unsigned long extent;
+    unsigned int offset;
+    unsigned char *p;
+
+    if (count <= 0) return 0;
+    if (!quicklistIndex(quicklist, start, &entry)) return 0;
+
+    // 将 count 限制在 start 之后的项数以内
+    extent = start >= 0 ? quicklist->count - start : (unsigned long)(-start);
+    if ((unsigned long)count > extent) count = extent;
+
+    node = entry.node;
+    p = entry.p;
+    offset = entry.offset;
+    while (count > 0) {
+        quicklistNode *next = node->next;
+        unsigned int del = node->count - offset;
+
+        if ((unsigned long)del > (unsigned long)count) del = (unsigned int)count;
+
+        if (offset == 0 && del == node->count) {
+            // 删除整个结点，压缩的结点不需要解压
+            _quicklistDelNode(quicklist, node);
+        } else {
+            unsigned char *end;
+            unsigned int j;
+
+            // 第一个结点已经由 quicklistIndex() 解压，之后的结点从表头开始删除
+            _quicklistNodeForUse(quicklist, node);
+            if (node != entry.node) p = node->entries;
+
+            for (j = 0, end = p; j < del; j++) end += _qlEntryLen(end);
+            _quicklistNodeDelBytes(node, p - node->entries, end - p, del);
+            quicklist->count -= del;
+            _quicklistRecompressOnly(quicklist, node);
+        }
+
+        count -= del;
+        node = next;
+        offset = 0;
+    }
+
+    _quicklistCompress(quicklist, NULL);
+    return 1;
+}
+
+/* -------------------------------- Iteration -------------------------------- */
+
+/*
+ * Return an iterator over the quicklist, from the head (AL_START_HEAD) or
+ * from the tail (AL_START_TAIL).
+ *
+ * T = O(1)
+*/
+// 返回快速列表的迭代器，从表头（AL_START_HEAD）或表尾（AL_START_TAIL）开始
+quicklistIter *quicklistGetIterator(quicklist *quicklist, int direction) {
+    quicklistIter *iter = zmalloc(sizeof(*iter));
+
+    iter->quicklist = quicklist;
+    iter->direction = direction;
+    iter->current = direction == AL_START_HEAD ? quicklist->head : quicklist->tail;
+    iter->p = NULL;
+    iter->offset = direction == AL_START_HEAD ? 0 :
+                   (iter->current ? (long)iter->current->count - 1 : 0);
+    return iter;
+}
+
+/*
+ * Return an iterator whose first entry is the one at index idx, or NULL if
+ * the index is out of range.
+ *
+ * T = O(N / fill + fill)
+*/
+// 返回第一项为索引 idx 上的项的迭代器，索引超出范围时返回 NULL
+quicklistIter *quicklistGetIteratorAtIdx(quicklist *quicklist,
+                                         int direction, long idx) {
+    quicklistEntry entry;
+    quicklistIter *iter;
+
+    if (!quicklistIndex(quicklist, idx, &entry)) return NULL;
+
+    iter = quicklistGetIterator(quicklist, direction);
+    iter->current = entry.node;
+    iter->p = entry.p;
+    iter->offset = entry.offset;
+    return iter;
+}
+
+/*
+ * Describe the next entry of the iteration in entry.
+ *
+ * Returns 1 if there was an entry, 0 when the iteration is over.
+ *
+ * T = O(1)
+*/
+// 通过 entry 描述迭代的下一项，有下一项时返回 1，迭代结束时返回 0
+int quicklistNext(quicklistIter *iter, quicklistEntry *entry) {
+    quicklistNode *node = iter->current;
+    unsigned char *next;
+
+    if (node == NULL) return 0;
+
+    // 从结点的一端开始，这时才解压结点，前一个结点会被重新压缩
+    if (iter->p == NULL) {
+        _quicklistNodeForUse(iter->quicklist, node);
+        iter->p = iter->direction == AL_START_HEAD ? node->entries :
+                  _qlEntryPrev(node, node->entries + node->sz);
+    }
+
+    entry->quicklist = iter->quicklist;
+    entry->node = node;
+    entry->p = iter->p;
+    entry->offset = (int)iter->offset;
+    _qlEntryDecode(iter->p, entry);
+
+    // 前进到下一项，当前结点遍历完毕时移动到下一个结点
+    if (iter->direction == AL_START_HEAD) {
+        next = _qlEntryNext(node, iter->p);
+        iter->offset++;
+        if (next == NULL) {
+            iter->current = node->next;
+            iter->offset = 0;
+        }
+    } else {
+        next = _qlEntryPrev(node, iter->p);
+        iter->offset--;
+        if (next == NULL) {
+            iter->current = node->prev;
+            iter->offset = iter->current ? (long)iter->current->count - 1 : 0;
+        }
+    }
+    iter->p = next;
+    return 1;
+}
+
+/*
+ * Delete the entry last returned by quicklistNext(), keeping the iterator
+ * valid so the iteration can go on.
+ *
+ * T = O(N) in the size of the node
+*/
+// 删除 quicklistNext() 最后返回的项，迭代器保持有效，可以继续迭代
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry) {
+    quicklistNode *node = entry->node;
+    size_t pos = entry->p - node->entries, len = _qlEntryLen(entry->p), ipos = 0;
+    int same = iter->current == node && iter->p != NULL;
+
+    // 结点被 realloc 后迭代器的指针会失效，先记下偏移
+    if (same) ipos = iter->p - node->entries;
+
+    // 结点被释放时迭代器已经指向了其他结点
+    if (_quicklistDelIndex(iter->quicklist, node, entry->p)) return;
+
+    if (same) {
+        if (ipos > pos) {
+            ipos -= len;
+            iter->offset--;
+        }
+        iter->p = node->entries + ipos;
+    }
+}
+
+/*
+ * Release the iterator.
+ *
+ * The node it decompressed last is left raw on purpose: reading the same
+ * range again, like repeated LRANGE calls crossing into the first
+ * compressed node, would otherwise compress and decompress it every time.
+ * It is compressed as soon as another interior node is accessed.
+ *
+ * T = O(1)
+*/
+/*
+ * 释放迭代器
+ *
+ * 迭代器最后解压的结点特意保持未压缩状态：否则重复读取同一个范围时，
+ * 比如反复执行跨入第一个压缩结点的 LRANGE，每次都要压缩和解压这个结点，
+ * 访问另一个中间结点时它就会被重新压缩
+*/
+void quicklistReleaseIterator(quicklistIter *iter) {
+    zfree(iter);
+}
+
+/*
+ * Return the number of bytes used by the quicklist: headers, nodes and
+ * packed entries, compressed or not.
+ *
+ * T = O(N) nodes
+*/
+// 返回快速列表使用的字节数：表头、结点以及紧凑排列的项（压缩或未压缩的）
+size_t quicklistBlobLen(const quicklist *quicklist) {
+    const quicklistNode *node;
+    size_t len = sizeof(*quicklist);
+
+    for (node = quicklist->head; node; node = node->next) {
+        len += sizeof(*node);
+        if (node->encoding == QUICKLIST_NODE_ENCODING_LZF)
+            len += sizeof(quicklistLZF) + ((quicklistLZF *)node->entries)->sz;
+        else
+            len += node->sz;
+    }
+    return len;
+}
+
+#ifdef QUICKLIST_TEST_MAIN
+#include <sys/time.h>
+#include <time.h>
+#include <assert.h>
+#include "sds.h"
+#include "testhelp.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
+// 防止编译器优化掉基准测试的读取
+static volatile long long sink;
+
+/* Render the entry as a string in buf, integers included */
+static int entryToString(quicklistEntry *entry, char *buf, size_t len) {
+    if (entry->value) {
+        assert(entry->sz < len);
+        memcpy(buf, entry->value, entry->sz);
+        buf[entry->sz] = '\0';
+        return entry->sz;
+    }
+    return ll2string(buf, len, entry->longval);
+}
+
+/* Random value: small and large integers, short, long and repetitive strings */
+static int randomValue(char *buf) {
+    int len, j;
+
+    switch (rand() % 5) {
+    case 0: return ll2string(buf, 32, rand() % 2000 - 1000);
+    case 1: return ll2string(buf, 32, ((long long)rand() << 32 | rand()) * (rand() & 1 ? 1 : -1));
+    case 2: len = rand() % 16; break;
+    case 3: return snprintf(buf, 512, "GET /api/v1/items/%d HTTP/1.1 200", rand() % 1000);
+    default: len = rand() % 300; break;
+    }
+    for (j = 0; j < len; j++) buf[j] = 'a' + rand() % 26;
+    buf[len] = '\0';
+    return len;
+}
+
+/* Check the quicklist against the reference array, in both directions */
+static int checkAgainst(quicklist *ql, char **ref, long len) {
+    quicklistEntry entry;
+    quicklistIter *iter;
+    quicklistNode *node;
+    unsigned long count = 0, nodes = 0;
+    char buf[512];
+    long j = 0;
+
+    if ((long)quicklistCount(ql) != len) return 0;
+    for (node = ql->head; node; node = node->next) {
+        int edge = nodes < (unsigned long)ql->compress ||
+                   nodes >= ql->len - ql->compress;
+
+        if (node->count == 0) return 0;
+        if (node->next && node->next->prev != node) return 0;
+        // 两端的结点不压缩，中间只能有一个为了访问而解压的结点
+        if (ql->compress && edge &&
+            (node->encoding != QUICKLIST_NODE_ENCODING_RAW || node->recompress)) return 0;
+        if (node->recompress && ql->unpacked != node) return 0;
+        if (!ql->compress && node->encoding != QUICKLIST_NODE_ENCODING_RAW) return 0;
+        count += node->count;
+        nodes++;
+    }
+    if (count != ql->count || nodes != ql->len) return 0;
+
+    iter = quicklistGetIterator(ql, AL_START_HEAD);
+    while (quicklistNext(iter, &entry)) {
+        entryToString(&entry, buf, sizeof(buf));
+        if (j >= len || strcmp(buf, ref[j++])) { quicklistReleaseIterator(iter); return 0; }
+    }
+    quicklistReleaseIterator(iter);
+    if (j != len) return 0;
+
+    iter = quicklistGetIterator(ql, AL_START_TAIL);
+    while (quicklistNext(iter, &entry)) {
+        entryToString(&entry, buf, sizeof(buf));
+        if (strcmp(buf, ref[--j])) { quicklistReleaseIterator(iter); return 0; }
+    }
+    quicklistReleaseIterator(iter);
+    return j == 0;
+}
+
+static void refInsert(char **ref, long *len, long idx, const char *s) {
+    memmove(ref + idx + 1, ref + idx, sizeof(char*) * (*len - idx));
+    ref[idx] = strdup(s);
+    (*len)++;
+}
+
+static void refDelete(char **ref, long *len, long idx, long count) {
+    long j;
+
+    for (j = idx; j < idx + count; j++) free(ref[j]);
+    memmove(ref + idx, ref + idx + count, sizeof(char*) * (*len - idx - count));
+    *len -= count;
+}
+
+static int fuzzTest(int fill, int compress, int ops) {
+    quicklist *ql = quicklistNew(fill, compress);
+    quicklistEntry entry;
+    char **ref = malloc(sizeof(char*) * (ops + 1));
+    char buf[512], got[512];
+    long len = 0, idx;
+    int i, ok = 1, sz;
+
+    for (i = 0; i < ops && ok; i++) {
+        int op = rand() % 10;
+
+        if (op == 9 && len) {
+            // 迭代并删除部分项
+            quicklistIter *iter = quicklistGetIterator(ql, rand() & 1);
+            int dir = iter->direction;
+            long pos = dir == AL_START_HEAD ? 0 : len - 1;
+
+            while (quicklistNext(iter, &entry)) {
+                entryToString(&entry, got, sizeof(got));
+                if (strcmp(got, ref[pos])) ok = 0;
+                if (rand() % 3 == 0) {
+                    quicklistDelEntry(iter, &entry);
+                    refDelete(ref, &len, pos, 1);
+                    if (dir == AL_START_HEAD) pos--;
+                }
+                pos += dir == AL_START_HEAD ? 1 : -1;
+            }
+            quicklistReleaseIterator(iter);
+            if (!checkAgainst(ql, ref, len)) ok = 0;
+            continue;
+        }
+
+        if (op <= 2 || len == 0) {
+            sz = randomValue(buf);
+            if (rand() & 1) {
+                quicklistPushHead(ql, buf, sz);
+                refInsert(ref, &len, 0, buf);
+            } else {
+                quicklistPushTail(ql, buf, sz);
+                refInsert(ref, &len, len, buf);
+            }
+        } else if (op == 3) {
+            unsigned char *data;
+            unsigned int dsz;
+            long long sval;
+            int where = rand() & 1 ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+
+            idx = where == QUICKLIST_HEAD ? 0 : len - 1;
+            quicklistPop(ql, where, &data, &dsz, &sval);
+            if (data) {
+                memcpy(got, data, dsz);
+                got[dsz] = '\0';
+                zfree(data);
+            } else {
+                ll2string(got, sizeof(got), sval);
+            }
+            if (strcmp(got, ref[idx])) ok = 0;
+            refDelete(ref, &len, idx, 1);
+        } else if (op == 4) {
+            idx = rand() % len;
+            if (!quicklistIndex(ql, rand() & 1 ? idx : idx - len, &entry)) ok = 0;
+            entryToString(&entry, got, sizeof(got));
+            if (strcmp(got, ref[idx])) ok = 0;
+        } else if (op == 5 || op == 6) {
+            idx = rand() % len;
+            quicklistIndex(ql, idx, &entry);
+            sz = randomValue(buf);
+            if (op == 5) {
+                quicklistInsertBefore(ql, &entry, buf, sz);
+                refInsert(ref, &len, idx, buf);
+            } else {
+                quicklistInsertAfter(ql, &entry, buf, sz);
+                refInsert(ref, &len, idx + 1, buf);
+            }
+        } else if (op == 7) {
+            idx = rand() % len;
+            sz = randomValue(buf);
+            quicklistReplaceAtIndex(ql, idx, buf, sz);
+            free(ref[idx]);
+            ref[idx] = strdup(buf);
+        } else {
+            long count = rand() % 40 + 1;
+
+            idx = rand() % len;
+            quicklistDelRange(ql, rand() & 1 ? idx : idx - len, count);
+            if (count > len - idx) count = len - idx;
+            refDelete(ref, &len, idx, count);
+        }
+        if (i % 64 == 0 && !checkAgainst(ql, ref, len)) ok = 0;
+    }
+    if (!checkAgainst(ql, ref, len)) ok = 0;
+
+    refDelete(ref, &len, 0, len);
+    free(ref);
+    quicklistRelease(ql);
+    return ok;
+}
+
+static void benchmark(long count, int vlen) {
+    quicklist *ql;
+    list *l;
+    quicklistEntry entry;
+    quicklistIter *qi;
+    listNode *ln;
+    size_t base, qlmem, lmem;
+    long long start, sum = 0;
+    long j, k, iterations = 100000;
+    // adlist 的每次查找都要遍历 O(N) 个结点，减少它的迭代次数
+    long slow_iterations = 200000000 / count;
+    char buf[64];
+    int len;
+
+    base = zmalloc_used_memory();
+    ql = quicklistCreate();
+    for (j = 0; j < count; j++) {
+        len = vlen ? snprintf(buf, sizeof(buf), "%0*ld", vlen, j) :
+                     ll2string(buf, sizeof(buf), j * 7);
+        quicklistPushTail(ql, buf, len);
+    }
+    qlmem = zmalloc_used_memory() - base;
+
+    base = zmalloc_used_memory();
+    l = listCreate();
+    for (j = 0; j < count; j++) {
+        len = vlen ? snprintf(buf, sizeof(buf), "%0*ld", vlen, j) :
+                     ll2string(buf, sizeof(buf), j * 7);
+        listAddNodeTail(l, sdsnewlen(buf, len));
+    }
+    lmem = zmalloc_used_memory() - base;
+
+    printf("%ld %s values: quicklist %.1f bytes/elem (%lu nodes), adlist %.1f bytes/elem\n",
+        count, vlen ? "string" : "integer",
+        (double)qlmem / count, ql->len, (double)lmem / count);
+
+    // LRANGE：从随机起点读取 100 个元素
+    start = usec();
+    for (j = 0; j < iterations; j++) {
+        qi = quicklistGetIteratorAtIdx(ql, AL_START_HEAD, rand() % count);
+        for (k = 0; k < 100 && quicklistNext(qi, &entry); k++) sum += entry.sz;
+        quicklistReleaseIterator(qi);
+    }
+    printf("  LRANGE 100: quicklist %.2f usec/op", (double)(usec() - start) / iterations);
+
+    start = usec();
+    for (j = 0; j < slow_iterations; j++) {
+        ln = listIndex(l, rand() % count);
+        for (k = 0; k < 100 && ln; k++, ln = ln->next) sum += sdslen(ln->value);
+    }
+    printf(", adlist %.2f usec/op\n", (double)(usec() - start) / slow_iterations);
+
+    // LINDEX：随机索引，正负各半
+    start = usec();
+    for (j = 0; j < iterations; j++) {
+        long idx = rand() % count;
+        quicklistIndex(ql, rand() & 1 ? idx : idx - count, &entry);
+        sum += entry.sz;
+    }
+    printf("  LINDEX:     quicklist %.2f usec/op", (double)(usec() - start) / iterations);
+
+    start = usec();
+    for (j = 0; j < slow_iterations; j++) {
+        long idx = rand() % count;
+        ln = listIndex(l, rand() & 1 ? idx : idx - count);
+        sum += (long)ln;
+    }
+    printf(", adlist %.2f usec/op\n", (double)(usec() - start) / slow_iterations);
+    sink = sum;
+
+    quicklistRelease(ql);
+    l->free = (void (*)(void*))sdsfree;
+    listRelease(l);
+}
+
+/*
+ * Log-like workload: a long list of access log lines, appended at the tail
+ * and trimmed at the head, with occasional reads in the middle.
+*/
+static void benchmarkCompress(long count) {
+    int depths[] = {0, 1, 2};
+    unsigned int d;
+    long iterations = 100000;
+
+    for (d = 0; d < sizeof(depths) / sizeof(*depths); d++) {
+        quicklist *ql;
+        quicklistEntry entry;
+        quicklistIter *qi;
+        unsigned char *data;
+        unsigned int dsz;
+        long long start, sval, sum = 0;
+        size_t base, mem;
+        char buf[128];
+        long j, k;
+        int len;
+
+        base = zmalloc_used_memory();
+        ql = quicklistNew(-2, depths[d]);
+        for (j = 0; j < count; j++) {
+            len = snprintf(buf, sizeof(buf),
+                "2026-10-18T12:%02ld:%02ld.%03ldZ INFO worker-%ld GET /api/v1/items/%ld 200 %ldms",
+                j / 60000 % 60, j / 1000 % 60, j % 1000, j % 8, j * 7919 % 100000, j % 250);
+            quicklistPushTail(ql, buf, len);
+        }
+        mem = zmalloc_used_memory() - base;
+        printf("Log of %ld lines, compress depth %d: %.1f bytes/elem\n",
+            count, depths[d], (double)mem / count);
+
+        // RPUSH + LPOP：只访问两端
+        start = usec();
+        for (j = 0; j < iterations; j++) {
+            len = snprintf(buf, sizeof(buf), "2026-10-18T13:00:00.000Z INFO worker-%ld GET /", j);
+            quicklistPushTail(ql, buf, len);
+            quicklistPop(ql, QUICKLIST_HEAD, &data, &dsz, &sval);
+            zfree(data);
+        }
+        printf("  RPUSH+LPOP %.3f usec/op", (double)(usec() - start) / iterations);
+
+        // LRANGE 0 99：表头
+        start = usec();
+        for (j = 0; j < iterations; j++) {
+            qi = quicklistGetIteratorAtIdx(ql, AL_START_HEAD, 0);
+            for (k = 0; k < 100 && quicklistNext(qi, &entry); k++) sum += entry.sz;
+            quicklistReleaseIterator(qi);
+        }
+        printf(", LRANGE head 100 %.2f usec/op", (double)(usec() - start) / iterations);
+
+        // LINDEX 和 LRANGE：列表中间的随机位置
+        start = usec();
+        for (j = 0; j < iterations / 10; j++) {
+            quicklistIndex(ql, rand() % count, &entry);
+            sum += entry.sz;
+        }
+        printf(", LINDEX middle %.2f usec/op", (double)(usec() - start) / (iterations / 10));
+
+        start = usec();
+        for (j = 0; j < iterations / 10; j++) {
+            qi = quicklistGetIteratorAtIdx(ql, AL_START_HEAD, rand() % count);
+            for (k = 0; k < 100 && quicklistNext(qi, &entry); k++) sum += entry.sz;
+            quicklistReleaseIterator(qi);
+        }
+        printf(", LRANGE middle 100 %.2f usec/op\n", (double)(usec() - start) / (iterations / 10));
+
+        sink = sum;
+        quicklistRelease(ql);
+    }
+}
+
+int main(void) {
+    srand(time(NULL));
+
+    {
+        quicklist *ql = quicklistCreate();
+        unsigned char *data;
+        unsigned int sz;
+        long long sval;
+
+        quicklistPushTail(ql, "-42", 3);
+        quicklistPushTail(ql, "hello", 5);
+        quicklistPushHead(ql, "9223372036854775807", 19);
+        quicklistPushHead(ql, "007", 3);
+        test_cond("Push to head and tail", quicklistCount(ql) == 4 && ql->len == 1);
+
+        quicklistPop(ql, QUICKLIST_HEAD, &data, &sz, &sval);
+        test_cond("Strings that are not canonical integers stay strings",
+            data && sz == 3 && !memcmp(data, "007", 3));
+        zfree(data);
+
+        quicklistPop(ql, QUICKLIST_HEAD, &data, &sz, &sval);
+        test_cond("Integers out of the packed range are stored as strings",
+            data && sz == 19 && !memcmp(data, "9223372036854775807", 19));
+        zfree(data);
+
+        quicklistPop(ql, QUICKLIST_TAIL, &data, &sz, &sval);
+        test_cond("Pop string from tail", data && sz == 5 && !memcmp(data, "hello", 5));
+        zfree(data);
+
+        quicklistPop(ql, QUICKLIST_TAIL, &data, &sz, &sval);
+        test_cond("Pop negative integer", data == NULL && sval == -42);
+
+        test_cond("Pop from empty list",
+            quicklistCount(ql) == 0 && ql->len == 0 && ql->head == NULL &&
+            quicklistPop(ql, QUICKLIST_HEAD, &data, &sz, &sval) == 0);
+        quicklistRelease(ql);
+    }
+
+    {
+        quicklist *ql = quicklistNew(-1, 0);
+        quicklistEntry entry;
+        char buf[32];
+        long j;
+        int ok = 1;
+
+        for (j = 0; j < 100000; j++) {
+            int len = ll2string(buf, sizeof(buf), j);
+            quicklistPushTail(ql, buf, len);
+        }
+        for (j = 0; j < 100000 && ok; j += 997) {
+            if (!quicklistIndex(ql, j, &entry) || entry.longval != j) ok = 0;
+            if (!quicklistIndex(ql, j - 100000, &entry) || entry.longval != j) ok = 0;
+        }
+        test_cond("Index from both ends", ok &&
+            !quicklistIndex(ql, 100000, &entry) && !quicklistIndex(ql, -100001, &entry));
+
+        quicklistDelRange(ql, 10, 99980);
+        test_cond("Delete a range spanning many nodes",
+            quicklistCount(ql) == 20 &&
+            quicklistIndex(ql, 9, &entry) && entry.longval == 9 &&
+            quicklistIndex(ql, 10, &entry) && entry.longval == 99990);
+        quicklistRelease(ql);
+    }
+
+    {
+        int fills[] = {1, 2, 4, 32, 128, -1, -2, -5};
+        unsigned int j;
+        int ok = 1;
+
+        for (j = 0; j < sizeof(fills) / sizeof(*fills); j++)
+            ok &= fuzzTest(fills[j], 0, 20000);
+        test_cond("Random operations against a reference array", ok);
+
+        for (j = 0, ok = 1; j < sizeof(fills) / sizeof(*fills); j++) {
+            ok &= fuzzTest(fills[j], 1, 10000);
+            ok &= fuzzTest(fills[j], 2, 10000);
+        }
+        test_cond("Random operations with compressed interior nodes", ok);
+    }
+
+    {
+        quicklist *ql = quicklistNew(-2, 1);
+        quicklistEntry entry;
+        quicklistNode *node;
+        char buf[64];
+        long j, compressed = 0;
+        int len;
+
+        for (j = 0; j < 10000; j++) {
+            len = snprintf(buf, sizeof(buf), "GET /api/v1/items/%ld 200", j);
+            quicklistPushTail(ql, buf, len);
+        }
+        for (node = ql->head->next; node != ql->tail; node = node->next)
+            compressed += node->encoding == QUICKLIST_NODE_ENCODING_LZF;
+        test_cond("Interior nodes are compressed, the ends are not",
+            ql->len > 2 && compressed == (long)ql->len - 2 &&
+            ql->head->encoding == QUICKLIST_NODE_ENCODING_RAW &&
+            ql->tail->encoding == QUICKLIST_NODE_ENCODING_RAW);
+
+        quicklistIndex(ql, 5000, &entry);
+        len = snprintf(buf, sizeof(buf), "GET /api/v1/items/%d 200", 5000);
+        test_cond("Reading an interior entry decompresses only its node",
+            entry.sz == (unsigned int)len && !memcmp(entry.value, buf, len) &&
+            ql->unpacked == entry.node &&
+            entry.node->encoding == QUICKLIST_NODE_ENCODING_RAW);
+
+        quicklistIndex(ql, 2000, &entry);
+        test_cond("Accessing another node compresses the previous one",
+            ql->unpacked == entry.node &&
+            ql->head->next->next->encoding == QUICKLIST_NODE_ENCODING_LZF);
+
+        quicklistSetCompressDepth(ql, 0);
+        for (node = ql->head, compressed = 0; node; node = node->next)
+            compressed += node->encoding == QUICKLIST_NODE_ENCODING_LZF;
+        test_cond("Disabling compression decompresses every node", compressed == 0);
+        quicklistRelease(ql);
+    }
+
+    test_report();
+
+    benchmark(100000, 0);
+    benchmark(100000, 12);
+    benchmark(1000000, 12);
+    benchmarkCompress(1000000);
+    return 0;
+}
+#endif
@@ -0,0 +1,170 @@
+#ifndef __QUICKLIST_H__
+#define __QUICKLIST_H__
+
+#include <stddef.h>
+
+#include "adlist.h"
+
+/*
+ * Quicklist: a doubly linked list of nodes, each holding a packed buffer
+ * of list entries, used for list values instead of one listNode (three
+ * pointers plus a separate value allocation) per element.
+ *
+ * Inside a node every entry is encoded as:
+ *
+ * | header | data | backlen |
+ *
+ * - header:  varint, (length << 1) for strings, followed by the bytes,
+ *            or (zigzag(value) << 1) | 1 for integers, with no data
+ * - backlen: size of header + data, encoded so that it can be read
+ *            backwards, to walk the node from the tail
+ *
+ * Nodes are bounded by the fill factor: a positive fill is the maximum
+ * number of entries per node, a negative fill selects a maximum node
+ * size of 4KB (-1), 8KB (-2), 16KB (-3), 32KB (-4) or 64KB (-5).
+ *
+ * Lists used as logs are mostly accessed at their ends: with a compress
+ * depth of N > 0 only the N nodes at each end are kept raw, the interior
+ * ones are LZF compressed and decompressed on access. 0 disables
+ * compression.
+*/
+/*
+ * 快速列表：由结点组成的双端链表，每个结点保存一个紧凑排列的列表项缓冲区
+ * 用于代替为每个元素分配一个 listNode（三个指针，外加单独分配的值）的列表值
+ *
+ * 结点中的每一项编码为：
+ *
+ * | header | data | backlen |
+ *
+ * - header：  变长整数，字符串为 (长度 << 1)，之后跟着字符串内容，
+ *             整数为 (zigzag(值) << 1) | 1，没有 data 部分
+ * - backlen： header + data 的大小，编码方式使其可以从后往前读取，用于从尾部遍历结点
+ *
+ * 结点的大小由填充因子限制：正数表示每个结点的最大项数，
+ * 负数选择结点的最大字节数：4KB（-1）、8KB（-2）、16KB（-3）、32KB（-4）或 64KB（-5）
+ *
+ * 用作日志的列表主要在两端进行访问：压缩深度 N > 0 时，只有两端各 N 个结点保持原样，
+ * 中间的结点使用 LZF 压缩，访问时再解压，0 表示不进行压缩
+*/
+
+// 结点
+typedef struct quicklistNode {
+
+    struct quicklistNode *prev;     // 前置结点
+
+    struct quicklistNode *next;     // 后置结点
+
+    unsigned char *entries;         // 紧凑排列的列表项，压缩时指向 quicklistLZF
+
+    unsigned int sz;                // 未压缩时 entries 的字节数
+
+    unsigned int count:16;          // 结点包含的项数
+
+    unsigned int encoding:2;        // 结点的编码，QUICKLIST_NODE_ENCODING_*
+
+    unsigned int recompress:1;      // 结点是为了访问而临时解压的，之后需要重新压缩
+
+} quicklistNode;
+
+// 压缩后的结点数据
+typedef struct quicklistLZF {
+
+    unsigned int sz;                // compressed 的字节数
+
+    char compressed[];              // LZF 压缩后的列表项
+
+} quicklistLZF;
+
+// 快速列表
+typedef struct quicklist {
+
+    quicklistNode *head;            // 表头结点
+
+    quicklistNode *tail;            // 表尾结点
+
+    unsigned long count;            // 所有结点包含的项数总和
+
+    unsigned long len;              // 结点数量
+
+    int fill;                       // 填充因子
+
+    int compress;                   // 压缩深度：两端保持不压缩的结点数量，0 表示不压缩
+
+    quicklistNode *unpacked;        // 为了访问而临时解压的中间结点，最多一个
+
+} quicklist;
+
+// 迭代器
+typedef struct quicklistIter {
+
+    quicklist *quicklist;           // 迭代的快速列表
+
+    quicklistNode *current;         // 当前结点
+
+    unsigned char *p;               // 下一个要返回的项，为 NULL 时从结点的一端开始
+
+    long offset;                    // 下一个要返回的项在结点中的位置
+
+    int direction;                  // 迭代的方向
+
+} quicklistIter;
+
+// 列表项的视图
+typedef struct quicklistEntry {
+
+    quicklist *quicklist;           // 所属的快速列表
+
+    quicklistNode *node;            // 所在的结点
+
+    unsigned char *p;               // 在结点中的位置
+
+    unsigned char *value;           // 字符串的内容，整数时为 NULL
+
+    long long longval;              // 整数的值
+
+    unsigned int sz;                // 字符串的长度
+
+    int offset;                     // 在结点中的序号
+
+} quicklistEntry;
+
+#define QUICKLIST_HEAD 0
+#define QUICKLIST_TAIL -1
+
+#define QUICKLIST_NODE_ENCODING_RAW 1
+#define QUICKLIST_NODE_ENCODING_LZF 2
+
+#define QUICKLIST_DEFAULT_FILL -2
+#define QUICKLIST_DEFAULT_COMPRESS 0
+
+// 迭代方向使用 adlist.h 中的 AL_START_HEAD 和 AL_START_TAIL
+
+#define quicklistCount(ql) ((ql)->count)    // 返回列表项的数量
+#define quicklistNodeCount(ql) ((ql)->len)  // 返回结点的数量
+
+quicklist *quicklistCreate(void);
+quicklist *quicklistNew(int fill, int compress);
+void quicklistSetFill(quicklist *quicklist, int fill);
+void quicklistSetCompressDepth(quicklist *quicklist, int depth);
+void quicklistRelease(quicklist *quicklist);
+int quicklistPushHead(quicklist *quicklist, void *value, size_t sz);
+int quicklistPushTail(quicklist *quicklist, void *value, size_t sz);
+void quicklistPush(quicklist *quicklist, void *value, size_t sz, int where);
+int quicklistPop(quicklist *quicklist, int where, unsigned char **data,
+                 unsigned int *sz, long long *sval);
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *entry,
+                           void *value, size_t sz);
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *entry,
+                          void *value, size_t sz);
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data, size_t sz);
+int quicklistDelRange(quicklist *quicklist, long start, long count);
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry);
+int quicklistIndex(quicklist *quicklist, long index, quicklistEntry *entry);
+quicklistIter *quicklistGetIterator(quicklist *quicklist, int direction);
+quicklistIter *quicklistGetIteratorAtIdx(quicklist *quicklist,
+                                         int direction, long idx);
+int quicklistNext(quicklistIter *iter, quicklistEntry *entry);
+void quicklistReleaseIterator(quicklistIter *iter);
+size_t quicklistBlobLen(const quicklist *quicklist);
+
+#endif // __QUICKLIST_H__
@@ -7,8 +7,12 @@
 #include "zskiplist.h"
 #include "zmalloc.h"
 #include "util.h"
+#include "monotonic.h"
 
 #include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
 
 /* Error codes */
 #define REDIS_OK    0
@@ -40,30 +44,103 @@
 #define REDIS_ENCODING_INTSET 6  /* Encoded as intset */
 #define REDIS_ENCODING_SKIPLIST 7  /* Encoded as skiplist */
 #define REDIS_ENCODING_EMBSTR 8  /* Embedded sds string encoding */
+#define REDIS_ENCODING_ROARING 9 /* Encoded as roaring bitmap */
+#define REDIS_ENCODING_INLINE 10 /* Short string stored in the ptr field */
 
-/* Return the UNIX time in microseconds */
-// 返回微秒格式的 UNIX 时间
-// 1 秒 = 1 000 000 微秒
-long long ustime(void) {
-    struct timeval tv;
-    long long ust;
-
-    gettimeofday(&tv, NULL);
-    ust = ((long long)tv.tv_sec)*1000000;
-    ust += tv.tv_usec;
-    return ust;
-}
-
-/* Return the UNIX time in milliseconds */
-// 返回毫秒格式的 UNIX 时间
-// 1 秒 = 1 000 毫秒
-long long mstime(void) {
-    return ustime()/1000;
-}
-
-unsigned int getLRUClock(void) {
-    return (mstime()/REDIS_LRU_CLOCK_RESOLUTION) & REDIS_LRU_CLOCK_MAX;
-}
+/* Set encoding limits */
+// intset 编码的集合所能保存的最大成员数量，超出后升级为 roaring 位图
+#define REDIS_SET_MAX_INTSET_ENTRIES 512
+
+/* Shared objects */
+// 共享的 SELECT 命令的数量
+#define REDIS_SHARED_SELECT_CMDS 10
+// 共享整数的数量，[0, REDIS_SHARED_INTEGERS) 之间的整数值不会单独创建对象
+#define REDIS_SHARED_INTEGERS 10000
+// 共享的多条回复和批量回复头部的数量
+#define REDIS_SHARED_BULKHDR_LEN 32
+// 共享对象的引用计数，这样的对象不受 incrRefCount() 和 decrRefCount() 影响，永远不会被释放
+#define REDIS_SHARED_REFCOUNT INT_MAX
+
+/*
+ * Build with -DREDIS_ATOMIC_REFCOUNT to update reference counts with
+ * atomic operations, so that objects can be shared with I/O and worker
+ * threads (lazy free included). The default build keeps plain integer
+ * updates, which are cheaper on the single threaded paths.
+*/
+/*
+ * 使用 -DREDIS_ATOMIC_REFCOUNT 编译时，引用计数使用原子操作更新，
+ * 对象可以和 I/O 线程以及工作线程（包括惰性释放）共享
+ * 默认的编译方式仍然使用普通的整数操作，在单线程的路径上代价更低
+*/
+#ifdef REDIS_ATOMIC_REFCOUNT
+#define objectGetRefCount(o) __atomic_load_n(&(o)->refcount, __ATOMIC_RELAXED)
+#else
+#define objectGetRefCount(o) ((o)->refcount)
+#endif
+
+/* Lazy free */
+// 元素数量超过这个值的对象才交给回收线程释放
+#define REDIS_LAZYFREE_THRESHOLD 64
+// 回收线程队列的最大长度，队列已满时同步释放
+#define REDIS_LAZYFREE_QUEUE_LEN 1024
+
+/* Redis maxmemory strategies. Instead of using just incremental number
+ * for this defines, we use a set of flags so that testing for certain
+ * properties common to multiple policies is faster. */
+// 内存淘汰策略，使用标志位组合，方便检查多个策略共有的属性
+#define REDIS_MAXMEMORY_FLAG_LRU (1<<0)
+#define REDIS_MAXMEMORY_FLAG_LFU (1<<1)
+#define REDIS_MAXMEMORY_FLAG_ALLKEYS (1<<2)
+#define REDIS_MAXMEMORY_FLAG_NO_SHARED_INTEGERS \
+    (REDIS_MAXMEMORY_FLAG_LRU|REDIS_MAXMEMORY_FLAG_LFU)
+
+#define REDIS_MAXMEMORY_VOLATILE_LRU ((0<<8)|REDIS_MAXMEMORY_FLAG_LRU)
+#define REDIS_MAXMEMORY_VOLATILE_LFU ((1<<8)|REDIS_MAXMEMORY_FLAG_LFU)
+#define REDIS_MAXMEMORY_VOLATILE_TTL (2<<8)
+#define REDIS_MAXMEMORY_VOLATILE_RANDOM (3<<8)
+#define REDIS_MAXMEMORY_ALLKEYS_LRU ((4<<8)|REDIS_MAXMEMORY_FLAG_LRU|REDIS_MAXMEMORY_FLAG_ALLKEYS)
+#define REDIS_MAXMEMORY_ALLKEYS_LFU ((5<<8)|REDIS_MAXMEMORY_FLAG_LFU|REDIS_MAXMEMORY_FLAG_ALLKEYS)
+#define REDIS_MAXMEMORY_ALLKEYS_RANDOM ((6<<8)|REDIS_MAXMEMORY_FLAG_ALLKEYS)
+#define REDIS_MAXMEMORY_NO_EVICTION (7<<8)
+
+#define REDIS_DEFAULT_MAXMEMORY_POLICY REDIS_MAXMEMORY_NO_EVICTION
+// 默认不限制内存
+#define REDIS_DEFAULT_MAXMEMORY 0
+// 每次填充淘汰池时，从每个数据库采样的键数量
+#define REDIS_DEFAULT_MAXMEMORY_SAMPLES 5
+// 淘汰池的大小
+#define REDIS_EVICTION_POOL_SIZE 16
+// 淘汰池每一项预先分配的键名缓冲区的大小
+#define REDIS_EVICTION_POOL_CACHED_SDS_SIZE 255
+
+/* LFU defines */
+// LFU 计数器的对数因子，越大需要越多的访问才能增加计数器
+#define REDIS_LFU_LOG_FACTOR 10
+// LFU 计数器每隔多少分钟减一，0 表示不衰减
+#define REDIS_LFU_DECAY_TIME 1
+// 新对象的 LFU 计数器初始值，使它们不会在积累访问之前就被淘汰
+#define REDIS_LFU_INIT_VAL 5
+
+/* Expire */
+// 主动过期每次循环从每个数据库采样的键数量
+#define ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP 20
+// 快速主动过期的最长时间，单位为微秒
+#define ACTIVE_EXPIRE_CYCLE_FAST_DURATION 1000
+// 慢速主动过期最多使用每个时钟周期的百分之多少
+#define ACTIVE_EXPIRE_CYCLE_SLOW_TIME_PERC 25
+#define ACTIVE_EXPIRE_CYCLE_SLOW 0
+#define ACTIVE_EXPIRE_CYCLE_FAST 1
+// 每次主动过期最多处理的数据库数量
+#define REDIS_DBCRON_DBS_PER_CALL 16
+
+/* LRU clock */
+#define REDIS_LRU_BITS 24
+#define REDIS_LRU_CLOCK_MAX ((1 << REDIS_LRU_BITS) - 1) /* Max value of obj->lru */
+#define REDIS_LRU_CLOCK_RESOLUTION 1000 /* LRU clock resolution in ms */
+
+/* HyperLogLog defines */
+// 稀疏表示的 HLL 的默认最大字节数，超出后转换为密集表示
+#define REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES 3000
 
 /* Global vars */
 struct redisServer server; /* server global state */
@@ -79,20 +156,32 @@ struct redisCommand *commandTable;
 
 #define sdsEncodedObject(objptr) (objptr->encoding == REDIS_ENCODING_RAW || objptr->encoding == REDIS_ENCODING_EMBSTR)
 
+/*
+ * INLINE encoded strings use the bytes of the ptr field itself: the first
+ * one holds the length, the following ones the string, zero padded, so
+ * that two inline strings are equal only if their ptr fields are.
+*/
+/*
+ * INLINE 编码的字符串直接使用 ptr 字段本身的字节：第一个字节保存长度，之后保存字符串，
+ * 剩余的字节用零填充，因此两个内联字符串相等当且仅当它们的 ptr 字段相等
+*/
+#define REDIS_INLINE_MAX_LEN (sizeof(void*) - 1)
+#define inlineObjectLen(objptr) (((unsigned char*)&(objptr)->ptr)[0])
+#define inlineObjectBuf(objptr) ((char*)&(objptr)->ptr + 1)
+
 /* The actual Redis Object */
 /*
  * Redis 对象
 */
-#define REDIS_LRU_BITS 24
-#define REDIS_LRU_CLOCK_MAX ((1 << REDIS_LRU_BITS) - 1)
-#define REDIS_LRU_CLOCK_RESOLUTION 1000
 typedef struct redisObject {
 
     unsigned type:4;                // 类型
 
     unsigned encoding:4;            // 编码
     
-    unsigned lru:REDIS_LRU_BITS;    // 对象最后一次被访问的时间
+    // 对象最后一次被访问的时间（LRU 时钟）
+    // 或者在 LFU 策略下：高 16 位为最后一次计数器衰减的时间（分钟），低 8 位为对数计数器
+    unsigned lru:REDIS_LRU_BITS;
 
     int refcount;                   // 引用计数
 
@@ -113,6 +202,61 @@ typedef struct zset {
     zskiplist *zsl;
 } zset;
 
+/* Redis database representation. There are multiple databases identified
+ * by integers from 0 (the default database) up to the max configured
+ * database. The database number is the 'id' field in the structure. */
+/*
+ * 数据库
+*/
+typedef struct redisDb {
+
+    dict *dict;                     // 键空间，键为 sds 字符串，值为对象
+
+    dict *expires;                  // 设置了过期时间的键，值为毫秒格式的 UNIX 时间戳，键和 dict 共享
+
+    int id;                         // 数据库号码
+
+} redisDb;
+
+/*
+ * 服务器状态
+*/
+struct redisServer {
+
+    int hz;                         // serverCron() 每秒调用的次数
+
+    unsigned lruclock:REDIS_LRU_BITS;   // LRU 时钟
+
+    time_t unixtime;                // 缓存的秒格式 UNIX 时间，由 updateCachedTime() 更新
+
+    long long mstime;               // 缓存的毫秒格式 UNIX 时间
+
+    long long ustime;               // 缓存的微秒格式 UNIX 时间
+
+    size_t hll_sparse_max_bytes;    // 稀疏表示的 HLL 的最大字节数
+
+    int lazyfree_enabled;           // 是否在后台线程中释放大对象
+
+    redisDb *db;                    // 数据库数组
+
+    int dbnum;                      // 数据库的数量
+
+    unsigned long long maxmemory;   // 最大可用内存，0 表示不限制
+
+    int maxmemory_samples;          // 淘汰时每个数据库采样的键数量
+
+    long long stat_evictedkeys;     // 因为内存淘汰而被删除的键的数量
+
+    long long stat_expiredkeys;     // 因为过期而被删除的键的数量
+
+    int maxmemory_policy;           // 内存淘汰策略，REDIS_MAXMEMORY_*
+
+    int lfu_log_factor;             // LFU 计数器的对数因子
+
+    int lfu_decay_time;             // LFU 计数器的衰减周期，单位为分钟
+
+};
+
 /* Our shared "common" objects */
 
 struct sharedObjectsStruct shared;
@@ -133,4 +277,76 @@ struct sharedObjectsStruct {
     *bulkhdr[REDIS_SHARED_BULKHDR_LEN];  /* "$<value>\r\n" */
 };
 
+/* Redis object implementation */
+robj *createObject(int type, void *ptr);
+robj *createStringObject(char *ptr, size_t len);
+robj *createInlineStringObject(char *ptr, size_t len);
+robj *createStringObjectFromLongLong(long long value);
+robj *makeObjectShared(robj *o);
+void createSharedIntegers(void);
+robj *tryObjectEncoding(robj *o);
+robj *getDecodedObject(robj *o);
+int compareStringObjects(robj *a, robj *b);
+int equalStringObjects(robj *a, robj *b);
+void incrRefCount(robj *o);
+void decrRefCount(robj *o);
+
+unsigned long long estimateObjectIdleTime(robj *o);
+int objectGetFrequency(robj *o, unsigned long *freq);
+
+/* Set data type */
+extern dictType setDictType;
+robj *createIntsetObject(void);
+robj *createRoaringSetObject(void);
+int setTypeConvertIntsetToRoaring(robj *setobj);
+void setTypeConvertToHashTable(robj *setobj);
+int setTypeAddInteger(robj *setobj, int64_t value);
+int setTypeIsMemberInteger(robj *setobj, int64_t value);
+unsigned long setTypeSize(robj *setobj);
+
+/* Keyspace */
+extern dictType dbDictType;
+extern dictType keyptrDictType;
+robj *lookupKey(redisDb *db, robj *key);
+robj *lookupKeyRead(redisDb *db, robj *key);
+robj *lookupKeyWrite(redisDb *db, robj *key);
+void dbAdd(redisDb *db, robj *key, robj *val);
+int dbDelete(redisDb *db, robj *key);
+void setExpire(redisDb *db, robj *key, long long when);
+long long getExpire(redisDb *db, robj *key);
+int removeExpire(redisDb *db, robj *key);
+int expireIfNeeded(redisDb *db, robj *key);
+unsigned long keyspaceScan(redisDb *db, unsigned long cursor, long count,
+        const stringmatchPattern *pattern, list *keys);
+
+/* Expire */
+void activeExpireCycle(int type);
+
+/* Time */
+long long ustime(void);
+long long mstime(void);
+unsigned int getLRUClock(void);
+void updateCachedTime(void);
+
+/* LRU and LFU */
+unsigned long LFUGetTimeInMinutes(void);
+unsigned long LFUTimeElapsed(unsigned long ldt);
+uint8_t LFULogIncr(uint8_t counter);
+unsigned long LFUDecrAndReturn(robj *o);
+unsigned int objectInitialLRU(void);
+void objectTouch(robj *o);
+
+/* Eviction */
+void evictionPoolAlloc(void);
+int freeMemoryIfNeeded(void);
+
+/* Lazy free */
+void lazyfreeInit(void);
+size_t lazyfreeGetFreeEffort(robj *o);
+int decrRefCountLazy(robj *o);
+void lazyfreeDrain(void);
+unsigned long lazyfreeGetPendingObjectsCount(void);
+size_t lazyfreeGetPendingBytes(void);
+unsigned long long lazyfreeGetFreedObjectsCount(void);
+
 #endif //ifndef __REDIS_H__
\ No newline at end of file
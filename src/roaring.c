@@ -0,0 +1,1010 @@
+/*
+ * Roaring bitmaps, used as the set encoding for large sets of integers
+ * that outgrew the intset limits. See roaring.h for the layout.
+ *
+ * Roaring 位图，作为超出整数集合限制的大整数集合的编码方式
+ * 布局说明见 roaring.h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "roaring.h"
+#include "zmalloc.h"
+
+/* ------------------------- Container helpers ---------------------------- */
+
+#define ROARING_BITMAP_ALLOC (ROARING_BITMAP_WORDS * 4)    // 以 uint16_t 计算
+
+#define containerWords(c) ((uint64_t*)(c)->data)
+
+/*
+ * Make room for at least n uint16_t in the container data
+ *
+ * T = O(N)
+*/
+/*
+ * 确保容器的数据区至少可以保存 n 个 uint16_t
+*/
+static void containerReserve(roaringContainer *c, uint32_t n) {
+    uint32_t alloc;
+
+    if (c->alloc >= n) return;
+    alloc = c->alloc ? c->alloc : 4;
+    while (alloc < n) alloc *= 2;
+    c->data = zrealloc(c->data, alloc * sizeof(uint16_t));
+    c->alloc = alloc;
+}
+
+/*
+ * Binary search of value in a sorted uint16_t array. Returns the position
+ * of the value if found, otherwise -(insert position) - 1.
+ *
+ * T = O(log N)
+*/
+/*
+ * 在有序 uint16_t 数组中二分查找 value
+ * 找到时返回所在位置，否则返回 -(插入位置) - 1
+*/
+static int32_t arraySearch(const uint16_t *a, uint32_t len, uint16_t value) {
+    int32_t lo = 0, hi = (int32_t)len - 1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        if (a[mid] < value) lo = mid + 1;
+        else if (a[mid] > value) hi = mid - 1;
+        else return mid;
+    }
+    return -(lo + 1);
+}
+
+/*
+ * Return the index of the last run starting at or before value, or -1
+ *
+ * T = O(log N)
+*/
+/*
+ * 返回起始值小于等于 value 的最后一个区间的下标，没有时返回 -1
+*/
+static int32_t runSearch(const roaringContainer *c, uint16_t value) {
+    int32_t lo = 0, hi = (int32_t)c->len - 1, found = -1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        if (c->data[mid * 2] <= value) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+/*
+ * Expand any container in a 65536 bits bitmap
+ *
+ * T = O(N)
+*/
+/*
+ * 将任意类型的容器展开为 65536 位的位图
+*/
+static void containerToWords(const roaringContainer *c, uint64_t *words) {
+    uint32_t j;
+
+    if (c->type == ROARING_BITMAP) {
+        memcpy(words, c->data, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+
+    memset(words, 0, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+    if (c->type == ROARING_ARRAY) {
+        for (j = 0; j < c->len; j++) {
+            words[c->data[j] >> 6] |= 1ULL << (c->data[j] & 63);
+        }
+    } else {
+        for (j = 0; j < c->len; j++) {
+            uint32_t v = c->data[j * 2], end = v + c->data[j * 2 + 1];
+            for (; v <= end; v++) words[v >> 6] |= 1ULL << (v & 63);
+        }
+    }
+}
+
+/*
+ * Count the bits set in a bitmap
+ *
+ * T = O(N)
+*/
+static uint32_t wordsPopcount(const uint64_t *words) {
+    uint32_t j, card = 0;
+
+    for (j = 0; j < ROARING_BITMAP_WORDS; j++) card += __builtin_popcountll(words[j]);
+    return card;
+}
+
+/*
+ * Build an array or bitmap container, whichever is smaller, holding the
+ * card bits set in words. The container must be empty.
+ *
+ * T = O(N)
+*/
+/*
+ * 根据位图 words 构建 array 或 bitmap 容器（取较小者）
+ * 位图中共有 card 个位被设置，容器必须是空的
+*/
+static void containerFromWords(roaringContainer *c, const uint64_t *words, uint32_t card) {
+    uint32_t j;
+
+    c->card = card;
+    if (card > ROARING_ARRAY_MAX) {
+        c->type = ROARING_BITMAP;
+        c->len = 0;
+        containerReserve(c, ROARING_BITMAP_ALLOC);
+        memcpy(c->data, words, ROARING_BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+
+    c->type = ROARING_ARRAY;
+    c->len = 0;
+    containerReserve(c, card);
+    for (j = 0; j < ROARING_BITMAP_WORDS; j++) {
+        uint64_t w = words[j];
+        while (w) {
+            c->data[c->len++] = (uint16_t)(j * 64 + __builtin_ctzll(w));
+            w &= w - 1;
+        }
+    }
+}
+
+/*
+ * Replace the content of a container with the given bitmap
+ *
+ * T = O(N)
+*/
+static void containerResetFromWords(roaringContainer *c, const uint64_t *words, uint32_t card) {
+    zfree(c->data);
+    c->data = NULL;
+    c->alloc = 0;
+    containerFromWords(c, words, card);
+}
+
+/*
+ * Convert a run container to an array or bitmap one, used before the
+ * operations that are not implemented on runs.
+ *
+ * T = O(N)
+*/
+/*
+ * 将 run 容器转换为 array 或 bitmap 容器，用于 run 容器不支持的操作之前
+*/
+static void containerUnrun(roaringContainer *c) {
+    uint64_t words[ROARING_BITMAP_WORDS];
+
+    if (c->type != ROARING_RUN) return;
+    containerToWords(c, words);
+    containerResetFromWords(c, words, c->card);
+}
+
+/*
+ * Deep copy of a container
+ *
+ * T = O(N)
+*/
+static void containerClone(roaringContainer *dst, const roaringContainer *src) {
+    *dst = *src;
+    dst->data = zmalloc(src->alloc * sizeof(uint16_t));
+    memcpy(dst->data, src->data, src->alloc * sizeof(uint16_t));
+}
+
+static int containerContains(const roaringContainer *c, uint16_t value) {
+    int32_t i;
+
+    switch (c->type) {
+        case ROARING_ARRAY:
+            return arraySearch(c->data, c->len, value) >= 0;
+        case ROARING_BITMAP:
+            return (containerWords(c)[value >> 6] >> (value & 63)) & 1;
+        default:
+            i = runSearch(c, value);
+            return i >= 0 && value <= (uint32_t)c->data[i * 2] + c->data[i * 2 + 1];
+    }
+}
+
+/*
+ * Add the low 16 bits of a value to a container.
+ * Returns 1 if the value was added, 0 if it was already there.
+ *
+ * T = O(N)
+*/
+/*
+ * 将值的低 16 位添加到容器中
+ * 添加成功返回 1，值已经存在返回 0
+*/
+static int containerAdd(roaringContainer *c, uint16_t value) {
+    int32_t pos;
+
+    if (c->type == ROARING_ARRAY) {
+        pos = arraySearch(c->data, c->len, value);
+        if (pos >= 0) return 0;
+        pos = -pos - 1;
+
+        // array 容器已满，转换为 bitmap 容器
+        if (c->len == ROARING_ARRAY_MAX) {
+            uint64_t words[ROARING_BITMAP_WORDS];
+            containerToWords(c, words);
+            words[value >> 6] |= 1ULL << (value & 63);
+            c->type = ROARING_BITMAP;
+            c->len = 0;
+            containerReserve(c, ROARING_BITMAP_ALLOC);
+            memcpy(c->data, words, sizeof(words));
+            c->card++;
+            return 1;
+        }
+
+        containerReserve(c, c->len + 1);
+        memmove(c->data + pos + 1, c->data + pos, (c->len - pos) * sizeof(uint16_t));
+        c->data[pos] = value;
+        c->len++;
+        c->card++;
+        return 1;
+    } else if (c->type == ROARING_BITMAP) {
+        uint64_t *w = containerWords(c) + (value >> 6);
+        uint64_t bit = 1ULL << (value & 63);
+
+        if (*w & bit) return 0;
+        *w |= bit;
+        c->card++;
+        return 1;
+    } else {
+        int32_t i = runSearch(c, value);
+        int joinprev, joinnext;
+
+        // 已经包含在区间 i 中
+        if (i >= 0 && value <= (uint32_t)c->data[i * 2] + c->data[i * 2 + 1]) return 0;
+
+        joinprev = i >= 0 && (uint32_t)c->data[i * 2] + c->data[i * 2 + 1] + 1 == value;
+        joinnext = (uint32_t)(i + 1) < c->len && (uint32_t)value + 1 == c->data[(i + 1) * 2];
+
+        if (joinprev && joinnext) {
+            // 填补两个区间之间的空隙，合并成一个区间
+            c->data[i * 2 + 1] = c->data[(i + 1) * 2] + c->data[(i + 1) * 2 + 1] - c->data[i * 2];
+            memmove(c->data + (i + 1) * 2, c->data + (i + 2) * 2,
+                    (c->len - i - 2) * 2 * sizeof(uint16_t));
+            c->len--;
+        } else if (joinprev) {
+            c->data[i * 2 + 1]++;
+        } else if (joinnext) {
+            c->data[(i + 1) * 2] = value;
+            c->data[(i + 1) * 2 + 1]++;
+        } else {
+            // 插入一个只包含 value 的新区间
+            containerReserve(c, (c->len + 1) * 2);
+            memmove(c->data + (i + 2) * 2, c->data + (i + 1) * 2,
+                    (c->len - i - 1) * 2 * sizeof(uint16_t));
+            c->data[(i + 1) * 2] = value;
+            c->data[(i + 1) * 2 + 1] = 0;
+            c->len++;
+        }
+        c->card++;
+        return 1;
+    }
+}
+
+/*
+ * Remove the low 16 bits of a value from a container.
+ * Returns 1 if the value was removed, 0 if it was not there.
+ *
+ * T = O(N)
+*/
+/*
+ * 从容器中删除值的低 16 位
+ * 删除成功返回 1，值不存在返回 0
+*/
+static int containerRemove(roaringContainer *c, uint16_t value) {
+    int32_t pos;
+
+    if (!containerContains(c, value)) return 0;
+    containerUnrun(c);
+
+    if (c->type == ROARING_ARRAY) {
+        pos = arraySearch(c->data, c->len, value);
+        memmove(c->data + pos, c->data + pos + 1, (c->len - pos - 1) * sizeof(uint16_t));
+        c->len--;
+        c->card--;
+    } else {
+        containerWords(c)[value >> 6] &= ~(1ULL << (value & 63));
+        c->card--;
+
+        // 成员数量降到 array 容器的限制以内，转换回 array 容器
+        if (c->card <= ROARING_ARRAY_MAX) {
+            uint64_t words[ROARING_BITMAP_WORDS];
+            memcpy(words, c->data, sizeof(words));
+            containerResetFromWords(c, words, c->card);
+        }
+    }
+    return 1;
+}
+
+/* ------------------------- Roaring API ---------------------------------- */
+
+/*
+ * Create an empty roaring bitmap
+ *
+ * T = O(1)
+*/
+roaring *roaringNew(void) {
+    roaring *r = zmalloc(sizeof(*r));
+
+    r->size = r->alloc = 0;
+    r->keys = NULL;
+    r->containers = NULL;
+    return r;
+}
+
+/*
+ * Free a roaring bitmap and all its containers
+ *
+ * T = O(N)
+*/
+void roaringFree(roaring *r) {
+    uint32_t j;
+
+    for (j = 0; j < r->size; j++) zfree(r->containers[j].data);
+    zfree(r->keys);
+    zfree(r->containers);
+    zfree(r);
+}
+
+/*
+ * Search the container for the given high 16 bits. Same return value
+ * convention of arraySearch().
+*/
+static int32_t roaringFindKey(roaring *r, uint16_t key) {
+    /* Appending in order is the common case when converting from intsets */
+    if (r->size && r->keys[r->size - 1] < key) return -((int32_t)r->size + 1);
+    return arraySearch(r->keys, r->size, key);
+}
+
+/*
+ * Insert an empty container for key at position pos and return it
+ *
+ * T = O(N)
+*/
+static roaringContainer *roaringInsertContainer(roaring *r, uint32_t pos, uint16_t key) {
+    roaringContainer *c;
+
+    if (r->size == r->alloc) {
+        r->alloc = r->alloc ? r->alloc * 2 : 4;
+        r->keys = zrealloc(r->keys, r->alloc * sizeof(uint16_t));
+        r->containers = zrealloc(r->containers, r->alloc * sizeof(roaringContainer));
+    }
+    memmove(r->keys + pos + 1, r->keys + pos, (r->size - pos) * sizeof(uint16_t));
+    memmove(r->containers + pos + 1, r->containers + pos,
+            (r->size - pos) * sizeof(roaringContainer));
+    r->keys[pos] = key;
+    r->size++;
+
+    c = r->containers + pos;
+    c->type = ROARING_ARRAY;
+    c->card = c->len = c->alloc = 0;
+    c->data = NULL;
+    return c;
+}
+
+/* Append a non empty container, taking ownership of its data */
+static void roaringAppendContainer(roaring *r, uint16_t key, roaringContainer *c) {
+    if (c->card == 0) {
+        zfree(c->data);
+        return;
+    }
+    *roaringInsertContainer(r, r->size, key) = *c;
+}
+
+static void roaringRemoveContainer(roaring *r, uint32_t pos) {
+    zfree(r->containers[pos].data);
+    memmove(r->keys + pos, r->keys + pos + 1, (r->size - pos - 1) * sizeof(uint16_t));
+    memmove(r->containers + pos, r->containers + pos + 1,
+            (r->size - pos - 1) * sizeof(roaringContainer));
+    r->size--;
+}
+
+/*
+ * Add a value to the set. Returns 1 if added, 0 if already present.
+ *
+ * 将 value 添加到集合中，添加成功返回 1，已经存在返回 0
+ *
+ * T = O(log N + C), C being the size of the container
+*/
+int roaringAdd(roaring *r, uint32_t value) {
+    int32_t pos = roaringFindKey(r, value >> 16);
+    roaringContainer *c;
+
+    if (pos >= 0) {
+        c = r->containers + pos;
+    } else {
+        c = roaringInsertContainer(r, -pos - 1, value >> 16);
+    }
+    return containerAdd(c, value & 0xffff);
+}
+
+/*
+ * Remove a value from the set. Returns 1 if removed, 0 if not present.
+ *
+ * 从集合中删除 value，删除成功返回 1，不存在返回 0
+ *
+ * T = O(log N + C)
+*/
+int roaringRemove(roaring *r, uint32_t value) {
+    int32_t pos = roaringFindKey(r, value >> 16);
+
+    if (pos < 0 || !containerRemove(r->containers + pos, value & 0xffff)) return 0;
+
+    // 删除空容器
+    if (r->containers[pos].card == 0) roaringRemoveContainer(r, pos);
+    return 1;
+}
+
+/*
+ * Return 1 if value is member of the set, 0 otherwise
+ *
+ * T = O(log N)
+*/
+int roaringContains(roaring *r, uint32_t value) {
+    int32_t pos = roaringFindKey(r, value >> 16);
+
+    return pos >= 0 && containerContains(r->containers + pos, value & 0xffff);
+}
+
+/*
+ * Return the number of members. Containers keep their cardinality, that
+ * bitmap operations recompute with popcount.
+ *
+ * 返回集合的成员数量
+ * 每个容器都记录了自己的成员数量，位图运算通过 popcount 重新计算
+ *
+ * T = O(N), N being the number of containers
+*/
+uint64_t roaringCardinality(roaring *r) {
+    uint64_t card = 0;
+    uint32_t j;
+
+    for (j = 0; j < r->size; j++) card += r->containers[j].card;
+    return card;
+}
+
+/*
+ * Store in *value the member with the given 0-based rank.
+ * Returns 0 if rank is out of range.
+ *
+ * T = O(N)
+*/
+/*
+ * 将排位为 rank（从 0 开始）的成员保存到 *value 中
+ * rank 超出范围时返回 0
+*/
+int roaringSelect(roaring *r, uint64_t rank, uint32_t *value) {
+    uint32_t j, k;
+
+    for (j = 0; j < r->size; j++) {
+        roaringContainer *c = r->containers + j;
+        uint32_t high = (uint32_t)r->keys[j] << 16;
+
+        if (rank >= c->card) {
+            rank -= c->card;
+            continue;
+        }
+
+        if (c->type == ROARING_ARRAY) {
+            *value = high | c->data[rank];
+        } else if (c->type == ROARING_BITMAP) {
+            uint64_t *words = containerWords(c), w;
+
+            for (k = 0; rank >= (uint64_t)__builtin_popcountll(words[k]); k++) {
+                rank -= __builtin_popcountll(words[k]);
+            }
+            w = words[k];
+            while (rank--) w &= w - 1;
+            *value = high | (k * 64 + __builtin_ctzll(w));
+        } else {
+            for (k = 0; rank > c->data[k * 2 + 1]; k++) {
+                rank -= c->data[k * 2 + 1] + 1;
+            }
+            *value = high | (c->data[k * 2] + rank);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Return a random member, the set must not be empty
+ *
+ * T = O(N)
+*/
+int64_t roaringRandom(roaring *r) {
+    uint64_t card = roaringCardinality(r);
+    uint64_t rank = (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % card;
+    uint32_t value = 0;
+
+    roaringSelect(r, rank, &value);
+    return value;
+}
+
+/* ------------------------- Set algebra ---------------------------------- */
+
+/*
+ * Container operations. Array vs array uses sorted merges, array vs
+ * anything probes the other container, every other combination goes
+ * through 65536 bits bitmaps combined 64 bits at a time, with the result
+ * cardinality computed by popcount.
+*/
+/*
+ * 容器之间的运算：array 与 array 使用有序归并，
+ * array 与其他类型的容器逐个探测，其余组合展开为 65536 位的位图，
+ * 每次处理 64 位，结果的成员数量通过 popcount 计算
+*/
+#define ROARING_OP_AND 0
+#define ROARING_OP_OR 1
+#define ROARING_OP_ANDNOT 2
+
+static void containerOp(const roaringContainer *a, const roaringContainer *b,
+                        int op, roaringContainer *out) {
+    uint64_t wa[ROARING_BITMAP_WORDS], wb[ROARING_BITMAP_WORDS];
+    uint32_t i = 0, j = 0;
+
+    out->type = ROARING_ARRAY;
+    out->card = out->len = out->alloc = 0;
+    out->data = NULL;
+
+    // 求交集和差集时，a 为 array 容器：逐个探测 b
+    if (a->type == ROARING_ARRAY && op != ROARING_OP_OR &&
+        b->type != ROARING_ARRAY) {
+        containerReserve(out, a->len);
+        for (i = 0; i < a->len; i++) {
+            if (containerContains(b, a->data[i]) == (op == ROARING_OP_AND)) {
+                out->data[out->len++] = a->data[i];
+            }
+        }
+        out->card = out->len;
+        return;
+    }
+
+    // 求交集时，b 为 array 容器：交换两者即可
+    if (b->type == ROARING_ARRAY && op == ROARING_OP_AND && a->type != ROARING_ARRAY) {
+        containerOp(b, a, op, out);
+        return;
+    }
+
+    // 两个 array 容器：有序归并
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY &&
+        (op != ROARING_OP_OR || a->len + b->len <= ROARING_ARRAY_MAX)) {
+        containerReserve(out, op == ROARING_OP_OR ? a->len + b->len : a->len);
+        while (i < a->len && j < b->len) {
+            if (a->data[i] < b->data[j]) {
+                if (op != ROARING_OP_AND) out->data[out->len++] = a->data[i];
+                i++;
+            } else if (a->data[i] > b->data[j]) {
+                if (op == ROARING_OP_OR) out->data[out->len++] = b->data[j];
+                j++;
+            } else {
+                if (op != ROARING_OP_ANDNOT) out->data[out->len++] = a->data[i];
+                i++;
+                j++;
+            }
+        }
+        if (op != ROARING_OP_AND) {
+            for (; i < a->len; i++) out->data[out->len++] = a->data[i];
+        }
+        if (op == ROARING_OP_OR) {
+            for (; j < b->len; j++) out->data[out->len++] = b->data[j];
+        }
+        out->card = out->len;
+        return;
+    }
+
+    // 其余情况：展开为位图后按字运算
+    containerToWords(a, wa);
+    containerToWords(b, wb);
+    for (i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        if (op == ROARING_OP_AND) wa[i] &= wb[i];
+        else if (op == ROARING_OP_OR) wa[i] |= wb[i];
+        else wa[i] &= ~wb[i];
+    }
+    containerFromWords(out, wa, wordsPopcount(wa));
+}
+
+/*
+ * Generic roaring vs roaring operation, merging the two sorted key lists
+ *
+ * T = O(N + M)
+*/
+static roaring *roaringOp(roaring *a, roaring *b, int op) {
+    roaring *res = roaringNew();
+    uint32_t i = 0, j = 0;
+    roaringContainer c;
+
+    while (i < a->size && j < b->size) {
+        if (a->keys[i] < b->keys[j]) {
+            if (op != ROARING_OP_AND) {
+                containerClone(&c, a->containers + i);
+                roaringAppendContainer(res, a->keys[i], &c);
+            }
+            i++;
+        } else if (a->keys[i] > b->keys[j]) {
+            if (op == ROARING_OP_OR) {
+                containerClone(&c, b->containers + j);
+                roaringAppendContainer(res, b->keys[j], &c);
+            }
+            j++;
+        } else {
+            containerOp(a->containers + i, b->containers + j, op, &c);
+            roaringAppendContainer(res, a->keys[i], &c);
+            i++;
+            j++;
+        }
+    }
+
+    if (op != ROARING_OP_AND) {
+        for (; i < a->size; i++) {
+            containerClone(&c, a->containers + i);
+            roaringAppendContainer(res, a->keys[i], &c);
+        }
+    }
+    if (op == ROARING_OP_OR) {
+        for (; j < b->size; j++) {
+            containerClone(&c, b->containers + j);
+            roaringAppendContainer(res, b->keys[j], &c);
+        }
+    }
+    return res;
+}
+
+/* Return a new set with the members of both a and b */
+roaring *roaringAnd(roaring *a, roaring *b) {
+    return roaringOp(a, b, ROARING_OP_AND);
+}
+
+/* Return a new set with the members of a or b */
+roaring *roaringOr(roaring *a, roaring *b) {
+    return roaringOp(a, b, ROARING_OP_OR);
+}
+
+/* Return a new set with the members of a that are not in b */
+roaring *roaringAndNot(roaring *a, roaring *b) {
+    return roaringOp(a, b, ROARING_OP_ANDNOT);
+}
+
+/*
+ * Convert every container to the smallest of the array, bitmap and run
+ * layouts. Meant to be called after bulk loading.
+ *
+ * T = O(N)
+*/
+/*
+ * 将每个容器转换为 array、bitmap 和 run 三种布局中最小的一种
+ * 适合在批量载入之后调用
+*/
+void roaringRunOptimize(roaring *r) {
+    uint64_t words[ROARING_BITMAP_WORDS];
+    uint32_t j, k;
+
+    for (j = 0; j < r->size; j++) {
+        roaringContainer *c = r->containers + j;
+        uint32_t runs = 0, best;
+        uint64_t carry = 0;
+
+        containerToWords(c, words);
+
+        // 每个区间的起点是一个前一位没有被设置的位
+        for (k = 0; k < ROARING_BITMAP_WORDS; k++) {
+            uint64_t w = words[k];
+            runs += __builtin_popcountll(w & ~((w << 1) | carry));
+            carry = w >> 63;
+        }
+
+        best = c->card <= ROARING_ARRAY_MAX ? c->card : ROARING_BITMAP_ALLOC;
+        if (runs * 2 < best) {
+            if (c->type == ROARING_RUN) continue;
+
+            // 转换为 run 容器
+            zfree(c->data);
+            c->data = NULL;
+            c->alloc = 0;
+            c->type = ROARING_RUN;
+            c->len = 0;
+            containerReserve(c, runs * 2);
+            for (k = 0; k < 65536; k++) {
+                if (!((words[k >> 6] >> (k & 63)) & 1)) continue;
+                c->data[c->len * 2] = k;
+                while (k + 1 < 65536 && ((words[(k + 1) >> 6] >> ((k + 1) & 63)) & 1)) k++;
+                c->data[c->len * 2 + 1] = k - c->data[c->len * 2];
+                c->len++;
+            }
+        } else if (c->type == ROARING_RUN) {
+            containerResetFromWords(c, words, c->card);
+        } else if (c->alloc > c->len && c->type == ROARING_ARRAY) {
+            // 释放 array 容器多余的空间
+            c->data = zrealloc(c->data, c->len * sizeof(uint16_t));
+            c->alloc = c->len;
+        }
+    }
+}
+
+/*
+ * Return the number of bytes used by the set, including the unused
+ * space allocated for future growth
+ *
+ * 返回集合占用的字节数，包括为后续增长预先分配的空间
+ *
+ * T = O(N)
+*/
+size_t roaringBlobLen(roaring *r) {
+    size_t len = sizeof(*r) + r->alloc * (sizeof(uint16_t) + sizeof(roaringContainer));
+    uint32_t j;
+
+    for (j = 0; j < r->size; j++) len += r->containers[j].alloc * sizeof(uint16_t);
+    return len;
+}
+
+/*
+ * Iterate the set in ascending order
+ *
+ * 按从小到大的顺序迭代集合
+*/
+void roaringInitIterator(roaring *r, roaringIterator *it) {
+    it->r = r;
+    it->ci = 0;
+    it->pos = 0;
+    it->off = 0;
+}
+
+/*
+ * Store the next member in *value and return 1, or return 0 when the
+ * iteration is over. The set must not be modified while iterating.
+*/
+int roaringNext(roaringIterator *it, uint32_t *value) {
+    while (it->ci < it->r->size) {
+        roaringContainer *c = it->r->containers + it->ci;
+        uint32_t high = (uint32_t)it->r->keys[it->ci] << 16;
+
+        if (c->type == ROARING_ARRAY && it->pos < c->len) {
+            *value = high | c->data[it->pos++];
+            return 1;
+        } else if (c->type == ROARING_BITMAP && it->pos < 65536) {
+            uint64_t *words = containerWords(c);
+            uint32_t k = it->pos >> 6;
+            uint64_t w = words[k] & (~0ULL << (it->pos & 63));
+
+            while (!w && ++k < ROARING_BITMAP_WORDS) w = words[k];
+            if (w) {
+                uint32_t bit = k * 64 + __builtin_ctzll(w);
+                *value = high | bit;
+                it->pos = bit + 1;
+                return 1;
+            }
+        } else if (c->type == ROARING_RUN && it->pos < c->len) {
+            *value = high | (c->data[it->pos * 2] + it->off);
+            if (it->off++ == c->data[it->pos * 2 + 1]) {
+                it->pos++;
+                it->off = 0;
+            }
+            return 1;
+        }
+
+        // 当前容器迭代完毕，移动到下一个容器
+        it->ci++;
+        it->pos = 0;
+        it->off = 0;
+    }
+    return 0;
+}
+
+/*
+ * Return 1 if every member of the intset fits in 32 unsigned bits, so that
+ * it can be converted to the roaring encoding. The intset is sorted, so
+ * checking the first and the last member is enough.
+ *
+ * T = O(1)
+*/
+/*
+ * 如果整数集合的所有成员都可以用 32 位无符号整数表示，返回 1
+ * 整数集合是有序的，只需要检查第一个和最后一个成员
+*/
+int roaringCanHoldIntset(intset *is) {
+    int64_t first, last;
+
+    if (intsetLen(is) == 0) return 1;
+    intsetGet(is, 0, &first);
+    intsetGet(is, intsetLen(is) - 1, &last);
+    return first >= 0 && last <= UINT32_MAX;
+}
+
+/*
+ * Convert an intset to a roaring bitmap. roaringCanHoldIntset() must be
+ * true. The members come sorted, so every add is an append.
+ *
+ * T = O(N)
+*/
+/*
+ * 将整数集合转换为 roaring 位图，roaringCanHoldIntset() 必须为真
+ * 成员是有序的，所以每次添加都是追加操作
+*/
+roaring *roaringFromIntset(intset *is) {
+    roaring *r = roaringNew();
+    uint32_t j, len = intsetLen(is);
+    int64_t v;
+
+    for (j = 0; j < len; j++) {
+        intsetGet(is, j, &v);
+        roaringAdd(r, (uint32_t)v);
+    }
+    roaringRunOptimize(r);
+    return r;
+}
+
+// 测试部分
+#ifdef ROARING_TEST_MAIN
+#include <sys/time.h>
+#include "testhelp.h"
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((long long)tv.tv_sec) * 1000000) + tv.tv_usec;
+}
+
+static uint32_t xorshift32(uint32_t *s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+/*
+ * Memory per member for ID sets of n members spread over a range of
+ * n * spread values. spread 1 gives consecutive IDs, spread 2 half of the
+ * IDs, large spreads sparse IDs. Members are generated in ascending order
+ * with random gaps, the same order in which intsets are converted.
+*/
+/*
+ * 统计 n 个成员、分布在 n * spread 个值范围内的 ID 集合平均每个成员占用的内存
+ * spread 为 1 时是连续的 ID，为 2 时约一半的 ID，更大时是稀疏的 ID
+*/
+static void memoryReport(uint32_t n, uint32_t spread) {
+    roaring *r = roaringNew();
+    uint32_t seed = 12345, j, v = 0;
+    long long start = usec();
+
+    for (j = 0; j < n; j++) {
+        v += (spread == 1) ? 1 : 1 + xorshift32(&seed) % (2 * spread - 1);
+        roaringAdd(r, v);
+    }
+    roaringRunOptimize(r);
+    printf("%9u members, spread %5u: %7.3f bytes/member "
+           "(intset %d, dict+robj ~80), built in %lld ms\n",
+           n, spread, (double)roaringBlobLen(r) / roaringCardinality(r),
+           v > INT32_MAX ? 8 : 4, (usec() - start) / 1000);
+    roaringFree(r);
+}
+
+int main(int argc, char **argv) {
+    uint32_t maxn = (argc > 1) ? (uint32_t)atol(argv[1]) : 10000000;
+
+    {
+        roaring *r = roaringNew();
+        uint32_t j, ok = 1;
+
+        for (j = 0; j < 100000; j += 3) roaringAdd(r, j);
+        for (j = 0; j < 100000; j++) ok &= roaringContains(r, j) == (j % 3 == 0);
+        test_cond("Add and membership ", ok && roaringCardinality(r) == 33334);
+        test_cond("Dense chunk becomes a bitmap container ",
+            r->containers[0].type == ROARING_BITMAP);
+        test_cond("Duplicate add is refused ", roaringAdd(r, 3) == 0);
+
+        for (j = 0; j < 100000; j += 6) roaringRemove(r, j);
+        test_cond("Remove ", roaringCardinality(r) == 16667 && !roaringContains(r, 6) &&
+            roaringContains(r, 3));
+        roaringFree(r);
+    }
+
+    {
+        roaring *r = roaringNew();
+        uint32_t j, ok = 1;
+
+        // 填满一个 array 容器，再添加一个位于中间的值
+        for (j = 0; j < ROARING_ARRAY_MAX; j++) roaringAdd(r, j * 2);
+        ok &= r->containers[0].type == ROARING_ARRAY;
+        ok &= roaringAdd(r, 4097) == 1;
+        for (j = 0; j < ROARING_ARRAY_MAX * 2; j++)
+            ok &= roaringContains(r, j) == (j % 2 == 0 || j == 4097);
+        test_cond("Full array container turns into a bitmap on the next add ",
+            ok && r->containers[0].type == ROARING_BITMAP &&
+            roaringCardinality(r) == ROARING_ARRAY_MAX + 1 &&
+            roaringAdd(r, 4097) == 0);
+        roaringFree(r);
+    }
+
+    {
+        roaring *r = roaringNew(), *a = roaringNew(), *b = roaringNew(), *x;
+        roaringIterator it;
+        uint32_t j, v, prev = 0, count = 0, ok = 1;
+
+        for (j = 0; j < 200000; j++) roaringAdd(r, 1000000 + j);
+        roaringRunOptimize(r);
+        test_cond("Consecutive values become run containers ",
+            r->containers[0].type == ROARING_RUN && roaringBlobLen(r) < 200);
+        roaringAdd(r, 1200000);
+        roaringAdd(r, 999999);
+        test_cond("Run containers grow in place ", roaringCardinality(r) == 200002 &&
+            r->containers[0].type == ROARING_RUN && r->containers[0].len == 1 &&
+            r->containers[r->size - 1].len == 1);
+        roaringRemove(r, 1000500);
+        test_cond("Remove from a run container ", !roaringContains(r, 1000500) &&
+            roaringContains(r, 1000501) && roaringCardinality(r) == 200001);
+
+        roaringInitIterator(r, &it);
+        while (roaringNext(&it, &v)) {
+            ok &= (count == 0 || v > prev);
+            prev = v;
+            count++;
+        }
+        test_cond("Iterator visits every member in order ", ok && count == 200001);
+        test_cond("roaringSelect() ", roaringSelect(r, 0, &v) && v == 999999 &&
+            roaringSelect(r, 200000, &v) && v == 1200000);
+
+        for (j = 0; j < 300000; j += 2) roaringAdd(a, j * 7);
+        for (j = 0; j < 300000; j += 3) roaringAdd(b, j * 7);
+        x = roaringAnd(a, b);
+        test_cond("roaringAnd() ", roaringCardinality(x) == 50000 && roaringContains(x, 42));
+        roaringFree(x);
+        x = roaringOr(a, b);
+        test_cond("roaringOr() ", roaringCardinality(x) == 200000);
+        roaringFree(x);
+        x = roaringAndNot(a, b);
+        test_cond("roaringAndNot() ", roaringCardinality(x) == 100000 &&
+            roaringContains(x, 14) && !roaringContains(x, 42));
+        roaringFree(x);
+        roaringFree(a);
+        roaringFree(b);
+        roaringFree(r);
+    }
+
+    {
+        intset *is = intsetNew();
+        roaring *r;
+        uint32_t j;
+
+        for (j = 0; j < 1000; j++) is = intsetAdd(is, 3000000000LL + j * 11, NULL);
+        test_cond("Intset with values up to UINT32_MAX can be converted ",
+            roaringCanHoldIntset(is));
+        r = roaringFromIntset(is);
+        test_cond("roaringFromIntset() ", roaringCardinality(r) == 1000 &&
+            roaringContains(r, 3000000000U + 999 * 11));
+        is = intsetAdd(is, -1, NULL);
+        test_cond("Negative members can't be converted ", !roaringCanHoldIntset(is));
+        roaringFree(r);
+        zfree(is);
+    }
+
+    /*
+     * Memory report for dense and sparse ID sets, pass the maximum set
+     * size as first argument (e.g. 100000000) to go past the default.
+    */
+    {
+        static const uint32_t spreads[] = {1, 2, 16, 400};
+        uint32_t n, s;
+
+        for (n = 1000000; n <= maxn; n *= 10) {
+            for (s = 0; s < sizeof(spreads) / sizeof(spreads[0]); s++) {
+                if ((uint64_t)n * spreads[s] > UINT32_MAX) continue;
+                memoryReport(n, spreads[s]);
+            }
+        }
+    }
+
+    test_report();
+    return 0;
+}
+#endif
@@ -0,0 +1,93 @@
+#ifndef __ROARING_H__
+#define __ROARING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "intset.h"
+
+/*
+ * Roaring bitmap: a compressed set of 32 bit unsigned integers.
+ *
+ * The value space is split in chunks of 65536 values keyed by the high
+ * 16 bits. Every non empty chunk is stored in a container holding the
+ * low 16 bits of its members, using the cheapest of three layouts:
+ *
+ * - array:  sorted uint16_t values, up to ROARING_ARRAY_MAX members
+ * - bitmap: 65536 bits, for chunks with more members than that
+ * - run:    sorted (start, length - 1) uint16_t pairs, for long runs of
+ *           consecutive values, produced by roaringRunOptimize()
+*/
+/*
+ * Roaring 位图：32 位无符号整数的压缩集合
+ *
+ * 值空间按照高 16 位划分成 65536 个值一组的块，
+ * 每个非空的块使用一个容器保存成员的低 16 位，容器选择三种布局中最省空间的一种：
+ *
+ * - array：  有序的 uint16_t 数组，最多 ROARING_ARRAY_MAX 个成员
+ * - bitmap： 65536 位的位图，用于成员更多的块
+ * - run：    有序的 (起始值, 长度 - 1) uint16_t 对，用于很长的连续值，
+ *            由 roaringRunOptimize() 生成
+*/
+#define ROARING_ARRAY 0
+#define ROARING_BITMAP 1
+#define ROARING_RUN 2
+
+#define ROARING_ARRAY_MAX 4096                 // array 容器的最大成员数
+#define ROARING_BITMAP_WORDS (65536 / 64)      // bitmap 容器的 64 位字数量
+
+// 容器
+typedef struct roaringContainer {
+
+    uint8_t type;           // ROARING_ARRAY, ROARING_BITMAP 或 ROARING_RUN
+
+    uint32_t card;          // 容器中的成员数量
+
+    uint32_t len;           // array：元素数量，run：区间数量，bitmap：未使用
+
+    uint32_t alloc;         // data 中已分配的 uint16_t 数量
+
+    uint16_t *data;         // 容器数据
+
+} roaringContainer;
+
+// Roaring 位图
+typedef struct roaring {
+
+    uint32_t size;                  // 容器数量
+
+    uint32_t alloc;                 // 已分配的容器槽位数量
+
+    uint16_t *keys;                 // 每个容器对应的高 16 位，有序
+
+    roaringContainer *containers;   // 容器数组
+
+} roaring;
+
+// 迭代器
+typedef struct roaringIterator {
+    roaring *r;
+    uint32_t ci;            // 当前容器
+    uint32_t pos;           // 容器内的位置（array 下标、bitmap 位号或 run 下标）
+    uint32_t off;           // run 容器中当前区间内的偏移
+} roaringIterator;
+
+roaring *roaringNew(void);
+void roaringFree(roaring *r);
+int roaringAdd(roaring *r, uint32_t value);
+int roaringRemove(roaring *r, uint32_t value);
+int roaringContains(roaring *r, uint32_t value);
+uint64_t roaringCardinality(roaring *r);
+int roaringSelect(roaring *r, uint64_t rank, uint32_t *value);
+int64_t roaringRandom(roaring *r);
+roaring *roaringAnd(roaring *a, roaring *b);
+roaring *roaringOr(roaring *a, roaring *b);
+roaring *roaringAndNot(roaring *a, roaring *b);
+void roaringRunOptimize(roaring *r);
+size_t roaringBlobLen(roaring *r);
+void roaringInitIterator(roaring *r, roaringIterator *it);
+int roaringNext(roaringIterator *it, uint32_t *value);
+int roaringCanHoldIntset(intset *is);
+roaring *roaringFromIntset(intset *is);
+
+#endif // __ROARING_H__
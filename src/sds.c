@@ -207,7 +207,7 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
 
     // s 目前剩余空间长度足够，无须进行扩展，直接返回
     if (free >= addlen) {
-        return;
+        return s;
     }
 
     // 获取 s 目前已占用空间长度
@@ -231,7 +231,7 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
     newsh = zrealloc(sh, sizeof(struct sdshdr) + newlen + 1);
 
     // 内存不足，分配失败，返回 NULL
-    if (newlen == NULL) {
+    if (newsh == NULL) {
         return NULL;
     }
 
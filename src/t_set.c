@@ -0,0 +1,310 @@
+/*-----------------------------------------------------------------------------
+ * Set API
+ *----------------------------------------------------------------------------*/
+/*
+ * Sets of integers start as intsets. Once they grow past
+ * REDIS_SET_MAX_INTSET_ENTRIES members they are upgraded to the roaring
+ * bitmap encoding when every member fits in 32 unsigned bits, instead of
+ * a hash table of string objects that costs about 80 bytes per member.
+ *
+ * Sets that can't use either, because a member doesn't fit in 32 unsigned
+ * bits, are converted to the hash table encoding.
+ *
+ * Intsets are never packed here (see intsetPack()): sets are written to
+ * one member at a time, and every write would unpack them again.
+*/
+/*
+ * 整数集合一开始使用 intset 编码，
+ * 成员数量超过 REDIS_SET_MAX_INTSET_ENTRIES 后，
+ * 如果所有成员都可以用 32 位无符号整数表示，就升级为 roaring 位图编码，
+ * 而不是每个成员大约要占用 80 字节的字符串对象哈希表
+ *
+ * 两种编码都不能使用时（有成员不能用 32 位无符号整数表示），转换为哈希表编码
+ *
+ * 这里不会压缩 intset（见 intsetPack()）：集合每次写入一个成员，而每次写入都会重新解压
+*/
+
+#include "redis.h"
+#include "intset.h"
+#include "roaring.h"
+
+/* ----------------------------------------------------------------------------
+ * Dict type
+ * --------------------------------------------------------------------------*/
+
+/*
+ * Hash of a string object of any encoding: integers and inline strings
+ * hash like the sds string with the same content.
+*/
+// 任意编码的字符串对象的哈希值：整数和 INLINE 字符串的哈希值和内容相同的 sds 字符串一样
+static unsigned int dictEncObjHash(const void *key) {
+    robj *o = (robj*)key;
+    char buf[32];
+    int len;
+
+    if (sdsEncodedObject(o)) {
+        return dictGenHashFunction(o->ptr, sdslen((sds)o->ptr));
+    } else if (o->encoding == REDIS_ENCODING_INLINE) {
+        return dictGenHashFunction(inlineObjectBuf(o), inlineObjectLen(o));
+    } else {
+        len = ll2string(buf, sizeof(buf), (long)o->ptr);
+        return dictGenHashFunction((unsigned char*)buf, len);
+    }
+}
+
+static int dictEncObjKeyCompare(void *privdata, const void *key1,
+        const void *key2)
+{
+    DICT_NOTUSED(privdata);
+
+    return equalStringObjects((robj*)key1, (robj*)key2);
+}
+
+static int dictEncObjDestructor(void *privdata, void *key) {
+    DICT_NOTUSED(privdata);
+
+    decrRefCount(key);
+    return 0;
+}
+
+/* Sets, keys are string objects of any encoding, vals are NULL. */
+// 集合，键为任意编码的字符串对象，值为 NULL
+dictType setDictType = {
+    dictEncObjHash,             /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictEncObjKeyCompare,       /* key compare */
+    dictEncObjDestructor,       /* key destructor */
+    NULL                        /* val destructor */
+};
+
+
+/*
+ * Convert an intset encoded set to the roaring encoding.
+ *
+ * Returns REDIS_ERR, leaving the set untouched, when some member doesn't
+ * fit in 32 unsigned bits: the caller has to fall back to the hash table
+ * encoding.
+ *
+ * T = O(N)
+*/
+/*
+ * 将 intset 编码的集合转换为 roaring 编码
+ *
+ * 如果有成员不能用 32 位无符号整数表示，那么不改动集合并返回 REDIS_ERR，
+ * 调用者需要转而使用哈希表编码
+*/
+int setTypeConvertIntsetToRoaring(robj *setobj) {
+    intset *is;
+
+    redisAssert(setobj->type == REDIS_SET && setobj->encoding == REDIS_ENCODING_INTSET);
+
+    is = setobj->ptr;
+    if (!roaringCanHoldIntset(is)) return REDIS_ERR;
+
+    setobj->ptr = roaringFromIntset(is);
+    setobj->encoding = REDIS_ENCODING_ROARING;
+    zfree(is);
+    return REDIS_OK;
+}
+
+/*
+ * Convert an intset or roaring encoded set to the hash table encoding,
+ * the one that can hold any member.
+ *
+ * T = O(N)
+*/
+// 将 intset 或 roaring 编码的集合转换为可以保存任意成员的哈希表编码
+void setTypeConvertToHashTable(robj *setobj) {
+    dict *d;
+
+    redisAssert(setobj->type == REDIS_SET);
+
+    d = dictCreate(&setDictType, NULL);
+    if (setobj->encoding == REDIS_ENCODING_INTSET) {
+        intset *is = setobj->ptr;
+        uint32_t j, len = intsetLen(is);
+        int64_t value;
+
+        // 预先扩展字典，避免转换过程中的 rehash
+        dictExpand(d, len);
+        for (j = 0; j < len; j++) {
+            intsetGet(is, j, &value);
+            redisAssert(dictAdd(d, createStringObjectFromLongLong(value), NULL) == DICT_OK);
+        }
+        zfree(is);
+    } else if (setobj->encoding == REDIS_ENCODING_ROARING) {
+        roaring *r = setobj->ptr;
+        roaringIterator it;
+        uint32_t value;
+
+        dictExpand(d, roaringCardinality(r));
+        roaringInitIterator(r, &it);
+        while (roaringNext(&it, &value)) {
+            redisAssert(dictAdd(d, createStringObjectFromLongLong(value), NULL) == DICT_OK);
+        }
+        roaringFree(r);
+    } else {
+        redisPanic("Unsupported set conversion");
+    }
+    setobj->ptr = d;
+    setobj->encoding = REDIS_ENCODING_HT;
+}
+
+/*
+ * Add an integer member to a set, upgrading the intset when it grows past
+ * the configured limit. Members a roaring set can't hold convert it to
+ * the hash table encoding, as does an intset that can't become roaring.
+ *
+ * Returns 1 if the member was added, 0 if it was already there.
+ *
+ * T = O(N)
+*/
+/*
+ * 将整数成员添加到集合中，intset 超出限制时对其进行升级
+ * roaring 集合不能保存的成员会将它转换为哈希表编码，不能升级为 roaring 的 intset 也一样
+ *
+ * 添加成功返回 1，成员已经存在返回 0
+*/
+int setTypeAddInteger(robj *setobj, int64_t value) {
+    uint8_t success = 0;
+
+    if (setobj->encoding == REDIS_ENCODING_INTSET) {
+        setobj->ptr = intsetAdd(setobj->ptr, value, &success);
+        if (success && intsetLen(setobj->ptr) > REDIS_SET_MAX_INTSET_ENTRIES) {
+            // 有成员不能用 32 位无符号整数表示
+            if (setTypeConvertIntsetToRoaring(setobj) == REDIS_ERR)
+                setTypeConvertToHashTable(setobj);
+        }
+        return success;
+    }
+
+    if (setobj->encoding == REDIS_ENCODING_ROARING) {
+        if (value >= 0 && value <= UINT32_MAX)
+            return roaringAdd(setobj->ptr, (uint32_t)value);
+        setTypeConvertToHashTable(setobj);
+    }
+
+    if (setobj->encoding == REDIS_ENCODING_HT) {
+        robj *member = createStringObjectFromLongLong(value);
+
+        if (dictAdd(setobj->ptr, member, NULL) == DICT_OK) return 1;
+        decrRefCount(member);
+        return 0;
+    }
+
+    redisPanic("Unknown set encoding");
+    return 0;
+}
+
+/*
+ * Return 1 if value is member of the set
+ *
+ * T = O(log N)
+*/
+int setTypeIsMemberInteger(robj *setobj, int64_t value) {
+    if (setobj->encoding == REDIS_ENCODING_INTSET) {
+        return intsetFind(setobj->ptr, value);
+    } else if (setobj->encoding == REDIS_ENCODING_ROARING) {
+        return value >= 0 && value <= UINT32_MAX &&
+               roaringContains(setobj->ptr, (uint32_t)value);
+    } else if (setobj->encoding == REDIS_ENCODING_HT) {
+        robj *member = createStringObjectFromLongLong(value);
+        int found = dictFind(setobj->ptr, member) != NULL;
+
+        decrRefCount(member);
+        return found;
+    } else {
+        redisPanic("Unknown set encoding");
+    }
+    return 0;
+}
+
+/*
+ * Return the number of members of the set
+ *
+ * T = O(1) for intsets, O(N) containers for roaring sets
+*/
+unsigned long setTypeSize(robj *setobj) {
+    if (setobj->encoding == REDIS_ENCODING_HT) {
+        return dictSize((dict*)setobj->ptr);
+    } else if (setobj->encoding == REDIS_ENCODING_INTSET) {
+        return intsetLen((intset*)setobj->ptr);
+    } else if (setobj->encoding == REDIS_ENCODING_ROARING) {
+        return roaringCardinality((roaring*)setobj->ptr);
+    } else {
+        redisPanic("Unknown set encoding");
+    }
+    return 0;
+}
+
+#ifdef SET_TEST_MAIN
+#include <stdio.h>
+#include "testhelp.h"
+
+// 创建一个包含 [first, first + count) 之间整数的集合
+static robj *setTestCreate(int64_t first, int count) {
+    robj *set = createIntsetObject();
+    int j;
+
+    for (j = 0; j < count; j++) setTypeAddInteger(set, first + j);
+    return set;
+}
+
+// 集合是否包含 [first, first + count) 之间的所有整数
+static int setTestHasRange(robj *set, int64_t first, int count) {
+    int j;
+
+    for (j = 0; j < count; j++) {
+        if (!setTypeIsMemberInteger(set, first + j)) return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    int count = REDIS_SET_MAX_INTSET_ENTRIES + 1;
+    robj *set;
+
+    createSharedIntegers();
+
+    set = setTestCreate(0, count);
+    test_cond("An intset past the limit becomes roaring",
+        set->encoding == REDIS_ENCODING_ROARING && setTypeSize(set) == (unsigned long)count);
+
+    test_cond("SADD of a negative value converts a roaring set to a hash table",
+        setTypeAddInteger(set, -1) == 1 &&
+        set->encoding == REDIS_ENCODING_HT &&
+        setTypeSize(set) == (unsigned long)count + 1 &&
+        setTypeIsMemberInteger(set, -1) && setTestHasRange(set, 0, count) &&
+        !setTypeIsMemberInteger(set, count));
+    test_cond("SADD of an existing member of a hash table set returns 0",
+        setTypeAddInteger(set, -1) == 0 && setTypeAddInteger(set, 5) == 0 &&
+        setTypeSize(set) == (unsigned long)count + 1);
+    decrRefCount(set);
+
+    set = setTestCreate(1000, count);
+    test_cond("SADD of a value above 32 bits converts a roaring set to a hash table",
+        set->encoding == REDIS_ENCODING_ROARING &&
+        setTypeAddInteger(set, 1LL << 40) == 1 &&
+        set->encoding == REDIS_ENCODING_HT &&
+        setTypeIsMemberInteger(set, 1LL << 40) && setTestHasRange(set, 1000, count) &&
+        setTypeAddInteger(set, UINT32_MAX) == 1 &&
+        setTypeSize(set) == (unsigned long)count + 2);
+    decrRefCount(set);
+
+    // 升级为 roaring 失败时，intset 转换为哈希表，而不是继续增长
+    set = setTestCreate(-10, REDIS_SET_MAX_INTSET_ENTRIES);
+    test_cond("An intset at the limit with a negative member stays an intset",
+        set->encoding == REDIS_ENCODING_INTSET);
+    test_cond("A failed roaring conversion falls back to a hash table",
+        setTypeAddInteger(set, 100000) == 1 &&
+        set->encoding == REDIS_ENCODING_HT &&
+        setTypeSize(set) == REDIS_SET_MAX_INTSET_ENTRIES + 1 &&
+        setTestHasRange(set, -10, REDIS_SET_MAX_INTSET_ENTRIES) &&
+        setTypeIsMemberInteger(set, 100000));
+    decrRefCount(set);
+
+    test_report();
+    return 0;
+}
+#endif
@@ -52,6 +52,7 @@
 #include "object.c"
 
 #include <math.h>
+#include <stdint.h>
 
 static int zslLexValueGteMin(robj *value, zlexrangespec *spec);
 static int zslLexValueLteMax(robj *value, zlexrangespec *spec);
@@ -136,27 +137,97 @@ void zslFree(zskiplist *zsl) {
     zfree(zsl);
 }
 
+/*
+ * Skiplist levels are drawn from a per-thread xorshift64* generator
+ * instead of libc random(), that takes a global lock in glibc and
+ * serializes threads building skiplists at the same time.
+ *
+ * A thread that never called zslSetRandomSeed() is lazily seeded from the
+ * clock and a process wide counter, so different threads get different
+ * streams. Benchmarks and tests can call zslSetRandomSeed() to get a
+ * reproducible sequence of levels in the calling thread.
+*/
+/*
+ * 跳跃表的层数由每个线程独立的 xorshift64* 生成器产生，
+ * 不再使用 libc 的 random()，后者在 glibc 中会获取全局锁，
+ * 导致多个线程同时构建跳跃表时被串行化
+ *
+ * 没有调用过 zslSetRandomSeed() 的线程会在第一次使用时
+ * 根据时钟和一个进程级计数器自动播种，保证各个线程的序列不同；
+ * 基准测试和单元测试可以调用 zslSetRandomSeed() 得到可重现的层数序列
+*/
+static __thread uint64_t zsl_rand_state = 0;
+static uint64_t zsl_rand_threads = 0;
+
+/* splitmix64 finalizer, turns any seed into a well mixed non zero state */
+static uint64_t zslRandomMix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x ? x : 0x9E3779B97F4A7C15ULL;
+}
+
+/*
+ * Seed the skiplist level generator of the calling thread
+ *
+ * T = O(1)
+*/
+/*
+ * 为调用线程的跳跃表层数生成器设置种子
+*/
+void zslSetRandomSeed(uint64_t seed) {
+    zsl_rand_state = zslRandomMix(seed);
+}
+
+/*
+ * Return the next 64 bit value of the calling thread's generator
+ *
+ * T = O(1)
+*/
+static uint64_t zslRandomNext(void) {
+    uint64_t x = zsl_rand_state;
+
+    // 线程第一次使用时自动播种
+    if (x == 0) {
+        uint64_t id = __sync_add_and_fetch(&zsl_rand_threads, 1);
+        x = zslRandomMix((uint64_t)ustime() ^ (id << 32) ^
+                         (uint64_t)(uintptr_t)&zsl_rand_state);
+    }
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    zsl_rand_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
 /*
  * Returns a random level for the new skiplist node we are going to create
  * 
  * The return value of this functino is between 1 and ZSKIPLIST_MAXLEVEL
  * (both inclusive), with a powerlaw-alike distrbution where higher
  * levels are less likely to be returned.
+ *
+ * With ZSKIPLIST_P = 1/4 every extra level needs two more zero bits, so
+ * the level is derived from the trailing zeros of a single 64 bit draw
+ * instead of looping over 16 bit draws. Setting bit 62 bounds the count
+ * to 62, that is a maximum level of 32 == ZSKIPLIST_MAXLEVEL.
  * 
- * T = O(N)
+ * T = O(1)
 */
 /*
  * 返回一个随机值，用作新跳跃表结点的层数
  * 
  * 返回值介于 1 和 ZSKIPLIST_MAXLEVEL 之间（包含 ZSKIPLIST_MAXLEVEL），
  * 根据随机算法所使用的幂次定律，越大的值生成的几率越小
+ *
+ * 因为 ZSKIPLIST_P 为 1/4，每多一层相当于多出两个为 0 的低位，
+ * 所以只需对一次 64 位的随机数计算末尾 0 的个数即可得到层数
 */
 int zslRandomLevel(void) {
-    int level = 1;
-
-    while ((random() & 0xFFFF) < (ZSKIPLIST_P * 0xFFFF)) {
-        level += 1;
-    }
+    uint64_t r = zslRandomNext() | (1ULL << 62);
+    int level = 1 + (__builtin_ctzll(r) >> 1);
 
     return (level < ZSKIPLIST_MAXLEVEL) ? level : ZSKIPLIST_MAXLEVEL;
 }
@@ -234,7 +305,7 @@ zskiplistNode *zslInsert(zskiplist *zsl, double score, robj *obj) {
             update[i]->level[i].span = zsl->length;
         }
         // 更新表中结点的最大层数
-        zsl->length = level;
+        zsl->level = level;
     }
 
     // 创建新结点
@@ -372,6 +443,125 @@ int zslDelete(zskiplist *zsl, double score, robj *obj) {
     return 0;  /* not found */
 }
 
+/*
+ * Update the score of an element inside the sorted set skiplist.
+ * Note that the element must exist and must match 'score'.
+ * This function does not update the score in the hash table side, the
+ * caller should take care of it.
+ *
+ * When the new score keeps the node between its neighbours, that is the
+ * node keeps its rank, the score is changed in place. Otherwise the node
+ * is unlinked using the update vector of the first search, and the same
+ * node is linked again at its new position, with its level unchanged:
+ * no zslFreeNode() and no zslCreatNode().
+ *
+ * The function returns the updated element skiplist node pointer.
+ *
+ * T_worst = O(N)
+ * T_avg = O(log(N))
+*/
+/*
+ * 将跳跃表中成员为 obj、分值为 curscore 的结点的分值更新为 newscore
+ *
+ * 结点必须存在，并且分值必须和 curscore 相同
+ * 字典一侧的分值需要由调用者自行更新
+ *
+ * 新分值仍然介于前后两个结点之间（也就是结点的排位不变）时，直接原地修改分值
+ * 否则使用第一次查找记录的沿途结点解除结点的链接，
+ * 再将同一个结点以原来的层数链接到新的位置：不需要释放和创建结点
+ *
+ * 函数返回被更新的结点
+*/
+zskiplistNode *zslUpdateScore(zskiplist *zsl, double curscore, robj *obj, double newscore) {
+    zskiplistNode *update[ZSKIPLIST_MAXLEVEL], *x, *p;
+    unsigned int rank[ZSKIPLIST_MAXLEVEL];
+    int i, level;
+
+    redisAssert(!isnan(newscore));
+
+    /* We need to seek to element to update to start: this is useful anyway,
+     * we'll have to update or remove it. */
+    // 查找目标结点，并记录所有沿途结点
+    x = zsl->header;
+    for (i = zsl->level - 1; i >= 0; i--) {
+        while (x->level[i].forward &&
+               (x->level[i].forward->score < curscore ||
+                (x->level[i].forward->score == curscore &&
+                 compareStringObjects(x->level[i].forward->obj, obj) < 0))) {
+            x = x->level[i].forward;
+        }
+        update[i] = x;
+    }
+
+    /* Jump to our element: note that this function assumes that the
+     * element with the matching score exists. */
+    x = x->level[0].forward;
+    redisAssert(x && curscore == x->score && equalStringObjects(x->obj, obj));
+
+    /* If the node, after the score update, would be still exactly
+     * at the same position, we can just update the score without
+     * actually removing and re-inserting the element in the skiplist. */
+    // 新分值仍然严格介于前后结点的分值之间，原地更新
+    if ((x->backward == NULL || x->backward->score < newscore) &&
+        (x->level[0].forward == NULL || x->level[0].forward->score > newscore)) {
+        x->score = newscore;
+        return x;
+    }
+
+    /* No way to reuse the old position: unlink the node and link it
+     * again at the right position. The node doesn't store its level,
+     * but it is the number of levels where update[i] points to it. */
+    // 无法保留原来的位置：解除结点的链接，再将它链接到新的位置
+    // 结点没有保存自己的层数，它等于沿途结点指向它的层数
+    for (level = 0; level < zsl->level && update[level]->level[level].forward == x; level++);
+    zslDeleteNode(zsl, x, update);
+    x->score = newscore;
+
+    // 和 zslInsert() 一样查找新的位置，并记录沿途跨越的结点数量
+    p = zsl->header;
+    for (i = zsl->level - 1; i >= 0; i--) {
+        rank[i] = i == (zsl->level - 1) ? 0 : rank[i + 1];
+        while (p->level[i].forward &&
+               (p->level[i].forward->score < newscore ||
+                (p->level[i].forward->score == newscore &&
+                 compareStringObjects(p->level[i].forward->obj, obj) < 0))) {
+            rank[i] += p->level[i].span;
+            p = p->level[i].forward;
+        }
+        update[i] = p;
+    }
+
+    // 删除结点可能降低了跳跃表的层数
+    if (level > zsl->level) {
+        for (i = zsl->level; i < level; i++) {
+            rank[i] = 0;
+            update[i] = zsl->header;
+            update[i]->level[i].span = zsl->length;
+        }
+        zsl->level = level;
+    }
+
+    // 将结点重新链接到新的位置，span 的计算和 zslInsert() 相同
+    for (i = 0; i < level; i++) {
+        x->level[i].forward = update[i]->level[i].forward;
+        update[i]->level[i].forward = x;
+        x->level[i].span = update[i]->level[i].span - (rank[0] - rank[i]);
+        update[i]->level[i].span = (rank[0] - rank[i]) + 1;
+    }
+    for (i = level; i < zsl->level; i++) {
+        update[i]->level[i].span++;
+    }
+
+    x->backward = (update[0] == zsl->header) ? NULL : update[0];
+    if (x->level[0].forward) {
+        x->level[0].forward->backward = x;
+    } else {
+        zsl->tail = x;
+    }
+    zsl->length++;
+    return x;
+}
+
 /*
  * 检测给定值 value 是否大于（或大于等于）范围 spec 中的 min 值
  * 
@@ -757,6 +947,23 @@ zskiplistNode* zslGetElementByRank(zskiplist *zsl, unsigned long rank) {
 static int zslParseRange(robj *min, robj *max, zrangespec *spec) {
     char *eptr;
 
+    /*
+     * INLINE encoded strings are not sds and are not null terminated,
+     * decode them and parse the sds copies.
+    */
+    // INLINE 编码的字符串不是 sds ，也没有结束符，先解码再分析
+    if (min->encoding == REDIS_ENCODING_INLINE ||
+        max->encoding == REDIS_ENCODING_INLINE) {
+        int retval;
+
+        min = getDecodedObject(min);
+        max = getDecodedObject(max);
+        retval = zslParseRange(min, max, spec);
+        decrRefCount(min);
+        decrRefCount(max);
+        return retval;
+    }
+
     // 默认为闭区间
     spec->minex = spec->maxex = 0;
 
@@ -825,8 +1032,19 @@ static int zslParseRange(robj *min, robj *max, zrangespec *spec) {
  * value of *dest and *ex is undefined
 */
 int zslParseLexRangeItem(robj *item, robj **dest, int *ex) {
-    char *c = item->ptr;
+    char *c;
 
+    // INLINE 编码的字符串不是 sds ，先解码再分析
+    if (item->encoding == REDIS_ENCODING_INLINE) {
+        int retval;
+
+        item = getDecodedObject(item);
+        retval = zslParseLexRangeItem(item, dest, ex);
+        decrRefCount(item);
+        return retval;
+    }
+
+    c = item->ptr;
     switch (c[0]) {
         case '+':
             if (c[1] != '\0') return REDIS_ERR;
@@ -905,16 +1123,35 @@ int compareStringObjectsForLexRange(robj *a, robj *b) {
     return compareStringObjects(a, b);
 }
 
+/*
+ * Check a member against the bounds of the range. The member is never
+ * shared.minstring or shared.maxstring, so only the bound needs to be
+ * checked for them, once, before the plain string comparison that the
+ * skiplist walk runs for every node.
+*/
+/*
+ * 检查成员是否满足范围的边界
+ * 成员永远不会是 shared.minstring 或 shared.maxstring，因此只需要检查边界本身，
+ * 之后就是跳跃表遍历时对每个结点进行的普通字符串对比
+*/
 static int zslLexValueGteMin(robj *value, zlexrangespec *spec) {
-    return spec->minex ?
-           (compareStringObjectsForLexRange(value, spec->min) > 0) :
-           (compareStringObjectsForLexRange(value, spec->min >= 0));
+    int cmp;
+
+    if (spec->min == shared.minstring) return 1;
+    if (spec->min == shared.maxstring) return 0;
+
+    cmp = compareStringObjects(value, spec->min);
+    return spec->minex ? (cmp > 0) : (cmp >= 0);
 }
 
 static int zslLexValueLteMax(robj *value, zlexrangespec *spec) {
-    return spec->maxex ?
-           (compareStringObjectsForLexRange(value, spec->max) > 0) :
-           (compareStringObjectsForLexRange(value, spec->max) >= 0);
+    int cmp;
+
+    if (spec->max == shared.maxstring) return 1;
+    if (spec->max == shared.minstring) return 0;
+
+    cmp = compareStringObjects(value, spec->max);
+    return spec->maxex ? (cmp < 0) : (cmp <= 0);
 }
 
 /*
@@ -924,13 +1161,13 @@ int zslIsInLexRange(zskiplist *zsl, zlexrangespec *range) {
     zskiplistNode *x;
 
     /* Test for ranges that will always be empty */
-    if (compareStringObjectsForLexRange(range->min, range->max) > 1 ||
-        (compareStringObjects(range->min, range->max) == 0 &&
-         (range->minex || range->maxex))){
+    int cmp = compareStringObjectsForLexRange(range->min, range->max);
+    if (cmp > 0 || (cmp == 0 && (range->minex || range->maxex))) {
         return 0;
     }
 
-    x = zsl->header;
+    // 表尾结点是最大的成员
+    x = zsl->tail;
     if (x == NULL || !zslLexValueGteMin(x->obj, range)) {
         return 0;
     }
@@ -996,4 +1233,337 @@ zskiplistNode *zslLastInLexRange(zskiplist *zsl, zlexrangespec *range) {
     /* Check if score >= min */
     if (!zslLexValueGteMin(x->obj, range)) return NULL;
     return x;
-}
\ No newline at end of file
+}
+
+// 测试部分
+#ifdef ZSKIPLIST_TEST_MAIN
+#include <stdio.h>
+#include "testhelp.h"
+
+/*
+ * ZINCRBY workloads on a fixed population of members, comparing the old
+ * zslDelete() + zslInsert() path against zslUpdateScore():
+ *
+ * - counters: 1000 distinct scores shared by 100 members each, bumped by
+ *   1 to 3, so nearly every update moves the member among its peers;
+ * - rank kept: distinct scores 16 apart, bumped by fractions, so members
+ *   never pass each other, like a slowly decaying rate.
+*/
+/*
+ * 在固定数量的成员上执行 ZINCRBY 负载，对比 zslDelete() + zslInsert() 和 zslUpdateScore()：
+ *
+ * - 计数器：1000 个不同的分值，每个分值有 100 个成员，每次增加 1 到 3，
+ *   几乎每次更新都会让成员移动位置
+ * - 排位不变：各不相同、间隔为 16 的分值，每次增加一个小数，成员之间从不互相超越
+*/
+#define ZSL_BENCH_MEMBERS 100000
+#define ZSL_BENCH_OPS 2000000
+
+static robj *bench_members[ZSL_BENCH_MEMBERS];
+static double bench_scores[ZSL_BENCH_MEMBERS];
+
+static zskiplist *zslBenchCreate(int rankkept) {
+    zskiplist *zsl = zslCreate();
+    int j;
+
+    for (j = 0; j < ZSL_BENCH_MEMBERS; j++) {
+        bench_scores[j] = rankkept ? j * 16 : j % 1000;
+        incrRefCount(bench_members[j]);
+        zslInsert(zsl, bench_scores[j], bench_members[j]);
+    }
+    return zsl;
+}
+
+// 分数增量：计数器负载为 1 到 3，排位不变负载为 1/1024 到 3/1024
+static double zslBenchIncr(int rankkept) {
+    double incr = (rand() % 3) + 1;
+
+    return rankkept ? incr / 1024 : incr;
+}
+
+/*
+ * Lexicographic workload: members that all have the same score, like an
+ * autocomplete index, queried with ZRANGEBYLEX ranges.
+*/
+/*
+ * 字典序负载：所有成员的分值都相同（比如自动补全的索引），使用 ZRANGEBYLEX 的范围进行查询
+*/
+#define ZSL_LEX_MEMBERS 1000000
+#define ZSL_LEX_QUERIES 200000
+#define ZSL_LEX_LIMIT 10
+
+// 生成一个由小写字母组成的随机单词
+static int zslBenchWord(char *buf) {
+    int len = 4 + rand() % 9, j;
+
+    for (j = 0; j < len; j++) buf[j] = 'a' + rand() % 26;
+    buf[len] = '\0';
+    return len;
+}
+
+/*
+ * Run ZRANGEBYLEX min max LIMIT 0 limit on the skiplist, returning the
+ * number of members found, or -1 for an invalid range.
+*/
+// 在跳跃表上执行 ZRANGEBYLEX min max LIMIT 0 limit，返回找到的成员数量，范围不合法时返回 -1
+static long zslBenchRangeByLex(zskiplist *zsl, char *min, char *max, long limit) {
+    robj *minobj = createStringObject(min, strlen(min));
+    robj *maxobj = createStringObject(max, strlen(max));
+    zlexrangespec range;
+    zskiplistNode *x;
+    long count = 0;
+
+    if (zslParseLexRange(minobj, maxobj, &range) == REDIS_ERR) {
+        count = -1;
+    } else {
+        x = zslFirstInLexRange(zsl, &range);
+        while (x && count != limit && zslLexValueLteMax(x->obj, &range)) {
+            count++;
+            x = x->level[0].forward;
+        }
+        zslFreeLexRange(&range);
+    }
+    decrRefCount(minobj);
+    decrRefCount(maxobj);
+    return count;
+}
+
+// 检查每个结点的排位，排位由 span 计算，所以这也检查了所有层的 span
+static int zslBenchCheckRanks(zskiplist *zsl) {
+    zskiplistNode *x = zsl->header->level[0].forward;
+    unsigned long rank = 1;
+
+    for (; x; x = x->level[0].forward, rank++) {
+        if (zslGetRank(zsl, x->score, x->obj) != rank) return 0;
+    }
+    return 1;
+}
+
+static int zslBenchCheckOrder(zskiplist *zsl) {
+    zskiplistNode *x = zsl->header->level[0].forward;
+    unsigned long count = 0;
+
+    while (x) {
+        if (x->level[0].forward && x->level[0].forward->score < x->score)
+            return 0;
+        count++;
+        x = x->level[0].forward;
+    }
+    return count == zsl->length;
+}
+
+int main(void) {
+    zskiplist *zsl;
+    long long start;
+    char buf[32];
+    int j, len, ok;
+
+    {
+        int levels[ZSKIPLIST_MAXLEVEL + 1] = {0}, a[64], same = 1;
+
+        zslSetRandomSeed(42);
+        for (j = 0; j < 64; j++) a[j] = zslRandomLevel();
+        zslSetRandomSeed(42);
+        for (j = 0; j < 64; j++) same &= (a[j] == zslRandomLevel());
+        test_cond("zslSetRandomSeed() makes levels reproducible ", same);
+
+        start = ustime();
+        for (j = 0; j < 10000000; j++) levels[zslRandomLevel()]++;
+        printf("zslRandomLevel: 10000000 draws in %lld usec\n",
+            ustime() - start);
+        test_cond("About 1/4 of the levels are greater than 1 ",
+            levels[1] > 7400000 && levels[1] < 7600000);
+    }
+    zslSetRandomSeed(1234);
+
+    shared.minstring = createStringObject("minstring", 9);
+    shared.maxstring = createStringObject("maxstring", 9);
+
+    {
+        static const char *words[] = {"a", "b", "bar", "baz", "c", "foo", "foobar", "zap"};
+        int n = sizeof(words) / sizeof(*words);
+
+        zsl = zslCreate();
+        for (j = 0; j < n; j++)
+            zslInsert(zsl, 0, createStringObject((char*)words[j], strlen(words[j])));
+
+        test_cond("ZRANGEBYLEX closed and open bounds ",
+            zslBenchRangeByLex(zsl, "[b", "[foo", -1) == 5 &&
+            zslBenchRangeByLex(zsl, "(b", "(foo", -1) == 3 &&
+            zslBenchRangeByLex(zsl, "[bar", "(baz", -1) == 1);
+        test_cond("ZRANGEBYLEX infinite bounds ",
+            zslBenchRangeByLex(zsl, "-", "+", -1) == n &&
+            zslBenchRangeByLex(zsl, "-", "(b", -1) == 1 &&
+            zslBenchRangeByLex(zsl, "(foobar", "+", -1) == 1);
+        test_cond("ZRANGEBYLEX empty ranges ",
+            zslBenchRangeByLex(zsl, "[zz", "+", -1) == 0 &&
+            zslBenchRangeByLex(zsl, "-", "(a", -1) == 0 &&
+            zslBenchRangeByLex(zsl, "(bar", "(bar", -1) == 0 &&
+            zslBenchRangeByLex(zsl, "[c", "[b", -1) == 0 &&
+            zslBenchRangeByLex(zsl, "+", "-", -1) == 0);
+        test_cond("ZRANGEBYLEX invalid ranges ",
+            zslBenchRangeByLex(zsl, "b", "[c", -1) == -1 &&
+            zslBenchRangeByLex(zsl, "[a", "+c", -1) == -1);
+
+        /*
+         * Short arguments are INLINE encoded once tryObjectEncoding()
+         * ran on them, "[foobar" fills the ptr field with no terminator.
+        */
+        // 经过 tryObjectEncoding() 的短参数是 INLINE 编码的，"[foobar" 占满 ptr 字段，没有结束符
+        {
+            robj *min = createInlineStringObject("[b", 2);
+            robj *max = createInlineStringObject("[foobar", 7);
+            robj *plus = createInlineStringObject("+", 1);
+            robj *bad = createInlineStringObject("+c", 2);
+            zlexrangespec lex;
+            zrangespec range;
+            zskiplistNode *x;
+            long count = 0;
+
+            ok = zslParseLexRange(min, max, &lex) == REDIS_OK;
+            if (ok) {
+                for (x = zslFirstInLexRange(zsl, &lex);
+                     x && zslLexValueLteMax(x->obj, &lex);
+                     x = x->level[0].forward) count++;
+                ok = count == 6 && lex.max->encoding != REDIS_ENCODING_INLINE &&
+                    sdslen(lex.max->ptr) == 6;
+                zslFreeLexRange(&lex);
+            }
+            if (ok && zslParseLexRange(min, plus, &lex) == REDIS_OK) {
+                ok = lex.max == shared.maxstring;
+                zslFreeLexRange(&lex);
+            } else {
+                ok = 0;
+            }
+            test_cond("ZRANGEBYLEX with INLINE encoded bounds ",
+                ok && zslParseLexRange(min, bad, &lex) == REDIS_ERR);
+
+            decrRefCount(min);
+            decrRefCount(max);
+            min = createInlineStringObject("(1.5", 4);
+            max = createInlineStringObject("1234567", 7);
+            test_cond("ZRANGEBYSCORE with INLINE encoded bounds ",
+                zslParseRange(min, max, &range) == REDIS_OK &&
+                range.min == 1.5 && range.minex &&
+                range.max == 1234567 && !range.maxex &&
+                zslParseRange(min, bad, &range) == REDIS_ERR);
+            decrRefCount(min);
+            decrRefCount(max);
+            decrRefCount(plus);
+            decrRefCount(bad);
+        }
+        zslFree(zsl);
+    }
+
+    {
+        zskiplistNode *x;
+        char min[16], max[16];
+        long found = 0;
+
+        srand(1234);
+        zsl = zslCreate();
+        start = ustime();
+        for (j = 0; j < ZSL_LEX_MEMBERS; j++) {
+            len = zslBenchWord(buf);
+            zslInsert(zsl, 0, createStringObject(buf, len));
+        }
+        printf("zslInsert: %d members with equal scores in %lld usec\n",
+            ZSL_LEX_MEMBERS, ustime() - start);
+
+        start = ustime();
+        for (j = 0; j < ZSL_LEX_QUERIES; j++) {
+            min[0] = '[';
+            max[0] = '(';
+            zslBenchWord(min + 1);
+            zslBenchWord(max + 1);
+            found += zslBenchRangeByLex(zsl, min, max, ZSL_LEX_LIMIT);
+        }
+        printf("ZRANGEBYLEX LIMIT 0 %d: %d queries on %d members in %lld usec "
+            "(%ld members found)\n", ZSL_LEX_LIMIT, ZSL_LEX_QUERIES,
+            ZSL_LEX_MEMBERS, ustime() - start, found);
+
+        // 对比全部成员的遍历结果，成员中没有 '\0'，可以使用 strcmp()
+        for (x = zsl->header->level[0].forward, len = 0; x; x = x->level[0].forward) {
+            if (strcmp(x->obj->ptr, "ab") >= 0 && strcmp(x->obj->ptr, "abz") < 0) len++;
+        }
+        test_cond("ZRANGEBYLEX matches a full scan ",
+            len > 0 && zslBenchRangeByLex(zsl, "[ab", "(abz", -1) == len);
+        zslFree(zsl);
+    }
+
+    // 排位改变的更新重新链接同一个结点
+    {
+        zskiplistNode *nodes[64], *x;
+
+        zsl = zslCreate();
+        for (j = 0; j < 64; j++) {
+            len = snprintf(buf, sizeof(buf), "m%d", j);
+            nodes[j] = zslInsert(zsl, j, createStringObject(buf, len));
+        }
+        ok = 1;
+        for (j = 0; j < 64; j++) {
+            // 依次移动到表尾、表头和中间
+            double newscore = j % 3 == 0 ? 1000 + j : (j % 3 == 1 ? -1000 - j : 31.5);
+
+            x = zslUpdateScore(zsl, nodes[j]->score, nodes[j]->obj, newscore);
+            if (x != nodes[j] || x->score != newscore) ok = 0;
+        }
+        test_cond("zslUpdateScore() relinks the same node when the rank changes ",
+            ok && zsl->length == 64 && zslBenchCheckOrder(zsl) &&
+            zslBenchCheckRanks(zsl));
+        zslFree(zsl);
+    }
+
+    for (j = 0; j < ZSL_BENCH_MEMBERS; j++) {
+        len = snprintf(buf, sizeof(buf), "member:%d", j);
+        bench_members[j] = createStringObject(buf, len);
+    }
+
+    for (j = 0; j < 2; j++) {
+        const char *name = j ? "rank kept" : "counters";
+        long long deltime, updtime;
+        int rankkept = j, k;
+
+        /* Delete + insert: two searches, a free and a malloc per update. */
+        srand(1234);
+        zsl = zslBenchCreate(rankkept);
+        start = ustime();
+        for (k = 0; k < ZSL_BENCH_OPS; k++) {
+            int m = rand() % ZSL_BENCH_MEMBERS;
+
+            incrRefCount(bench_members[m]);
+            zslDelete(zsl, bench_scores[m], bench_members[m]);
+            bench_scores[m] += zslBenchIncr(rankkept);
+            zslInsert(zsl, bench_scores[m], bench_members[m]);
+        }
+        deltime = ustime() - start;
+        test_cond("Skiplist is ordered after delete+insert updates ",
+            zslBenchCheckOrder(zsl));
+        zslFree(zsl);
+
+        /* Same workload through zslUpdateScore(). */
+        srand(1234);
+        zsl = zslBenchCreate(rankkept);
+        start = ustime();
+        for (k = 0; k < ZSL_BENCH_OPS; k++) {
+            int m = rand() % ZSL_BENCH_MEMBERS;
+            double newscore = bench_scores[m] + zslBenchIncr(rankkept);
+
+            zslUpdateScore(zsl, bench_scores[m], bench_members[m], newscore);
+            bench_scores[m] = newscore;
+        }
+        updtime = ustime() - start;
+        test_cond("Skiplist is ordered after zslUpdateScore() updates ",
+            zslBenchCheckOrder(zsl));
+        test_cond("zslGetRank() finds updated members at their rank ",
+            zslBenchCheckRanks(zsl));
+        zslFree(zsl);
+
+        printf("%s: %d updates, zslDelete+zslInsert %lld usec, "
+            "zslUpdateScore %lld usec\n", name, ZSL_BENCH_OPS, deltime, updtime);
+    }
+
+    test_report();
+    return 0;
+}
+#endif
@@ -8,59 +8,595 @@
 #include <float.h>
 
 #include "util.h"
+#include "zmalloc.h"
 
-/* =========================================================================== */
+/* ----------------------------------------------------------------------------
+ * Glob-style pattern matching
+ * --------------------------------------------------------------------------*/
 
-// 手动实现 gettimeofday() 函数
-// 替代 unix 下的 <sys/time.h>
-#include <time.h>
-#include <windows.h>
+/*
+ * The pattern is compiled once into a list of positions, each matching
+ * exactly one byte: a literal, '?', or a [...] set kept as a 256 bit map.
+ * The '*' characters split the positions into fixed length segments.
+ *
+ * A string matches when the first segment matches at its start (unless
+ * the pattern starts with '*'), the last one at its end (unless it ends
+ * with '*'), and every segment in the middle is found, in order, after
+ * the previous one. Taking the leftmost occurrence of each middle segment
+ * is always right: it leaves the most room to the segments that follow.
+ * So there is no backtracking, and no recursion.
+ *
+ * Middle segments of up to 64 positions are searched with Shift-And: one
+ * bit of state per position, updated with a table lookup per byte. The
+ * search restarts where the previous segment ended, so a whole match is
+ * O(N) in the length of the string, whatever the number of '*'. When the
+ * first position is a single byte, the search jumps with memchr() while
+ * no partial match is pending. Longer middle segments are compared at
+ * every offset, O(N*M) in the worst case. Literal runs at the start of a
+ * segment are compared with memcmp() when the match is case sensitive.
+ *
+ * Compiling allocates, and the Shift-And tables take 2KB per middle
+ * segment, so only code matching many strings against one pattern (KEYS,
+ * SCAN MATCH) compiles it. stringmatchlen() matches a single string
+ * straight from the pattern, without allocating.
+*/
+/*
+ * 模式只编译一次，编译为一组位置，每个位置匹配一个字节：
+ * 字面字符、'?'，或者 [...] 字符集合（使用 256 位的位图保存）
+ * 模式中的 '*' 将这些位置分割为长度固定的片段
+ *
+ * 字符串匹配模式的条件是：第一个片段在字符串开头匹配（模式以 '*' 开头时除外），
+ * 最后一个片段在字符串结尾匹配（模式以 '*' 结尾时除外），
+ * 中间的片段依次在前一个片段之后被找到
+ * 每个中间片段都取最左边的出现位置总是正确的：这样给后面的片段留下了最多的空间
+ * 所以不需要回溯，也不需要递归
+ *
+ * 不超过 64 个位置的中间片段使用 Shift-And 查找：每个位置一个状态位，
+ * 每个字节通过一次查表更新状态
+ * 每次查找都从上一个片段结束的地方开始，所以不管有多少个 '*'，整个匹配都是 O(N) 的
+ * 第一个位置只能匹配一个字节时，在没有部分匹配的情况下使用 memchr() 跳过
+ * 更长的中间片段在每个偏移量上进行比较，最坏情况下为 O(N*M)
+ * 区分大小写时，片段开头的字面字符使用 memcmp() 比较
+ *
+ * 编译需要分配内存，每个中间片段的 Shift-And 表还要占用 2KB，
+ * 所以只有用同一个模式匹配很多字符串的代码（KEYS、SCAN MATCH）才编译模式
+ * stringmatchlen() 直接使用模式匹配一个字符串，不分配内存
+*/
 
-#if defined(_MSC_VER) || defined(_MSC_EXTENSIONS)
-    #define DELTA_EPOCH_IN_MICROSECS  11644473600000000Ui64
-#else
-    #define DELTA_EPOCH_IN_MICROSECS  11644473600000000ULL
-#endif
+// 位置的操作码：0 - 255 为字面字符（nocase 时为小写），256 为 '?'，257 以上为字符集合
+#define STRINGMATCH_OP_ANY 256
+#define STRINGMATCH_OP_SET 257
 
-struct timezone
-{
-    int  tz_minuteswest; /* minutes W of Greenwich */
-    int  tz_dsttime;     /* type of dst correction */
+// 使用 Shift-And 查找的中间片段的最大长度
+#define STRINGMATCH_SHIFTAND_MAX 64
+
+typedef struct stringmatchSegment {
+    // 第一个位置的索引
+    int start;
+    // 位置的数量，也就是片段匹配的字节数
+    int len;
+    // 开头的字面字符的数量
+    int litlen;
+    // 第一个位置只能匹配一个字节时为这个字节，否则为 -1
+    int first;
+    // Shift-And 表，只有中间片段才有，更长的片段为 NULL
+    uint64_t *masks;
+} stringmatchSegment;
+
+struct stringmatchPattern {
+    // 是否忽略大小写
+    int nocase;
+    // 模式中是否有 '*'
+    int star;
+    // 第一个片段必须在字符串开头匹配
+    int anchor_start;
+    // 最后一个片段必须在字符串结尾匹配
+    int anchor_end;
+    // 所有片段长度的和，更短的字符串不可能匹配
+    int minlen;
+    // 片段数量
+    int nsegs;
+    stringmatchSegment *segs;
+    // 每个位置的操作码
+    uint16_t *ops;
+    // 每个位置的字面字符，用于 memcmp()
+    unsigned char *lits;
+    // 字符集合的位图
+    unsigned char (*sets)[32];
 };
 
-int gettimeofday(struct timeval *tv, struct timezone *tz)
+// 位置的操作码 op 是否匹配字节 c
+static inline int stringmatchAccepts(const stringmatchPattern *pat, int op,
+        unsigned char c)
 {
-    FILETIME ft;
-    unsigned __int64 tmpres = 0;
-    static int tzflag;
+    if (op < STRINGMATCH_OP_ANY) return (pat->nocase ? tolower(c) : c) == op;
+    if (op == STRINGMATCH_OP_ANY) return 1;
+    return (pat->sets[op - STRINGMATCH_OP_SET][c >> 3] >> (c & 7)) & 1;
+}
 
-    if (NULL != tv)
-    {
-        GetSystemTimeAsFileTime(&ft);
+/*
+ * Add the bytes between start and end to the set, comparing them the same
+ * way the matcher always did: ranges are swapped when reversed, then both
+ * the bounds and the byte are lowered when nocase is set.
+*/
+// 将 start 和 end 之间的字节添加到字符集合中，比较的方式和原来的匹配函数一样：
+// 范围反过来时先交换，nocase 时再将边界和字节都转为小写
+static void stringmatchSetAddRange(unsigned char *set, int start, int end,
+        int nocase)
+{
+    int c, lc;
 
-        tmpres |= ft.dwHighDateTime;
-        tmpres <<= 32;
-        tmpres |= ft.dwLowDateTime;
+    if (start > end) {
+        int t = start;
 
-        /*converting file time to unix epoch*/
-        tmpres /= 10;  /*convert into microseconds*/
-        tmpres -= DELTA_EPOCH_IN_MICROSECS;
-        tv->tv_sec = (long)(tmpres / 1000000UL);
-        tv->tv_usec = (long)(tmpres % 1000000UL);
+        start = end;
+        end = t;
+    }
+    if (nocase) {
+        start = tolower(start);
+        end = tolower(end);
     }
+    for (c = 0; c < 256; c++) {
+        lc = nocase ? tolower(c) : c;
+        if (lc >= start && lc <= end) set[c >> 3] |= 1 << (c & 7);
+    }
+}
 
-    if (NULL != tz)
-    {
-        if (!tzflag)
-        {
-            _tzset();
-            tzflag++;
+/*
+ * Parse the [...] set at p, up to the closing ']' or to the end of the
+ * pattern, and return the number of pattern bytes consumed after '['.
+*/
+// 解析 p 处的 [...] 字符集合，直到 ']' 或者模式结束，返回 '[' 之后使用的模式字节数
+static int stringmatchParseSet(unsigned char *set, const unsigned char *p,
+        int plen, int nocase)
+{
+    const unsigned char *start = p;
+    int not, j;
+
+    memset(set, 0, 32);
+    not = plen > 0 && p[0] == '^';
+    if (not) {
+        p++;
+        plen--;
+    }
+
+    while (plen > 0 && p[0] != ']') {
+        if (p[0] == '\\' && plen >= 2) {
+            // 转义的字符总是区分大小写
+            p++;
+            plen--;
+            set[p[0] >> 3] |= 1 << (p[0] & 7);
+        } else if (plen >= 3 && p[1] == '-') {
+            stringmatchSetAddRange(set, p[0], p[2], nocase);
+            p += 2;
+            plen -= 2;
+        } else {
+            stringmatchSetAddRange(set, p[0], p[0], nocase);
         }
-        tz->tz_minuteswest = _timezone / 60;
-        tz->tz_dsttime = _daylight;
+        p++;
+        plen--;
     }
 
-    return 0;
+    if (not) {
+        for (j = 0; j < 32; j++) set[j] = ~set[j];
+    }
+
+    // 跳过 ']'，没有 ']' 时集合一直延续到模式结束
+    return (int)(p - start) + (plen > 0);
+}
+
+// 将位置的操作码 op 匹配的所有字节保存到位图 set 中
+static void stringmatchOpBytes(const stringmatchPattern *pat, int op,
+        unsigned char *set)
+{
+    int c;
+
+    if (op >= STRINGMATCH_OP_SET) {
+        memcpy(set, pat->sets[op - STRINGMATCH_OP_SET], 32);
+    } else if (op == STRINGMATCH_OP_ANY) {
+        memset(set, 0xff, 32);
+    } else if (!pat->nocase) {
+        memset(set, 0, 32);
+        set[op >> 3] |= 1 << (op & 7);
+    } else {
+        memset(set, 0, 32);
+        for (c = 0; c < 256; c++) {
+            if (tolower(c) == op) set[c >> 3] |= 1 << (c & 7);
+        }
+    }
+}
+
+/*
+ * Build the Shift-And table of a segment: bit k of masks[c] is set when
+ * position k of the segment accepts the byte c.
+*/
+// 创建片段的 Shift-And 表：位置 k 匹配字节 c 时，masks[c] 的第 k 位为 1
+static uint64_t *stringmatchBuildMasks(const stringmatchPattern *pat,
+        const stringmatchSegment *seg)
+{
+    uint64_t *masks = zmalloc(sizeof(uint64_t) * 256);
+    unsigned char set[32];
+    int k, c;
+
+    memset(masks, 0, sizeof(uint64_t) * 256);
+    for (k = 0; k < seg->len; k++) {
+        int op = pat->ops[seg->start + k];
+
+        // 区分大小写的字面字符只匹配一个字节
+        if (op < STRINGMATCH_OP_ANY && !pat->nocase) {
+            masks[op] |= (uint64_t)1 << k;
+            continue;
+        }
+        stringmatchOpBytes(pat, op, set);
+        for (c = 0; c < 256; c++) {
+            if ((set[c >> 3] >> (c & 7)) & 1) masks[c] |= (uint64_t)1 << k;
+        }
+    }
+    return masks;
+}
+
+/*
+ * Compile the glob-style pattern p of plen bytes:
+ *
+ *   *       matches any sequence of bytes, including the empty one
+ *   ?       matches any byte
+ *   [abc]   matches one of the bytes in the set, which can have ranges
+ *           like [a-z], be negated with [^...], and escape with '\'
+ *   \x      matches x literally
+ *
+ * With nocase the comparisons ignore the case, except for the escaped
+ * bytes of a set. The result is used with stringmatchExec() as many times
+ * as needed, and freed with stringmatchFree().
+ *
+ * T = O(M), M is the length of the pattern
+*/
+/*
+ * 编译长度为 plen 字节的 glob 模式 p：
+ *
+ *   *       匹配任意字节序列，包括空序列
+ *   ?       匹配任意一个字节
+ *   [abc]   匹配集合中的一个字节，可以使用 [a-z] 这样的范围，
+ *           可以使用 [^...] 取反，以及使用 '\' 转义
+ *   \x      匹配字面的 x
+ *
+ * nocase 时比较忽略大小写，集合中转义的字节除外
+ * 编译的结果可以任意多次地传给 stringmatchExec()，最后使用 stringmatchFree() 释放
+*/
+stringmatchPattern *stringmatchCompile(const char *pattern, int plen, int nocase) {
+    const unsigned char *p = (const unsigned char*)pattern;
+    stringmatchPattern *pat;
+    int nsets = 0, npos = 0, segstart = 0, j;
+    unsigned char *buf;
+
+    // 每个 '[' 最多产生一个集合，每个模式字节最多产生一个位置和一个片段
+    for (j = 0; j < plen; j++) if (p[j] == '[') nsets++;
+    buf = zmalloc(sizeof(*pat) + sizeof(unsigned char[32]) * nsets +
+                  sizeof(stringmatchSegment) * (plen + 1) +
+                  sizeof(uint16_t) * plen + plen);
+    pat = (stringmatchPattern*)buf;
+    pat->sets = (unsigned char (*)[32])(buf + sizeof(*pat));
+    pat->segs = (stringmatchSegment*)(pat->sets + nsets);
+    pat->ops = (uint16_t*)(pat->segs + plen + 1);
+    pat->lits = (unsigned char*)(pat->ops + plen);
+    pat->nocase = nocase;
+    pat->star = 0;
+    pat->anchor_start = !(plen > 0 && p[0] == '*');
+    pat->anchor_end = 1;
+    pat->minlen = 0;
+    pat->nsegs = 0;
+    nsets = 0;
+
+    while (plen > 0) {
+        int op, used = 1;
+
+        switch (p[0]) {
+        case '*':
+            // 连续的 '*' 等于一个，'*' 结束当前的片段
+            while (plen > used && p[used] == '*') used++;
+            if (npos > segstart) {
+                pat->segs[pat->nsegs].start = segstart;
+                pat->segs[pat->nsegs].len = npos - segstart;
+                pat->nsegs++;
+            }
+            segstart = npos;
+            pat->star = 1;
+            pat->anchor_end = 0;
+            p += used;
+            plen -= used;
+            continue;
+        case '?':
+            op = STRINGMATCH_OP_ANY;
+            break;
+        case '[':
+            used += stringmatchParseSet(pat->sets[nsets], p + 1, plen - 1, nocase);
+            op = STRINGMATCH_OP_SET + nsets++;
+            break;
+        case '\\':
+            if (plen >= 2) used++;
+            /* fall through */
+        default:
+            op = p[used - 1];
+            if (nocase) op = tolower(op);
+            break;
+        }
+        pat->ops[npos] = op;
+        pat->lits[npos] = op & 0xff;
+        npos++;
+        pat->anchor_end = 1;
+        p += used;
+        plen -= used;
+    }
+    if (npos > segstart) {
+        pat->segs[pat->nsegs].start = segstart;
+        pat->segs[pat->nsegs].len = npos - segstart;
+        pat->nsegs++;
+    }
+
+    for (j = 0; j < pat->nsegs; j++) {
+        stringmatchSegment *seg = &pat->segs[j];
+        unsigned char set[32];
+        int middle, c, count = 0;
+
+        pat->minlen += seg->len;
+
+        for (seg->litlen = 0; seg->litlen < seg->len; seg->litlen++) {
+            if (pat->ops[seg->start + seg->litlen] >= STRINGMATCH_OP_ANY) break;
+        }
+
+        // 第一个位置只匹配一个字节时，可以使用 memchr() 查找
+        stringmatchOpBytes(pat, pat->ops[seg->start], set);
+        for (c = 0; c < 256 && count < 2; c++) {
+            if ((set[c >> 3] >> (c & 7)) & 1) {
+                seg->first = c;
+                count++;
+            }
+        }
+        if (count != 1) seg->first = -1;
+
+        // 只有中间的片段需要查找
+        middle = pat->star &&
+                 !(j == 0 && pat->anchor_start) &&
+                 !(j == pat->nsegs - 1 && pat->anchor_end);
+        seg->masks = (middle && seg->len <= STRINGMATCH_SHIFTAND_MAX) ?
+                     stringmatchBuildMasks(pat, seg) : NULL;
+    }
+    return pat;
+}
+
+// 释放编译好的模式
+void stringmatchFree(stringmatchPattern *pat) {
+    int j;
+
+    if (pat == NULL) return;
+    for (j = 0; j < pat->nsegs; j++) zfree(pat->segs[j].masks);
+    zfree(pat);
+}
+
+// 片段 seg 是否匹配 s 开头的 seg->len 个字节
+static int stringmatchSegmentAt(const stringmatchPattern *pat,
+        const stringmatchSegment *seg, const unsigned char *s)
+{
+    int j = 0;
+
+    if (!pat->nocase && seg->litlen > 0) {
+        if (memcmp(s, pat->lits + seg->start, seg->litlen) != 0) return 0;
+        j = seg->litlen;
+    }
+    for (; j < seg->len; j++) {
+        if (!stringmatchAccepts(pat, pat->ops[seg->start + j], s[j])) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Return the offset of the leftmost occurrence of the segment in the n
+ * bytes at s, or -1 if it doesn't occur.
+ *
+ * T = O(N) with the Shift-And table, O(N*M) without it
+*/
+// 返回片段在 s 开始的 n 个字节中最左边的出现位置，没有出现时返回 -1
+static long stringmatchSegmentFind(const stringmatchPattern *pat,
+        const stringmatchSegment *seg, const unsigned char *s, long n)
+{
+    long last = n - seg->len, j;
+    const unsigned char *q;
+
+    if (last < 0) return -1;
+
+    if (seg->masks) {
+        uint64_t state = 0, hit = (uint64_t)1 << (seg->len - 1);
+
+        for (j = 0; j < n; j++) {
+            if (state == 0) {
+                // 没有部分匹配，片段只能从 j 或者之后开始
+                if (j > last) return -1;
+                if (seg->first >= 0) {
+                    q = memchr(s + j, seg->first, last - j + 1);
+                    if (q == NULL) return -1;
+                    j = q - s;
+                }
+            }
+            state = ((state << 1) | 1) & seg->masks[s[j]];
+            if (state & hit) return j - seg->len + 1;
+        }
+        return -1;
+    }
+
+    for (j = 0; j <= last; j++) {
+        if (seg->first >= 0) {
+            q = memchr(s + j, seg->first, last - j + 1);
+            if (q == NULL) return -1;
+            j = q - s;
+        }
+        if (stringmatchSegmentAt(pat, seg, s + j)) return j;
+    }
+    return -1;
+}
+
+/*
+ * Return 1 if the slen bytes at s match the compiled pattern, 0 otherwise.
+ *
+ * T = O(N), N is the length of the string
+*/
+// 字符串 s 匹配编译好的模式时返回 1，否则返回 0
+int stringmatchExec(const stringmatchPattern *pat, const char *str, int slen) {
+    const unsigned char *s = (const unsigned char*)str;
+    const stringmatchSegment *seg;
+    long pos = 0, end = slen, off;
+    int j = 0, last = pat->nsegs;
+
+    if (slen < pat->minlen) return 0;
+
+    // 没有 '*' 时，只有一个片段（或者没有），长度必须相等
+    if (!pat->star) {
+        return slen == pat->minlen &&
+               (pat->nsegs == 0 || stringmatchSegmentAt(pat, &pat->segs[0], s));
+    }
+
+    if (pat->anchor_start) {
+        if (!stringmatchSegmentAt(pat, &pat->segs[0], s)) return 0;
+        pos = pat->segs[0].len;
+        j++;
+    }
+    if (pat->anchor_end) {
+        seg = &pat->segs[last - 1];
+        if (!stringmatchSegmentAt(pat, seg, s + slen - seg->len)) return 0;
+        end -= seg->len;
+        last--;
+    }
+
+    // 依次查找中间的片段，每个都从上一个结束的地方开始
+    for (; j < last; j++) {
+        seg = &pat->segs[j];
+        off = stringmatchSegmentFind(pat, seg, s + pos, end - pos);
+        if (off < 0) return 0;
+        pos += off + seg->len;
+    }
+    return 1;
+}
+
+/*
+ * Match the byte c against the pattern position at p, which is not '*',
+ * and store in *used the number of pattern bytes the position spans.
+ * Sets are interpreted as stringmatchParseSet() does, without building
+ * the bitmap.
+*/
+/*
+ * 使用 p 处的模式位置（不是 '*'）匹配字节 c，并将这个位置占用的模式字节数保存到 *used 中
+ * 字符集合的解释方式和 stringmatchParseSet() 一样，但不创建位图
+*/
+static int stringmatchOneByte(const unsigned char *p, int plen,
+        unsigned char c, int nocase, int *used)
+{
+    int not, match = 0, j = 1;
+
+    switch (p[0]) {
+    case '?':
+        *used = 1;
+        return 1;
+    case '[':
+        not = plen > 1 && p[1] == '^';
+        if (not) j++;
+        while (j < plen && p[j] != ']') {
+            if (p[j] == '\\' && plen - j >= 2) {
+                // 转义的字符总是区分大小写
+                j++;
+                if (p[j] == c) match = 1;
+            } else if (plen - j >= 3 && p[j + 1] == '-') {
+                int start = p[j], end = p[j + 2], lc = c;
+
+                if (start > end) {
+                    int t = start;
+
+                    start = end;
+                    end = t;
+                }
+                if (nocase) {
+                    start = tolower(start);
+                    end = tolower(end);
+                    lc = tolower(lc);
+                }
+                if (lc >= start && lc <= end) match = 1;
+                j += 2;
+            } else if (nocase ? tolower(p[j]) == tolower(c) : p[j] == c) {
+                match = 1;
+            }
+            j++;
+        }
+        // 跳过 ']'，没有 ']' 时集合一直延续到模式结束
+        *used = j + (j < plen);
+        return not ? !match : match;
+    case '\\':
+        if (plen >= 2) {
+            *used = 2;
+            return p[1] == c || (nocase && tolower(p[1]) == tolower(c));
+        }
+        /* fall through */
+    default:
+        *used = 1;
+        return p[0] == c || (nocase && tolower(p[0]) == tolower(c));
+    }
+}
+
+/*
+ * Glob-style pattern matching of a single string, with the same syntax
+ * as stringmatchCompile() but without compiling, so without allocating.
+ *
+ * Every position other than '*' matches exactly one byte, so on a
+ * mismatch it is enough to retry from the last '*', one byte further in
+ * the string: the earlier '*' can't help, whatever they matched the last
+ * one can match as well. No recursion, and O(N*M) in the worst case
+ * instead of O(N^K) for K stars.
+ *
+ * Code matching many strings against the same pattern, like KEYS and
+ * SCAN MATCH, should compile it once instead: the compiled form is O(N).
+ *
+ * T = O(N*M)
+*/
+/*
+ * 使用 glob 模式匹配一个字符串，语法和 stringmatchCompile() 相同，
+ * 但不编译模式，因此也不分配内存
+ *
+ * 除了 '*' 之外的每个位置都只匹配一个字节，所以不匹配时，
+ * 只需要从最后一个 '*' 处、在字符串中前进一个字节重新尝试：
+ * 更早的 '*' 没有帮助，它们匹配的内容最后一个 '*' 同样可以匹配
+ * 不需要递归，最坏情况下为 O(N*M)，而不是 K 个 '*' 时的 O(N^K)
+ *
+ * 需要用同一个模式匹配很多字符串时（比如 KEYS 和 SCAN MATCH），应该只编译一次：
+ * 编译好的模式的匹配是 O(N) 的
+*/
+int stringmatchlen(const char *pattern, int plen, const char *str, int slen,
+        int nocase)
+{
+    const unsigned char *p = (const unsigned char*)pattern;
+    const unsigned char *s = (const unsigned char*)str;
+    int pi = 0, si = 0, star_pi = -1, star_si = 0, used;
+
+    while (si < slen) {
+        if (pi < plen && p[pi] == '*') {
+            // 连续的 '*' 等于一个，模式以 '*' 结束时剩下的字符串总是匹配
+            while (pi < plen && p[pi] == '*') pi++;
+            if (pi == plen) return 1;
+            star_pi = pi;
+            star_si = si;
+            continue;
+        }
+        if (pi < plen && stringmatchOneByte(p + pi, plen - pi, s[si], nocase, &used)) {
+            pi += used;
+            si++;
+            continue;
+        }
+        // 回到最后一个 '*'，让它多匹配一个字节
+        if (star_pi < 0) return 0;
+        pi = star_pi;
+        si = ++star_si;
+    }
+    while (pi < plen && p[pi] == '*') pi++;
+    return pi == plen;
+}
+
+int stringmatch(const char *p, const char *s, int nocase) {
+    return stringmatchlen(p, strlen(p), s, strlen(s), nocase);
 }
 
 /*
@@ -88,4 +624,419 @@ int ll2string(char *s, size_t len, long long value) {
     memcpy(s, p, l);
     s[l] = '\0';
     return l;
-}
\ No newline at end of file
+}
+
+/*
+ * Return the number of digits of v when converted to string in radix 10.
+ *
+ * T = O(1)
+*/
+// 返回 v 转换为十进制字符串之后的位数
+uint32_t digits10(uint64_t v) {
+    if (v < 10) return 1;
+    if (v < 100) return 2;
+    if (v < 1000) return 3;
+    if (v < 1000000000000ULL) {
+        if (v < 100000000ULL) {
+            if (v < 1000000) {
+                if (v < 10000) return 4;
+                return 5 + (v >= 100000);
+            }
+            return 7 + (v >= 10000000ULL);
+        }
+        if (v < 10000000000ULL) {
+            return 9 + (v >= 1000000000ULL);
+        }
+        return 11 + (v >= 100000000000ULL);
+    }
+    return 12 + digits10(v / 1000000000000ULL);
+}
+
+/*
+ * Convert a string into a long long. Returns 1 if the string could be
+ * parsed into a (non-overflowing) long long, 0 otherwise. The value will
+ * be set to the parsed value when appropriate.
+ *
+ * Only strings that are the exact representation of the number are
+ * accepted: no spaces, no leading zeroes, no '+' sign. This way
+ * ll2string(string2ll(s)) == s, which is what the integer encodings rely
+ * on.
+*/
+/*
+ * 将字符串转换为 long long 整数
+ * 字符串可以被解析为不溢出的 long long 时返回 1，并将 value 设置为解析得到的值，
+ * 否则返回 0
+ *
+ * 只接受数字的精确表示：不能有空格、前导零或者 '+' 号，
+ * 这样 ll2string(string2ll(s)) == s，整数编码依赖于这一点
+*/
+int string2ll(const char *s, size_t slen, long long *value) {
+    const char *p = s;
+    size_t plen = 0;
+    int negative = 0;
+    unsigned long long v;
+
+    if (plen == slen) return 0;
+
+    /* Special case: first and only digit is 0. */
+    if (slen == 1 && p[0] == '0') {
+        if (value != NULL) *value = 0;
+        return 1;
+    }
+
+    if (p[0] == '-') {
+        negative = 1;
+        p++; plen++;
+
+        /* Abort on only a negative sign. */
+        if (plen == slen) return 0;
+    }
+
+    /* First digit should be 1-9, otherwise the string should just be 0. */
+    if (p[0] >= '1' && p[0] <= '9') {
+        v = p[0] - '0';
+        p++; plen++;
+    } else {
+        return 0;
+    }
+
+    while (plen < slen && p[0] >= '0' && p[0] <= '9') {
+        if (v > (ULLONG_MAX / 10)) /* Overflow. */
+            return 0;
+        v *= 10;
+
+        if (v > (ULLONG_MAX - (p[0] - '0'))) /* Overflow. */
+            return 0;
+        v += p[0] - '0';
+
+        p++; plen++;
+    }
+
+    /* Return if not all bytes were used. */
+    if (plen < slen) return 0;
+
+    if (negative) {
+        if (v > ((unsigned long long)(-(LLONG_MIN + 1)) + 1)) /* Overflow. */
+            return 0;
+        if (value != NULL) *value = -v;
+    } else {
+        if (v > LLONG_MAX) /* Overflow. */
+            return 0;
+        if (value != NULL) *value = v;
+    }
+    return 1;
+}
+
+/*
+ * Convert a string into a long. Returns 1 if the string could be parsed
+ * into a (non-overflowing) long, 0 otherwise.
+*/
+// 将字符串转换为 long 整数，成功返回 1，失败返回 0
+int string2l(const char *s, size_t slen, long *lval) {
+    long long llval;
+
+    if (!string2ll(s, slen, &llval)) return 0;
+    if (llval < LONG_MIN || llval > LONG_MAX) return 0;
+
+    *lval = (long)llval;
+    return 1;
+}
+
+#ifdef UTIL_TEST_MAIN
+#include "monotonic.h"
+#include "testhelp.h"
+
+/*
+ * The recursive matcher that stringmatchlen() replaced, kept as the
+ * reference for the tests and the benchmark. Every '*' tries all the
+ * suffixes of the string, so K stars cost O(N^K) on a string that
+ * almost matches.
+*/
+// stringmatchlen() 替换掉的递归匹配函数，作为测试和基准测试的参照
+// 每个 '*' 都要尝试字符串的所有后缀，所以对于几乎匹配的字符串，K 个 '*' 的代价是 O(N^K)
+static int recursiveStringmatchlen(const char *pattern, int patternLen,
+        const char *string, int stringLen, int nocase)
+{
+    while (patternLen) {
+        switch (pattern[0]) {
+        case '*':
+            while (patternLen > 1 && pattern[1] == '*') {
+                pattern++;
+                patternLen--;
+            }
+            if (patternLen == 1) return 1;
+            while (stringLen) {
+                if (recursiveStringmatchlen(pattern + 1, patternLen - 1,
+                            string, stringLen, nocase))
+                    return 1;
+                string++;
+                stringLen--;
+            }
+            return 0;
+        case '?':
+            if (stringLen == 0) return 0;
+            string++;
+            stringLen--;
+            break;
+        case '[':
+        {
+            int not, match = 0;
+
+            if (stringLen == 0) return 0;
+            pattern++;
+            patternLen--;
+            not = patternLen > 0 && pattern[0] == '^';
+            if (not) {
+                pattern++;
+                patternLen--;
+            }
+            while (1) {
+                if (patternLen >= 2 && pattern[0] == '\\') {
+                    pattern++;
+                    patternLen--;
+                    if (pattern[0] == string[0]) match = 1;
+                } else if (patternLen == 0) {
+                    pattern--;
+                    patternLen++;
+                    break;
+                } else if (pattern[0] == ']') {
+                    break;
+                } else if (patternLen >= 3 && pattern[1] == '-') {
+                    int start = (unsigned char)pattern[0];
+                    int end = (unsigned char)pattern[2];
+                    int c = (unsigned char)string[0];
+
+                    if (start > end) {
+                        int t = start;
+
+                        start = end;
+                        end = t;
+                    }
+                    if (nocase) {
+                        start = tolower(start);
+                        end = tolower(end);
+                        c = tolower(c);
+                    }
+                    pattern += 2;
+                    patternLen -= 2;
+                    if (c >= start && c <= end) match = 1;
+                } else if (!nocase) {
+                    if (pattern[0] == string[0]) match = 1;
+                } else {
+                    if (tolower((unsigned char)pattern[0]) ==
+                        tolower((unsigned char)string[0])) match = 1;
+                }
+                pattern++;
+                patternLen--;
+            }
+            if (not) match = !match;
+            if (!match) return 0;
+            string++;
+            stringLen--;
+            break;
+        }
+        case '\\':
+            if (patternLen >= 2) {
+                pattern++;
+                patternLen--;
+            }
+            /* fall through */
+        default:
+            if (stringLen == 0) return 0;
+            if (!nocase) {
+                if (pattern[0] != string[0]) return 0;
+            } else {
+                if (tolower((unsigned char)pattern[0]) !=
+                    tolower((unsigned char)string[0])) return 0;
+            }
+            string++;
+            stringLen--;
+            break;
+        }
+        pattern++;
+        patternLen--;
+        if (stringLen == 0) {
+            while (patternLen > 0 && pattern[0] == '*') {
+                pattern++;
+                patternLen--;
+            }
+            break;
+        }
+    }
+    return patternLen == 0 && stringLen == 0;
+}
+
+// 使用给定字母表中的字符，生成长度在 [0, maxlen) 之间的随机字符串
+static int utilTestRandomString(char *buf, int maxlen, const char *alphabet) {
+    int len = rand() % maxlen, alen = strlen(alphabet), j;
+
+    for (j = 0; j < len; j++) buf[j] = alphabet[rand() % alen];
+    return len;
+}
+
+/*
+ * Time the recursive matcher against stringmatchlen() on one string, and
+ * against a compiled pattern. Calls are repeated until they took 100ms.
+*/
+// 在一个字符串上比较递归匹配函数、stringmatchlen() 和编译好的模式的耗时
+// 每种调用重复执行，直到耗时超过 100 毫秒
+static double utilTestTimeMatch(int which, const char *p, const char *s,
+        stringmatchPattern *pat)
+{
+    int plen = strlen(p), slen = strlen(s);
+    long calls = 0;
+    monotime start;
+
+    elapsedStart(&start);
+    do {
+        if (which == 0) recursiveStringmatchlen(p, plen, s, slen, 0);
+        else if (which == 1) stringmatchlen(p, plen, s, slen, 0);
+        else stringmatchExec(pat, s, slen);
+        calls++;
+    } while (elapsedUs(start) < 100000);
+    return (double)elapsedUs(start) / calls;
+}
+
+int main(void) {
+    static const struct {
+        const char *pattern, *string;
+        int nocase, match;
+    } cases[] = {
+        {"", "", 0, 1}, {"", "a", 0, 0}, {"*", "", 0, 1}, {"*", "abc", 0, 1},
+        {"**", "", 0, 1}, {"?", "", 0, 0}, {"?", "a", 0, 1}, {"a?c", "abc", 0, 1},
+        {"h*llo", "hllo", 0, 1}, {"h*llo", "heeeello", 0, 1},
+        {"h*llo", "hello world", 0, 0}, {"*llo", "hello", 0, 1},
+        {"user:*", "user:1000", 0, 1}, {"user:*", "users:1000", 0, 0},
+        {"*:session:*", "app:session:42", 0, 1}, {"*:session:*", "session:42", 0, 0},
+        {"*a*b*a*", "xaxbxa", 0, 1}, {"*a*b*a*", "xaxaxb", 0, 0},
+        {"h[ae]llo", "hallo", 0, 1}, {"h[ae]llo", "hillo", 0, 0},
+        {"h[^e]llo", "hallo", 0, 1}, {"h[^e]llo", "hello", 0, 0},
+        {"h[a-b]llo", "hbllo", 0, 1}, {"h[b-a]llo", "hbllo", 0, 1},
+        {"[a-c]*[x-z]", "bqqqy", 0, 1}, {"[]", "a", 0, 0}, {"[^]", "a", 0, 1},
+        {"[abc", "b", 0, 1}, {"[abc", "bc", 0, 0}, {"[", "", 0, 0},
+        {"\\*", "*", 0, 1}, {"\\*", "a", 0, 0}, {"a\\", "a\\", 0, 1},
+        {"[\\]]", "]", 0, 1}, {"[\\-]", "-", 0, 1},
+        {"HELLO", "hello", 1, 1}, {"HELLO", "hello", 0, 0},
+        {"*LL*", "hello", 1, 1}, {"h[A-Z]llo", "hello", 1, 1},
+        {"[\\A]", "a", 1, 0}, {"[\\A]", "A", 1, 1},
+        {"*a*a*a*a*a*a*a*b", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 0, 1},
+        {"*a*a*a*a*a*a*a*b", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 0, 0},
+    };
+    static const char *alphabet[] = {"ab*?[]^-\\", "abAB*?[]^-\\", "ab"};
+    stringmatchPattern *pat;
+    char p[16], s[16], buf[64];
+    long j, mismatches = 0;
+    int ok = 1, i;
+
+    monotonicInit();
+
+    for (j = 0; j < (long)(sizeof(cases) / sizeof(cases[0])); j++) {
+        int match = stringmatch(cases[j].pattern, cases[j].string, cases[j].nocase);
+        int compiled;
+
+        pat = stringmatchCompile(cases[j].pattern, strlen(cases[j].pattern),
+            cases[j].nocase);
+        compiled = stringmatchExec(pat, cases[j].string, strlen(cases[j].string));
+        stringmatchFree(pat);
+        if (match != cases[j].match || compiled != cases[j].match) {
+            printf("'%s' against '%s' (nocase %d): %d, compiled %d\n",
+                cases[j].pattern, cases[j].string, cases[j].nocase, match, compiled);
+            ok = 0;
+        }
+    }
+    test_cond("stringmatch() and compiled patterns match the documented syntax", ok);
+
+    // 和递归匹配函数比较随机的模式和字符串，包括未闭合的集合、转义以及大小写
+    srand(1234);
+    for (j = 0; j < 1000000; j++) {
+        int plen = utilTestRandomString(p, sizeof(p), alphabet[j % 2]);
+        int slen = utilTestRandomString(s, sizeof(s), alphabet[1 + j % 2]);
+        int nocase = (j / 2) % 2;
+        int match = recursiveStringmatchlen(p, plen, s, slen, nocase);
+
+        pat = stringmatchCompile(p, plen, nocase);
+        if (stringmatchlen(p, plen, s, slen, nocase) != match ||
+            stringmatchExec(pat, s, slen) != match)
+        {
+            if (mismatches++ == 0) {
+                printf("'%.*s' against '%.*s' (nocase %d)\n",
+                    plen, p, slen, s, nocase);
+            }
+        }
+        stringmatchFree(pat);
+    }
+    test_cond("1000000 random patterns agree with the recursive matcher",
+        mismatches == 0);
+
+    // 长度超过 64 的中间片段不使用 Shift-And
+    ok = 1;
+    for (j = 0; j < 100000 && ok; j++) {
+        char lp[160], ls[256];
+        int lplen, lslen, k;
+
+        lplen = snprintf(lp, sizeof(lp), "*");
+        for (k = 0; k < 70; k++) lp[lplen++] = "ab?"[rand() % 3];
+        lp[lplen++] = '*';
+        lslen = utilTestRandomString(ls, sizeof(ls), "ab");
+        pat = stringmatchCompile(lp, lplen, 0);
+        k = recursiveStringmatchlen(lp, lplen, ls, lslen, 0);
+        ok = stringmatchlen(lp, lplen, ls, lslen, 0) == k &&
+             stringmatchExec(pat, ls, lslen) == k;
+        stringmatchFree(pat);
+    }
+    test_cond("Segments longer than 64 bytes agree with the recursive matcher", ok);
+
+    // 编译好的模式可以重复使用
+    pat = stringmatchCompile("key:[0-9]*:?", 12, 0);
+    ok = 1;
+    for (j = 0; j < 100000; j++) {
+        int len = snprintf(buf, sizeof(buf), "key:%ld:%c", j, j % 2 ? 'x' : 'y');
+
+        if (!stringmatchExec(pat, buf, len)) ok = 0;
+        if (stringmatchExec(pat, buf, len - 1)) ok = 0;
+    }
+    stringmatchFree(pat);
+    test_cond("A compiled pattern can be used many times", ok);
+
+    {
+        static const struct {
+            const char *pattern;
+            int as;
+        } bench[] = {
+            {"*a*a*a*b", 200},
+            {"*a*a*a*b*", 200},
+            {"*a*a*a*a*a*a*a*b", 32},
+            {"*a*a*a*a*a*a*a*b*", 32},
+            {"a*a*a*a*a*a*a*a*a*a*a*a*b", 24},
+            {"a*a*a*a*a*a*a*a*a*a*a*a*b*", 24},
+            {"user:*", 0},
+            {"*:session:*", 0},
+            {"*[0-9][0-9][0-9]", 0},
+        };
+        const char *ordinary = "user:1000:session:4c0a3b27-52d7-4b1e-9a7c-17e2a3b9d123";
+
+        printf("Matching time, recursive vs stringmatchlen() vs compiled:\n");
+        for (i = 0; i < (int)(sizeof(bench) / sizeof(bench[0])); i++) {
+            char str[256];
+            double t[3];
+            int k;
+
+            // 对抗性的输入：全部都是 'a'，几乎匹配但最后不匹配
+            if (bench[i].as) {
+                for (k = 0; k < bench[i].as; k++) str[k] = 'a';
+                str[k] = '\0';
+            } else {
+                snprintf(str, sizeof(str), "%s", ordinary);
+            }
+            pat = stringmatchCompile(bench[i].pattern, strlen(bench[i].pattern), 0);
+            for (k = 0; k < 3; k++) t[k] = utilTestTimeMatch(k, bench[i].pattern, str, pat);
+            printf("  %-26s %3d bytes %12.3f us %9.3f us %9.3f us\n",
+                bench[i].pattern, (int)strlen(str), t[0], t[1], t[2]);
+            stringmatchFree(pat);
+        }
+    }
+
+    test_report();
+    return 0;
+}
+#endif
@@ -1,12 +1,22 @@
 #ifndef __UTIL_H__
 #define __UTIL_H__
 
+#include <stdint.h>
+
 #include "sds.h"
 
+/* Compiled glob-style pattern, see stringmatchCompile() */
+// 编译好的 glob 模式，见 stringmatchCompile()
+typedef struct stringmatchPattern stringmatchPattern;
+
+stringmatchPattern *stringmatchCompile(const char *p, int plen, int nocase);
+int stringmatchExec(const stringmatchPattern *pat, const char *s, int slen);
+void stringmatchFree(stringmatchPattern *pat);
 int stringmatchlen(const char *p, int plen, const char *s, int slen, int nocase);
 int stringmatch(const char *p, const char *s, int nocase);
 long long memtoll(const char *p, int *err);
 int ll2string(char *s, size_t len, long long value);
+uint32_t digits10(uint64_t v);
 int string2ll(const char *s, size_t slen, long long *value);
 int string2l(const char *s, size_t slen, long *value);
 int d2string(char *buf, size_t len, double value);
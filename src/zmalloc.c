@@ -97,7 +97,7 @@ pthread_mutex_t used_memory_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void zmalloc_default_oom(size_t size) {
     fprintf(stderr, "zmalloc: Out of memory trying to allocate %zu bytes\n", size);
     fflush(stderr);
-    about();        // 中断退出
+    abort();        // 中断退出
 }
 
 static void(*zmalloc_oom_handler)(size_t) = zmalloc_default_oom;
@@ -260,7 +260,7 @@ size_t zmalloc_used_memory(void) {
 }
 
 // 开启线程安全
-void zmalloc_enable_thread_safemess(void) {
+void zmalloc_enable_thread_safeness(void) {
     zmalloc_thread_safe = 1;
 }
 
@@ -7,12 +7,13 @@
 #define __ZSKIPLIST_H__
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "redis.h"
 #include "dict.h"
 
 #define ZSKIPLIST_MAXLEVEL 32 /* Should be enough for 2^32 elements */
-#define ZSKIPLIST_P 0.25      /* Skiplist P = 1/4 */
+#define ZSKIPLIST_P 0.25      /* Skiplist P = 1/4, zslRandomLevel() relies on it */
 
 /* ZSETs use a specialized version of Skiplists */
 // 跳跃表结点
@@ -67,10 +68,13 @@ typedef struct {
     int minex, maxex;       // are min or max exclusive?
 } zlexrangespec;
 
+void zslSetRandomSeed(uint64_t seed);
+int zslRandomLevel(void);
 zskiplist *zslCreate(void);
 void zslFree(zskiplist *zsl);
 zskiplistNode *zslInsert(zskiplist *zsl, double score, robj *obj);
 int zslDelete(zskiplist *zsl, double score, robj *obj);
+zskiplistNode *zslUpdateScore(zskiplist *zsl, double curscore, robj *obj, double newscore);
 void zslDeleteNode(zskiplist *zsl, zskiplistNode *x, zskiplistNode **update);
 zskiplistNode *zslFirstInRange(zskiplist *zsl, zrangespec *range);
 zskiplistNode *zslLastInRange(zskiplist *zsl, zrangespec *range);